@@ -139,6 +139,9 @@ LSMASHVideoSource::LSMASHVideoSource
     enum AVPixelFormat  pixel_format,
     const char         *preferred_decoder_names,
     int                 prefer_hw_decoder,
+    size_t              frame_cache_size,
+    int                 scale_threads,
+    int                 lookahead_depth,
     IScriptEnvironment *env
 ) : LSMASHVideoSource{}
 {
@@ -150,9 +153,13 @@ LSMASHVideoSource::LSMASHVideoSource
     libavsmash_video_set_forward_seek_threshold ( vdhp, forward_seek_threshold );
     libavsmash_video_set_preferred_decoder_names( vdhp, tokenize_preferred_decoder_names() );
     libavsmash_video_set_prefer_hw_decoder      ( vdhp, prefer_hw_decoder );
+    libavsmash_video_set_lookahead_depth        ( vdhp, lookahead_depth );
+    if( libavsmash_video_set_frame_cache_size( vdhp, frame_cache_size ) < 0 )
+        env->ThrowError( "LSMASHVideoSource: failed to allocate the frame cache." );
     vohp->vfr2cfr = (fps_num > 0 && fps_den > 0);
     vohp->cfr_num = (uint32_t)fps_num;
     vohp->cfr_den = (uint32_t)fps_den;
+    vohp->scaler.threads = scale_threads;
     as_video_output_handler_t *as_vohp = (as_video_output_handler_t *)lw_malloc_zero( sizeof(as_video_output_handler_t) );
     if( as_vohp == nullptr )
         env->ThrowError( "LSMASHVideoSource: failed to allocate the AviSynth video output handler." );
@@ -355,6 +362,7 @@ LSMASHAudioSource::LSMASHAudioSource
     uint64_t            channel_layout,
     int                 sample_rate,
     const char         *preferred_decoder_names,
+    size_t              pcm_cache_size,
     IScriptEnvironment *env
 ) : LSMASHAudioSource{}
 {
@@ -365,6 +373,7 @@ LSMASHAudioSource::LSMASHAudioSource
     libavsmash_audio_set_preferred_decoder_names( adhp, tokenize_preferred_decoder_names() );
     get_audio_track( source, track_number, env );
     prepare_audio_decoding( adhp, aohp, format_ctx.get(), channel_layout, sample_rate, skip_priming, vi, env );
+    libavsmash_audio_set_pcm_cache_size( adhp, pcm_cache_size );
     lsmash_discard_boxes( libavsmash_audio_get_root( adhp ) );
 }
 
@@ -422,14 +431,21 @@ AVSValue __cdecl CreateLSMASHVideoSource( AVSValue args, void *user_data, IScrip
     const char *preferred_decoder_names = args[9].AsString( nullptr );
     int         prefer_hw_decoder       = args[10].AsInt( 0 );
     int         ff_loglevel             = args[11].AsInt( 0 );
+    int         cache_mb                = args[12].AsInt( 0 );
+    int         scale_threads           = args[13].AsInt( 1 );
+    int         lookahead_depth         = args[14].AsInt( 0 );
     threads                = threads >= 0 ? threads : 0;
     seek_mode              = CLIP_VALUE( seek_mode, 0, 2 );
     forward_seek_threshold = CLIP_VALUE( forward_seek_threshold, 1, 999 );
     direct_rendering      &= (pixel_format == AV_PIX_FMT_NONE);
     prefer_hw_decoder      = CLIP_VALUE( prefer_hw_decoder, 0, 3 );
+    scale_threads          = CLIP_VALUE( scale_threads, 1, 64 );
+    lookahead_depth        = CLIP_VALUE( lookahead_depth, 0, 64 );
+    size_t frame_cache_size = (size_t)MIN( (uint64_t)MAX( cache_mb, 0 ), (uint64_t)(SIZE_MAX >> 20) ) << 20;
     set_av_log_level( ff_loglevel );
     return new LSMASHVideoSource( source, track_number, threads, seek_mode, forward_seek_threshold,
-                                  direct_rendering, fps_num, fps_den, pixel_format, preferred_decoder_names, prefer_hw_decoder, env );
+                                  direct_rendering, fps_num, fps_den, pixel_format, preferred_decoder_names, prefer_hw_decoder, frame_cache_size,
+                                  scale_threads, lookahead_depth, env );
 }
 
 AVSValue __cdecl CreateLSMASHAudioSource( AVSValue args, void *user_data, IScriptEnvironment *env )
@@ -441,8 +457,10 @@ AVSValue __cdecl CreateLSMASHAudioSource( AVSValue args, void *user_data, IScrip
     int         sample_rate             = args[4].AsInt( 0 );
     const char *preferred_decoder_names = args[5].AsString( nullptr );
     int         ff_loglevel             = args[6].AsInt( 0 );
+    int         cache_mb                = args[7].AsInt( 0 );
     uint64_t channel_layout = layout_string ? av_get_channel_layout( layout_string ) : 0;
+    size_t pcm_cache_size = (size_t)MIN( (uint64_t)MAX( cache_mb, 0 ), (uint64_t)(SIZE_MAX >> 20) ) << 20;
     set_av_log_level( ff_loglevel );
     return new LSMASHAudioSource( source, track_number, skip_priming,
-                                  channel_layout, sample_rate, preferred_decoder_names, env );
+                                  channel_layout, sample_rate, preferred_decoder_names, pcm_cache_size, env );
 }
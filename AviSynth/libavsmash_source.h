@@ -73,6 +73,9 @@ public:
         enum AVPixelFormat  pixel_format,
         const char         *preferred_decoder_names,
         int                 prefer_hw_decoder,
+        size_t              frame_cache_size,
+        int                 scale_threads,
+        int                 lookahead_depth,
         IScriptEnvironment *env
     );
     ~LSMASHVideoSource();
@@ -110,6 +113,7 @@ public:
         uint64_t            channel_layout,
         int                 sample_rate,
         const char         *preferred_decoder_names,
+        size_t              pcm_cache_size,
         IScriptEnvironment *env
     );
     ~LSMASHAudioSource();
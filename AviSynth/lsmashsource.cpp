@@ -48,18 +48,22 @@ extern AVSValue __cdecl CreateLSMASHVideoSource( AVSValue args, void *user_data,
 extern AVSValue __cdecl CreateLSMASHAudioSource( AVSValue args, void *user_data, IScriptEnvironment *env );
 extern AVSValue __cdecl CreateLWLibavVideoSource( AVSValue args, void *user_data, IScriptEnvironment *env );
 extern AVSValue __cdecl CreateLWLibavAudioSource( AVSValue args, void *user_data, IScriptEnvironment *env );
+extern AVSValue __cdecl CreateLWLibavInfo( AVSValue args, void *user_data, IScriptEnvironment *env );
+extern "C" void lwlibav_setup_index_registry( void );
 
 const AVS_Linkage* AVS_linkage = 0;
 
 extern "C" AVS_EXPORT const char* __stdcall AvisynthPluginInit3( IScriptEnvironment* env, const AVS_Linkage* const vectors )
 {
     AVS_linkage = vectors;
+    /* Let the sources of the same file share the parsed index. */
+    lwlibav_setup_index_registry();
 
     /* LSMASHVideoSource */
     env->AddFunction
     (
         "LSMASHVideoSource",
-        "[source]s[track]i[threads]i[seek_mode]i[seek_threshold]i[dr]b[fpsnum]i[fpsden]i[format]s[decoder]s[prefer_hw]i[ff_loglevel]i",
+        "[source]s[track]i[threads]i[seek_mode]i[seek_threshold]i[dr]b[fpsnum]i[fpsden]i[format]s[decoder]s[prefer_hw]i[ff_loglevel]i[cache_mb]i[scale_threads]i[lookahead]i",
         CreateLSMASHVideoSource,
         0
     );
@@ -67,7 +71,7 @@ extern "C" AVS_EXPORT const char* __stdcall AvisynthPluginInit3( IScriptEnvironm
     env->AddFunction
     (
         "LSMASHAudioSource",
-        "[source]s[track]i[skip_priming]b[layout]s[rate]i[decoder]s[ff_loglevel]i",
+        "[source]s[track]i[skip_priming]b[layout]s[rate]i[decoder]s[ff_loglevel]i[cache_mb]i",
         CreateLSMASHAudioSource,
         0
     );
@@ -75,7 +79,7 @@ extern "C" AVS_EXPORT const char* __stdcall AvisynthPluginInit3( IScriptEnvironm
     env->AddFunction
     (
         "LWLibavVideoSource",
-        "[source]s[stream_index]i[threads]i[cache]b[cachefile]s[seek_mode]i[seek_threshold]i[dr]b[fpsnum]i[fpsden]i[repeat]b[dominance]i[format]s[decoder]s[prefer_hw]i[ff_loglevel]i",
+        "[source]s[stream_index]i[threads]i[cache]b[cachefile]s[seek_mode]i[seek_threshold]i[dr]b[fpsnum]i[fpsden]i[repeat]b[dominance]i[format]s[decoder]s[prefer_hw]i[ff_loglevel]i[text_index]b[cache_mb]i[cache_gop]b[content_hash]i[prefetch]i[scale_threads]i[lookahead]i[partial_index]b",
         CreateLWLibavVideoSource,
         0
     );
@@ -83,9 +87,17 @@ extern "C" AVS_EXPORT const char* __stdcall AvisynthPluginInit3( IScriptEnvironm
     env->AddFunction
     (
         "LWLibavAudioSource",
-        "[source]s[stream_index]i[cache]b[cachefile]s[av_sync]b[layout]s[rate]i[decoder]s[ff_loglevel]i",
+        "[source]s[stream_index]i[cache]b[cachefile]s[av_sync]b[layout]s[rate]i[decoder]s[ff_loglevel]i[text_index]b[content_hash]i[cache_mb]i[decode_threads]i[partial_index]b",
         CreateLWLibavAudioSource,
         0
     );
+    /* LWLibavInfo */
+    env->AddFunction
+    (
+        "LWLibavInfo",
+        "[source]s[stream_index]i[cachefile]s[content_hash]i[audio]b",
+        CreateLWLibavInfo,
+        0
+    );
     return "LSMASHSource";
 }
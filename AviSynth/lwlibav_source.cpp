@@ -100,6 +100,11 @@ LWLibavVideoSource::LWLibavVideoSource
     enum AVPixelFormat  pixel_format,
     const char         *preferred_decoder_names,
     int                 prefer_hw_decoder,
+    size_t              frame_cache_size,
+    int                 gop_retention,
+    int                 prefetch_depth,
+    int                 scale_threads,
+    int                 lookahead_depth,
     IScriptEnvironment *env
 ) : LWLibavVideoSource{}
 {
@@ -112,6 +117,12 @@ LWLibavVideoSource::LWLibavVideoSource
     lwlibav_video_set_forward_seek_threshold ( vdhp, forward_seek_threshold );
     lwlibav_video_set_preferred_decoder_names( vdhp, tokenize_preferred_decoder_names() );
     lwlibav_video_set_prefer_hw_decoder      ( vdhp, prefer_hw_decoder);
+    if( lwlibav_video_set_frame_cache_size( vdhp, frame_cache_size ) < 0 )
+        env->ThrowError( "LWLibavVideoSource: failed to allocate the frame cache." );
+    lwlibav_video_set_gop_retention          ( vdhp, gop_retention );
+    lwlibav_video_set_prefetch_depth         ( vdhp, prefetch_depth );
+    lwlibav_video_set_lookahead_depth        ( vdhp, lookahead_depth );
+    vohp->scaler.threads = scale_threads;
     as_video_output_handler_t *as_vohp = (as_video_output_handler_t *)lw_malloc_zero( sizeof(as_video_output_handler_t) );
     if( !as_vohp )
         env->ThrowError( "LWLibavVideoSource: failed to allocate the AviSynth video output handler." );
@@ -154,6 +165,7 @@ LWLibavVideoSource::~LWLibavVideoSource()
     lwlibav_video_decode_handler_t *vdhp = this->vdhp.get();
     lw_free( lwlibav_video_get_preferred_decoder_names( vdhp ) );
     lw_free( lwh.file_path );
+    lw_free( lwh.format_name );
 }
 
 PVideoFrame __stdcall LWLibavVideoSource::GetFrame( int n, IScriptEnvironment *env )
@@ -230,6 +242,8 @@ LWLibavAudioSource::LWLibavAudioSource
     uint64_t            channel_layout,
     int                 sample_rate,
     const char         *preferred_decoder_names,
+    size_t              pcm_cache_size,
+    int                 decode_threads,
     IScriptEnvironment *env
 ) : LWLibavAudioSource{}
 {
@@ -258,6 +272,8 @@ LWLibavAudioSource::LWLibavAudioSource
     if( lwlibav_audio_get_desired_track( lwh.file_path, adhp, lwh.threads ) < 0 )
         env->ThrowError( "LWLibavAudioSource: failed to get the audio track." );
     prepare_audio_decoding( adhp, aohp, channel_layout, sample_rate, lwh, vi, env );
+    lwlibav_audio_set_pcm_cache_size( adhp, pcm_cache_size );
+    aohp->decode_threads = decode_threads;
 }
 
 LWLibavAudioSource::~LWLibavAudioSource()
@@ -265,6 +281,7 @@ LWLibavAudioSource::~LWLibavAudioSource()
     lwlibav_audio_decode_handler_t *adhp = this->adhp.get();
     lw_free( lwlibav_audio_get_preferred_decoder_names( adhp ) );
     lw_free( lwh.file_path );
+    lw_free( lwh.format_name );
 }
 
 int LWLibavAudioSource::delay_audio( int64_t *start, int64_t wanted_length )
@@ -333,6 +350,14 @@ AVSValue __cdecl CreateLWLibavVideoSource( AVSValue args, void *user_data, IScri
     const char *preferred_decoder_names = args[13].AsString( nullptr );
     int         prefer_hw_decoder       = args[14].AsInt( 0 );
     int         ff_loglevel             = args[15].AsInt( 0 );
+    int         text_index              = args[16].AsBool( true ) ? 1 : 0;
+    int         cache_mb                = args[17].AsInt( 0 );
+    int         gop_retention           = args[18].AsBool( false ) ? 1 : 0;
+    int         content_hash_stride     = args[19].AsInt( 0 );
+    int         prefetch_depth          = args[20].AsInt( 0 );
+    int         scale_threads           = args[21].AsInt( 1 );
+    int         lookahead_depth         = args[22].AsInt( 0 );
+    int         partial_index           = args[23].AsBool( false ) ? 1 : 0;
     /* Set LW-Libav options. */
     lwlibav_option_t opt;
     opt.file_path         = source;
@@ -340,12 +365,15 @@ AVSValue __cdecl CreateLWLibavVideoSource( AVSValue args, void *user_data, IScri
     opt.av_sync           = 0;
     opt.no_create_index   = no_create_index;
     opt.index_file_path   = index_file_path;
+    opt.text_index        = text_index;
     opt.force_video       = (stream_index >= 0);
     opt.force_video_index = stream_index >= 0 ? stream_index : -1;
     opt.force_audio       = 0;
     opt.force_audio_index = -2;
+    opt.partial_index     = partial_index;
     opt.apply_repeat_flag = apply_repeat_flag;
     opt.field_dominance   = CLIP_VALUE( field_dominance, 0, 2 );    /* 0: Obey source flags, 1: TFF, 2: BFF */
+    opt.content_hash_stride = MAX( content_hash_stride, 0 );
     opt.vfr2cfr.active    = fps_num > 0 && fps_den > 0 ? 1 : 0;
     opt.vfr2cfr.fps_num   = fps_num;
     opt.vfr2cfr.fps_den   = fps_den;
@@ -353,9 +381,14 @@ AVSValue __cdecl CreateLWLibavVideoSource( AVSValue args, void *user_data, IScri
     forward_seek_threshold = CLIP_VALUE( forward_seek_threshold, 1, 999 );
     direct_rendering      &= (pixel_format == AV_PIX_FMT_NONE);
     prefer_hw_decoder      = CLIP_VALUE( prefer_hw_decoder, 0, 3 );
+    prefetch_depth         = CLIP_VALUE( prefetch_depth, 0, 1024 );
+    scale_threads          = CLIP_VALUE( scale_threads, 1, 64 );
+    lookahead_depth        = CLIP_VALUE( lookahead_depth, 0, 64 );
+    size_t frame_cache_size = (size_t)MIN( (uint64_t)MAX( cache_mb, 0 ), (uint64_t)(SIZE_MAX >> 20) ) << 20;
     set_av_log_level( ff_loglevel );
     return new LWLibavVideoSource( &opt, seek_mode, forward_seek_threshold,
-                                   direct_rendering, pixel_format, preferred_decoder_names, prefer_hw_decoder, env );
+                                   direct_rendering, pixel_format, preferred_decoder_names, prefer_hw_decoder, frame_cache_size, gop_retention, prefetch_depth,
+                                   scale_threads, lookahead_depth, env );
 }
 
 AVSValue __cdecl CreateLWLibavAudioSource( AVSValue args, void *user_data, IScriptEnvironment *env )
@@ -369,6 +402,11 @@ AVSValue __cdecl CreateLWLibavAudioSource( AVSValue args, void *user_data, IScri
     uint32_t    sample_rate             = args[6].AsInt( 0 );
     const char *preferred_decoder_names = args[7].AsString( nullptr );
     int         ff_loglevel             = args[8].AsInt( 0 );
+    int         text_index              = args[9].AsBool( true ) ? 1 : 0;
+    int         content_hash_stride     = args[10].AsInt( 0 );
+    int         cache_mb                = args[11].AsInt( 0 );
+    int         decode_threads          = args[12].AsInt( 1 );
+    int         partial_index           = args[13].AsBool( false ) ? 1 : 0;
     /* Set LW-Libav options. */
     lwlibav_option_t opt;
     opt.file_path         = source;
@@ -376,16 +414,86 @@ AVSValue __cdecl CreateLWLibavAudioSource( AVSValue args, void *user_data, IScri
     opt.av_sync           = av_sync;
     opt.no_create_index   = no_create_index;
     opt.index_file_path   = index_file_path;
+    opt.text_index        = text_index;
     opt.force_video       = 0;
     opt.force_video_index = -1;
     opt.force_audio       = (stream_index >= 0);
     opt.force_audio_index = stream_index >= 0 ? stream_index : -1;
+    opt.partial_index     = partial_index;
     opt.apply_repeat_flag = 0;
     opt.field_dominance   = 0;
+    opt.content_hash_stride = MAX( content_hash_stride, 0 );
     opt.vfr2cfr.active    = 0;
     opt.vfr2cfr.fps_num   = 0;
     opt.vfr2cfr.fps_den   = 0;
     uint64_t channel_layout = layout_string ? av_get_channel_layout( layout_string ) : 0;
+    size_t pcm_cache_size = (size_t)MIN( (uint64_t)MAX( cache_mb, 0 ), (uint64_t)(SIZE_MAX >> 20) ) << 20;
+    decode_threads = CLIP_VALUE( decode_threads, 1, 64 );
     set_av_log_level( ff_loglevel );
-    return new LWLibavAudioSource( &opt, channel_layout, sample_rate, preferred_decoder_names, env );
+    return new LWLibavAudioSource( &opt, channel_layout, sample_rate, preferred_decoder_names, pcm_cache_size, decode_threads, env );
+}
+
+static AVSValue make_info_entry( const char *key, AVSValue value )
+{
+    AVSValue entry[2] = { key, value };
+    return AVSValue( entry, 2 );
+}
+
+AVSValue __cdecl CreateLWLibavInfo( AVSValue args, void *user_data, IScriptEnvironment *env )
+{
+    const char *source              = args[0].AsString();
+    int         stream_index        = args[1].AsInt( -1 );
+    const char *index_file_path     = args[2].AsString( nullptr );
+    int         content_hash_stride = args[3].AsInt( 0 );
+    int         audio               = args[4].AsBool( false ) ? 1 : 0;
+    /* Set the options in the same way as LWLibavVideoSource or LWLibavAudioSource so that its index file is found. */
+    lwlibav_option_t opt = { 0 };
+    opt.file_path           = source;
+    opt.index_file_path     = index_file_path;
+    opt.force_video         = !audio && (stream_index >= 0);
+    opt.force_video_index   = audio ? -1 : stream_index >= 0 ? stream_index : -1;
+    opt.force_audio         = audio && (stream_index >= 0);
+    opt.force_audio_index   = !audio ? -2 : stream_index >= 0 ? stream_index : -1;
+    opt.content_hash_stride = MAX( content_hash_stride, 0 );
+    /* Get the metadata from the index file only. */
+    lwlibav_index_metadata_t metadata;
+    if( lwlibav_get_index_metadata( &opt, &metadata ) < 0 )
+        env->ThrowError( "LWLibavInfo: failed to get the metadata from the index file. Open the source first." );
+    lwlibav_stream_metadata_t *smp = audio ? &metadata.audio : &metadata.video;
+    if( smp->stream_index < 0 )
+    {
+        lwlibav_cleanup_index_metadata( &metadata );
+        env->ThrowError( "LWLibavInfo: no %s stream is in the index file.", audio ? "audio" : "video" );
+    }
+    /* Timestamps are given in seconds since AviSynth has no 64-bit integer. */
+    double time_base = av_q2d( smp->time_base );
+    std::unique_ptr< AVSValue[] > timestamps( new AVSValue[ smp->frame_count ] );
+    std::unique_ptr< AVSValue[] > keyframes ( new AVSValue[ MAX( smp->keyframe_count, 1 ) ] );
+    for( uint32_t i = 0; i < smp->frame_count; i++ )
+        timestamps[i] = smp->timestamps[i] * time_base;
+    for( uint32_t i = 0; i < smp->keyframe_count; i++ )
+        keyframes[i] = (int)smp->keyframes[i];
+    /* Return the array of the pairs of the key and the value, which ArrayGet() can look up by the key. */
+    AVSValue entries[9];
+    int count = 0;
+    entries[count++] = make_info_entry( "stream_index", smp->stream_index );
+    entries[count++] = make_info_entry( "codec",        env->SaveString( avcodec_get_name( smp->codec_id ) ) );
+    entries[count++] = make_info_entry( "num_frames",   (int)smp->frame_count );
+    entries[count++] = make_info_entry( "duration",     smp->duration * time_base );
+    entries[count++] = make_info_entry( "timestamps",   AVSValue( timestamps.get(), (int)smp->frame_count ) );
+    entries[count++] = make_info_entry( "keyframes",    AVSValue( keyframes.get(),  (int)smp->keyframe_count ) );
+    if( audio )
+    {
+        entries[count++] = make_info_entry( "sample_rate", metadata.sample_rate );
+        entries[count++] = make_info_entry( "channels",    av_get_channel_layout_nb_channels( metadata.channel_layout ) );
+    }
+    else
+    {
+        const char *pix_fmt_name = av_get_pix_fmt_name( metadata.pix_fmt );
+        entries[count++] = make_info_entry( "width",  metadata.width );
+        entries[count++] = make_info_entry( "height", metadata.height );
+        entries[count++] = make_info_entry( "format", env->SaveString( pix_fmt_name ? pix_fmt_name : "none" ) );
+    }
+    lwlibav_cleanup_index_metadata( &metadata );
+    return AVSValue( entries, count );
 }
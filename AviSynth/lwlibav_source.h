@@ -65,6 +65,11 @@ public:
         enum AVPixelFormat  pixel_format,
         const char         *preferred_decoder_names,
         int                 prefer_hw_decoder,
+        size_t              frame_cache_size,
+        int                 gop_retention,
+        int                 prefetch_depth,
+        int                 scale_threads,
+        int                 lookahead_depth,
         IScriptEnvironment *env
     );
     ~LWLibavVideoSource();
@@ -85,6 +90,8 @@ public:
         uint64_t            channel_layout,
         int                 sample_rate,
         const char         *preferred_decoder_names,
+        size_t              pcm_cache_size,
+        int                 decode_threads,
         IScriptEnvironment *env
     );
     ~LWLibavAudioSource();
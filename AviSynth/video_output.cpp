@@ -30,26 +30,16 @@
 
 #include "lsmashsource.h"
 
-#if _MSC_VER >= 1700
-#define VC_HAS_AVX2 1
-#else
-#define VC_HAS_AVX2 0
-#endif
-
-#include <emmintrin.h>  /* SSE2 */
-#if VC_HAS_AVX2
-#include <immintrin.h>  /* AVX, AVX2 */
-#endif
-
 extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
 }
 
-#include "../common/lwsimd.h"
+#include "../common/semiplanar.h"
 
 #include "video_output.h"
 
@@ -59,15 +49,6 @@ extern "C"
 #define FFMPEG_HIGH_DEPTH_SUPPORT 0
 #endif
 
-static inline __m128i _MM_PACKUS_EPI32( const __m128i &low, const __m128i &high )
-{
-    const __m128i val_32 = _mm_set1_epi32( 0x8000 );
-    const __m128i val_16 = _mm_set1_epi16( 0x8000 );
-    const __m128i low1   = _mm_sub_epi32( low, val_32 );
-    const __m128i high1  = _mm_sub_epi32( high, val_32 );
-    return _mm_add_epi16( _mm_packs_epi32( low1, high1 ), val_16 );
-}
-
 static void make_black_background_planar_yuv
 (
     PVideoFrame &frame,
@@ -127,16 +108,12 @@ static void make_black_background_packed_all_zero
  * So, I think it's OK that we always use swscale instead. */
 static inline int convert_av_pixel_format
 (
-    struct SwsContext *sws_ctx,
-    int                height,
-    AVFrame           *av_frame,
-    as_picture_t      *as_picture
+    lw_video_scaler_handler_t *vshp,
+    AVFrame                   *av_frame,
+    as_picture_t              *as_picture
 )
 {
-    int ret = sws_scale( sws_ctx,
-                         (const uint8_t * const *)av_frame->data, av_frame->linesize,
-                         0, height,
-                         as_picture->data, as_picture->linesize );
+    int ret = scale_video_frame( vshp, av_frame, as_picture->data, as_picture->linesize );
     return ret > 0 ? ret : -1;
 }
 
@@ -164,63 +141,19 @@ static int make_frame_planar_yuv
 {
     as_picture_t as_picture = { { NULL } };
     as_assign_planar_yuv( as_frame, &as_picture );
-    if( vohp->scaler.input_pixel_format == AV_PIX_FMT_P010LE && vohp->scaler.output_pixel_format == AV_PIX_FMT_YUV420P10LE )
+    const lw_video_scaler_handler_t *vshp = &vohp->scaler;
+    if( lw_check_semiplanar_unpack( vshp->input_pixel_format, vshp->output_pixel_format ) )
     {
-        const int width_y       = as_frame->GetRowSize( PLANAR_Y ) / sizeof( uint16_t );
-        const int width_uv      = as_frame->GetRowSize( PLANAR_U ) / sizeof( uint16_t );
-        const int height_y      = as_frame->GetHeight( PLANAR_Y );
-        const int height_uv     = as_frame->GetHeight( PLANAR_U );
-        const int src_pitch_y   = av_frame->linesize[0] / sizeof( uint16_t );
-        const int src_pitch_uv  = av_frame->linesize[1] / sizeof( uint16_t );
-        const int dst_pitch_y   = as_picture.linesize[0] / sizeof( uint16_t );
-        const int dst_pitch_uv  = as_picture.linesize[1] / sizeof( uint16_t );
-        uint16_t *srcp_y        = (uint16_t *)av_frame->data[0];
-        uint16_t *srcp_uv       = (uint16_t *)av_frame->data[1];
-        uint16_t *dstp_y        = (uint16_t *)as_picture.data[0];
-        uint16_t *dstp_u        = (uint16_t *)as_picture.data[1];
-        uint16_t *dstp_v        = (uint16_t *)as_picture.data[2];
-
-        for( int y = 0; y < height_y; y++ )
-        {
-            for( int x = 0; x < width_y; x += 8 )
-            {
-                __m128i yy = _mm_load_si128( (const __m128i *)(srcp_y + x) );
-                yy         = _mm_srli_epi16( yy, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_y + x), yy );
-            }
-            srcp_y += src_pitch_y;
-            dstp_y += dst_pitch_y;
-        }
-
-        const __m128i mask = _mm_set1_epi32(0x0000FFFF);
-        for( int y = 0; y < height_uv; y++ )
-        {
-            for( int x = 0; x < width_uv; x += 8 )
-            {
-                __m128i uv_low  = _mm_load_si128( (__m128i *)((uint32_t *)srcp_uv + x + 0) );
-                __m128i uv_high = _mm_load_si128( (__m128i *)((uint32_t *)srcp_uv + x + 4) );
-
-                __m128i u_low  = _mm_and_si128( uv_low, mask );
-                __m128i u_high = _mm_and_si128( uv_high, mask );
-                __m128i u      = _MM_PACKUS_EPI32( u_low, u_high );
-                u              = _mm_srli_epi16( u, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_u + x), u );
-
-                __m128i v_low  = _mm_srli_epi32( uv_low, 16 );
-                __m128i v_high = _mm_srli_epi32( uv_high, 16 );
-                __m128i v      = _MM_PACKUS_EPI32( v_low, v_high );
-                v              = _mm_srli_epi16( v, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_v + x), v );
-            }
-            srcp_uv += src_pitch_uv;
-            dstp_u  += dst_pitch_uv;
-            dstp_v  += dst_pitch_uv;
-        }
-
-        return height_y;
+        const int bytes_per_sample = av_pix_fmt_desc_get( vshp->output_pixel_format )->comp[0].depth > 8 ? 2 : 1;
+        const int width            = MIN( av_frame->width, as_frame->GetRowSize( PLANAR_Y ) / bytes_per_sample );
+        height = MIN( height, as_frame->GetHeight( PLANAR_Y ) );
+        lw_unpack_semiplanar( vshp->input_pixel_format, vshp->output_pixel_format,
+                              as_picture.data, as_picture.linesize,
+                              av_frame->data, av_frame->linesize, width, height );
+        return height;
     }
     else
-        return convert_av_pixel_format( vohp->scaler.sws_ctx, height, av_frame, &as_picture );
+        return convert_av_pixel_format( &vohp->scaler, av_frame, &as_picture );
 }
 
 static int make_frame_packed_yuv
@@ -234,7 +167,7 @@ static int make_frame_packed_yuv
     as_picture_t as_picture = { { NULL } };
     as_picture.data    [0] = as_frame->GetWritePtr();
     as_picture.linesize[0] = as_frame->GetPitch   ();
-    return convert_av_pixel_format( vohp->scaler.sws_ctx, height, av_frame, &as_picture );
+    return convert_av_pixel_format( &vohp->scaler, av_frame, &as_picture );
 }
 
 static int make_frame_packed_rgb
@@ -248,7 +181,7 @@ static int make_frame_packed_rgb
     as_picture_t as_picture = { { NULL } };
     as_picture.data    [0] = as_frame->GetWritePtr() + as_frame->GetPitch() * (as_frame->GetHeight() - 1);
     as_picture.linesize[0] = -as_frame->GetPitch();
-    return convert_av_pixel_format( vohp->scaler.sws_ctx, height, av_frame, &as_picture );
+    return convert_av_pixel_format( &vohp->scaler, av_frame, &as_picture );
 }
 
 enum AVPixelFormat get_av_output_pixel_format
@@ -343,15 +276,31 @@ static int determine_colorspace_conversion
             { AV_PIX_FMT_YUV422P9BE,  AV_PIX_FMT_YUV422P10LE, VideoInfo::CS_YUV422P10, 2, 1, 0 },
             { AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV422P10LE, VideoInfo::CS_YUV422P10, 2, 1, 0 },
             { AV_PIX_FMT_YUV422P10BE, AV_PIX_FMT_YUV422P10LE, VideoInfo::CS_YUV422P10, 2, 1, 0 },
+#ifdef AV_PIX_FMT_P210
+            { AV_PIX_FMT_P210LE,      AV_PIX_FMT_YUV422P10LE, VideoInfo::CS_YUV422P10, 2, 1, 0 },
+            { AV_PIX_FMT_P210BE,      AV_PIX_FMT_YUV422P10LE, VideoInfo::CS_YUV422P10, 2, 1, 0 },
+#endif
             { AV_PIX_FMT_YUV422P16LE, AV_PIX_FMT_YUV422P16LE, VideoInfo::CS_YUV422P16, 8, 1, 0 },
             { AV_PIX_FMT_YUV422P16BE, AV_PIX_FMT_YUV422P16LE, VideoInfo::CS_YUV422P16, 8, 1, 0 },
+#ifdef AV_PIX_FMT_P216
+            { AV_PIX_FMT_P216LE,      AV_PIX_FMT_YUV422P16LE, VideoInfo::CS_YUV422P16, 8, 1, 0 },
+            { AV_PIX_FMT_P216BE,      AV_PIX_FMT_YUV422P16LE, VideoInfo::CS_YUV422P16, 8, 1, 0 },
+#endif
             { AV_PIX_FMT_YUV444P,     AV_PIX_FMT_YUV444P,     VideoInfo::CS_YV24,      0, 0, 0 },
             { AV_PIX_FMT_YUV444P9LE,  AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
             { AV_PIX_FMT_YUV444P9BE,  AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
             { AV_PIX_FMT_YUV444P10LE, AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
             { AV_PIX_FMT_YUV444P10BE, AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
+#ifdef AV_PIX_FMT_P410
+            { AV_PIX_FMT_P410LE,      AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
+            { AV_PIX_FMT_P410BE,      AV_PIX_FMT_YUV444P10LE, VideoInfo::CS_YUV444P10, 2, 0, 0 },
+#endif
             { AV_PIX_FMT_YUV444P16LE, AV_PIX_FMT_YUV444P16LE, VideoInfo::CS_YUV444P16, 8, 0, 0 },
             { AV_PIX_FMT_YUV444P16BE, AV_PIX_FMT_YUV444P16LE, VideoInfo::CS_YUV444P16, 8, 0, 0 },
+#ifdef AV_PIX_FMT_P416
+            { AV_PIX_FMT_P416LE,      AV_PIX_FMT_YUV444P16LE, VideoInfo::CS_YUV444P16, 8, 0, 0 },
+            { AV_PIX_FMT_P416BE,      AV_PIX_FMT_YUV444P16LE, VideoInfo::CS_YUV444P16, 8, 0, 0 },
+#endif
             { AV_PIX_FMT_YUV410P,     AV_PIX_FMT_YUV410P,     VideoInfo::CS_YUV9,      0, 2, 2 },
             { AV_PIX_FMT_YUV411P,     AV_PIX_FMT_YUV411P,     VideoInfo::CS_YV411,     0, 2, 0 },
             { AV_PIX_FMT_UYYVYY411,   AV_PIX_FMT_YUV411P,     VideoInfo::CS_YV411,     0, 2, 0 },
@@ -359,11 +359,11 @@ static void convert_yv12i_to_yuy2
 
 static int to_yuv16le
 (
-    struct SwsContext *sws_ctx,
-    AVFrame           *picture,
-    AVFrame           *yuv444p16,
-    int                width,
-    int                height
+    lw_video_scaler_handler_t *vshp,
+    AVFrame                   *picture,
+    AVFrame                   *yuv444p16,
+    int                        width,
+    int                        height
 )
 {
     static const struct
@@ -397,7 +397,7 @@ static int to_yuv16le
         return height;
     }
     else
-        return sws_scale( sws_ctx, (const uint8_t* const*)picture->data, picture->linesize, 0, height, yuv444p16->data, yuv444p16->linesize );
+        return scale_video_frame( vshp, picture, yuv444p16->data, yuv444p16->linesize );
 }
 
 int to_yuv16le_to_lw48
@@ -411,7 +411,7 @@ int to_yuv16le_to_lw48
     au_video_output_handler_t *au_vohp = (au_video_output_handler_t *)vohp->private_handler;
     AVFrame *yuv444p16 = au_vohp->yuv444p16;
     int output_rowsize = vshp->input_width * LW48_SIZE;
-    int output_height  = to_yuv16le( vshp->sws_ctx, picture, yuv444p16, vshp->input_width, vshp->input_height );
+    int output_height  = to_yuv16le( vshp, picture, yuv444p16, vshp->input_width, vshp->input_height );
     /* Convert planar YUV 4:4:4 48bpp little-endian into LW48. */
     convert_yuv16le_to_lw48( buf, au_vohp->output_linesize, yuv444p16, output_rowsize, output_height );
     return MAKE_AVIUTL_PITCH( output_rowsize << 3 ) * output_height;
@@ -428,7 +428,7 @@ int to_yuv16le_to_yc48
     au_video_output_handler_t *au_vohp = (au_video_output_handler_t *)vohp->private_handler;
     AVFrame *yuv444p16 = au_vohp->yuv444p16;
     int output_rowsize = vshp->input_width * YC48_SIZE;
-    int output_height  = to_yuv16le( vshp->sws_ctx, picture, yuv444p16, vshp->input_width, vshp->input_height );
+    int output_height  = to_yuv16le( vshp, picture, yuv444p16, vshp->input_width, vshp->input_height );
     /* Convert planar YUV 4:4:4 48bpp little-endian into YC48. */
     static int simd_available = -1;
     if( simd_available == -1 )
@@ -450,7 +450,7 @@ int to_rgba
     au_video_output_handler_t *au_vohp = (au_video_output_handler_t *)vohp->private_handler;
     uint8_t *dst_data    [4] = { buf + au_vohp->output_linesize * (vohp->output_height - 1), NULL, NULL, NULL };
     int      dst_linesize[4] = { -(au_vohp->output_linesize), 0, 0, 0 };
-    int output_height  = sws_scale( vshp->sws_ctx, (const uint8_t* const*)picture->data, picture->linesize, 0, vshp->input_height, dst_data, dst_linesize );
+    int output_height  = scale_video_frame( vshp, picture, dst_data, dst_linesize );
     int output_rowsize = vshp->input_width * RGBA_SIZE;
     return MAKE_AVIUTL_PITCH( output_rowsize << 3 ) * output_height;
 }
@@ -466,7 +466,7 @@ int to_rgb24
     au_video_output_handler_t *au_vohp = (au_video_output_handler_t *)vohp->private_handler;
     uint8_t *dst_data    [4] = { buf + au_vohp->output_linesize * (vohp->output_height - 1), NULL, NULL, NULL };
     int      dst_linesize[4] = { -(au_vohp->output_linesize), 0, 0, 0 };
-    int output_height  = sws_scale( vshp->sws_ctx, (const uint8_t* const*)picture->data, picture->linesize, 0, vshp->input_height, dst_data, dst_linesize );
+    int output_height  = scale_video_frame( vshp, picture, dst_data, dst_linesize );
     int output_rowsize = vshp->input_width * RGB24_SIZE;
     return MAKE_AVIUTL_PITCH( output_rowsize << 3 ) * output_height;
 }
@@ -528,7 +528,7 @@ int to_yuy2
     {
         uint8_t *dst_data    [4] = { buf, NULL, NULL, NULL };
         int      dst_linesize[4] = { au_vohp->output_linesize, 0, 0, 0 };
-        sws_scale( vshp->sws_ctx, (const uint8_t* const*)picture->data, picture->linesize, 0, vshp->input_height, dst_data, dst_linesize );
+        scale_video_frame( vshp, picture, dst_data, dst_linesize );
         output_rowsize = vshp->input_width * YUY2_SIZE;
     }
     return MAKE_AVIUTL_PITCH( output_rowsize << 3 ) * vohp->output_height;
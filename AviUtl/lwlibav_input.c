@@ -204,12 +204,15 @@ static void *open_file( char *file_path, reader_option_t *opt )
     lwlibav_opt.av_sync           = opt->av_sync;
     lwlibav_opt.no_create_index   = opt->no_create_index;
     lwlibav_opt.index_file_path   = NULL;
+    lwlibav_opt.text_index        = 1;
     lwlibav_opt.force_video       = opt->force_video;
     lwlibav_opt.force_video_index = opt->force_video_index;
     lwlibav_opt.force_audio       = opt->force_audio;
     lwlibav_opt.force_audio_index = opt->force_audio_index;
+    lwlibav_opt.partial_index     = 0;
     lwlibav_opt.apply_repeat_flag = opt->video_opt.apply_repeat_flag;
     lwlibav_opt.field_dominance   = opt->video_opt.field_dominance;
+    lwlibav_opt.content_hash_stride = 0;
     lwlibav_opt.vfr2cfr.active    = opt->video_opt.vfr2cfr.active;
     lwlibav_opt.vfr2cfr.fps_num   = opt->video_opt.vfr2cfr.framerate_num;
     lwlibav_opt.vfr2cfr.fps_den   = opt->video_opt.vfr2cfr.framerate_den;
@@ -332,6 +335,7 @@ static void close_file( void *private_stuff )
     if( !hp )
         return;
     lw_free( hp->lwh.file_path );
+    lw_free( hp->lwh.format_name );
     lw_free( hp );
 }
 
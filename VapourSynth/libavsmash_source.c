@@ -259,6 +259,15 @@ static const VSFrameRef *VS_CC vs_filter_get_frame( int n, int activation_reason
         return NULL;
     }
     set_frame_properties( vdhp, vi, av_frame, vs_frame, sample_number, vsapi );
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    libavsmash_video_get_frame_cache_stats( vdhp, &cache_hits, &cache_misses );
+    if( cache_hits || cache_misses )
+    {
+        VSMap *props = vsapi->getFramePropsRW( vs_frame );
+        vsapi->propSetInt( props, "LWFrameCacheHits",   (int64_t)cache_hits,   paReplace );
+        vsapi->propSetInt( props, "LWFrameCacheMisses", (int64_t)cache_misses, paReplace );
+    }
     return vs_frame;
 }
 
@@ -330,6 +339,9 @@ void VS_CC vs_libavsmashsource_create( const VSMap *in, VSMap *out, void *user_d
     int64_t fps_den;
     int64_t prefer_hw_decoder;
     int64_t ff_loglevel;
+    int64_t cache_mb;
+    int64_t scale_threads;
+    int64_t lookahead;
     const char *format;
     const char *preferred_decoder_names;
     set_option_int64 ( &track_number,            0,    "track",          in, vsapi );
@@ -342,6 +354,9 @@ void VS_CC vs_libavsmashsource_create( const VSMap *in, VSMap *out, void *user_d
     set_option_int64 ( &fps_den,                 1,    "fpsden",         in, vsapi );
     set_option_int64 ( &prefer_hw_decoder,       0,    "prefer_hw",      in, vsapi );
     set_option_int64 ( &ff_loglevel,             0,    "ff_loglevel",    in, vsapi );
+    set_option_int64 ( &cache_mb,                0,    "cache_mb",       in, vsapi );
+    set_option_int64 ( &scale_threads,           1,    "scale_threads",  in, vsapi );
+    set_option_int64 ( &lookahead,               0,    "lookahead",      in, vsapi );
     set_option_string( &format,                  NULL, "format",         in, vsapi );
     set_option_string( &preferred_decoder_names, NULL, "decoder",        in, vsapi );
     set_preferred_decoder_names_on_buf( hp->preferred_decoder_names_buf, preferred_decoder_names );
@@ -349,9 +364,17 @@ void VS_CC vs_libavsmashsource_create( const VSMap *in, VSMap *out, void *user_d
     libavsmash_video_set_forward_seek_threshold ( vdhp, CLIP_VALUE( seek_threshold, 1, 999 ) );
     libavsmash_video_set_preferred_decoder_names( vdhp, tokenize_preferred_decoder_names( hp->preferred_decoder_names_buf ) );
     libavsmash_video_set_prefer_hw_decoder      ( vdhp, CLIP_VALUE( prefer_hw_decoder, 0, 3 ) );
+    libavsmash_video_set_lookahead_depth        ( vdhp, CLIP_VALUE( lookahead,         0, 64 ) );
+    if( libavsmash_video_set_frame_cache_size( vdhp, (size_t)CLIP_VALUE( cache_mb, 0, (int64_t)(SIZE_MAX >> 20) ) << 20 ) < 0 )
+    {
+        free_handler( &hp );
+        vsapi->setError( out, "lsmas: failed to allocate the frame cache." );
+        return;
+    }
     vohp->vfr2cfr = (fps_num > 0 && fps_den > 0);
     vohp->cfr_num = (uint32_t)fps_num;
     vohp->cfr_den = (uint32_t)fps_den;
+    vohp->scaler.threads = CLIP_VALUE( scale_threads, 1, 64 );
     vs_vohp->variable_info               = CLIP_VALUE( variable_info,  0, 1 );
     vs_vohp->direct_rendering            = CLIP_VALUE( direct_rendering,  0, 1 ) && !format;
     vs_vohp->vs_output_pixel_format = vs_vohp->variable_info ? pfNone : get_vs_output_pixel_format( format );
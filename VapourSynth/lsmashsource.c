@@ -63,6 +63,8 @@ void set_error_on_init
 
 extern void VS_CC vs_libavsmashsource_create( const VSMap *in, VSMap *out, void *user_data, VSCore *core, const VSAPI *vsapi );
 extern void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data, VSCore *core, const VSAPI *vsapi );
+extern void VS_CC vs_lwlibavinfo_create( const VSMap *in, VSMap *out, void *user_data, VSCore *core, const VSAPI *vsapi );
+extern void lwlibav_setup_index_registry( void );
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit( VSConfigPlugin config_func, VSRegisterFunction register_func, VSPlugin *plugin )
 {
@@ -75,7 +77,9 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit( VSConfigPlugin config_func, VSRegis
         1,
         plugin
     );
-#define COMMON_OPTS "threads:int:opt;seek_mode:int:opt;seek_threshold:int:opt;dr:int:opt;fpsnum:int:opt;fpsden:int:opt;variable:int:opt;format:data:opt;decoder:data:opt;prefer_hw:int:opt;"
+    /* Let the sources of the same file share the parsed index. */
+    lwlibav_setup_index_registry();
+#define COMMON_OPTS "threads:int:opt;seek_mode:int:opt;seek_threshold:int:opt;dr:int:opt;fpsnum:int:opt;fpsden:int:opt;variable:int:opt;format:data:opt;decoder:data:opt;prefer_hw:int:opt;cache_mb:int:opt;scale_threads:int:opt;lookahead:int:opt;"
     register_func
     (
         "LibavSMASHSource",
@@ -87,10 +91,18 @@ VS_EXTERNAL_API(void) VapourSynthPluginInit( VSConfigPlugin config_func, VSRegis
     register_func
     (
         "LWLibavSource",
-        "source:data;stream_index:int:opt;cache:int:opt;cachefile:data:opt;" COMMON_OPTS "repeat:int:opt;dominance:int:opt;ff_loglevel:int:opt;",
+        "source:data;stream_index:int:opt;cache:int:opt;cachefile:data:opt;text_index:int:opt;" COMMON_OPTS "repeat:int:opt;dominance:int:opt;ff_loglevel:int:opt;cache_gop:int:opt;decoders:int:opt;content_hash:int:opt;prefetch:int:opt;partial_index:int:opt;",
         vs_lwlibavsource_create,
         NULL,
         plugin
     );
+    register_func
+    (
+        "LWLibavInfo",
+        "source:data;stream_index:int:opt;cachefile:data:opt;content_hash:int:opt;",
+        vs_lwlibavinfo_create,
+        NULL,
+        plugin
+    );
 #undef COMMON_OPTS
 }
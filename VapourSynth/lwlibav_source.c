@@ -66,6 +66,32 @@ uint64_t output_pcm_samples_from_packet
     return 0;
 }
 
+uint64_t output_pcm_samples_from_frame
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    AVFrame                   *frame,
+    uint8_t                  **output_buffer,
+    enum audio_output_flag    *output_flags
+)
+{
+    return 0;
+}
+
+int lw_check_audio_bulk_decodable( const AVCodecContext *ctx ){ return 0; }
+int lw_decode_audio_packets_in_bulk
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    int                        config_index,
+    AVPacket                 **packets,
+    AVFrame                  **frames,
+    int                        count
+)
+{
+    return -1;
+}
+
 void lw_cleanup_audio_output_handler( lw_audio_output_handler_t *aohp ){ }
 #endif
 
@@ -74,13 +100,23 @@ void lw_cleanup_audio_output_handler( lw_audio_output_handler_t *aohp ){ }
 #include "lsmashsource.h"
 #include "video_output.h"
 
+#include "../common/osdep.h"
 #include "../common/progress.h"
 #include "../common/lwlibav_dec.h"
 #include "../common/lwlibav_video.h"
+#include "../common/frame_cache.h"
+#include "../common/lookahead.h"
 #include "../common/lwlibav_video_internal.h"
 #include "../common/lwlibav_audio.h"
 #include "../common/lwindex.h"
 
+typedef struct
+{
+    lwlibav_video_decode_handler_t *vdhp;
+    lwlibav_video_output_handler_t *vohp;
+    int                             busy;
+} lwlibav_decoder_t;
+
 typedef struct
 {
     VSVideoInfo                     vi;
@@ -89,6 +125,12 @@ typedef struct
     lwlibav_video_output_handler_t *vohp;
     lwlibav_audio_decode_handler_t *adhp;
     lwlibav_audio_output_handler_t *aohp;
+    /* Decoders serving frame requests concurrently.
+     * The first one is made of vdhp and vohp, and the others share the index with it. */
+    lwlibav_decoder_t              *decoders;
+    int                             decoder_count;
+    lw_mutex_t                      decoder_mutex;
+    lw_cond_t                       decoder_cond;
     char preferred_decoder_names_buf[PREFERRED_DECODER_NAMES_BUFSIZE];
 } lwlibav_handler_t;
 
@@ -101,12 +143,25 @@ static void free_handler
     if( !hpp || !*hpp )
         return;
     lwlibav_handler_t *hp = *hpp;
+    /* The duplicated decoders refer to the index owned by the first one, so free them first. */
+    if( hp->decoders )
+        for( int i = 1; i < hp->decoder_count; i++ )
+        {
+            lwlibav_video_free_decode_handler( hp->decoders[i].vdhp );
+            lwlibav_video_free_output_handler( hp->decoders[i].vohp );
+        }
+    lw_free( hp->decoders );
+    if( hp->decoder_mutex )
+        lw_mutex_destroy( hp->decoder_mutex );
+    if( hp->decoder_cond )
+        lw_cond_destroy( hp->decoder_cond );
     lw_free( lwlibav_video_get_preferred_decoder_names( hp->vdhp ) );
     lwlibav_video_free_decode_handler( hp->vdhp );
     lwlibav_video_free_output_handler( hp->vohp );
     lwlibav_audio_free_decode_handler( hp->adhp );
     lwlibav_audio_free_output_handler( hp->aohp );
     lw_free( hp->lwh.file_path );
+    lw_free( hp->lwh.format_name );
     lw_free( hp );
 }
 
@@ -170,15 +225,14 @@ static void set_frame_properties
 
 static int prepare_video_decoding
 (
-    lwlibav_handler_t *hp,
-    VSMap             *out,
-    VSCore            *core,
-    const VSAPI       *vsapi
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    VSVideoInfo                    *vi,
+    VSMap                          *out,
+    VSCore                         *core,
+    const VSAPI                    *vsapi
 )
 {
-    lwlibav_video_decode_handler_t *vdhp = hp->vdhp;
-    lwlibav_video_output_handler_t *vohp = hp->vohp;
-    VSVideoInfo                    *vi   = &hp->vi;
     /* Import AVIndexEntrys. */
     if( lwlibav_import_av_index_entry( (lwlibav_decode_handler_t *)vdhp ) < 0 )
         return -1;
@@ -205,15 +259,103 @@ static int prepare_video_decoding
     return 0;
 }
 
-static const VSFrameRef *VS_CC vs_filter_get_frame( int n, int activation_reason, void **instance_data, void **frame_data, VSFrameContext *frame_ctx, VSCore *core, const VSAPI *vsapi )
+/* Allocate the decoders other than the first one.
+ * This must be done before prepare_video_decoding() on the first decoder since it takes over the index entries. */
+static int create_decoders
+(
+    lwlibav_handler_t *hp,
+    int                decoder_count
+)
+{
+    hp->decoders = (lwlibav_decoder_t *)lw_malloc_zero( decoder_count * sizeof(lwlibav_decoder_t) );
+    if( !hp->decoders )
+        return -1;
+    hp->decoder_count    = decoder_count;
+    hp->decoders[0].vdhp = hp->vdhp;
+    hp->decoders[0].vohp = hp->vohp;
+    hp->decoder_mutex = lw_mutex_create();
+    hp->decoder_cond  = lw_cond_create();
+    if( !hp->decoder_mutex || !hp->decoder_cond )
+        return -1;
+    vs_video_output_handler_t *vs_vohp = (vs_video_output_handler_t *)hp->vohp->private_handler;
+    for( int i = 1; i < decoder_count; i++ )
+    {
+        lwlibav_decoder_t *dp = &hp->decoders[i];
+        dp->vdhp = lwlibav_video_duplicate_decode_handler( hp->vdhp, hp->lwh.file_path, hp->lwh.threads );
+        dp->vohp = lwlibav_video_duplicate_output_handler( hp->vohp );
+        if( !dp->vdhp || !dp->vohp )
+            return -1;
+        vs_video_output_handler_t *dup_vs_vohp = vs_allocate_video_output_handler( dp->vohp );
+        if( !dup_vs_vohp )
+            return -1;
+        dup_vs_vohp->variable_info          = vs_vohp->variable_info;
+        dup_vs_vohp->direct_rendering       = vs_vohp->direct_rendering;
+        dup_vs_vohp->vs_output_pixel_format = vs_vohp->vs_output_pixel_format;
+        dp->vohp->scaler.threads            = hp->vohp->scaler.threads;
+    }
+    return 0;
+}
+
+/* Take the idle decoder which will reach the requested frame with the fewest decodes.
+ * Block until any decoder gets idle if all are busy. */
+static lwlibav_decoder_t *acquire_decoder
+(
+    lwlibav_handler_t *hp,
+    uint32_t           frame_number
+)
+{
+    lw_mutex_lock( hp->decoder_mutex );
+    lwlibav_decoder_t *best = NULL;
+    while( 1 )
+    {
+        uint32_t best_distance = UINT32_MAX;
+        for( int i = 0; i < hp->decoder_count; i++ )
+        {
+            lwlibav_decoder_t *dp = &hp->decoders[i];
+            if( dp->busy )
+                continue;
+            /* A decoder past the requested frame has to seek anyway, so it is the last resort.
+             * The frame number here is the output one, which is close enough to the decoder's one for this purpose. */
+            uint32_t last_frame_number = lwlibav_video_get_last_frame_number( dp->vdhp );
+            uint32_t distance = last_frame_number <= frame_number ? frame_number - last_frame_number : UINT32_MAX;
+            if( !best || distance < best_distance )
+            {
+                best          = dp;
+                best_distance = distance;
+            }
+        }
+        if( best )
+            break;
+        lw_cond_wait( hp->decoder_cond, hp->decoder_mutex );
+    }
+    best->busy = 1;
+    lw_mutex_unlock( hp->decoder_mutex );
+    return best;
+}
+
+static void release_decoder
+(
+    lwlibav_handler_t *hp,
+    lwlibav_decoder_t *dp
+)
+{
+    lw_mutex_lock( hp->decoder_mutex );
+    dp->busy = 0;
+    lw_cond_signal( hp->decoder_cond );
+    lw_mutex_unlock( hp->decoder_mutex );
+}
+
+static const VSFrameRef *get_frame_from_decoder
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    VSVideoInfo                    *vi,
+    uint32_t                        frame_number,
+    VSFrameContext                 *frame_ctx,
+    VSCore                         *core,
+    const VSAPI                    *vsapi
+)
 {
-    if( activation_reason != arInitial )
-        return NULL;
-    lwlibav_handler_t *hp = (lwlibav_handler_t *)*instance_data;
-    VSVideoInfo       *vi = &hp->vi;
-    uint32_t frame_number = MIN( n + 1, vi->numFrames );    /* frame_number is 1-origin. */
-    lwlibav_video_decode_handler_t *vdhp = hp->vdhp;
-    lwlibav_video_output_handler_t *vohp = hp->vohp;
     if( lwlibav_video_get_error( vdhp ) )
     {
         vsapi->setFilterError( "lsmas: failed to output a video frame.", frame_ctx );
@@ -246,6 +388,29 @@ static const VSFrameRef *VS_CC vs_filter_get_frame( int n, int activation_reason
         return NULL;
     }
     set_frame_properties( vi, av_frame, vdhp->format->streams[vdhp->stream_index], vs_frame, vsapi );
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    lwlibav_video_get_frame_cache_stats( vdhp, &cache_hits, &cache_misses );
+    if( cache_hits || cache_misses )
+    {
+        VSMap *props = vsapi->getFramePropsRW( vs_frame );
+        vsapi->propSetInt( props, "LWFrameCacheHits",   (int64_t)cache_hits,   paReplace );
+        vsapi->propSetInt( props, "LWFrameCacheMisses", (int64_t)cache_misses, paReplace );
+        vsapi->propSetInt( props, "LWFrameCacheSavedDecodes", (int64_t)lwlibav_video_get_saved_decode_count( vdhp ), paReplace );
+    }
+    return vs_frame;
+}
+
+static const VSFrameRef *VS_CC vs_filter_get_frame( int n, int activation_reason, void **instance_data, void **frame_data, VSFrameContext *frame_ctx, VSCore *core, const VSAPI *vsapi )
+{
+    if( activation_reason != arInitial )
+        return NULL;
+    lwlibav_handler_t *hp = (lwlibav_handler_t *)*instance_data;
+    VSVideoInfo       *vi = &hp->vi;
+    uint32_t frame_number = MIN( n + 1, vi->numFrames );    /* frame_number is 1-origin. */
+    lwlibav_decoder_t *dp = acquire_decoder( hp, frame_number );
+    const VSFrameRef *vs_frame = get_frame_from_decoder( dp->vdhp, dp->vohp, vi, frame_number, frame_ctx, core, vsapi );
+    release_decoder( hp, dp );
     return vs_frame;
 }
 
@@ -288,6 +453,7 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     int64_t stream_index;
     int64_t threads;
     int64_t cache_index;
+    int64_t text_index;
     int64_t seek_mode;
     int64_t seek_threshold;
     int64_t variable_info;
@@ -298,12 +464,21 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     int64_t apply_repeat_flag;
     int64_t field_dominance;
     int64_t ff_loglevel;
+    int64_t cache_mb;
+    int64_t cache_gop;
+    int64_t decoders;
+    int64_t content_hash;
+    int64_t prefetch;
+    int64_t scale_threads;
+    int64_t lookahead;
+    int64_t partial_index;
     const char *index_file_path;
     const char *format;
     const char *preferred_decoder_names;
     set_option_int64 ( &stream_index,           -1,    "stream_index",   in, vsapi );
     set_option_int64 ( &threads,                 0,    "threads",        in, vsapi );
     set_option_int64 ( &cache_index,             1,    "cache",          in, vsapi );
+    set_option_int64 ( &text_index,              1,    "text_index",     in, vsapi );
     set_option_int64 ( &seek_mode,               0,    "seek_mode",      in, vsapi );
     set_option_int64 ( &seek_threshold,          10,   "seek_threshold", in, vsapi );
     set_option_int64 ( &variable_info,           0,    "variable",       in, vsapi );
@@ -314,6 +489,14 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     set_option_int64 ( &apply_repeat_flag,       1,    "repeat",         in, vsapi );
     set_option_int64 ( &field_dominance,         0,    "dominance",      in, vsapi );
     set_option_int64 ( &ff_loglevel,             0,    "ff_loglevel",    in, vsapi );
+    set_option_int64 ( &cache_mb,                0,    "cache_mb",       in, vsapi );
+    set_option_int64 ( &cache_gop,               0,    "cache_gop",      in, vsapi );
+    set_option_int64 ( &decoders,                1,    "decoders",       in, vsapi );
+    set_option_int64 ( &content_hash,            0,    "content_hash",   in, vsapi );
+    set_option_int64 ( &prefetch,                0,    "prefetch",       in, vsapi );
+    set_option_int64 ( &scale_threads,           1,    "scale_threads",  in, vsapi );
+    set_option_int64 ( &lookahead,               0,    "lookahead",      in, vsapi );
+    set_option_int64 ( &partial_index,           0,    "partial_index",  in, vsapi );
     set_option_string( &index_file_path,         NULL, "cachefile",      in, vsapi );
     set_option_string( &format,                  NULL, "format",         in, vsapi );
     set_option_string( &preferred_decoder_names, NULL, "decoder",        in, vsapi );
@@ -325,12 +508,15 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     opt.av_sync           = 0;
     opt.no_create_index   = !cache_index;
     opt.index_file_path   = index_file_path;
+    opt.text_index        = !!text_index;
     opt.force_video       = (stream_index >= 0);
     opt.force_video_index = stream_index >= 0 ? stream_index : -1;
     opt.force_audio       = 0;
     opt.force_audio_index = -2;
+    opt.partial_index     = !!partial_index;
     opt.apply_repeat_flag = apply_repeat_flag;
     opt.field_dominance   = CLIP_VALUE( field_dominance, 0, 2 );    /* 0: Obey source flags, 1: TFF, 2: BFF */
+    opt.content_hash_stride = CLIP_VALUE( content_hash, 0, INT_MAX );
     opt.vfr2cfr.active    = fps_num > 0 && fps_den > 0 ? 1 : 0;
     opt.vfr2cfr.fps_num   = fps_num;
     opt.vfr2cfr.fps_den   = fps_den;
@@ -338,6 +524,18 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     lwlibav_video_set_forward_seek_threshold ( vdhp, CLIP_VALUE( seek_threshold, 1, 999 ) );
     lwlibav_video_set_preferred_decoder_names( vdhp, tokenize_preferred_decoder_names( hp->preferred_decoder_names_buf ) );
     lwlibav_video_set_prefer_hw_decoder      ( vdhp, CLIP_VALUE( prefer_hw_decoder, 0, 3 ) );
+    decoders = CLIP_VALUE( decoders, 1, 16 );
+    /* The memory budget of the frame cache is split among the decoders. */
+    if( lwlibav_video_set_frame_cache_size( vdhp, ((size_t)CLIP_VALUE( cache_mb, 0, (int64_t)(SIZE_MAX >> 20) ) << 20) / decoders ) < 0 )
+    {
+        free_handler( &hp );
+        vsapi->setError( out, "lsmas: failed to allocate the frame cache." );
+        return;
+    }
+    lwlibav_video_set_gop_retention          ( vdhp, CLIP_VALUE( cache_gop, 0, 1 ) );
+    lwlibav_video_set_prefetch_depth         ( vdhp, CLIP_VALUE( prefetch,  0, 1024 ) );
+    lwlibav_video_set_lookahead_depth        ( vdhp, CLIP_VALUE( lookahead, 0, 64 ) );
+    vohp->scaler.threads            = CLIP_VALUE( scale_threads,     1, 64 );
     vs_vohp->variable_info          = CLIP_VALUE( variable_info,     0, 1 );
     vs_vohp->direct_rendering       = CLIP_VALUE( direct_rendering,  0, 1 ) && !format;
     vs_vohp->vs_output_pixel_format = vs_vohp->variable_info ? pfNone : get_vs_output_pixel_format( format );
@@ -388,10 +586,90 @@ void VS_CC vs_lwlibavsource_create( const VSMap *in, VSMap *out, void *user_data
     hp->vi.fpsDen    = 1;
     lwlibav_video_setup_timestamp_info( lwhp, vdhp, vohp, &hp->vi.fpsNum, &hp->vi.fpsDen, opt.apply_repeat_flag );
     /* Set up decoders for this stream. */
-    if( prepare_video_decoding( hp, out, core, vsapi ) < 0 )
+    if( create_decoders( hp, (int)decoders ) < 0 )
     {
         free_handler( &hp );
+        vsapi->setError( out, "lsmas: failed to allocate the video decoders." );
+        return;
+    }
+    for( int i = 0; i < hp->decoder_count; i++ )
+    {
+        /* The video info is set up identically for every decoder, so keep the first one only. */
+        VSVideoInfo vi = hp->vi;
+        if( prepare_video_decoding( hp->decoders[i].vdhp, hp->decoders[i].vohp, i ? &vi : &hp->vi, out, core, vsapi ) < 0 )
+        {
+            free_handler( &hp );
+            return;
+        }
+    }
+    VSFilterMode filter_mode = hp->decoder_count > 1 ? fmParallel : fmUnordered;
+    vsapi->createFilter( in, out, "LWLibavSource", vs_filter_init, vs_filter_get_frame, vs_filter_free, filter_mode, nfMakeLinear, hp, core );
+}
+
+static int set_int_array
+(
+    VSMap          *out,
+    const char     *key,
+    const uint32_t *values,
+    uint32_t        count,
+    const VSAPI    *vsapi
+)
+{
+    int64_t *array = (int64_t *)lw_malloc_zero( MAX( count, 1 ) * sizeof(int64_t) );
+    if( !array )
+        return -1;
+    for( uint32_t i = 0; i < count; i++ )
+        array[i] = values[i];
+    vsapi->propSetIntArray( out, key, array, count );
+    lw_free( array );
+    return 0;
+}
+
+void VS_CC vs_lwlibavinfo_create( const VSMap *in, VSMap *out, void *user_data, VSCore *core, const VSAPI *vsapi )
+{
+    const char *file_path = vsapi->propGetData( in, "source", 0, NULL );
+    /* Get options. */
+    int64_t stream_index;
+    int64_t content_hash;
+    const char *index_file_path;
+    set_option_int64 ( &stream_index,    -1,   "stream_index", in, vsapi );
+    set_option_int64 ( &content_hash,    0,    "content_hash", in, vsapi );
+    set_option_string( &index_file_path, NULL, "cachefile",    in, vsapi );
+    /* Set the options in the same way as LWLibavSource so that its index file is found. */
+    lwlibav_option_t opt = { 0 };
+    opt.file_path           = file_path;
+    opt.index_file_path     = index_file_path;
+    opt.force_video         = (stream_index >= 0);
+    opt.force_video_index   = stream_index >= 0 ? stream_index : -1;
+    opt.force_audio         = 0;
+    opt.force_audio_index   = -2;
+    opt.content_hash_stride = CLIP_VALUE( content_hash, 0, INT_MAX );
+    /* Get the metadata from the index file only. */
+    lwlibav_index_metadata_t metadata;
+    if( lwlibav_get_index_metadata( &opt, &metadata ) < 0 )
+    {
+        vsapi->setError( out, "lsmas: failed to get the metadata from the index file. Run LWLibavSource first." );
+        return;
+    }
+    lwlibav_stream_metadata_t *smp = &metadata.video;
+    if( smp->stream_index < 0 )
+    {
+        lwlibav_cleanup_index_metadata( &metadata );
+        vsapi->setError( out, "lsmas: no video stream is in the index file." );
         return;
     }
-    vsapi->createFilter( in, out, "LWLibavSource", vs_filter_init, vs_filter_get_frame, vs_filter_free, fmUnordered, nfMakeLinear, hp, core );
+    const char *pix_fmt_name = av_get_pix_fmt_name( metadata.pix_fmt );
+    vsapi->propSetInt     ( out, "stream_index",  smp->stream_index,           paReplace );
+    vsapi->propSetData    ( out, "codec",         avcodec_get_name( smp->codec_id ), -1, paReplace );
+    vsapi->propSetInt     ( out, "width",         metadata.width,              paReplace );
+    vsapi->propSetInt     ( out, "height",        metadata.height,             paReplace );
+    vsapi->propSetData    ( out, "format",        pix_fmt_name ? pix_fmt_name : "none", -1, paReplace );
+    vsapi->propSetInt     ( out, "num_frames",    smp->frame_count,            paReplace );
+    vsapi->propSetInt     ( out, "time_base_num", smp->time_base.num,          paReplace );
+    vsapi->propSetInt     ( out, "time_base_den", smp->time_base.den,          paReplace );
+    vsapi->propSetInt     ( out, "duration",      smp->duration,               paReplace );
+    vsapi->propSetIntArray( out, "timestamps",    smp->timestamps, smp->frame_count );
+    if( set_int_array( out, "keyframes", smp->keyframes, smp->keyframe_count, vsapi ) < 0 )
+        vsapi->setError( out, "lsmas: failed to allocate the keyframe list." );
+    lwlibav_cleanup_index_metadata( &metadata );
 }
@@ -37,8 +37,7 @@
 
 #include "lsmashsource.h"
 #include "video_output.h"
-
-#include <emmintrin.h>
+#include "../common/semiplanar.h"
 
 #if (LIBAVUTIL_VERSION_MICRO >= 100) && (LIBSWSCALE_VERSION_MICRO >= 100)
 #define FFMPEG_HIGH_DEPTH_SUPPORT 1
@@ -52,64 +51,109 @@ typedef struct
     int      linesize[4];
 } vs_picture_t;
 
-static inline __m128i _MM_PACKUS_EPI32( const __m128i *low, const __m128i *high )
+static inline uint8_t *get_region_pointer
+(
+    VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    const VSAPI *vsapi
+)
 {
-    const __m128i val_32 = _mm_set1_epi32( 0x8000 );
-    const __m128i val_16 = _mm_set1_epi16( 0x8000 );
-    const __m128i low1   = _mm_sub_epi32( *low, val_32 );
-    const __m128i high1  = _mm_sub_epi32( *high, val_32 );
-    return _mm_add_epi16( _mm_packs_epi32( low1, high1 ), val_16 );
+    return vsapi->getWritePtr( vs_frame, plane )
+         + y * vsapi->getStride( vs_frame, plane )
+         + x * vsapi->getFrameFormat( vs_frame )->bytesPerSample;
+}
+
+static void fill_region_zero
+(
+    VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
+    const VSAPI *vsapi
+)
+{
+    uint8_t *data   = get_region_pointer( vs_frame, plane, x, y, vsapi );
+    int      stride = vsapi->getStride( vs_frame, plane );
+    size_t   size   = (size_t)width * vsapi->getFrameFormat( vs_frame )->bytesPerSample;
+    for( int i = 0; i < height; i++, data += stride )
+        memset( data, 0x00, size );
 }
 
 static void make_black_background_planar_yuv8
 (
     VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
     const VSAPI *vsapi
 )
 {
-    for( int i = 0; i < 3; i++ )
-        memset( vsapi->getWritePtr( vs_frame, i ), i ? 0x80 : 0x00, vsapi->getStride( vs_frame, i ) * vsapi->getFrameHeight( vs_frame, i ) );
+    uint8_t *data   = get_region_pointer( vs_frame, plane, x, y, vsapi );
+    int      stride = vsapi->getStride( vs_frame, plane );
+    for( int i = 0; i < height; i++, data += stride )
+        memset( data, plane ? 0x80 : 0x00, width );
 }
 
 static void make_black_background_planar_yuv16
 (
     VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
     const VSAPI *vsapi
 )
 {
-    int shift = vsapi->getFrameFormat( vs_frame )->bitsPerSample - 8;
-    for( int i = 0; i < 3; i++ )
+    if( plane == 0 || height <= 0 )
     {
-        int v = i ? 0x00000080 << shift : 0x00000000;
-        uint8_t *data = vsapi->getWritePtr( vs_frame, i );
-        uint8_t *end  = data + vsapi->getStride( vs_frame, i ) * vsapi->getFrameHeight( vs_frame, i );
-        while( data < end )
-        {
-            /* Assume little endianess. */
-            data[0] = v;
-            data[1] = v >> 8;
-            data += 2;
-        }
+        fill_region_zero( vs_frame, plane, x, y, width, height, vsapi );
+        return;
     }
+    int      shift  = vsapi->getFrameFormat( vs_frame )->bitsPerSample - 8;
+    uint16_t v      = 0x0080 << shift;
+    uint8_t *line   = get_region_pointer( vs_frame, plane, x, y, vsapi );
+    int      stride = vsapi->getStride( vs_frame, plane );
+    /* Fill the first row sample by sample, and copy it into the others. */
+    uint16_t *data = (uint16_t *)line;
+    for( int i = 0; i < width; i++ )
+        data[i] = v;
+    for( int i = 1; i < height; i++ )
+        memcpy( line + i * stride, line, 2 * width );
 }
 
 static void make_black_background_planar_rgb
 (
     VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
     const VSAPI *vsapi
 )
 {
-    for( int i = 0; i < 3; i++ )
-        memset( vsapi->getWritePtr( vs_frame, i ), 0x00, vsapi->getStride( vs_frame, i ) * vsapi->getFrameHeight( vs_frame, i ) );
+    fill_region_zero( vs_frame, plane, x, y, width, height, vsapi );
 }
 
 static void make_black_background_planar_gray
 (
     VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
     const VSAPI *vsapi
 )
 {
-    memset( vsapi->getWritePtr( vs_frame, 0 ), 0x00, vsapi->getStride( vs_frame, 0 ) * vsapi->getFrameHeight( vs_frame, 0 ) );
+    fill_region_zero( vs_frame, plane, x, y, width, height, vsapi );
 }
 
 static void make_frame_planar_yuv
@@ -139,61 +183,14 @@ static void make_frame_planar_yuv
             0
         }
     };
-    if( vshp->input_pixel_format == AV_PIX_FMT_P010LE && vshp->output_pixel_format == AV_PIX_FMT_YUV420P10LE )
-    {
-        const int width_y       = vsapi->getFrameWidth( vs_frame, 0 );
-        const int width_uv      = vsapi->getFrameWidth( vs_frame, 1 );
-        const int height_y      = vsapi->getFrameHeight( vs_frame, 0 );
-        const int height_uv     = vsapi->getFrameHeight( vs_frame, 1 );
-        const int src_stride_y  = av_picture->linesize[0] / sizeof( uint16_t );
-        const int src_stride_uv = av_picture->linesize[1] / sizeof( uint16_t );
-        const int dst_stride_y  = vs_picture.linesize[0] / sizeof( uint16_t );
-        const int dst_stride_uv = vs_picture.linesize[1] / sizeof( uint16_t );
-        uint16_t *srcp_y        = (uint16_t *)av_picture->data[0];
-        uint16_t *srcp_uv       = (uint16_t *)av_picture->data[1];
-        uint16_t *dstp_y        = (uint16_t *)vs_picture.data[0];
-        uint16_t *dstp_u        = (uint16_t *)vs_picture.data[1];
-        uint16_t *dstp_v        = (uint16_t *)vs_picture.data[2];
-
-        for( int y = 0; y < height_y; y++ )
-        {
-            for( int x = 0; x < width_y; x += 8 )
-            {
-                __m128i yy = _mm_load_si128( (const __m128i *)(srcp_y + x) );
-                yy         = _mm_srli_epi16( yy, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_y + x), yy );
-            }
-            srcp_y += src_stride_y;
-            dstp_y += dst_stride_y;
-        }
-
-        const __m128i mask = _mm_set1_epi32(0x0000FFFF);
-        for( int y = 0; y < height_uv; y++ )
-        {
-            for( int x = 0; x < width_uv; x += 8 )
-            {
-                __m128i uv_low  = _mm_load_si128( (__m128i *)((uint32_t *)srcp_uv + x + 0) );
-                __m128i uv_high = _mm_load_si128( (__m128i *)((uint32_t *)srcp_uv + x + 4) );
-
-                __m128i u_low  = _mm_and_si128( uv_low, mask );
-                __m128i u_high = _mm_and_si128( uv_high, mask );
-                __m128i u      = _MM_PACKUS_EPI32( &u_low, &u_high );
-                u              = _mm_srli_epi16( u, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_u + x), u );
-
-                __m128i v_low  = _mm_srli_epi32( uv_low, 16 );
-                __m128i v_high = _mm_srli_epi32( uv_high, 16 );
-                __m128i v      = _MM_PACKUS_EPI32( &v_low, &v_high );
-                v              = _mm_srli_epi16( v, 6 );
-                _mm_stream_si128( (__m128i *)(dstp_v + x), v );
-            }
-            srcp_uv += src_stride_uv;
-            dstp_u  += dst_stride_uv;
-            dstp_v  += dst_stride_uv;
-        }
-    }
+    if( lw_check_semiplanar_unpack( vshp->input_pixel_format, vshp->output_pixel_format ) )
+        lw_unpack_semiplanar( vshp->input_pixel_format, vshp->output_pixel_format,
+                              vs_picture.data, vs_picture.linesize,
+                              (const uint8_t * const *)av_picture->data, av_picture->linesize,
+                              MIN( av_picture->width,  vsapi->getFrameWidth ( vs_frame, 0 ) ),
+                              MIN( av_picture->height, vsapi->getFrameHeight( vs_frame, 0 ) ) );
     else
-        sws_scale(vshp->sws_ctx, (const uint8_t * const *)av_picture->data, av_picture->linesize, 0, av_picture->height, vs_picture.data, vs_picture.linesize);
+        scale_video_frame( vshp, av_picture, vs_picture.data, vs_picture.linesize );
 }
 
 static void make_frame_planar_rgb
@@ -224,7 +221,7 @@ static void make_frame_planar_rgb
         }
 
     };
-    sws_scale( vshp->sws_ctx, (const uint8_t* const*)av_picture->data, av_picture->linesize, 0, av_picture->height, vs_picture.data, vs_picture.linesize );
+    scale_video_frame( vshp, av_picture, vs_picture.data, vs_picture.linesize );
 }
 
 static void make_frame_planar_rgb8
@@ -342,7 +339,7 @@ static void make_frame_planar_gray
             0
         }
     };
-    sws_scale( vshp->sws_ctx, (const uint8_t* const*)av_picture->data, av_picture->linesize, 0, av_picture->height, vs_picture.data, vs_picture.linesize );
+    scale_video_frame( vshp, av_picture, vs_picture.data, vs_picture.linesize );
 }
 
 VSPresetFormat get_vs_output_pixel_format( const char *format_name )
@@ -597,6 +594,12 @@ static int determine_colorspace_conversion
             { AV_PIX_FMT_YUV422P10BE, pfYUV422P10, 1 },
             { AV_PIX_FMT_YUV444P10LE, pfYUV444P10, 0 },
             { AV_PIX_FMT_YUV444P10BE, pfYUV444P10, 1 },
+#ifdef AV_PIX_FMT_P210
+            { AV_PIX_FMT_P210LE,      pfYUV422P10, 1 },
+            { AV_PIX_FMT_P210BE,      pfYUV422P10, 1 },
+            { AV_PIX_FMT_P410LE,      pfYUV444P10, 1 },
+            { AV_PIX_FMT_P410BE,      pfYUV444P10, 1 },
+#endif
 #if FFMPEG_HIGH_DEPTH_SUPPORT
             { AV_PIX_FMT_YUV420P12LE, pfYUV420P12, 0 },
             { AV_PIX_FMT_YUV420P12BE, pfYUV420P12, 1 },
@@ -619,6 +622,12 @@ static int determine_colorspace_conversion
             { AV_PIX_FMT_YUV422P16BE, pfYUV422P16, 1 },
             { AV_PIX_FMT_YUV444P16LE, pfYUV444P16, 0 },
             { AV_PIX_FMT_YUV444P16BE, pfYUV444P16, 1 },
+#ifdef AV_PIX_FMT_P216
+            { AV_PIX_FMT_P216LE,      pfYUV422P16, 1 },
+            { AV_PIX_FMT_P216BE,      pfYUV422P16, 1 },
+            { AV_PIX_FMT_P416LE,      pfYUV444P16, 1 },
+            { AV_PIX_FMT_P416BE,      pfYUV444P16, 1 },
+#endif
             { AV_PIX_FMT_GRAY8,       pfGray8,     0 },
 #if FFMPEG_HIGH_DEPTH_SUPPORT
             { AV_PIX_FMT_GRAY10LE,    pfGray16,    1 },
@@ -685,10 +694,74 @@ typedef struct
     const VSAPI *vsapi;
 } vs_video_buffer_handler_t;
 
+/* Compute the areas the picture of the given size leaves uncovered in the output frame.
+ * They are kept until the picture size changes. */
+static void update_border_regions
+(
+    vs_video_output_handler_t *vs_vohp,
+    int                        picture_width,
+    int                        picture_height
+)
+{
+    const VSFormat *format = vs_vohp->output_format;
+    vs_vohp->border_picture_width  = picture_width;
+    vs_vohp->border_picture_height = picture_height;
+    vs_vohp->border_region_count   = 0;
+    for( int i = 0; i < format->numPlanes; i++ )
+    {
+        int ssw = i ? format->subSamplingW : 0;
+        int ssh = i ? format->subSamplingH : 0;
+        int plane_width    = vs_vohp->output_width  >> ssw;
+        int plane_height   = vs_vohp->output_height >> ssh;
+        int covered_width  = MIN( (picture_width  + (1 << ssw) - 1) >> ssw, plane_width );
+        int covered_height = MIN( (picture_height + (1 << ssh) - 1) >> ssh, plane_height );
+        if( covered_width < plane_width && covered_height > 0 )
+        {
+            vs_border_region_t *region = &vs_vohp->border_regions[ vs_vohp->border_region_count++ ];
+            region->plane  = i;
+            region->x      = covered_width;
+            region->y      = 0;
+            region->width  = plane_width - covered_width;
+            region->height = covered_height;
+        }
+        if( covered_height < plane_height )
+        {
+            vs_border_region_t *region = &vs_vohp->border_regions[ vs_vohp->border_region_count++ ];
+            region->plane  = i;
+            region->x      = 0;
+            region->y      = covered_height;
+            region->width  = plane_width;
+            region->height = plane_height - covered_height;
+        }
+    }
+}
+
+/* Paint black only where the picture doesn't cover, instead of copying a whole black frame. */
+static void make_black_border
+(
+    vs_video_output_handler_t *vs_vohp,
+    VSFrameRef                *vs_frame,
+    int                        picture_width,
+    int                        picture_height,
+    const VSAPI               *vsapi
+)
+{
+    if( picture_width  != vs_vohp->border_picture_width
+     || picture_height != vs_vohp->border_picture_height )
+        update_border_regions( vs_vohp, picture_width, picture_height );
+    for( int i = 0; i < vs_vohp->border_region_count; i++ )
+    {
+        vs_border_region_t *region = &vs_vohp->border_regions[i];
+        vs_vohp->make_black_background( vs_frame, region->plane, region->x, region->y, region->width, region->height, vsapi );
+    }
+}
+
 static VSFrameRef *new_output_video_frame
 (
     vs_video_output_handler_t *vs_vohp,
     const AVFrame             *av_frame,
+    int                        picture_width,
+    int                        picture_height,
     enum AVPixelFormat        *output_pixel_format,
     int                        input_pix_fmt_change,
     VSFrameContext            *frame_ctx,
@@ -710,7 +783,10 @@ static VSFrameRef *new_output_video_frame
          && input_pix_fmt_change
          && determine_colorspace_conversion( vs_vohp, av_frame->format, output_pixel_format ) < 0 )
             goto fail;
-        return vsapi->copyFrame( vs_vohp->background_frame, core );
+        VSFrameRef *vs_frame = vsapi->newVideoFrame( vs_vohp->output_format, vs_vohp->output_width, vs_vohp->output_height, NULL, core );
+        if( vs_frame )
+            make_black_border( vs_vohp, vs_frame, picture_width, picture_height, vsapi );
+        return vs_frame;
     }
 fail:
     if( frame_ctx )
@@ -739,7 +815,7 @@ VSFrameRef *make_frame
         return NULL;
     /* Make video frame.
      * Convert pixel format if needed. We don't change the presentation resolution. */
-    VSFrameRef *vs_frame = new_output_video_frame( vs_vohp, av_frame,
+    VSFrameRef *vs_frame = new_output_video_frame( vs_vohp, av_frame, av_frame->width, av_frame->height,
                                                   &vshp->output_pixel_format,
                                                   !!(vshp->frame_prop_change_flags & LW_FRAME_PROP_CHANGE_FLAG_PIXEL_FORMAT),
                                                   frame_ctx, core, vsapi );
@@ -880,8 +956,11 @@ static int vs_video_get_buffer
         return AVERROR( ENOMEM );
     }
     av_frame->opaque = vs_vbhp;
+    /* The decoder writes the picture of this size at least. */
+    int picture_width  = av_frame->width;
+    int picture_height = av_frame->height;
     avcodec_align_dimensions2( ctx, &av_frame->width, &av_frame->height, av_frame->linesize );
-    VSFrameRef *vs_frame_buffer = new_output_video_frame( vs_vohp, av_frame, NULL, 0,
+    VSFrameRef *vs_frame_buffer = new_output_video_frame( vs_vohp, av_frame, picture_width, picture_height, NULL, 0,
                                                           vs_vohp->frame_ctx, vs_vohp->core, vs_vohp->vsapi );
     if( !vs_frame_buffer )
     {
@@ -956,13 +1035,11 @@ int vs_setup_video_rendering
         vi->format = vsapi->getFormatPreset( vs_vohp->vs_output_pixel_format, vs_vohp->core );
         vi->width  = lw_vohp->output_width;
         vi->height = lw_vohp->output_height;
-        vs_vohp->background_frame = vsapi->newVideoFrame( vi->format, vi->width, vi->height, NULL, vs_vohp->core );
-        if( !vs_vohp->background_frame )
-        {
-            set_error_on_init( out, vsapi, "lsmas: failed to allocate memory for the background black frame data." );
-            return -1;
-        }
-        vs_vohp->make_black_background( vs_vohp->background_frame, vsapi );
+        vs_vohp->output_format         = vi->format;
+        vs_vohp->output_width          = vi->width;
+        vs_vohp->output_height         = vi->height;
+        vs_vohp->border_picture_width  = -1;
+        vs_vohp->border_picture_height = -1;
     }
     return 0;
 }
@@ -975,8 +1052,6 @@ static void vs_free_video_output_handler
     vs_video_output_handler_t *vs_vohp = (vs_video_output_handler_t *)private_handler;
     if( !vs_vohp )
         return;
-    if( vs_vohp->vsapi && vs_vohp->vsapi->freeFrame && vs_vohp->background_frame )
-        vs_vohp->vsapi->freeFrame( vs_vohp->background_frame );
     lw_free( vs_vohp );
 }
 
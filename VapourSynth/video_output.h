@@ -27,9 +27,24 @@ typedef int component_reorder_t;
 typedef void func_make_black_background
 (
     VSFrameRef  *vs_frame,
+    int          plane,
+    int          x,
+    int          y,
+    int          width,
+    int          height,
     const VSAPI *vsapi
 );
 
+/* area of a plane not covered by the picture */
+typedef struct
+{
+    int plane;
+    int x;
+    int y;
+    int width;
+    int height;
+} vs_border_region_t;
+
 typedef void func_make_frame
 (
     lw_video_scaler_handler_t *vshp,
@@ -46,7 +61,13 @@ typedef struct
     int                         direct_rendering;
     const component_reorder_t  *component_reorder;
     VSPresetFormat              vs_output_pixel_format;
-    VSFrameRef                 *background_frame;
+    const VSFormat             *output_format;
+    int                         output_width;
+    int                         output_height;
+    int                         border_picture_width;   /* the picture size which border_regions are computed for */
+    int                         border_picture_height;
+    int                         border_region_count;
+    vs_border_region_t          border_regions[6];      /* the right and the bottom of each plane */
     func_make_black_background *make_black_background;
     func_make_frame            *make_frame;
     VSFrameContext             *frame_ctx;
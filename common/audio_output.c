@@ -33,6 +33,8 @@ extern "C"
 }
 #endif  /* __cplusplus */
 
+#include "osdep.h"
+#include "utils.h"
 #include "audio_output.h"
 #include "resample.h"
 #include "decode.h"
@@ -109,6 +111,66 @@ uint64_t output_pcm_samples_from_buffer
     return output_length;
 }
 
+uint64_t output_pcm_samples_from_frame
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    AVFrame                   *frame,
+    uint8_t                  **output_buffer,
+    enum audio_output_flag    *output_flags
+)
+{
+    if( !frame->extended_data
+     || !frame->extended_data[0] )
+        return 0;
+    /* Check channel layout, sample rate and sample format of decoded audio samples. */
+    if( frame->channel_layout == 0 )
+        frame->channel_layout = av_get_default_channel_layout( ctx->channels );
+    enum AVSampleFormat input_sample_format = (enum AVSampleFormat)frame->format;
+    if( aohp->input_channel_layout != frame->channel_layout
+     || aohp->input_sample_rate    != frame->sample_rate
+     || aohp->input_sample_format  != input_sample_format )
+    {
+        /* Detected a change of channel layout, sample rate or sample format.
+         * Reconfigure audio resampler. */
+        if( update_resampler_configuration( aohp->swr_ctx,
+                                            aohp->output_channel_layout,
+                                            aohp->output_sample_rate,
+                                            aohp->output_sample_format,
+                                            frame->channel_layout,
+                                            frame->sample_rate,
+                                            input_sample_format,
+                                            &aohp->input_planes,
+                                            &aohp->input_block_align ) < 0 )
+        {
+            *output_flags |= AUDIO_RECONFIG_FAILURE;
+            return 0;
+        }
+        aohp->input_channel_layout = frame->channel_layout;
+        aohp->input_sample_rate    = frame->sample_rate;
+        aohp->input_sample_format  = input_sample_format;
+    }
+    /* Process decoded audio samples. */
+    uint64_t output_length  = 0;
+    int      decoded_length = frame->nb_samples;
+    if( decoded_length > aohp->output_sample_offset )
+    {
+        /* Send decoded audio data to resampler and get desired resampled audio as you want as much as possible. */
+        int useful_length = (int)(decoded_length - aohp->output_sample_offset);
+        int resampled_length = consume_decoded_audio_samples( aohp, frame,
+                                                              useful_length, (int)aohp->request_length,
+                                                              output_buffer, (int)aohp->output_sample_offset );
+        output_length        += resampled_length;
+        aohp->request_length -= resampled_length;
+        aohp->output_sample_offset = 0;
+        if( aohp->request_length <= 0 )
+            *output_flags |= AUDIO_OUTPUT_ENOUGH;
+    }
+    else
+        aohp->output_sample_offset -= decoded_length;
+    return output_length;
+}
+
 uint64_t output_pcm_samples_from_packet
 (
     lw_audio_output_handler_t *aohp,
@@ -148,57 +210,11 @@ uint64_t output_pcm_samples_from_packet
             break;
         }
         output_audio |= decode_complete ? 1 : 0;
-        if( decode_complete
-         && frame_buffer->extended_data
-         && frame_buffer->extended_data[0] )
+        if( decode_complete )
         {
-            /* Check channel layout, sample rate and sample format of decoded audio samples. */
-            if( frame_buffer->channel_layout == 0 )
-                frame_buffer->channel_layout = av_get_default_channel_layout( ctx->channels );
-            enum AVSampleFormat input_sample_format = (enum AVSampleFormat)frame_buffer->format;
-            if( aohp->input_channel_layout != frame_buffer->channel_layout
-             || aohp->input_sample_rate    != frame_buffer->sample_rate
-             || aohp->input_sample_format  != input_sample_format )
-            {
-                /* Detected a change of channel layout, sample rate or sample format.
-                 * Reconfigure audio resampler. */
-                if( update_resampler_configuration( aohp->swr_ctx,
-                                                    aohp->output_channel_layout,
-                                                    aohp->output_sample_rate,
-                                                    aohp->output_sample_format,
-                                                    frame_buffer->channel_layout,
-                                                    frame_buffer->sample_rate,
-                                                    input_sample_format,
-                                                    &aohp->input_planes,
-                                                    &aohp->input_block_align ) < 0 )
-                {
-                    *output_flags |= AUDIO_RECONFIG_FAILURE;
-                    break;
-                }
-                aohp->input_channel_layout = frame_buffer->channel_layout;
-                aohp->input_sample_rate    = frame_buffer->sample_rate;
-                aohp->input_sample_format  = input_sample_format;
-            }
-            /* Process decoded audio samples. */
-            int decoded_length = frame_buffer->nb_samples;
-            if( decoded_length > aohp->output_sample_offset )
-            {
-                /* Send decoded audio data to resampler and get desired resampled audio as you want as much as possible. */
-                int useful_length = (int)(decoded_length - aohp->output_sample_offset);
-                int resampled_length = consume_decoded_audio_samples( aohp, frame_buffer,
-                                                                      useful_length, (int)aohp->request_length,
-                                                                      output_buffer, (int)aohp->output_sample_offset );
-                output_length        += resampled_length;
-                aohp->request_length -= resampled_length;
-                aohp->output_sample_offset = 0;
-                if( aohp->request_length <= 0 )
-                {
-                    *output_flags |= AUDIO_OUTPUT_ENOUGH;
-                    break;
-                }
-            }
-            else
-                aohp->output_sample_offset -= decoded_length;
+            output_length += output_pcm_samples_from_frame( aohp, ctx, frame_buffer, output_buffer, output_flags );
+            if( *output_flags & (AUDIO_RECONFIG_FAILURE | AUDIO_OUTPUT_ENOUGH) )
+                break;
         }
     } while( pkt->size > 0 );
     if( !output_audio && pkt->data )
@@ -207,11 +223,227 @@ uint64_t output_pcm_samples_from_packet
     return output_length;
 }
 
+/*****************************************************************************
+ * Bulk decoding
+ *****************************************************************************/
+typedef struct
+{
+    lw_audio_decoder_pool_t *pool;
+    lw_thread_t              thread;    /* NULL for the first decoder, which runs on the calling thread */
+    AVCodecContext          *ctx;
+    int                      index;
+} lw_audio_decoder_t;
+
+struct lw_audio_decoder_pool_tag
+{
+    lw_mutex_t          mutex;
+    lw_cond_t           cond;           /* signaled whenever a job is posted or a decoder finishes its packets */
+    lw_audio_decoder_t *decoders;
+    int                 decoder_count;
+    int                 config_index;   /* the decoder configuration which the decoders are opened for; -1 means none */
+    /* the current job */
+    AVPacket          **packets;
+    AVFrame           **frames;
+    int                 count;
+    uint32_t            generation;
+    int                 pending;        /* the number of the decoder threads still decoding the current job */
+    int                 exit;
+};
+
+int lw_check_audio_bulk_decodable
+(
+    const AVCodecContext *ctx
+)
+{
+    if( !ctx || !ctx->codec || (ctx->codec->capabilities & AV_CODEC_CAP_DELAY) )
+        return 0;
+    /* Lossy codecs such as AAC overlap their transforms across frames,
+     * so a frame decoded by another decoder instance is not bit-identical even after pre-roll. */
+    const AVCodecDescriptor *desc = avcodec_descriptor_get( ctx->codec_id );
+    return desc
+        && (desc->props & AV_CODEC_PROP_INTRA_ONLY)
+        && (desc->props & AV_CODEC_PROP_LOSSLESS)
+        && !(desc->props & AV_CODEC_PROP_LOSSY);
+}
+
+/* Decode the contiguous share of the current job assigned to 'decoder'. */
+static void decode_packet_range
+(
+    lw_audio_decoder_t *decoder
+)
+{
+    lw_audio_decoder_pool_t *pool = decoder->pool;
+    int first = (int)((int64_t)pool->count *  decoder->index      / pool->decoder_count);
+    int last  = (int)((int64_t)pool->count * (decoder->index + 1) / pool->decoder_count);
+    for( int i = first; i < last; i++ )
+    {
+        AVPacket *pkt   = pool->packets[i];
+        AVFrame  *frame = pool->frames[i];
+        int decode_complete;
+        av_frame_unref( frame );
+        if( decode_audio_packet( decoder->ctx, frame, &decode_complete, pkt ) != pkt->size
+         || !decode_complete )
+        {
+            /* Leave this packet to the calling decoder, and drop whatever this decoder might hold back. */
+            av_frame_unref( frame );
+            avcodec_flush_buffers( decoder->ctx );
+        }
+    }
+}
+
+static void *audio_decoder_worker
+(
+    void *arg
+)
+{
+    lw_audio_decoder_t      *decoder = (lw_audio_decoder_t *)arg;
+    lw_audio_decoder_pool_t *pool    = decoder->pool;
+    uint32_t generation = 0;
+    lw_mutex_lock( pool->mutex );
+    while( 1 )
+    {
+        while( !pool->exit && generation == pool->generation )
+            lw_cond_wait( pool->cond, pool->mutex );
+        if( pool->exit )
+            break;
+        generation = pool->generation;
+        lw_mutex_unlock( pool->mutex );
+        decode_packet_range( decoder );
+        lw_mutex_lock( pool->mutex );
+        if( -- pool->pending == 0 )
+            lw_cond_broadcast( pool->cond );
+    }
+    lw_mutex_unlock( pool->mutex );
+    return NULL;
+}
+
+static void destroy_audio_decoder_pool
+(
+    lw_audio_decoder_pool_t *pool
+)
+{
+    if( !pool )
+        return;
+    if( pool->decoders )
+    {
+        lw_mutex_lock( pool->mutex );
+        pool->exit = 1;
+        lw_cond_broadcast( pool->cond );
+        lw_mutex_unlock( pool->mutex );
+        for( int i = 0; i < pool->decoder_count; i++ )
+        {
+            if( pool->decoders[i].thread )
+                lw_thread_join( pool->decoders[i].thread );
+            avcodec_free_context( &pool->decoders[i].ctx );
+        }
+        lw_free( pool->decoders );
+    }
+    lw_cond_destroy( pool->cond );
+    lw_mutex_destroy( pool->mutex );
+    lw_free( pool );
+}
+
+static lw_audio_decoder_pool_t *create_audio_decoder_pool
+(
+    int threads
+)
+{
+    lw_audio_decoder_pool_t *pool = (lw_audio_decoder_pool_t *)lw_malloc_zero( sizeof(lw_audio_decoder_pool_t) );
+    if( !pool )
+        return NULL;
+    pool->config_index = -1;
+    pool->mutex = lw_mutex_create();
+    pool->cond  = lw_cond_create();
+    if( !pool->mutex || !pool->cond )
+        goto fail;
+    pool->decoders = (lw_audio_decoder_t *)lw_malloc_zero( threads * sizeof(lw_audio_decoder_t) );
+    if( !pool->decoders )
+        goto fail;
+    pool->decoder_count = threads;
+    for( int i = 0; i < threads; i++ )
+    {
+        pool->decoders[i].pool  = pool;
+        pool->decoders[i].index = i;
+    }
+    for( int i = 1; i < threads; i++ )
+    {
+        pool->decoders[i].thread = lw_thread_create( audio_decoder_worker, &pool->decoders[i] );
+        if( !pool->decoders[i].thread )
+            goto fail;
+    }
+    return pool;
+fail:
+    destroy_audio_decoder_pool( pool );
+    return NULL;
+}
+
+static int open_pool_decoders
+(
+    lw_audio_decoder_pool_t *pool,
+    AVCodecContext          *ctx,
+    int                      config_index
+)
+{
+    if( pool->config_index == config_index )
+        return 0;
+    pool->config_index = -1;
+    AVCodecParameters *codecpar = avcodec_parameters_alloc();
+    if( !codecpar || avcodec_parameters_from_context( codecpar, ctx ) < 0 )
+        goto fail;
+    for( int i = 0; i < pool->decoder_count; i++ )
+    {
+        avcodec_free_context( &pool->decoders[i].ctx );
+        if( open_decoder( &pool->decoders[i].ctx, codecpar, ctx->codec, 1 ) < 0 )
+            goto fail;
+    }
+    avcodec_parameters_free( &codecpar );
+    pool->config_index = config_index;
+    return 0;
+fail:
+    avcodec_parameters_free( &codecpar );
+    return -1;
+}
+
+int lw_decode_audio_packets_in_bulk
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    int                        config_index,
+    AVPacket                 **packets,
+    AVFrame                  **frames,
+    int                        count
+)
+{
+    if( aohp->decode_threads <= 1 )
+        return -1;
+    if( !aohp->decoder_pool && !(aohp->decoder_pool = create_audio_decoder_pool( aohp->decode_threads )) )
+        return -1;
+    lw_audio_decoder_pool_t *pool = aohp->decoder_pool;
+    if( open_pool_decoders( pool, ctx, config_index ) < 0 )
+        return -1;
+    lw_mutex_lock( pool->mutex );
+    pool->packets = packets;
+    pool->frames  = frames;
+    pool->count   = count;
+    pool->pending = pool->decoder_count - 1;
+    ++ pool->generation;
+    lw_cond_broadcast( pool->cond );
+    lw_mutex_unlock( pool->mutex );
+    decode_packet_range( &pool->decoders[0] );
+    lw_mutex_lock( pool->mutex );
+    while( pool->pending )
+        lw_cond_wait( pool->cond, pool->mutex );
+    lw_mutex_unlock( pool->mutex );
+    return 0;
+}
+
 void lw_cleanup_audio_output_handler
 (
     lw_audio_output_handler_t *aohp
 )
 {
+    destroy_audio_decoder_pool( aohp->decoder_pool );
+    aohp->decoder_pool = NULL;
     if( aohp->resampled_buffer )
         av_freep( &aohp->resampled_buffer );
     if( aohp->swr_ctx )
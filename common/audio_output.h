@@ -22,6 +22,8 @@
 
 #include "cpp_compat.h"
 
+typedef struct lw_audio_decoder_pool_tag lw_audio_decoder_pool_t;
+
 typedef struct
 {
     SwrContext *swr_ctx;
@@ -41,6 +43,8 @@ typedef struct
     uint64_t                request_length;
     uint64_t                skip_decoded_samples;   /* Upsampling by the decoder is considered. */
     uint64_t                output_sample_offset;
+    int                     decode_threads;         /* the number of decoders for bulk reads of intra-only audio; 1 or less means the calling decoder only */
+    lw_audio_decoder_pool_t *decoder_pool;          /* the decoders and their threads if decode_threads > 1 */
 } lw_audio_output_handler_t;
 
 enum audio_output_flag
@@ -62,6 +66,16 @@ uint64_t output_pcm_samples_from_buffer
     enum audio_output_flag    *output_flags
 );
 
+/* Same as output_pcm_samples_from_packet(), but for a frame decoded by 'ctx' elsewhere. */
+uint64_t output_pcm_samples_from_frame
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    AVFrame                   *frame,
+    uint8_t                  **output_buffer,
+    enum audio_output_flag    *output_flags
+);
+
 uint64_t output_pcm_samples_from_packet
 (
     lw_audio_output_handler_t *aohp,
@@ -72,6 +86,29 @@ uint64_t output_pcm_samples_from_packet
     enum audio_output_flag    *output_flags
 );
 
+/* Return 1 if every packet of the stream decoded by 'ctx' is decoded into the same samples by any decoder instance,
+ * i.e. the codec is intra-only and lossless, and the decoder holds no frames back.
+ * Return 0 otherwise. */
+int lw_check_audio_bulk_decodable
+(
+    const AVCodecContext *ctx
+);
+
+/* Decode the 'count' packets in parallel on the aohp->decode_threads decoders of the pool, the i-th packet into frames[i].
+ * The pool decoders are opened with the configuration of 'ctx', and reopened whenever 'config_index' changes.
+ * A frame is left empty if its packet does not yield exactly a frame on its own, and then the packet is left to 'ctx'.
+ * Return 0 if successful.
+ * Return a negative value otherwise, and then no frames are decoded. */
+int lw_decode_audio_packets_in_bulk
+(
+    lw_audio_output_handler_t *aohp,
+    AVCodecContext            *ctx,
+    int                        config_index,
+    AVPacket                 **packets,
+    AVFrame                  **frames,
+    int                        count
+);
+
 void lw_cleanup_audio_output_handler
 (
     lw_audio_output_handler_t *aohp
@@ -30,9 +30,13 @@ extern "C"
 }
 #endif  /* __cplusplus */
 
+#include "utils.h"
 #include "decode.h"
 #include "qsv.h"
 
+/* the maximum number of the decoders kept for switching the decoder configuration back */
+#define DECODER_POOL_SIZE 4
+
 static AVCodec *select_hw_decoder
 (
     const char              *codec_name,
@@ -229,3 +233,121 @@ int decode_audio_packet
         *got_frame = 1;
     return consumed_bytes;
 }
+
+/*****************************************************************************
+ * Decoder pool
+ *****************************************************************************/
+typedef struct
+{
+    int                index;       /* the index of the decoder configuration */
+    const AVCodec     *codec;       /* NULL if this entry is unused */
+    AVCodecParameters *codecpar;    /* the parameters the decoder was opened with */
+    int                width;       /* the resolution set up by actual decoding */
+    int                height;
+    uint64_t           last_used;
+} lw_decoder_pool_entry_t;
+
+struct lw_decoder_pool_tag
+{
+    lw_decoder_pool_entry_t entries[DECODER_POOL_SIZE];
+    uint64_t                clock;
+};
+
+static void free_pooled_decoder
+(
+    lw_decoder_pool_entry_t *entry
+)
+{
+    entry->codec = NULL;
+    avcodec_parameters_free( &entry->codecpar );
+}
+
+int lw_decoder_pool_put
+(
+    lw_decoder_pool_t      **pool,
+    int                      index,
+    const AVCodec           *codec,
+    const AVCodecParameters *codecpar,
+    int                      width,
+    int                      height
+)
+{
+    if( !*pool && !(*pool = (lw_decoder_pool_t *)lw_malloc_zero( sizeof(lw_decoder_pool_t) )) )
+        return -1;
+    lw_decoder_pool_t *p = *pool;
+    /* Replace the entry of the same configuration, an unused one or the least recently used one in this order. */
+    lw_decoder_pool_entry_t *entry = NULL;
+    for( int i = 0; i < DECODER_POOL_SIZE; i++ )
+        if( p->entries[i].codec && p->entries[i].index == index )
+        {
+            entry = &p->entries[i];
+            break;
+        }
+    for( int i = 0; !entry && i < DECODER_POOL_SIZE; i++ )
+        if( !p->entries[i].codec )
+            entry = &p->entries[i];
+    if( !entry )
+    {
+        entry = &p->entries[0];
+        for( int i = 1; i < DECODER_POOL_SIZE; i++ )
+            if( p->entries[i].last_used < entry->last_used )
+                entry = &p->entries[i];
+    }
+    AVCodecParameters *copy = avcodec_parameters_alloc();
+    if( !copy || avcodec_parameters_copy( copy, codecpar ) < 0 )
+    {
+        avcodec_parameters_free( &copy );
+        return -1;
+    }
+    free_pooled_decoder( entry );
+    entry->index     = index;
+    entry->codec     = codec;
+    entry->codecpar  = copy;
+    entry->width     = width;
+    entry->height    = height;
+    entry->last_used = ++ p->clock;
+    return 0;
+}
+
+AVCodecContext *lw_decoder_pool_open
+(
+    lw_decoder_pool_t *pool,
+    int                index,
+    int                thread_count,
+    AVCodecParameters *codecpar
+)
+{
+    if( !pool )
+        return NULL;
+    for( int i = 0; i < DECODER_POOL_SIZE; i++ )
+    {
+        lw_decoder_pool_entry_t *entry = &pool->entries[i];
+        if( !entry->codec || entry->index != index )
+            continue;
+        AVCodecContext *ctx = NULL;
+        if( (codecpar && avcodec_parameters_copy( codecpar, entry->codecpar ) < 0)
+         || open_decoder( &ctx, entry->codecpar, entry->codec, thread_count ) < 0 )
+        {
+            free_pooled_decoder( entry );
+            return NULL;
+        }
+        /* avcodec_open2() may have changed resolution unexpectedly. */
+        ctx->width       = entry->width;
+        ctx->height      = entry->height;
+        entry->last_used = ++ pool->clock;
+        return ctx;
+    }
+    return NULL;
+}
+
+void lw_decoder_pool_destroy
+(
+    lw_decoder_pool_t **pool
+)
+{
+    if( !*pool )
+        return;
+    for( int i = 0; i < DECODER_POOL_SIZE; i++ )
+        free_pooled_decoder( &(*pool)->entries[i] );
+    lw_freep( pool );
+}
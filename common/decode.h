@@ -68,3 +68,40 @@ int decode_audio_packet
     int            *got_frame,
     AVPacket       *pkt
 );
+
+/* Decoders kept for each decoder configuration
+ * Switching back to a decoder configuration set up before reopens the decoder kept for it with the parameters it was opened with,
+ * instead of finding a decoder and setting it up by actual decoding again. No opened decoder is kept.
+ * Only the decoders of a few recently used configurations are kept. */
+typedef struct lw_decoder_pool_tag lw_decoder_pool_t;
+
+/* Keep the decoder 'codec', the parameters 'codecpar' it was opened with and the resolution 'width' x 'height' set up
+ * by actual decoding for the decoder configuration 'index'.
+ * The pool is allocated if '*pool' is NULL.
+ * Return 0 if successful.
+ * Return a negative value if failed. */
+int lw_decoder_pool_put
+(
+    lw_decoder_pool_t      **pool,
+    int                      index,
+    const AVCodec           *codec,
+    const AVCodecParameters *codecpar,
+    int                      width,
+    int                      height
+);
+
+/* Open the decoder kept for the decoder configuration 'index' with 'thread_count' threads,
+ * and copy the parameters it is opened with to 'codecpar' if not NULL.
+ * Return NULL if not kept or failed to open. */
+AVCodecContext *lw_decoder_pool_open
+(
+    lw_decoder_pool_t *pool,
+    int                index,
+    int                thread_count,
+    AVCodecParameters *codecpar
+);
+
+void lw_decoder_pool_destroy
+(
+    lw_decoder_pool_t **pool
+);
@@ -0,0 +1,223 @@
+/*****************************************************************************
+ * frame_cache.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "cpp_compat.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+#include <libavutil/frame.h>
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#include "utils.h"
+#include "frame_cache.h"
+
+struct lw_frame_cache_entry_tag
+{
+    lw_frame_cache_entry_t *prev;
+    lw_frame_cache_entry_t *next;
+    AVFrame                *frame;
+    uint32_t                number;
+    size_t                  size;
+    int                     retained;
+};
+
+static size_t get_frame_buffer_size
+(
+    const AVFrame *frame
+)
+{
+    size_t size = 0;
+    for( int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++ )
+        size += frame->buf[i]->size;
+    for( int i = 0; i < frame->nb_extended_buf; i++ )
+        size += frame->extended_buf[i]->size;
+    return size;
+}
+
+static void unlink_entry
+(
+    lw_frame_cache_t       *fcp,
+    lw_frame_cache_entry_t *entry
+)
+{
+    if( entry->prev )
+        entry->prev->next = entry->next;
+    else
+        fcp->head = entry->next;
+    if( entry->next )
+        entry->next->prev = entry->prev;
+    else
+        fcp->tail = entry->prev;
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void link_entry_to_head
+(
+    lw_frame_cache_t       *fcp,
+    lw_frame_cache_entry_t *entry
+)
+{
+    entry->prev = NULL;
+    entry->next = fcp->head;
+    if( fcp->head )
+        fcp->head->prev = entry;
+    else
+        fcp->tail = entry;
+    fcp->head = entry;
+}
+
+static void remove_entry
+(
+    lw_frame_cache_t       *fcp,
+    lw_frame_cache_entry_t *entry
+)
+{
+    unlink_entry( fcp, entry );
+    fcp->size -= entry->size;
+    av_frame_free( &entry->frame );
+    lw_free( entry );
+}
+
+static lw_frame_cache_entry_t *find_entry
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number
+)
+{
+    for( lw_frame_cache_entry_t *entry = fcp->head; entry; entry = entry->next )
+        if( entry->number == number )
+            return entry;
+    return NULL;
+}
+
+void lw_frame_cache_init
+(
+    lw_frame_cache_t *fcp,
+    size_t            max_size
+)
+{
+    lw_frame_cache_clear( fcp );
+    fcp->max_size      = max_size;
+    fcp->hits          = 0;
+    fcp->misses        = 0;
+    fcp->retained_hits = 0;
+}
+
+void lw_frame_cache_clear
+(
+    lw_frame_cache_t *fcp
+)
+{
+    while( fcp->head )
+        remove_entry( fcp, fcp->head );
+    fcp->size = 0;
+}
+
+AVFrame *lw_frame_cache_get
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number
+)
+{
+    /* The number of entries is bounded by the memory budget, so a linear search is enough. */
+    lw_frame_cache_entry_t *entry = find_entry( fcp, number );
+    if( entry )
+    {
+        if( entry != fcp->head )
+        {
+            unlink_entry( fcp, entry );
+            link_entry_to_head( fcp, entry );
+        }
+        ++ fcp->hits;
+        if( entry->retained )
+        {
+            ++ fcp->retained_hits;
+            entry->retained = 0;
+        }
+        return entry->frame;
+    }
+    ++ fcp->misses;
+    return NULL;
+}
+
+static int insert_entry
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number,
+    const AVFrame    *frame,
+    int               retained
+)
+{
+    size_t size = get_frame_buffer_size( frame );
+    if( fcp->max_size == 0 || size == 0 || size > fcp->max_size )
+        return 0;
+    lw_frame_cache_entry_t *entry = (lw_frame_cache_entry_t *)lw_malloc_zero( sizeof(lw_frame_cache_entry_t) );
+    if( !entry )
+        return -1;
+    entry->frame = av_frame_alloc();
+    if( !entry->frame || av_frame_ref( entry->frame, frame ) < 0 )
+    {
+        av_frame_free( &entry->frame );
+        lw_free( entry );
+        return -1;
+    }
+    entry->number   = number;
+    entry->size     = size;
+    entry->retained = retained;
+    /* Evict the least recently used frames until the new one fits in the budget. */
+    while( fcp->tail && fcp->size + size > fcp->max_size )
+        remove_entry( fcp, fcp->tail );
+    link_entry_to_head( fcp, entry );
+    fcp->size += size;
+    return 0;
+}
+
+int lw_frame_cache_put
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number,
+    const AVFrame    *frame
+)
+{
+    /* Replace the stale entry if any. */
+    lw_frame_cache_entry_t *entry = find_entry( fcp, number );
+    if( entry )
+        remove_entry( fcp, entry );
+    return insert_entry( fcp, number, frame, 0 );
+}
+
+int lw_frame_cache_retain
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number,
+    const AVFrame    *frame
+)
+{
+    if( find_entry( fcp, number ) )
+        return 0;
+    return insert_entry( fcp, number, frame, 1 );
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * frame_cache.h
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Decoded frame cache
+ * Frames are held as references to the buffers the decoder output, so nothing is copied.
+ * The least recently used frames are dropped once the referenced buffers exceed max_size bytes. */
+typedef struct lw_frame_cache_entry_tag lw_frame_cache_entry_t;
+
+typedef struct
+{
+    lw_frame_cache_entry_t *head;       /* most recently used */
+    lw_frame_cache_entry_t *tail;       /* least recently used */
+    size_t                  size;       /* total bytes of the referenced buffers */
+    size_t                  max_size;   /* 0 means disabled */
+    uint64_t                hits;
+    uint64_t                misses;
+    uint64_t                retained_hits;  /* hits on frames retained without being requested */
+} lw_frame_cache_t;
+
+void lw_frame_cache_init
+(
+    lw_frame_cache_t *fcp,
+    size_t            max_size
+);
+
+void lw_frame_cache_clear
+(
+    lw_frame_cache_t *fcp
+);
+
+/* Return the cached frame of 'number' and mark it as the most recently used if present.
+ * Return NULL otherwise. The returned frame is owned by the cache. */
+AVFrame *lw_frame_cache_get
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number
+);
+
+/* Return 0 if successful.
+ * Return a negative value otherwise. */
+int lw_frame_cache_put
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number,
+    const AVFrame    *frame
+);
+
+/* Same as lw_frame_cache_put(), but for a frame decoded on the way to a requested one.
+ * An existing entry is kept as it is, and the first hit on the retained frame is counted as a saved decode. */
+int lw_frame_cache_retain
+(
+    lw_frame_cache_t *fcp,
+    uint32_t          number,
+    const AVFrame    *frame
+);
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -711,6 +712,38 @@ fail:
     return -1;
 }
 
+/* Read a sample from the file into a padded buffer taken from the pool.
+ * This saves the allocation and the copy of each sample through L-SMASH.
+ * Return 0 if successful, 1 if reached the end of the media timeline, or a negative value otherwise. */
+static int read_sample_directly
+(
+    lsmash_root_t         *root,
+    uint32_t               track_ID,
+    uint32_t               sample_number,
+    codec_configuration_t *config,
+    lsmash_sample_t       *sample,
+    AVPacket              *pkt
+)
+{
+    if( lsmash_get_sample_info_from_media_timeline( root, track_ID, sample_number, sample ) < 0 )
+        return 1;
+    if( sample->length > (uint32_t)config->input_size )
+        return -1;
+    AVBufferRef *buf = av_buffer_pool_get( config->input_pool );
+    if( !buf )
+        return -1;
+    if( avio_seek( config->input, sample->pos, SEEK_SET ) < 0
+     || avio_read( config->input, buf->data, sample->length ) != (int)sample->length )
+    {
+        av_buffer_unref( &buf );
+        return -1;
+    }
+    memset( buf->data + sample->length, 0, AV_INPUT_BUFFER_PADDING_SIZE );
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    return 0;
+}
+
 int get_sample
 (
     lsmash_root_t         *root,
@@ -726,10 +759,13 @@ int get_sample
         config->dequeue_packet = 0;
         if( sample_number == config->queue.sample_number )
         {
+            av_packet_unref( pkt );
             *pkt = config->queue.packet;
+            config->queue.packet.buf = NULL;
             return 0;
         }
     }
+    av_packet_unref( pkt );
     av_init_packet( pkt );
     if( config->update_pending || config->queue.delay_count )
     {
@@ -743,36 +779,59 @@ int get_sample
         }
         return 0;
     }
-    lsmash_sample_t *sample = lsmash_get_sample_from_media_timeline( root, track_ID, sample_number );
+    lsmash_sample_t  direct_sample;
+    lsmash_sample_t *sample = NULL;
+    if( config->input )
+    {
+        int ret = read_sample_directly( root, track_ID, sample_number, config, &direct_sample, pkt );
+        if( ret > 0 )
+        {
+            /* Reached the end of this media timeline. */
+            pkt->data = NULL;
+            pkt->size = 0;
+            return 1;
+        }
+        if( ret == 0 )
+            sample = &direct_sample;
+    }
     if( !sample )
     {
-        /* Reached the end of this media timeline. */
-        pkt->data = NULL;
-        pkt->size = 0;
-        return 1;
+        sample = lsmash_get_sample_from_media_timeline( root, track_ID, sample_number );
+        if( !sample )
+        {
+            /* Reached the end of this media timeline. */
+            pkt->data = NULL;
+            pkt->size = 0;
+            return 1;
+        }
+        /* Copy sample data from L-SMASH.
+         * Set 0 to the end of the additional AV_INPUT_BUFFER_PADDING_SIZE bytes.
+         * Without this, some decoders could cause wrong results. */
+        pkt->data = config->input_buffer;
+        memcpy( pkt->data, sample->data, sample->length );
+        memset( pkt->data + sample->length, 0, AV_INPUT_BUFFER_PADDING_SIZE );
     }
     pkt->flags = sample->prop.ra_flags;     /* Set proper flags when feeding this packet into the decoder. */
     pkt->size  = sample->length;
-    pkt->data  = config->input_buffer;
     pkt->pts   = sample->cts;               /* Set composition timestamp to presentation timestamp field. */
     pkt->dts   = sample->dts;
-    /* Copy sample data from L-SMASH.
-     * Set 0 to the end of the additional AV_INPUT_BUFFER_PADDING_SIZE bytes.
-     * Without this, some decoders could cause wrong results. */
-    memcpy( pkt->data, sample->data, sample->length );
-    memset( pkt->data + sample->length, 0, AV_INPUT_BUFFER_PADDING_SIZE );
+    uint32_t sample_index = sample->index;
+    if( sample != &direct_sample )
+        lsmash_delete_sample( sample );
     /* TODO: add handling invalid indexes. */
-    if( sample->index != config->index )
+    if( sample_index != config->index )
     {
-        if( prepare_new_decoder_configuration( config, sample->index ) )
+        if( prepare_new_decoder_configuration( config, sample_index ) )
         {
-            lsmash_delete_sample( sample );
+            av_packet_unref( pkt );
             return -1;
         }
         /* Queue the current packet and, instead of this, return NULL packet.
          * The current packet will be dequeued and returned after the corresponding decoder configuration is activated. */
+        av_buffer_unref( &config->queue.packet.buf );
         config->queue.sample_number = sample_number;
         config->queue.packet        = *pkt;
+        pkt->buf  = NULL;
         pkt->data = NULL;
         pkt->size = 0;
         if( config->queue.delay_count == 0 )
@@ -780,13 +839,11 @@ int get_sample
             /* This NULL packet must not be sent to the decoder. */
             config->update_pending = 1;
             config->dequeue_packet = 1;
-            lsmash_delete_sample( sample );
             return 2;
         }
         else
             config->dequeue_packet = 0;
     }
-    lsmash_delete_sample( sample );
     return 0;
 }
 
@@ -860,9 +917,36 @@ void update_configuration
         strcpy( error_string, "Failed to get the CODEC parameters.\n" );
         goto fail;
     }
-    /* Close the decoder here. */
+    /* Keep the decoder and the parameters here for switching back to the current configuration later. */
+    if( !config->error )
+        lw_decoder_pool_put( &config->decoder_pool, (int)config->index, config->ctx->codec, codecpar,
+                             config->ctx->width, config->ctx->height );
     config->ctx->opaque = NULL;
     avcodec_free_context( &config->ctx );
+    /* Reopen the decoder set up for the queued configuration before if any.
+     * It is opened with the parameters it was set up with, so it needs no setup by actual decoding. */
+    config->ctx = lw_decoder_pool_open( config->decoder_pool, (int)new_index, thread_count, NULL );
+    if( config->ctx )
+    {
+        avcodec_parameters_free( &codecpar );
+        av_freep( &config->queue.extradata );
+        config->queue.extradata_size = 0;
+        config->index             = new_index;
+        config->update_pending    = 0;
+        config->delay_count       = 0;
+        config->queue.delay_count = 0;
+        config->queue.index       = config->index;
+        config->dequeue_packet    = 1;
+        config->ctx->get_buffer2  = config->get_buffer;
+        config->ctx->opaque       = app_specific;
+        if( config->ctx->codec_type == AVMEDIA_TYPE_VIDEO )
+        {
+            extended_summary_t *extended = &config->entries[ config->index - 1 ].extended;
+            config->ctx->width  = extended->width;
+            config->ctx->height = extended->height;
+        }
+        return;
+    }
     /* Find an appropriate decoder. */
     const AVCodec *codec = find_decoder( config->queue.codec_id, codecpar, config->preferred_decoder_names, config->prefer_hw_decoder );
     if( !codec )
@@ -954,6 +1038,7 @@ void update_configuration
             }
             int dummy;
             decode_video_packet( ctx, picture, &dummy, &pkt );
+            av_packet_unref( &pkt );
         } while( ctx->width == 0 || ctx->height == 0 || ctx->pix_fmt == AV_PIX_FMT_NONE );
     }
     else
@@ -978,6 +1063,7 @@ void update_configuration
             }
             int dummy;
             decode_audio_packet( ctx, picture, &dummy, &pkt );
+            av_packet_unref( &pkt );
         } while( ctx->sample_rate == 0 || (ctx->channel_layout == 0 && ctx->channels == 0) || ctx->sample_fmt == AV_SAMPLE_FMT_NONE );
         extended->channel_layout = ctx->channel_layout ? ctx->channel_layout : av_get_default_channel_layout( ctx->channels );
         extended->sample_rate    = ctx->sample_rate;
@@ -1009,24 +1095,71 @@ fail:
     lw_log_show( &config->lh, LW_LOG_FATAL, "%sIt is recommended you reopen the file.", error_string );
 }
 
+/* Direct reading relies on that all samples are in the file itself. */
+static int is_self_contained_track
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID
+)
+{
+    for( uint32_t i = 1; ; i++ )
+    {
+        lsmash_data_reference_t data_ref;
+        data_ref.index    = i;
+        data_ref.location = NULL;
+        if( lsmash_get_data_reference( root, track_ID, &data_ref ) < 0 )
+            return i > 1;
+        int self_contained = !data_ref.location;
+        lsmash_cleanup_data_reference( &data_ref );
+        if( !self_contained )
+            return 0;
+    }
+}
+
+static void open_direct_input
+(
+    lsmash_root_t         *root,
+    uint32_t               track_ID,
+    codec_configuration_t *config,
+    const char            *file_name,
+    int                    input_size
+)
+{
+    if( !file_name || !is_self_contained_track( root, track_ID ) )
+        return;
+    config->input_pool = av_buffer_pool_init( input_size + AV_INPUT_BUFFER_PADDING_SIZE, NULL );
+    if( !config->input_pool
+     || avio_open( &config->input, file_name, AVIO_FLAG_READ ) < 0 )
+    {
+        /* Fall back on copying the samples from L-SMASH. */
+        av_buffer_pool_uninit( &config->input_pool );
+        config->input = NULL;
+        return;
+    }
+    config->input_size = input_size;
+}
+
 int initialize_decoder_configuration
 (
     lsmash_root_t         *root,
     uint32_t               track_ID,
-    codec_configuration_t *config
+    codec_configuration_t *config,
+    const char            *file_name
 )
 {
     /* Note: the input buffer for libavcodec's decoders must be AV_INPUT_BUFFER_PADDING_SIZE larger than the actual read bytes. */
     uint32_t input_buffer_size = lsmash_get_max_sample_size_in_media_timeline( root, track_ID );
-    if( input_buffer_size == 0 )
+    if( input_buffer_size == 0 || input_buffer_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE )
         return -1;
     config->input_buffer = (uint8_t *)av_mallocz( input_buffer_size + AV_INPUT_BUFFER_PADDING_SIZE );
     if( !config->input_buffer )
         return -1;
+    open_direct_input( root, track_ID, config, file_name, (int)input_buffer_size );
     config->get_buffer = avcodec_default_get_buffer2;
     /* Initialize decoder configuration at the first valid sample. */
     AVPacket dummy = { 0 };
     for( uint32_t i = 1; get_sample( root, track_ID, i, config, &dummy ) < 0; i++ );
+    av_packet_unref( &dummy );
     update_configuration( root, track_ID, config );
     /* Decide preferred settings. */
     config->prefer.width           = config->ctx->width;
@@ -1062,6 +1195,7 @@ int initialize_decoder_configuration
         if( sample.index <= config->count && !index_list[ sample.index - 1 ] )
         {
             for( uint32_t j = i; get_sample( root, track_ID, j, config, &dummy ) < 0; j++ );
+            av_packet_unref( &dummy );
             update_configuration( root, track_ID, config );
             index_list[ sample.index - 1 ] = 1;
             if( config->ctx->width > config->prefer.width )
@@ -1116,6 +1250,7 @@ int initialize_decoder_configuration
     lw_free( index_list );
     /* Reinitialize decoder configuration at the first valid sample. */
     for( uint32_t i = 1; get_sample( root, track_ID, i, config, &dummy ) < 0; i++ );
+    av_packet_unref( &dummy );
     update_configuration( root, track_ID, config );
     return config->error ? -1 : 0;
 }
@@ -1132,6 +1267,10 @@ void cleanup_configuration
         free( config->entries );
     }
     av_freep( &config->queue.extradata );
+    av_buffer_unref( &config->queue.packet.buf );
     av_freep( &config->input_buffer );
+    av_buffer_pool_uninit( &config->input_pool );
+    avio_closep( &config->input );
+    lw_decoder_pool_destroy( &config->decoder_pool );
     avcodec_free_context( &config->ctx );
 }
@@ -46,7 +46,11 @@ typedef struct
     uint32_t              index;    /* index of the current decoder configuration */
     uint32_t              delay_count;
     uint8_t              *input_buffer;
+    AVIOContext          *input;        /* the source file read directly into the pooled buffers if not NULL */
+    AVBufferPool         *input_pool;   /* padded buffers of the maximum sample size */
+    int                   input_size;
     AVCodecContext       *ctx;
+    struct lw_decoder_pool_tag *decoder_pool;   /* the decoders set up for the other configurations */
     const char          **preferred_decoder_names;
     int                   prefer_hw_decoder;
     libavsmash_summary_t *entries;
@@ -106,13 +110,17 @@ int libavsmash_find_and_open_decoder
     const int                thread_count
 );
 
+/* If 'file_name' is given, the samples are read from it directly into reference-counted buffers
+ * rather than copied from L-SMASH where possible. */
 int initialize_decoder_configuration
 (
     lsmash_root_t         *root,
     uint32_t               track_ID,
-    codec_configuration_t *config
+    codec_configuration_t *config,
+    const char            *file_name
 );
 
+/* The packet may hold a reference to a buffer, so unreference it after use. */
 int get_sample
 (
     lsmash_root_t         *root,
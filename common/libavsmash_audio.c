@@ -41,6 +41,7 @@ extern "C"
 #include "resample.h"
 #include "libavsmash.h"
 #include "libavsmash_audio.h"
+#include "pcm_cache.h"
 #include "libavsmash_audio_internal.h"
 
 /*****************************************************************************
@@ -78,6 +79,7 @@ void libavsmash_audio_free_decode_handler
 {
     if( !adhp )
         return;
+    lw_pcm_cache_clear( &adhp->pcm_cache );
     av_frame_free( &adhp->frame_buffer );
     cleanup_configuration( &adhp->config );
     lw_free( adhp );
@@ -146,6 +148,15 @@ void libavsmash_audio_set_preferred_decoder_names
     adhp->config.preferred_decoder_names = preferred_decoder_names;
 }
 
+void libavsmash_audio_set_pcm_cache_size
+(
+    libavsmash_audio_decode_handler_t *adhp,
+    size_t                             max_size
+)
+{
+    lw_pcm_cache_init( &adhp->pcm_cache, max_size );
+}
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -366,7 +377,7 @@ int libavsmash_audio_initialize_decoder_configuration
         strcpy( error_string, "Failed to find and open the audio decoder.\n" );
         goto fail;
     }
-    return initialize_decoder_configuration( adhp->root, adhp->track_id, &adhp->config );
+    return initialize_decoder_configuration( adhp->root, adhp->track_id, &adhp->config, NULL );
 fail:;
     lw_log_handler_t *lhp = libavsmash_audio_get_log_handler( adhp );
     lw_log_show( lhp, LW_LOG_FATAL, "%s", error_string );
@@ -625,7 +636,7 @@ static int find_start_audio_frame
     return frame_number;
 }
 
-uint64_t libavsmash_audio_get_pcm_samples
+static uint64_t get_pcm_samples
 (
     libavsmash_audio_decode_handler_t *adhp,
     libavsmash_audio_output_handler_t *aohp,
@@ -728,3 +739,43 @@ audio_out:
     adhp->last_frame_number      = frame_number;
     return output_length;
 }
+
+typedef struct
+{
+    libavsmash_audio_decode_handler_t *adhp;
+    libavsmash_audio_output_handler_t *aohp;
+} pcm_decoder_t;
+
+static uint64_t decode_pcm_samples
+(
+    void   *priv,
+    void   *buf,
+    int64_t start,
+    int64_t length
+)
+{
+    pcm_decoder_t *decoder = (pcm_decoder_t *)priv;
+    return get_pcm_samples( decoder->adhp, decoder->aohp, buf, start, length );
+}
+
+uint64_t libavsmash_audio_get_pcm_samples
+(
+    libavsmash_audio_decode_handler_t *adhp,
+    libavsmash_audio_output_handler_t *aohp,
+    void                              *buf,
+    int64_t                            start,
+    int64_t                            wanted_length
+)
+{
+    if( adhp->config.error )
+        return 0;
+    if( adhp->pcm_cache.max_size == 0 )
+        return get_pcm_samples( adhp, aohp, buf, start, wanted_length );
+    lw_pcm_format_t format;
+    format.channel_layout = aohp->output_channel_layout;
+    format.sample_format  = aohp->output_sample_format;
+    format.sample_rate    = aohp->output_sample_rate;
+    format.block_align    = aohp->output_block_align;
+    pcm_decoder_t decoder = { adhp, aohp };
+    return lw_pcm_cache_get_samples( &adhp->pcm_cache, &format, decode_pcm_samples, &decoder, buf, start, wanted_length );
+}
@@ -86,6 +86,14 @@ void libavsmash_audio_set_preferred_decoder_names
     const char                       **preferred_decoder_names
 );
 
+/* Set the memory budget in bytes of the resampled PCM block cache.
+ * The cache is disabled if set to 0. */
+void libavsmash_audio_set_pcm_cache_size
+(
+    libavsmash_audio_decode_handler_t *adhp,
+    size_t                             max_size
+);
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
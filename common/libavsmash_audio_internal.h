@@ -35,4 +35,5 @@ struct libavsmash_audio_decode_handler_tag
     uint32_t              media_timescale;
     uint64_t              media_duration;   /* unused */
     uint64_t              min_cts;
+    lw_pcm_cache_t        pcm_cache;
 };
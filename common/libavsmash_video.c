@@ -40,6 +40,8 @@ extern "C"
 #include "video_output.h"
 #include "libavsmash.h"
 #include "libavsmash_video.h"
+#include "frame_cache.h"
+#include "lookahead.h"
 #include "libavsmash_video_internal.h"
 #include "decode.h"
 
@@ -78,10 +80,16 @@ void libavsmash_video_free_decode_handler
 {
     if( !vdhp )
         return;
+    /* The lookahead thread must be stopped before the decoder is closed. */
+    lw_lookahead_destroy( vdhp->lookahead );
     lw_freep( &vdhp->keyframe_list );
     lw_freep( &vdhp->order_converter );
+    lw_freep( &vdhp->rap_list );
+    lw_freep( &vdhp->sdi_run_list );
     av_frame_free( &vdhp->frame_buffer );
     av_frame_free( &vdhp->first_valid_frame );
+    av_frame_free( &vdhp->cached_frame );
+    lw_frame_cache_clear( &vdhp->frame_cache );
     cleanup_configuration( &vdhp->config );
     lw_free( vdhp );
 }
@@ -193,6 +201,32 @@ void libavsmash_video_set_get_buffer_func
     vdhp->config.get_buffer = vdhp->config.ctx->get_buffer2;
 }
 
+void libavsmash_video_set_lookahead_depth
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    int                                lookahead_depth
+)
+{
+    vdhp->lookahead_depth = lookahead_depth;
+}
+
+int libavsmash_video_set_frame_cache_size
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    size_t                             max_size
+)
+{
+    if( max_size && !vdhp->cached_frame )
+    {
+        vdhp->cached_frame = av_frame_alloc();
+        if( !vdhp->cached_frame )
+            return -1;
+    }
+    lw_frame_cache_init( &vdhp->frame_cache, max_size );
+    vdhp->output_cached_frame = 0;
+    return 0;
+}
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -281,7 +315,20 @@ AVFrame *libavsmash_video_get_frame_buffer
     libavsmash_video_decode_handler_t *vdhp
 )
 {
-    return vdhp ? vdhp->frame_buffer : NULL;
+    if( !vdhp )
+        return NULL;
+    return vdhp->output_cached_frame ? vdhp->cached_frame : vdhp->frame_buffer;
+}
+
+void libavsmash_video_get_frame_cache_stats
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    uint64_t                          *hits,
+    uint64_t                          *misses
+)
+{
+    *hits   = vdhp ? vdhp->frame_cache.hits   : 0;
+    *misses = vdhp ? vdhp->frame_cache.misses : 0;
 }
 
 uint32_t libavsmash_video_get_sample_count
@@ -409,7 +456,7 @@ int libavsmash_video_initialize_decoder_configuration
         strcpy( error_string, "Failed to find and open the video decoder.\n" );
         goto fail;
     }
-    return initialize_decoder_configuration( vdhp->root, vdhp->track_id, &vdhp->config );
+    return initialize_decoder_configuration( vdhp->root, vdhp->track_id, &vdhp->config, format_ctx->url );
 fail:;
     lw_log_handler_t *lhp = libavsmash_video_get_log_handler( vdhp );
     lw_log_show( lhp, LW_LOG_FATAL, "%s", error_string );
@@ -491,6 +538,183 @@ void libavsmash_video_close_codec_context
     avcodec_free_context( &vdhp->config.ctx );
 }
 
+/* Build the tables looked up on seeking instead of the media timeline.
+ * Random accessible points keep the detail L-SMASH gives at themselves. */
+static int create_seek_tables
+(
+    libavsmash_video_decode_handler_t *vdhp
+)
+{
+    lw_freep( &vdhp->rap_list );
+    lw_freep( &vdhp->sdi_run_list );
+    vdhp->rap_count     = 0;
+    vdhp->sdi_run_count = 0;
+    uint32_t rap_count     = 0;
+    uint32_t sdi_run_count = 0;
+    uint32_t index         = 0;
+    for( uint32_t i = 1; i <= vdhp->sample_count; i++ )
+    {
+        lsmash_sample_t sample;
+        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, i, &sample ) < 0 )
+            return -1;
+        if( sample.prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+            ++rap_count;
+        if( i == 1 || sample.index != index )
+        {
+            index = sample.index;
+            ++sdi_run_count;
+        }
+    }
+    vdhp->rap_list     = (rap_info_t *)lw_malloc_zero( MAX( rap_count, 1 ) * sizeof(rap_info_t) );
+    vdhp->sdi_run_list = (sample_description_run_t *)lw_malloc_zero( MAX( sdi_run_count, 1 ) * sizeof(sample_description_run_t) );
+    if( !vdhp->rap_list || !vdhp->sdi_run_list )
+        goto fail;
+    for( uint32_t i = 1; i <= vdhp->sample_count; i++ )
+    {
+        lsmash_sample_t sample;
+        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, i, &sample ) < 0 )
+            goto fail;
+        if( sample.prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE && vdhp->rap_count < rap_count )
+        {
+            rap_info_t *rap = &vdhp->rap_list[ vdhp->rap_count ];
+            if( lsmash_get_closest_random_accessible_point_detail_from_media_timeline( vdhp->root, vdhp->track_id, i, &rap->number,
+                                                                                       &rap->ra_flags, &rap->leadings, &rap->distance ) == 0
+             && rap->number == i )
+                ++ vdhp->rap_count;
+        }
+        if( (vdhp->sdi_run_count == 0 || sample.index != vdhp->sdi_run_list[ vdhp->sdi_run_count - 1 ].index)
+         && vdhp->sdi_run_count < sdi_run_count )
+        {
+            vdhp->sdi_run_list[ vdhp->sdi_run_count ].first_number = i;
+            vdhp->sdi_run_list[ vdhp->sdi_run_count ].index        = sample.index;
+            ++ vdhp->sdi_run_count;
+        }
+    }
+    return 0;
+fail:
+    lw_freep( &vdhp->rap_list );
+    lw_freep( &vdhp->sdi_run_list );
+    vdhp->rap_count     = 0;
+    vdhp->sdi_run_count = 0;
+    return -1;
+}
+
+/* Return the number of the source sample of the output sample 'sample_number' by scanning the timestamps from the source sample 'last_sample_number'.
+ * Return 0 if not found. */
+static uint32_t scan_vfr2cfr
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    libavsmash_video_output_handler_t *vohp,
+    uint32_t                           sample_number,
+    uint32_t                           last_sample_number
+)
+{
+    /* Convert VFR to CFR. */
+    double target_pts  = (double)((uint64_t)(sample_number - 1) * vohp->cfr_den) / vohp->cfr_num;
+    double current_pts = DBL_MAX;
+    lsmash_sample_t sample;
+    if( last_sample_number <= vdhp->sample_count )
+    {
+        uint32_t last_decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, last_sample_number );
+        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, last_decoding_sample_number, &sample ) < 0 )
+            return 0;
+        current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
+        if( target_pts == current_pts )
+            return last_sample_number;
+    }
+    uint32_t composition_sample_number = last_sample_number;
+    double   prev_pts = current_pts;
+    if( target_pts < current_pts )
+    {
+        for( composition_sample_number--;
+             composition_sample_number;
+             composition_sample_number-- )
+        {
+            uint32_t decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
+            if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, decoding_sample_number, &sample ) < 0 )
+                return 0;
+            current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
+            prev_pts = current_pts;
+            if( current_pts <= target_pts )
+                break;
+        }
+        if( composition_sample_number == 0 )
+            return 0;
+    }
+    double next_target_pts = (double)((uint64_t)sample_number * vohp->cfr_den) / vohp->cfr_num;
+    for( composition_sample_number++;
+         composition_sample_number <= vdhp->sample_count;
+         composition_sample_number++ )
+    {
+        uint32_t decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
+        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, decoding_sample_number, &sample ) < 0 )
+            return 0;
+        current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
+        if( current_pts >= target_pts )
+        {
+            uint32_t prev_composition_sample_number = composition_sample_number - 1;
+            if( current_pts > next_target_pts )
+                /* Between the current target and the next target, there are no input samples.
+                 * Therefore, output the previous sample. This is absolutely correct. */
+                sample_number = prev_composition_sample_number;
+            else
+            {
+                if( current_pts > (next_target_pts + target_pts) / 2 )
+                    /* The current sample is far from the current target and should be a candidate for the next target. */
+                    sample_number = prev_composition_sample_number;
+                else
+                {
+                    /* Choose the nearest one. */
+                    if( current_pts - target_pts >= target_pts - prev_pts )
+                        sample_number = prev_composition_sample_number;
+                    else
+                        sample_number = composition_sample_number;
+                }
+            }
+            break;
+        }
+        prev_pts = current_pts;
+    }
+    if( composition_sample_number > vdhp->sample_count )
+        sample_number = vdhp->sample_count;
+    return sample_number;
+}
+
+/* Map all output samples to the source samples in ascending order, which takes linear time in total,
+ * so that each request is a single lookup. */
+static int create_vfr2cfr_map
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    libavsmash_video_output_handler_t *vohp
+)
+{
+    lw_freep( &vohp->cfr_frame_map );
+    uint32_t *map = (uint32_t *)lw_malloc_zero( (vohp->frame_count + 1) * sizeof(uint32_t) );
+    if( !map )
+        return -1;
+    uint32_t last_sample_number = vdhp->sample_count + 1;
+    for( uint32_t i = 1; i <= vohp->frame_count; i++ )
+    {
+        map[i] = scan_vfr2cfr( vdhp, vohp, i, last_sample_number );
+        if( map[i] )
+            last_sample_number = map[i];
+    }
+    vohp->cfr_frame_map = map;
+    return 0;
+}
+
+static uint32_t libavsmash_vfr2cfr
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    libavsmash_video_output_handler_t *vohp,
+    uint32_t                           sample_number
+)
+{
+    if( vohp->cfr_frame_map )
+        return sample_number <= vohp->frame_count ? vohp->cfr_frame_map[sample_number] : 0;
+    return scan_vfr2cfr( vdhp, vohp, sample_number, vdhp->last_sample_number );
+}
+
 int libavsmash_video_setup_timestamp_info
 (
     libavsmash_video_decode_handler_t *vdhp,
@@ -500,6 +724,8 @@ int libavsmash_video_setup_timestamp_info
 )
 {
     int err = -1;
+    if( create_seek_tables( vdhp ) < 0 )
+        lw_log_show( &vdhp->config.lh, LW_LOG_WARNING, "Failed to create the seek tables. Seeking may get slow." );
     uint64_t media_timescale = lsmash_get_media_timescale( vdhp->root, vdhp->track_id );
     uint64_t media_duration  = lsmash_get_media_duration_from_media_timeline( vdhp->root, vdhp->track_id );
     if( media_duration == 0 )
@@ -604,6 +830,8 @@ setup_finish:;
         vohp->frame_count = libavsmash_video_get_sample_count( vdhp );
     uint32_t min_cts_sample_number = get_decoding_sample_number( vdhp->order_converter, 1 );
     vdhp->config.error = lsmash_get_cts_from_media_timeline( vdhp->root, vdhp->track_id, min_cts_sample_number, &vdhp->min_cts );
+    if( vohp->vfr2cfr && !vdhp->config.error && create_vfr2cfr_map( vdhp, vohp ) < 0 )
+        lw_log_show( &vdhp->config.lh, LW_LOG_WARNING, "Failed to create the VFR to CFR conversion table. Seeking may get slow." );
     return err;
 }
 
@@ -630,6 +858,7 @@ static int decode_video_sample
     av_frame_unref( picture );
     uint64_t cts = pkt.pts;
     ret = decode_video_packet( config->ctx, picture, got_picture, &pkt );
+    av_packet_unref( &pkt );
     picture->pts = cts;
     if( ret < 0 )
     {
@@ -639,6 +868,61 @@ static int decode_video_sample
     return 0;
 }
 
+static uint32_t find_sample_description_run
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    uint32_t                           decoding_sample_number
+)
+{
+    /* Return the last run starting at or before the sample. */
+    uint32_t lo = 0;
+    uint32_t hi = vdhp->sdi_run_count - 1;
+    while( lo < hi )
+    {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if( vdhp->sdi_run_list[mid].first_number <= decoding_sample_number )
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+static int get_closest_random_accessible_point
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    uint32_t                           decoding_sample_number,
+    uint32_t                          *rap_number,
+    lsmash_random_access_flag         *ra_flags,
+    uint32_t                          *number_of_leadings,
+    uint32_t                          *distance
+)
+{
+    if( vdhp->rap_count && vdhp->rap_list[0].number <= decoding_sample_number )
+    {
+        uint32_t lo = 0;
+        uint32_t hi = vdhp->rap_count - 1;
+        while( lo < hi )
+        {
+            uint32_t mid = lo + (hi - lo + 1) / 2;
+            if( vdhp->rap_list[mid].number <= decoding_sample_number )
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        rap_info_t *rap = &vdhp->rap_list[lo];
+        *rap_number         = rap->number;
+        *ra_flags           = rap->ra_flags;
+        *number_of_leadings = rap->leadings;
+        *distance           = rap->distance;
+        return 0;
+    }
+    /* No table or no past random accessible point. Leave it to L-SMASH. */
+    return lsmash_get_closest_random_accessible_point_detail_from_media_timeline( vdhp->root, vdhp->track_id,
+                                                                                  decoding_sample_number, rap_number,
+                                                                                  ra_flags, number_of_leadings, distance );
+}
+
 static int find_random_accessible_point
 (
     libavsmash_video_decode_handler_t *vdhp,
@@ -649,55 +933,34 @@ static int find_random_accessible_point
 {
     if( decoding_sample_number == 0 )
         decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
-    lsmash_random_access_flag ra_flags;
-    uint32_t distance;  /* distance from the closest random accessible point to the previous. */
-    uint32_t number_of_leadings;
-    if( lsmash_get_closest_random_accessible_point_detail_from_media_timeline( vdhp->root, vdhp->track_id,
-                                                                               decoding_sample_number, rap_number,
-                                                                               &ra_flags, &number_of_leadings, &distance ) < 0 )
+    lsmash_random_access_flag ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE;
+    uint32_t distance = 0;  /* distance from the closest random accessible point to the previous. */
+    uint32_t number_of_leadings = 0;
+    if( get_closest_random_accessible_point( vdhp, decoding_sample_number, rap_number,
+                                             &ra_flags, &number_of_leadings, &distance ) < 0 )
         *rap_number = 1;
     int roll_recovery = !!(ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_GDR);
     int is_leading    = number_of_leadings && (decoding_sample_number - *rap_number <= number_of_leadings);
     if( (roll_recovery || is_leading) && *rap_number > distance )
         *rap_number -= distance;
+    else
+        distance = 0;
+    if( vdhp->sdi_run_count == 0 )
+        return roll_recovery;
     /* Check whether random accessible point has the same decoder configuration or not. */
     decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
-    do
+    uint32_t run_number = find_sample_description_run( vdhp, decoding_sample_number );
+    uint32_t index      = vdhp->sdi_run_list[run_number].index;
+    if( vdhp->sdi_run_list[ find_sample_description_run( vdhp, *rap_number ) ].index != index )
     {
-        lsmash_sample_t sample;
-        lsmash_sample_t rap_sample;
-        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, decoding_sample_number, &sample ) < 0
-         || lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, *rap_number, &rap_sample ) < 0 )
-        {
-            /* Fatal error. */
-            *rap_number = vdhp->last_rap_number;
-            return 0;
-        }
-        if( sample.index == rap_sample.index )
-            break;
-        uint32_t sample_index = sample.index;
-        for( uint32_t i = decoding_sample_number - 1; i; i-- )
-        {
-            if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, i, &sample ) < 0 )
-            {
-                /* Fatal error. */
-                *rap_number = vdhp->last_rap_number;
-                return 0;
-            }
-            if( sample.index != sample_index )
-            {
-                if( distance )
-                {
-                    *rap_number += distance;
-                    distance = 0;
-                    continue;
-                }
-                else
-                    *rap_number = i + 1;
-            }
-        }
-        break;
-    } while( 1 );
+        /* Go back to the random accessible point before the distance is applied if it has the same configuration.
+         * Otherwise, start from the first sample of the run of the configuration. */
+        uint32_t first_number = vdhp->sdi_run_list[run_number].first_number;
+        if( distance && *rap_number + distance >= first_number )
+            *rap_number += distance;
+        else
+            *rap_number = first_number;
+    }
     return roll_recovery;
 }
 
@@ -917,82 +1180,118 @@ video_fail:
 #undef MAX_ERROR_COUNT
 }
 
-static uint32_t libavsmash_vfr2cfr
+/* Decode the frame following the requested ones on the lookahead thread. */
+static int decode_video_sample_ahead
+(
+    void    *priv,
+    uint32_t sample_number,
+    AVFrame *frame
+)
+{
+    libavsmash_video_decode_handler_t *vdhp = (libavsmash_video_decode_handler_t *)priv;
+    codec_configuration_t *config = &vdhp->config;
+    /* Updating the decoder configuration reports fatal errors through the log handler bound to the caller,
+     * so leave the samples of another sample description to the caller. */
+    uint32_t last_decoding_sample_number = MIN( sample_number + config->delay_count, vdhp->sample_count );
+    if( !vdhp->sdi_run_list
+     || vdhp->sdi_run_list[ find_sample_description_run( vdhp, last_decoding_sample_number ) ].index != config->index )
+        return 1;
+    if( get_requested_picture( vdhp, vdhp->frame_buffer, sample_number ) < 0 )
+        return -1;
+    return av_frame_ref( frame, vdhp->frame_buffer ) < 0 ? -1 : 0;
+}
+
+static void start_lookahead
+(
+    libavsmash_video_decode_handler_t *vdhp
+)
+{
+    /* Direct rendering allocates the frame buffers through the front-end on the calling thread. */
+    if( !vdhp->config.ctx || vdhp->config.ctx->get_buffer2 != avcodec_default_get_buffer2 )
+        goto disable;
+    if( !vdhp->cached_frame && !(vdhp->cached_frame = av_frame_alloc()) )
+        goto fail;
+    vdhp->lookahead = lw_lookahead_create( vdhp->lookahead_depth, vdhp->sample_count, decode_video_sample_ahead, vdhp );
+    if( vdhp->lookahead )
+        return;
+fail:
+    lw_log_show( &vdhp->config.lh, LW_LOG_WARNING, "Failed to start decoding frames ahead." );
+disable:
+    vdhp->lookahead_depth = 0;
+}
+
+/* The lookahead thread decodes into frame_buffer while the caller is using the output frame,
+ * so the caller takes the decoded frame through cached_frame. */
+static int hand_over_decoded_frame
+(
+    libavsmash_video_decode_handler_t *vdhp
+)
+{
+    av_frame_unref( vdhp->cached_frame );
+    if( av_frame_ref( vdhp->cached_frame, vdhp->frame_buffer ) < 0 )
+        return -1;
+    vdhp->output_cached_frame = 1;
+    return 0;
+}
+
+static int get_video_sample
 (
     libavsmash_video_decode_handler_t *vdhp,
     libavsmash_video_output_handler_t *vohp,
     uint32_t                           sample_number
 )
 {
-    /* Convert VFR to CFR. */
-    double target_pts  = (double)((uint64_t)(sample_number - 1) * vohp->cfr_den) / vohp->cfr_num;
-    double current_pts = DBL_MAX;
-    lsmash_sample_t sample;
-    if( vdhp->last_sample_number <= vdhp->sample_count )
+    lw_frame_cache_t *fcp = &vdhp->frame_cache;
+    int output_cached_frame = vdhp->output_cached_frame;
+    if( vdhp->lookahead )
     {
-        uint32_t last_decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, vdhp->last_sample_number );
-        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, last_decoding_sample_number, &sample ) < 0 )
-            return 0;
-        current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
-        if( target_pts == current_pts )
-            return vdhp->last_sample_number;
-    }
-    uint32_t composition_sample_number = vdhp->last_sample_number;
-    double   prev_pts = current_pts;
-    if( target_pts < current_pts )
-    {
-        for( composition_sample_number--;
-             composition_sample_number;
-             composition_sample_number-- )
+        /* The last output frame is still referenced by cached_frame. */
+        if( sample_number == lw_lookahead_get_last_request( vdhp->lookahead ) )
+            return 1;
+        int ret = lw_lookahead_take( vdhp->lookahead, sample_number, vdhp->cached_frame );
+        if( ret < 0 )
+            return -1;
+        if( ret > 0 )
         {
-            uint32_t decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
-            if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, decoding_sample_number, &sample ) < 0 )
-                return 0;
-            current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
-            prev_pts = current_pts;
-            if( current_pts <= target_pts )
-                break;
+            vdhp->output_cached_frame = 1;
+            if( update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->config.lh, vdhp->cached_frame ) < 0 )
+                return -1;
+            goto put_frame;
         }
-        if( composition_sample_number == 0 )
-            return 0;
     }
-    double next_target_pts = (double)((uint64_t)sample_number * vohp->cfr_den) / vohp->cfr_num;
-    for( composition_sample_number++;
-         composition_sample_number <= vdhp->sample_count;
-         composition_sample_number++ )
+    if( fcp->max_size )
     {
-        uint32_t decoding_sample_number = get_decoding_sample_number( vdhp->order_converter, composition_sample_number );
-        if( lsmash_get_sample_info_from_media_timeline( vdhp->root, vdhp->track_id, decoding_sample_number, &sample ) < 0 )
-            return 0;
-        current_pts = (double)(sample.cts - vdhp->min_cts) / vdhp->media_timescale;
-        if( current_pts >= target_pts )
+        /* The decoder state is left untouched on a hit, so the next miss keeps decoding from where it was. */
+        AVFrame *cached = lw_frame_cache_get( fcp, sample_number );
+        if( cached )
         {
-            uint32_t prev_composition_sample_number = composition_sample_number - 1;
-            if( current_pts > next_target_pts )
-                /* Between the current target and the next target, there are no input samples.
-                 * Therefore, output the previous sample. This is absolutely correct. */
-                sample_number = prev_composition_sample_number;
-            else
-            {
-                if( current_pts > (next_target_pts + target_pts) / 2 )
-                    /* The current sample is far from the current target and should be a candidate for the next target. */
-                    sample_number = prev_composition_sample_number;
-                else
-                {
-                    /* Choose the nearest one. */
-                    if( current_pts - target_pts >= target_pts - prev_pts )
-                        sample_number = prev_composition_sample_number;
-                    else
-                        sample_number = composition_sample_number;
-                }
-            }
-            break;
+            av_frame_unref( vdhp->cached_frame );
+            if( av_frame_ref( vdhp->cached_frame, cached ) < 0 )
+                return -1;
+            vdhp->output_cached_frame = 1;
+            return update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->config.lh, vdhp->cached_frame ) < 0 ? -1 : 0;
         }
-        prev_pts = current_pts;
+        vdhp->output_cached_frame = 0;
     }
-    if( composition_sample_number > vdhp->sample_count )
-        sample_number = vdhp->sample_count;
-    return sample_number;
+    int ret;
+    if( sample_number == vdhp->last_sample_number )
+    {
+        if( !output_cached_frame )
+            return 1;
+        /* The last decoded frame is still there. */
+        if( vdhp->lookahead && hand_over_decoded_frame( vdhp ) < 0 )
+            return -1;
+        ret = update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->config.lh, libavsmash_video_get_frame_buffer( vdhp ) );
+        return ret < 0 ? ret : 0;
+    }
+    if( (ret = get_requested_picture( vdhp, vdhp->frame_buffer, sample_number )) < 0
+     || (vdhp->lookahead && (ret = hand_over_decoded_frame( vdhp )) < 0)
+     || (ret = update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->config.lh, libavsmash_video_get_frame_buffer( vdhp ) )) < 0 )
+        return ret;
+put_frame:
+    if( fcp->max_size && lw_frame_cache_put( fcp, sample_number, libavsmash_video_get_frame_buffer( vdhp ) ) < 0 )
+        lw_log_show( &vdhp->config.lh, LW_LOG_WARNING, "Failed to cache a decoded video frame." );
+    return 0;
 }
 
 /* Return 0 if successful.
@@ -1005,19 +1304,21 @@ int libavsmash_video_get_frame
     uint32_t                           sample_number
 )
 {
-    if( vohp->vfr2cfr )
-    {
-        sample_number = libavsmash_vfr2cfr( vdhp, vohp, sample_number );
-        if( sample_number == 0 )
-            return -1;
-    }
-    if( sample_number == vdhp->last_sample_number )
-        return 1;
-    int ret;
-    if( (ret = get_requested_picture( vdhp, vdhp->frame_buffer, sample_number )) < 0
-     || (ret = update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->config.lh, vdhp->frame_buffer )) < 0 )
-        return ret;
-    return 0;
+    if( vdhp->lookahead_depth > 0 && !vdhp->lookahead )
+        start_lookahead( vdhp );
+    /* VFR to CFR conversion also looks at the decoder position. */
+    if( vdhp->lookahead )
+        lw_lookahead_pause( vdhp->lookahead );
+    int ret = -1;
+    if( vohp->vfr2cfr
+     && (sample_number = libavsmash_vfr2cfr( vdhp, vohp, sample_number )) == 0 )
+        goto resume;
+    ret = get_video_sample( vdhp, vohp, sample_number );
+resume:
+    /* The thread must be resumed even on failure, or it never decodes ahead again. */
+    if( vdhp->lookahead )
+        lw_lookahead_resume( vdhp->lookahead, sample_number );
+    return ret;
 }
 
 int libavsmash_video_find_first_valid_frame
@@ -1032,7 +1333,10 @@ int libavsmash_video_find_first_valid_frame
         get_sample( vdhp->root, vdhp->track_id, i, config, &pkt );
         av_frame_unref( vdhp->frame_buffer );
         int got_picture;
-        if( decode_video_packet( config->ctx, vdhp->frame_buffer, &got_picture, &pkt ) >= 0 && got_picture )
+        int ret     = decode_video_packet( config->ctx, vdhp->frame_buffer, &got_picture, &pkt );
+        int flushed = !pkt.data;
+        av_packet_unref( &pkt );
+        if( ret >= 0 && got_picture )
         {
             vdhp->first_valid_frame_number = i - MIN( get_decoder_delay( config->ctx ), config->delay_count );
             if( vdhp->first_valid_frame_number > 1 || vdhp->sample_count == 1 )
@@ -1044,7 +1348,7 @@ int libavsmash_video_find_first_valid_frame
             }
             break;
         }
-        else if( pkt.data )
+        else if( !flushed )
             ++ config->delay_count;
     }
     return 0;
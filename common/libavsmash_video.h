@@ -116,6 +116,22 @@ void libavsmash_video_set_get_buffer_func
     libavsmash_video_decode_handler_t *vdhp
 );
 
+/* Set the maximum number of frames decoded ahead of sequential requests by a dedicated thread.
+ * Decoding ahead is disabled if set to 0. */
+void libavsmash_video_set_lookahead_depth
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    int                                lookahead_depth
+);
+
+/* Set the memory budget in bytes of the decoded frame cache.
+ * The cache is disabled if set to 0. */
+int libavsmash_video_set_frame_cache_size
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    size_t                             max_size
+);
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -174,6 +190,13 @@ AVFrame *libavsmash_video_get_frame_buffer
     libavsmash_video_decode_handler_t *vdhp
 );
 
+void libavsmash_video_get_frame_cache_stats
+(
+    libavsmash_video_decode_handler_t *vdhp,
+    uint64_t                          *hits,
+    uint64_t                          *misses
+);
+
 uint32_t libavsmash_video_get_sample_count
 (
     libavsmash_video_decode_handler_t *vdhp
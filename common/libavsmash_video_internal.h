@@ -29,6 +29,21 @@ typedef struct
     uint32_t composition_to_decoding;
 } order_converter_t;
 
+typedef struct
+{
+    uint32_t                  number;           /* sample number in decoding order */
+    uint32_t                  leadings;         /* the number of the leading samples */
+    uint32_t                  distance;         /* distance to the previous random accessible point */
+    lsmash_random_access_flag ra_flags;
+} rap_info_t;
+
+/* consecutive samples in decoding order which share a sample description */
+typedef struct
+{
+    uint32_t first_number;
+    uint32_t index;
+} sample_description_run_t;
+
 struct libavsmash_video_decode_handler_tag
 {
     lsmash_root_t        *root;
@@ -47,4 +62,13 @@ struct libavsmash_video_decode_handler_tag
     uint32_t              media_timescale;
     uint64_t              media_duration;
     uint64_t              min_cts;
+    lw_frame_cache_t      frame_cache;          /* decoded frames keyed by sample number in composition order */
+    AVFrame              *cached_frame;         /* the frame taken from the frame cache */
+    int                   output_cached_frame;  /* Output cached_frame instead of frame_buffer if set to non-zero. */
+    rap_info_t           *rap_list;             /* random accessible points in decoding order */
+    uint32_t              rap_count;
+    sample_description_run_t *sdi_run_list;
+    uint32_t              sdi_run_count;
+    int                   lookahead_depth;      /* the maximum number of frames decoded ahead; 0 means disabled */
+    lw_lookahead_t       *lookahead;            /* the thread decoding frames ahead of sequential requests if lookahead_depth is non-zero */
 };
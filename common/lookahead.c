@@ -0,0 +1,258 @@
+/*****************************************************************************
+ * lookahead.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "cpp_compat.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+#include <libavutil/frame.h>
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#include "utils.h"
+#include "osdep.h"
+#include "lookahead.h"
+
+struct lw_lookahead_tag
+{
+    lw_thread_t           thread;
+    lw_mutex_t            mutex;
+    lw_cond_t             cond;         /* signaled whenever the state of the ring or the thread changes */
+    lw_lookahead_decode_t decode;
+    void                 *priv;
+    AVFrame             **ring;         /* ring buffer of the frames decoded ahead */
+    uint32_t             *numbers;      /* the frame numbers of the ring entries */
+    int                   depth;        /* the maximum number of the frames decoded ahead */
+    int                   head;
+    int                   count;
+    uint32_t              frame_count;
+    uint32_t              next;         /* the number of the frame to be decoded ahead next */
+    uint32_t              limit;        /* the number of the last frame to be decoded ahead; 0 means nothing */
+    uint32_t              stall;        /* the number of the last frame failed to be decoded ahead */
+    uint32_t              last_request;
+    int                   paused;       /* The decoder is lent to the caller if set to non-zero. */
+    int                   decoding;     /* The lookahead thread is using the decoder if set to non-zero. */
+    int                   exit;
+};
+
+static void drop_head
+(
+    lw_lookahead_t *lap
+)
+{
+    av_frame_unref( lap->ring[ lap->head ] );
+    lap->head = (lap->head + 1) % lap->depth;
+    -- lap->count;
+}
+
+static void clear_ring
+(
+    lw_lookahead_t *lap
+)
+{
+    while( lap->count )
+        drop_head( lap );
+    lap->head = 0;
+}
+
+static void *lookahead_thread
+(
+    void *arg
+)
+{
+    lw_lookahead_t *lap = (lw_lookahead_t *)arg;
+    lw_log_mute_thread( 1 );
+    lw_mutex_lock( lap->mutex );
+    while( !lap->exit )
+    {
+        if( lap->paused || lap->count == lap->depth || lap->next > lap->limit || lap->next <= lap->stall )
+        {
+            lw_cond_wait( lap->cond, lap->mutex );
+            continue;
+        }
+        uint32_t frame_number = lap->next;
+        int      tail         = (lap->head + lap->count) % lap->depth;
+        lap->decoding = 1;
+        lw_mutex_unlock( lap->mutex );
+        /* Decode without the lock so that the caller can take the frames decoded ahead meanwhile.
+         * The caller never touches the tail entry until it is counted in. */
+        int ret = lap->decode( lap->priv, frame_number, lap->ring[tail] );
+        lw_mutex_lock( lap->mutex );
+        lap->decoding = 0;
+        if( ret == 0 )
+        {
+            lap->numbers[tail] = frame_number;
+            ++ lap->count;
+            ++ lap->next;
+        }
+        else
+        {
+            /* Leave this frame to the caller, which can report the error or update the decoder configuration. */
+            av_frame_unref( lap->ring[tail] );
+            lap->stall = frame_number;
+        }
+        lw_cond_broadcast( lap->cond );
+    }
+    lw_mutex_unlock( lap->mutex );
+    return NULL;
+}
+
+lw_lookahead_t *lw_lookahead_create
+(
+    int                   depth,
+    uint32_t              frame_count,
+    lw_lookahead_decode_t decode,
+    void                 *priv
+)
+{
+    if( depth <= 0 )
+        return NULL;
+    lw_lookahead_t *lap = (lw_lookahead_t *)lw_malloc_zero( sizeof(lw_lookahead_t) );
+    if( !lap )
+        return NULL;
+    lap->decode      = decode;
+    lap->priv        = priv;
+    lap->depth       = depth;
+    lap->frame_count = frame_count;
+    lap->next        = 1;
+    lap->paused      = 1;
+    lap->ring    = (AVFrame **)lw_malloc_zero( depth * sizeof(AVFrame *) );
+    lap->numbers = (uint32_t *)lw_malloc_zero( depth * sizeof(uint32_t) );
+    if( !lap->ring || !lap->numbers )
+        goto fail;
+    for( int i = 0; i < depth; i++ )
+        if( !(lap->ring[i] = av_frame_alloc()) )
+            goto fail;
+    lap->mutex = lw_mutex_create();
+    lap->cond  = lw_cond_create();
+    if( !lap->mutex || !lap->cond )
+        goto fail;
+    lap->thread = lw_thread_create( lookahead_thread, lap );
+    if( !lap->thread )
+        goto fail;
+    return lap;
+fail:
+    lw_lookahead_destroy( lap );
+    return NULL;
+}
+
+void lw_lookahead_destroy
+(
+    lw_lookahead_t *lap
+)
+{
+    if( !lap )
+        return;
+    if( lap->thread )
+    {
+        lw_mutex_lock( lap->mutex );
+        lap->exit = 1;
+        lw_cond_broadcast( lap->cond );
+        lw_mutex_unlock( lap->mutex );
+        lw_thread_join( lap->thread );
+    }
+    if( lap->ring )
+    {
+        for( int i = 0; i < lap->depth; i++ )
+            av_frame_free( &lap->ring[i] );
+        lw_free( lap->ring );
+    }
+    lw_free( lap->numbers );
+    lw_cond_destroy( lap->cond );
+    lw_mutex_destroy( lap->mutex );
+    lw_free( lap );
+}
+
+void lw_lookahead_pause
+(
+    lw_lookahead_t *lap
+)
+{
+    lw_mutex_lock( lap->mutex );
+    lap->paused = 1;
+    while( lap->decoding )
+        lw_cond_wait( lap->cond, lap->mutex );
+    lw_mutex_unlock( lap->mutex );
+}
+
+int lw_lookahead_take
+(
+    lw_lookahead_t *lap,
+    uint32_t        frame_number,
+    AVFrame        *frame
+)
+{
+    int ret = 0;
+    lw_mutex_lock( lap->mutex );
+    while( lap->count && lap->numbers[ lap->head ] < frame_number )
+        drop_head( lap );
+    if( lap->count && lap->numbers[ lap->head ] == frame_number )
+    {
+        av_frame_unref( frame );
+        ret = av_frame_ref( frame, lap->ring[ lap->head ] ) < 0 ? -1 : 1;
+        drop_head( lap );
+    }
+    else
+        clear_ring( lap );
+    lw_mutex_unlock( lap->mutex );
+    return ret;
+}
+
+void lw_lookahead_resume
+(
+    lw_lookahead_t *lap,
+    uint32_t        frame_number
+)
+{
+    lw_mutex_lock( lap->mutex );
+    if( frame_number > lap->last_request && frame_number - lap->last_request <= (uint32_t)lap->depth )
+    {
+        /* Sequential access, which may skip a few frames, e.g. by VFR to CFR conversion. */
+        if( lap->count == 0 )
+            lap->next = frame_number + 1;
+        lap->limit = MIN( frame_number + lap->depth, lap->frame_count );
+    }
+    else if( frame_number != lap->last_request )
+    {
+        /* Random access. The frames decoded ahead, if any, are useless. */
+        clear_ring( lap );
+        lap->limit = 0;
+    }
+    lap->last_request = frame_number;
+    lap->paused       = 0;
+    lw_cond_broadcast( lap->cond );
+    lw_mutex_unlock( lap->mutex );
+}
+
+uint32_t lw_lookahead_get_last_request
+(
+    lw_lookahead_t *lap
+)
+{
+    lw_mutex_lock( lap->mutex );
+    uint32_t last_request = lap->last_request;
+    lw_mutex_unlock( lap->mutex );
+    return last_request;
+}
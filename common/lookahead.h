@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * lookahead.h
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Lookahead decoding
+ * While the caller is busy with the last returned frame, a background thread keeps decoding
+ * the following frames into a ring of references to the decoded buffers.
+ * The thread runs only while the requests are sequential, and it shares the decoder with the caller,
+ * so the caller must pause it before touching the decoder and resume it after that. */
+typedef struct lw_lookahead_tag lw_lookahead_t;
+
+/* Decode the frame of 'frame_number' and reference it to 'frame' on the lookahead thread.
+ * Return 0 if successful.
+ * Return a positive value if the frame can't be decoded ahead safely, e.g. over a change of the decoder configuration.
+ * Return a negative value if failed. */
+typedef int (*lw_lookahead_decode_t)( void *priv, uint32_t frame_number, AVFrame *frame );
+
+/* Return NULL if failed or 'depth' is not positive. */
+lw_lookahead_t *lw_lookahead_create
+(
+    int                   depth,
+    uint32_t              frame_count,
+    lw_lookahead_decode_t decode,
+    void                 *priv
+);
+
+void lw_lookahead_destroy
+(
+    lw_lookahead_t *lap
+);
+
+/* Wait for the frame being decoded ahead if any, and keep the thread from decoding until lw_lookahead_resume(). */
+void lw_lookahead_pause
+(
+    lw_lookahead_t *lap
+);
+
+/* Reference the frame of 'frame_number' to 'frame' if it was decoded ahead, and drop the frames before it.
+ * Return 1 if found.
+ * Return 0 if not found, and then all frames decoded ahead are dropped.
+ * Return a negative value if failed.
+ * The lookahead thread must be paused. */
+int lw_lookahead_take
+(
+    lw_lookahead_t *lap,
+    uint32_t        frame_number,
+    AVFrame        *frame
+);
+
+/* Let the thread decode up to 'depth' frames following 'frame_number', which the caller has just got,
+ * if it is at most 'depth' frames after the last requested one.
+ * Otherwise, the thread stays idle until the next sequential request. */
+void lw_lookahead_resume
+(
+    lw_lookahead_t *lap,
+    uint32_t        frame_number
+);
+
+/* Return the number of the last frame requested by the caller. */
+uint32_t lw_lookahead_get_last_request
+(
+    lw_lookahead_t *lap
+);
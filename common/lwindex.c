@@ -31,6 +31,7 @@ extern "C"
 #include <libswresample/swresample.h>   /* Resampler/Buffer */
 #include <libavutil/mathematics.h>      /* Timebase rescaler */
 #include <libavutil/pixdesc.h>
+#include <libavutil/cpu.h>
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -41,14 +42,18 @@ extern "C"
 #include "audio_output.h"
 #include "lwlibav_dec.h"
 #include "lwlibav_video.h"
+#include "frame_cache.h"
+#include "lookahead.h"
 #include "lwlibav_video_internal.h"
 #include "lwlibav_audio.h"
+#include "pcm_cache.h"
 #include "lwlibav_audio_internal.h"
 #include "progress.h"
 #include "lwindex.h"
 #include "decode.h"
 
 #include <sys/stat.h>
+#define XXH_STATIC_LINKING_ONLY     /* for XXH3_state_t */
 #include "xxhash.h"
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -73,6 +78,15 @@ typedef struct
                                                  * 2: either VC-1 or WMV3 encapsulated in ASF */
     int                         already_decoded;
     int (*decode)(AVCodecContext *, AVFrame *, int *, AVPacket * );
+    /* Audio frame length by the bitstream headers instead of actual decoding */
+    int (*read_frame_length)( const uint8_t *, int, uint32_t * );
+    uint32_t                    header_config;      /* the coded audio configuration in the last read header */
+    uint32_t                    decoder_config;     /* the coded audio configuration the decoder agreed with */
+    int                         frame_length_scale; /* the decoded samples per the samples in the headers, or 0 if not agreed */
+    uint32_t                    audio_packet_count;
+    uint32_t                    decoded_packet_count;
+    int                         queued;         /* set to non-zero once a packet of this stream is queued in the parallel indexing */
+    int                         parsing;        /* set to non-zero while a worker parses a packet of this stream */
 } lwindex_helper_t;
 
 typedef struct
@@ -84,6 +98,11 @@ typedef struct
     const char       **preferred_audio_decoder_names;
     int                thread_count;
     char              *format_name;
+    /* If partial_* is set to non-zero, the streams of the type other than *_stream_index are not indexed. */
+    int                partial_video;
+    int                partial_audio;
+    int                video_stream_index;
+    int                audio_stream_index;
 } lwindex_indexer_t;
 
 typedef struct
@@ -666,9 +685,35 @@ static int decide_video_seek_method
             }
         }
     }
-    /* Set up keyframe list: presentation order (info) -> decoding order (keyframe_list) */
+    /* Set up the list of the random accessible pictures: presentation order (info) -> decoding order (rap_list) */
+    uint8_t *is_rap = (uint8_t *)lw_malloc_zero( (sample_count + 1) * sizeof(uint8_t) );
+    if( !is_rap )
+    {
+        lw_log_show( &vdhp->lh, LW_LOG_FATAL, "Failed to allocate memory." );
+        return -1;
+    }
+    uint32_t rap_count = 0;
+    for( uint32_t i = 1; i <= sample_count; i++ )
+        if( (info[i].flags & LW_VFRAME_FLAG_KEY) && info[i].sample_number <= sample_count )
+        {
+            is_rap[ info[i].sample_number ] = 1;
+            ++rap_count;
+        }
+    uint32_t *rap_list = (uint32_t *)lw_malloc_zero( MAX( rap_count, 1 ) * sizeof(uint32_t) );
+    if( !rap_list )
+    {
+        lw_free( is_rap );
+        lw_log_show( &vdhp->lh, LW_LOG_FATAL, "Failed to allocate memory." );
+        return -1;
+    }
+    rap_count = 0;
     for( uint32_t i = 1; i <= sample_count; i++ )
-        vdhp->keyframe_list[ info[i].sample_number ] = !!(info[i].flags & LW_VFRAME_FLAG_KEY);
+        if( is_rap[i] )
+            rap_list[ rap_count++ ] = i;
+    lw_free( is_rap );
+    lw_free( vdhp->rap_list );
+    vdhp->rap_list  = rap_list;
+    vdhp->rap_count = rap_count;
     return 0;
 }
 
@@ -1198,6 +1243,22 @@ disable_repeat:
     return;
 }
 
+/* the lock of the shared index registry, which is available only if set up by the application */
+static lw_mutex_t shared_index_mutex = NULL;
+
+/* Keep a copy of the frame list for the index registry before creating the frame order list,
+ * which settles the field info and the flags in the frame list according to the repeat option. */
+static void keep_initial_frame_list
+(
+    lwlibav_video_decode_handler_t *vdhp
+)
+{
+    lw_freep( &vdhp->initial_frame_list );
+    if( shared_index_mutex )
+        vdhp->initial_frame_list = (video_frame_info_t *)lw_memdup( vdhp->frame_list,
+                                                                    (vdhp->frame_count + 1) * sizeof(video_frame_info_t) );
+}
+
 static lwlibav_extradata_t *alloc_extradata_entries
 (
     lwlibav_extradata_handler_t *exhp,
@@ -1296,6 +1357,207 @@ static inline void av_init_packet_for_safe
     av_init_packet( pkt );
 }
 
+/*****************************************************************************
+ * Audio frame length by the bitstream headers
+ *****************************************************************************/
+/* Each reader returns the number of the samples in the frames of a packet, or 0 if unknown,
+ * and sets '*config' to the value identifying the coded audio configuration, e.g. the sample rate and the channels.
+ * The frame length is trusted only while the configuration is the same as the one checked by actual decoding. */
+static inline uint32_t read_header_bits
+(
+    const uint8_t *data,
+    int            offset,
+    int            count
+)
+{
+    uint32_t value = 0;
+    for( int i = offset; i < offset + count; i++ )
+        value = (value << 1) | ((data[i >> 3] >> (7 - (i & 7))) & 1);
+    return value;
+}
+
+static int read_ac3_frame_length
+(
+    const uint8_t *data,
+    int            size,
+    uint32_t      *config
+)
+{
+    /* the frame sizes in 16-bit words per frmsizecod and fscod */
+    static const uint16_t ac3_frame_sizes[38][3] =
+    {
+        {   64,   69,   96 }, {   64,   70,   96 }, {   80,   87,  120 }, {   80,   88,  120 },
+        {   96,  104,  144 }, {   96,  105,  144 }, {  112,  121,  168 }, {  112,  122,  168 },
+        {  128,  139,  192 }, {  128,  140,  192 }, {  160,  174,  240 }, {  160,  175,  240 },
+        {  192,  208,  288 }, {  192,  209,  288 }, {  224,  243,  336 }, {  224,  244,  336 },
+        {  256,  278,  384 }, {  256,  279,  384 }, {  320,  348,  480 }, {  320,  349,  480 },
+        {  384,  417,  576 }, {  384,  418,  576 }, {  448,  487,  672 }, {  448,  488,  672 },
+        {  512,  557,  768 }, {  512,  558,  768 }, {  640,  696,  960 }, {  640,  697,  960 },
+        {  768,  835, 1152 }, {  768,  836, 1152 }, {  896,  975, 1344 }, {  896,  976, 1344 },
+        { 1024, 1114, 1536 }, { 1024, 1115, 1536 }, { 1152, 1253, 1728 }, { 1152, 1254, 1728 },
+        { 1280, 1393, 1920 }, { 1280, 1394, 1920 }
+    };
+    static const uint8_t eac3_blocks[4] = { 1, 2, 3, 6 };
+    int      frame_length = 0;
+    uint32_t frame_config = 0;
+    uint32_t dependent    = 0;
+    while( size >= 8 && data[0] == 0x0B && data[1] == 0x77 )
+    {
+        int bsid = data[5] >> 3;
+        int frame_size;
+        if( bsid <= 8 )
+        {
+            /* AC-3 */
+            int fscod      = data[4] >> 6;
+            int frmsizecod = data[4] & 0x3F;
+            if( fscod == 3 || frmsizecod >= 38 )
+                return 0;
+            /* The position of lfeon depends on acmod. */
+            int acmod  = data[6] >> 5;
+            int offset = 51;
+            if( (acmod & 1) && acmod != 1 )
+                offset += 2;    /* cmixlev */
+            if( acmod & 4 )
+                offset += 2;    /* surmixlev */
+            if( acmod == 2 )
+                offset += 2;    /* dsurmod */
+            frame_size    = ac3_frame_sizes[frmsizecod][fscod] * 2;
+            frame_length += 1536;
+            frame_config  = (bsid << 8) | (fscod << 4) | (acmod << 1) | read_header_bits( data, offset, 1 );
+        }
+        else if( bsid >= 11 && bsid <= 16 )
+        {
+            /* E-AC-3
+             * The dependent substreams and the independent ones other than the first are coded along with the first one. */
+            int strmtyp     = data[2] >> 6;
+            int substreamid = (data[2] >> 3) & 0x07;
+            int fscod       = data[4] >> 6;
+            int blocks      = fscod == 3 ? 6 : eac3_blocks[ (data[4] >> 4) & 0x03 ];
+            frame_size = ((((data[2] & 0x07) << 8) | data[3]) + 1) * 2;
+            if( strmtyp == 3 )
+                return 0;
+            if( strmtyp == 1 )
+                dependent = 1;
+            else if( substreamid == 0 )
+            {
+                frame_length += blocks * 256;
+                frame_config  = (bsid << 8) | (data[4] & 0xCF) | (fscod == 3 ? (data[4] & 0x30) : 0);
+            }
+        }
+        else
+            return 0;
+        data += frame_size;
+        size -= frame_size;
+    }
+    if( size != 0 || frame_length == 0 )
+        return 0;
+    *config = (dependent << 16) | frame_config;
+    return frame_length;
+}
+
+static int read_dts_frame_length
+(
+    const uint8_t *data,
+    int            size,
+    uint32_t      *config
+)
+{
+    /* The core frames only. The extension substreams following them are coded along with them. */
+    int      frame_length = 0;
+    uint32_t frame_config = 0;
+    while( size >= 11 && data[0] == 0x7F && data[1] == 0xFE && data[2] == 0x80 && data[3] == 0x01 )
+    {
+        int npcmblocks = read_header_bits( data, 39,  7 ) + 1;
+        int frame_size = read_header_bits( data, 46, 14 ) + 1;
+        if( npcmblocks < 6 || frame_size < 96 )
+            return 0;
+        frame_length += npcmblocks * 32;
+        /* AMODE, SFREQ, EXT_AUDIO_ID, EXT_AUDIO and LFF */
+        frame_config = (read_header_bits( data, 60, 10 ) << 8) | (read_header_bits( data, 80, 4 ) << 3) | read_header_bits( data, 85, 2 );
+        data += frame_size;
+        size -= frame_size;
+    }
+    if( frame_length == 0 )
+        return 0;
+    *config = frame_config;
+    return frame_length;
+}
+
+static int read_mlp_frame_length
+(
+    const uint8_t *data,
+    int            size,
+    uint32_t      *config
+)
+{
+    /* Not every access unit has the major sync, so the configuration is taken over from the previous ones. */
+    int      frame_length = 0;
+    uint32_t frame_config = *config;
+    while( size >= 4 )
+    {
+        int unit_size = (((data[0] & 0x0F) << 8) | data[1]) * 2;
+        if( unit_size < 4 || unit_size > size )
+            return 0;
+        if( unit_size >= 12 && data[4] == 0xF8 && data[5] == 0x72 && data[6] == 0x6F && (data[7] == 0xBA || data[7] == 0xBB) )
+        {
+            /* TrueHD has the sample rate code at the top, and MLP has it in the 2nd byte. */
+            int ratebits = data[7] == 0xBA ? data[8] >> 4 : data[9] >> 4;
+            frame_config = 0x80000000 | ((uint32_t)ratebits << 24) | ((uint32_t)data[7] << 16) | (data[10] << 8) | data[11];
+        }
+        if( !(frame_config & 0x80000000) || ((frame_config >> 24) & 0x0F) == 0x0F )
+            return 0;
+        frame_length += 40 << ((frame_config >> 24) & 0x07);
+        data += unit_size;
+        size -= unit_size;
+    }
+    if( size != 0 || frame_length == 0 )
+        return 0;
+    *config = frame_config;
+    return frame_length;
+}
+
+static int read_adts_frame_length
+(
+    const uint8_t *data,
+    int            size,
+    uint32_t      *config
+)
+{
+    /* The decoded samples per raw data block depend on the implicit SBR, so they are agreed with actual decoding. */
+    int      frame_length = 0;
+    uint32_t frame_config = 0;
+    while( size >= 7 && data[0] == 0xFF && (data[1] & 0xF6) == 0xF0 )
+    {
+        int frame_size = ((data[3] & 0x03) << 11) | (data[4] << 3) | (data[5] >> 5);
+        if( frame_size < 7 )
+            return 0;
+        frame_length += ((data[6] & 0x03) + 1) * 1024;
+        /* profile, sampling_frequency_index and channel_configuration */
+        frame_config = ((data[2] & 0xFD) << 8) | (data[3] & 0xC0);
+        data += frame_size;
+        size -= frame_size;
+    }
+    if( size != 0 || frame_length == 0 )
+        return 0;
+    *config = frame_config;
+    return frame_length;
+}
+
+static const struct
+{
+    enum AVCodecID codec_id;
+    int (*read_frame_length)( const uint8_t *, int, uint32_t * );
+} audio_header_readers[] =
+{
+    { AV_CODEC_ID_AC3,    read_ac3_frame_length  },
+    { AV_CODEC_ID_EAC3,   read_ac3_frame_length  },
+    { AV_CODEC_ID_DTS,    read_dts_frame_length  },
+    { AV_CODEC_ID_TRUEHD, read_mlp_frame_length  },
+    { AV_CODEC_ID_MLP,    read_mlp_frame_length  },
+    { AV_CODEC_ID_AAC,    read_adts_frame_length },
+    { AV_CODEC_ID_NONE,   NULL                   }
+};
+
 static lwindex_helper_t *get_index_helper
 (
     lwindex_indexer_t *indexer,
@@ -1321,8 +1583,13 @@ static lwindex_helper_t *get_index_helper
         if( !helper )
             return NULL;
         indexer->helpers[ stream->index ] = helper;
-        /* Set up the decoder. */
         AVCodecParameters *codecpar = stream->codecpar;
+        if( (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && indexer->partial_video && stream->index != indexer->video_stream_index
+          && codecpar->codec_id != AV_CODEC_ID_DVVIDEO)  /* DV video may carry the audio. */
+         || (codecpar->codec_type == AVMEDIA_TYPE_AUDIO && indexer->partial_audio && stream->index != indexer->audio_stream_index) )
+            /* Leave this stream out of the indexing. The streams without the decoder are discarded by the demuxer. */
+            return helper;
+        /* Set up the decoder. */
         const char **preferred_decoder_names = codecpar->codec_type == AVMEDIA_TYPE_VIDEO
                                              ? indexer->preferred_video_decoder_names
                                              : indexer->preferred_audio_decoder_names;
@@ -1370,6 +1637,13 @@ static lwindex_helper_t *get_index_helper
             if( !helper->picture )
                 return NULL;
         }
+        if( codecpar->codec_type == AVMEDIA_TYPE_AUDIO )
+            for( int i = 0; audio_header_readers[i].codec_id != AV_CODEC_ID_NONE; i++ )
+                if( audio_header_readers[i].codec_id == codecpar->codec_id )
+                {
+                    helper->read_frame_length = audio_header_readers[i].read_frame_length;
+                    break;
+                }
         if( helper->parser_ctx && helper->vc1_wmv3 == 2 )
         {
             /* Initialize the VC-1/WMV3 parser by extradata. */
@@ -1799,12 +2073,21 @@ static int get_audio_frame_length
         frame_length = 0;
     if( frame_length == 0 && helper->delay_count == 0 )
         frame_length = ctx->frame_size;
+    ++ helper->audio_packet_count;
+    if( frame_length == 0 && !helper->already_decoded && helper->frame_length_scale > 0 && helper->delay_count == 0 )
+    {
+        /* Try to get by the bitstream headers if the configuration is the same as the one the decoder agreed with. */
+        int header_frame_length = helper->read_frame_length( pkt->data, pkt->size, &helper->header_config );
+        if( header_frame_length > 0 && helper->header_config == helper->decoder_config )
+            frame_length = header_frame_length * helper->frame_length_scale;
+    }
     if( frame_length == 0 )
     {
         if( helper->already_decoded )
             frame_length += helper->picture->nb_samples;
         else
         {
+            ++ helper->decoded_packet_count;
             /* Try to get by actual decoding. */
             AVPacket temp = *pkt;
             int ret          = 0;
@@ -1834,6 +2117,20 @@ static int get_audio_frame_length
             if( draining )
                 /* Reset the draining state. */
                 avcodec_flush_buffers( ctx );
+            if( helper->read_frame_length && helper->delay_count == 0 )
+            {
+                /* Check the bitstream headers against the decoder so that the next packets can skip decoding. */
+                int header_frame_length = frame_length > 0
+                                        ? helper->read_frame_length( pkt->data, pkt->size, &helper->header_config )
+                                        : 0;
+                if( header_frame_length > 0 && frame_length % header_frame_length == 0 )
+                {
+                    helper->decoder_config     = helper->header_config;
+                    helper->frame_length_scale = frame_length / header_frame_length;
+                }
+                else
+                    helper->frame_length_scale = 0;
+            }
         }
         if( frame_length == 0 )
         {
@@ -1953,7 +2250,7 @@ static void write_audio_extradata
 static void disable_video_stream( lwlibav_video_decode_handler_t *vdhp )
 {
     lw_freep( &vdhp->frame_list );
-    lw_freep( &vdhp->keyframe_list );
+    lw_freep( &vdhp->rap_list );
     lw_freep( &vdhp->order_converter );
     av_freep( &vdhp->index_entries );
     vdhp->stream_index        = -1;
@@ -1986,15 +2283,18 @@ static void cleanup_index_helpers( lwindex_indexer_t *indexer, AVFormatContext *
     av_freep( &indexer->helpers );
 }
 
+/* Hash the first and the last 1MiB of the file of 'file_size' bytes.
+ * 'file_size' may be smaller than the actual size so that a grown file can be checked against its old hash. */
 static unsigned xxhash_file( const char *file_path, int64_t file_size )
 {
     uint8_t *file_buffer = (uint8_t *)lw_malloc_zero( 1 << 21 );
     const size_t read_len = 1 << 20;
     FILE *fp = lw_fopen( file_path, "rb" );
-    size_t buffer_len = fread( file_buffer, 1, read_len, fp );
+    /* Never hash the bytes beyond 'file_size', which may have been appended after the hash was taken. */
+    size_t buffer_len = fread( file_buffer, 1, (size_t)MIN( (int64_t)read_len, file_size ), fp );
     if( file_size > (1 << 21) )
     {
-        fseek( fp, -(1 << 20), SEEK_END );
+        lw_fseek( fp, file_size - (1 << 20), SEEK_SET );
         buffer_len += fread( file_buffer + buffer_len, 1, read_len, fp );
     }
     fclose( fp );
@@ -2003,139 +2303,1413 @@ static unsigned xxhash_file( const char *file_path, int64_t file_size )
     return hash;
 }
 
-static void create_index
+/* Streaming hash of the whole file content
+ * The file is split into blocks of CONTENT_HASH_BLOCK_SIZE bytes and every 'stride'-th block is fed to XXH3,
+ * so the strictness is traded for the amount of reading. While indexing, the blocks are fed right after
+ * the demuxer passed them, i.e. while they are still in the page cache. */
+#define CONTENT_HASH_BLOCK_SIZE (1 << 20)
+
+typedef struct
+{
+    XXH3_state_t *state;
+    FILE         *fp;
+    uint8_t      *buffer;
+    uint32_t      stride;
+    int64_t       next_block;   /* the number of the block to be fed next */
+    int           error;
+} lwindex_content_hasher_t;
+
+static int open_content_hasher
 (
-    lwlibav_file_handler_t         *lwhp,
-    lwlibav_video_decode_handler_t *vdhp,
-    lwlibav_video_output_handler_t *vohp,
-    lwlibav_audio_decode_handler_t *adhp,
-    lwlibav_audio_output_handler_t *aohp,
-    AVFormatContext                *format_ctx,
-    lwlibav_option_t               *opt,
-    progress_indicator_t           *indicator,
-    progress_handler_t             *php
+    lwindex_content_hasher_t *hasher,
+    const char               *file_path,
+    uint32_t                  stride
 )
 {
-    uint32_t video_info_count = 1 << 16;
-    uint32_t audio_info_count = 1 << 16;
-    video_frame_info_t *video_info = (video_frame_info_t *)lw_malloc_zero( video_info_count * sizeof(video_frame_info_t) );
-    if( !video_info )
-        return;
-    audio_frame_info_t *audio_info = (audio_frame_info_t *)lw_malloc_zero( audio_info_count * sizeof(audio_frame_info_t) );
-    if( !audio_info )
+    memset( hasher, 0, sizeof(lwindex_content_hasher_t) );
+    hasher->stride = stride;
+    hasher->state  = XXH3_createState();
+    hasher->buffer = (uint8_t *)lw_malloc_zero( CONTENT_HASH_BLOCK_SIZE );
+    hasher->fp     = lw_fopen( file_path, "rb" );
+    if( stride == 0 || !hasher->state || !hasher->buffer || !hasher->fp
+     || XXH3_64bits_reset( hasher->state ) != XXH_OK )
     {
-        free( video_info );
-        return;
+        hasher->error = 1;
+        return -1;
     }
-    /*
-        # Structure of Libav reader index file
-        <LibavReaderIndexFile=16>
-        <InputFilePath>foobar.omo</InputFilePath>
-        <FileSize=1048576>
-        <FileHash=0x1234abcd>
-        <LibavReaderIndex=0x00000208,0,marumoska>
-        <ActiveVideoStreamIndex>+0000000000</ActiveVideoStreamIndex>
-        <ActiveAudioStreamIndex>-0000000001</ActiveAudioStreamIndex>
-        <StreamInfo=0,0>
-        Codec=2,TimeBase=1001/24000,Width=1920,Height=1080,Format=yuv420p,ColorSpace=5
-        </StreamInfo>
-        Index=0,POS=0,PTS=2002,DTS=0,EDI=0
-        Key=1,Pic=1,POC=0,Repeat=1,Field=0
-        </LibavReaderIndex>
-        <StreamDuration=0,0>5000</StreamDuration>
-        <StreamIndexEntries=0,0,1>
-        POS=0,TS=2002,Flags=1,Size=1024,Distance=0
-        </StreamIndexEntries>
-        <ExtraDataList=0,0,1>
-        Size=252,Codec=28,4CC=0x564d4448,Width=1920,Height=1080,Format=yuv420p,BPS=0
-        ... binary string ...
-        </ExtraDataList>
-        </LibavReaderIndexFile>
-     */
-    FILE *index;
-    if( opt->index_file_path )
-        index = !opt->no_create_index ? lw_fopen( opt->index_file_path, "wb" ) : NULL;
-    else
+    return 0;
+}
+
+static void close_content_hasher
+(
+    lwindex_content_hasher_t *hasher
+)
+{
+    if( hasher->state )
+        XXH3_freeState( hasher->state );
+    if( hasher->fp )
+        fclose( hasher->fp );
+    lw_free( hasher->buffer );
+    memset( hasher, 0, sizeof(lwindex_content_hasher_t) );
+}
+
+static void feed_content_block
+(
+    lwindex_content_hasher_t *hasher,
+    size_t                    block_len
+)
+{
+    if( lw_fseek( hasher->fp, hasher->next_block * CONTENT_HASH_BLOCK_SIZE, SEEK_SET )
+     || fread( hasher->buffer, 1, block_len, hasher->fp ) != block_len
+     || XXH3_64bits_update( hasher->state, hasher->buffer, block_len ) != XXH_OK )
+        hasher->error = 1;
+    hasher->next_block += hasher->stride;
+}
+
+/* Feed the whole blocks ending at or before 'end_pos'. */
+static void update_content_hash
+(
+    lwindex_content_hasher_t *hasher,
+    int64_t                   end_pos
+)
+{
+    while( !hasher->error && (hasher->next_block + 1) * CONTENT_HASH_BLOCK_SIZE <= end_pos )
+        feed_content_block( hasher, CONTENT_HASH_BLOCK_SIZE );
+}
+
+/* Feed the rest of the file of 'file_size' bytes including the last partial block, and return the digest.
+ * Return 0 if failed. 0 is also stored for the files without the content hash. */
+static uint64_t finish_content_hash
+(
+    lwindex_content_hasher_t *hasher,
+    int64_t                   file_size
+)
+{
+    update_content_hash( hasher, file_size );
+    int64_t block_pos = hasher->next_block * CONTENT_HASH_BLOCK_SIZE;
+    if( !hasher->error && block_pos < file_size )
+        feed_content_block( hasher, (size_t)(file_size - block_pos) );
+    uint64_t hash = hasher->error ? 0 : (uint64_t)XXH3_64bits_digest( hasher->state );
+    close_content_hasher( hasher );
+    return hash;
+}
+
+/* Return 1 if the content of the file doesn't match the stored hash under the requested strictness.
+ * Return 0 otherwise, including the case where no check is requested. */
+static int content_hash_mismatch
+(
+    const char *file_path,
+    int64_t     file_size,
+    uint32_t    stored_stride,
+    uint64_t    stored_hash,
+    uint32_t    requested_stride
+)
+{
+    if( requested_stride == 0 )
+        return 0;
+    if( stored_stride != requested_stride || stored_hash == 0 )
+        return 1;
+    lwindex_content_hasher_t hasher;
+    if( open_content_hasher( &hasher, file_path, stored_stride ) < 0 )
     {
-        char index_path[512] = { 0 };
-        sprintf( index_path, "%s.lwi", lwhp->file_path );
-        index = !opt->no_create_index ? lw_fopen( index_path, "wb" ) : NULL;
+        close_content_hasher( &hasher );
+        return 1;
     }
-    if( !index && !opt->no_create_index )
+    return finish_content_hash( &hasher, file_size ) != stored_hash;
+}
+
+/* 'file_mtime' may be NULL if not needed. */
+static int get_file_status
+(
+    const char *file_path,
+    int64_t    *file_size,
+    int64_t    *file_mtime
+)
+{
+#ifdef _WIN32
+    wchar_t *wname;
+    struct _stat64 file_stat;
+    if( lw_string_to_wchar( CP_UTF8, file_path, &wname ) )
     {
-        free( video_info );
-        free( audio_info );
-        return;
+        int ret = _wstat64( wname, &file_stat );
+        lw_free( wname );
+        if( ret )
+            return -1;
     }
-    lwhp->format_name  = (char *)format_ctx->iformat->name;
-    lwhp->format_flags = format_ctx->iformat->flags;
-    lwhp->raw_demuxer  = !!format_ctx->iformat->raw_codec_id;
-    vdhp->format       = format_ctx;
-    adhp->format       = format_ctx;
-    adhp->dv_in_avi    = !strcmp( lwhp->format_name, "avi" ) ? -1 : 0;
-    int32_t video_index_pos = 0;
-    int32_t audio_index_pos = 0;
-    if( index )
-    {
-        /* Write Index file header. */
-        uint8_t lwindex_version[4] =
-        {
-            (LWINDEX_VERSION >> 24) & 0xff,
-            (LWINDEX_VERSION >> 16) & 0xff,
-            (LWINDEX_VERSION >>  8) & 0xff,
-             LWINDEX_VERSION        & 0xff
-        };
-        fprintf( index, "<LSMASHWorksIndexVersion=%" PRIu8 ".%" PRIu8 ".%" PRIu8 ".%" PRIu8 ">\n",
-                 lwindex_version[0], lwindex_version[1], lwindex_version[2], lwindex_version[3] );
-        fprintf( index, "<LibavReaderIndexFile=%d>\n", LWINDEX_INDEX_FILE_VERSION );
-        fprintf( index, "<InputFilePath>%s</InputFilePath>\n", lwhp->file_path );
-#ifdef _WIN32
-        wchar_t *wname;
-        struct _stat64 file_stat;
-        if( lw_string_to_wchar( CP_UTF8, lwhp->file_path, &wname ) )
-            _wstat64( wname, &file_stat );
-        else
-            _stat64( lwhp->file_path, &file_stat );
+    else if( _stat64( file_path, &file_stat ) )
+        return -1;
 #else
-        struct stat file_stat;
-        stat( lwhp->file_path, &file_stat );
+    struct stat file_stat;
+    if( stat( file_path, &file_stat ) )
+        return -1;
 #endif
-        fprintf( index, "<FileSize=%" PRId64 ">\n", file_stat.st_size );
-        fprintf( index, "<FileHash=0x%08x>\n", xxhash_file( lwhp->file_path, file_stat.st_size ) );
-        fprintf( index, "<LibavReaderIndex=0x%08x,%d,%s>\n", lwhp->format_flags, lwhp->raw_demuxer, lwhp->format_name );
-        video_index_pos = ftell( index );
-        fprintf( index, "<ActiveVideoStreamIndex>%+011d</ActiveVideoStreamIndex>\n", -1 );
-        audio_index_pos = ftell( index );
-        fprintf( index, "<ActiveAudioStreamIndex>%+011d</ActiveAudioStreamIndex>\n", adhp->stream_index == -2 ? -2 : -1 );
-    }
-    AVPacket pkt = { 0 };
-    av_init_packet( &pkt );
-    int       pix_fmt_investigated  = 0;
-    int       video_resolution      = 0;
-    int       is_attached_pic       = 0;
-    uint32_t  video_sample_count    = 0;
-    uint32_t  invisible_count       = 0;
-    uint32_t  video_keyframe_count  = 0;
-    int64_t   last_keyframe_pts     = AV_NOPTS_VALUE;
-    uint32_t  audio_sample_count    = 0;
-    int       audio_sample_rate     = 0;
-    int       constant_frame_length = 1;
-    uint64_t  audio_duration        = 0;
-    int64_t   first_dts             = AV_NOPTS_VALUE;
-    int64_t   filesize              = avio_size( format_ctx->pb );
-    if( indicator->open )
-        indicator->open( php );
-    /* Start to read frames and write the index file. */
-    lwindex_indexer_t indexer =
+    *file_size = file_stat.st_size;
+    if( file_mtime )
+        *file_mtime = (int64_t)file_stat.st_mtime;
+    return 0;
+}
+
+static char *concatenate_path
+(
+    const char *path,
+    const char *suffix
+)
+{
+    size_t path_length   = strlen( path );
+    size_t suffix_length = strlen( suffix );
+    char *concatenated_path = (char *)lw_malloc_zero( path_length + suffix_length + 1 );
+    if( !concatenated_path )
+        return NULL;
+    memcpy( concatenated_path, path, path_length );
+    memcpy( concatenated_path + path_length, suffix, suffix_length );
+    return concatenated_path;
+}
+
+/* Replace the format name with a copy of 'format_name' owned by the file handler. */
+static int set_format_name
+(
+    lwlibav_file_handler_t *lwhp,
+    const char             *format_name
+)
+{
+    char *copy = concatenate_path( format_name, "" );
+    if( !copy )
+        return -1;
+    lw_free( lwhp->format_name );
+    lwhp->format_name = copy;
+    return 0;
+}
+
+static int has_lwi_extension
+(
+    const char *path
+)
+{
+    size_t path_length = strlen( path );
+    return path_length >= 5 && !strncmp( &path[path_length - 4], ".lwi", strlen( ".lwi" ) );
+}
+
+/* Return the path of the index file for the input file, or NULL if failed.
+ * If 'per_stream' is set to non-zero, the forced streams are tagged to the path, e.g. "input.mkv.v0.a1.lwi",
+ * so that the partial indexes of different streams never overwrite each other. */
+static char *get_index_file_path
+(
+    lwlibav_option_t *opt,
+    const char       *input_file_path,
+    int               per_stream
+)
+{
+    char *index_file_path = opt->index_file_path ? concatenate_path( opt->index_file_path, "" )
+                                                 : concatenate_path( input_file_path, ".lwi" );
+    if( !index_file_path || !per_stream )
+        return index_file_path;
+    char tag[32] = { 0 };
+    if( opt->force_video )
+        sprintf( tag, ".v%d", opt->force_video_index );
+    if( opt->force_audio )
+        sprintf( tag + strlen( tag ), ".a%d", opt->force_audio_index );
+    /* Insert the tag before the extension if any. */
+    size_t base_length = strlen( index_file_path ) - (has_lwi_extension( index_file_path ) ? strlen( ".lwi" ) : 0);
+    char *tagged_path = concatenate_path( index_file_path, tag );
+    if( tagged_path )
     {
-        0,                              /* number_of_helpers */
+        memcpy( tagged_path + base_length, tag, strlen( tag ) );
+        strcpy( tagged_path + base_length + strlen( tag ), index_file_path + base_length );
+    }
+    lw_free( index_file_path );
+    return tagged_path;
+}
+
+/* Return 1 if the index for 'opt' is the partial one written for each stream, otherwise 0.
+ * The index file given as the input is always used as is. */
+static int is_per_stream_index
+(
+    lwlibav_option_t *opt
+)
+{
+    return opt->partial_index && (opt->force_video || opt->force_audio) && !has_lwi_extension( opt->file_path );
+}
+
+/*
+    # Structure of Libav reader binary index file
+    All values are stored in native byte order, and each section begins at an 8-byte aligned offset.
+    The frame lists are the ones of the active streams just before deciding the seek method,
+    that is, the same state as the text index file gives after parsing.
+        lwindex_binary_header_t
+        input file path         (not null-terminated)
+        video_frame_info_t         * (the number of video frames + 1)
+        AVIndexEntry               * (the number of video index entries)
+        lwindex_binary_extradata_t * (the number of video extradata)
+        audio_frame_info_t         * (the number of audio frames + 1)
+        AVIndexEntry               * (the number of audio index entries)
+        lwindex_binary_extradata_t * (the number of audio extradata)
+        extradata payloads
+    The checkpoint is the file offset where the indexing can resume when the input file has grown since,
+    e.g. a recording still being written. It is the last keyframe of the active video stream, or the last
+    packet of the active audio stream if no video stream is active. For H.264 and HEVC, only the keyframes
+    with POC 0, i.e. IDR pictures, are checkpoints since the parser restarted at a recovery point would give
+    POCs which don't continue the previous ones, and the PTS generation from POCs takes POC 0 as the start of
+    a coded video sequence. The records at and after the checkpoint are discarded and made again from there.
+    Since the records depend on the build, the binary index file is rejected unless the record sizes and
+    the versions of libavutil, libavcodec and libavformat match the ones at writing.
+ */
+#define LWINDEX_BINARY_MAGIC "LWIBINDX"
+
+typedef struct
+{
+    uint64_t offset;
+    uint32_t count;
+    uint32_t record_size;
+} lwindex_binary_section_t;
+
+typedef struct
+{
+    int32_t                  stream_index;
+    int32_t                  codec_id;
+    int32_t                  time_base_num;
+    int32_t                  time_base_den;
+    int32_t                  partial;           /* 1 if the other streams of this type are not indexed */
+    lwindex_binary_section_t frames;
+    lwindex_binary_section_t index_entries;
+    lwindex_binary_section_t extradata;
+} lwindex_binary_stream_t;
+
+typedef struct
+{
+    char                     magic[8];
+    uint32_t                 lwindex_version;
+    uint32_t                 index_file_version;
+    uint32_t                 header_size;
+    uint32_t                 avutil_version;
+    uint32_t                 avcodec_version;
+    uint32_t                 avformat_version;          /* AVIndexEntry is defined by libavformat. */
+    uint32_t                 file_hash;
+    int64_t                  file_size;
+    lwindex_binary_section_t input_file_path;
+    char                     format_name[64];
+    int32_t                  format_flags;
+    int32_t                  raw_demuxer;
+    /* video */
+    lwindex_binary_stream_t  video;
+    int32_t                  max_width;
+    int32_t                  max_height;
+    int32_t                  initial_width;
+    int32_t                  initial_height;
+    int32_t                  initial_pix_fmt;
+    int32_t                  initial_colorspace;
+    int64_t                  stream_duration;
+    uint32_t                 invisible_count;
+    /* audio */
+    int32_t                  dv_in_avi;
+    lwindex_binary_stream_t  audio;
+    int32_t                  frame_length;
+    int32_t                  sample_rate;               /* the sample rate of the first audio frame */
+    uint64_t                 output_channel_layout;
+    int32_t                  output_sample_format;
+    int32_t                  output_sample_rate;
+    int32_t                  output_bits_per_sample;
+    uint32_t                 content_hash_stride;       /* 0 if the content hash is not computed */
+    int64_t                  checkpoint_pos;            /* -1 if the indexing cannot resume */
+    uint64_t                 content_hash;
+} lwindex_binary_header_t;
+
+typedef struct
+{
+    uint64_t offset;
+    int32_t  size;
+    int32_t  codec_id;
+    uint32_t codec_tag;
+    int32_t  width;
+    int32_t  height;
+    int32_t  pixel_format;
+    uint64_t channel_layout;
+    int32_t  sample_format;
+    int32_t  sample_rate;
+    int32_t  bits_per_sample;
+    int32_t  block_align;
+} lwindex_binary_extradata_t;
+
+static uint64_t set_binary_section
+(
+    lwindex_binary_section_t *section,
+    uint64_t                  offset,
+    uint32_t                  count,
+    uint32_t                  record_size
+)
+{
+    section->offset      = (offset + 7) & ~UINT64_C(7);
+    section->count       = count;
+    section->record_size = record_size;
+    return section->offset + (uint64_t)count * record_size;
+}
+
+static int write_binary_section
+(
+    FILE                           *index,
+    uint64_t                       *written,
+    const lwindex_binary_section_t *section,
+    const void                     *data
+)
+{
+    static const uint8_t padding[8] = { 0 };
+    size_t padding_size = (size_t)(section->offset - *written);
+    size_t data_size    = (size_t)section->count * section->record_size;
+    if( fwrite( padding, 1, padding_size, index ) != padding_size
+     || (data_size > 0 && fwrite( data, 1, data_size, index ) != data_size) )
+        return -1;
+    *written = section->offset + data_size;
+    return 0;
+}
+
+static int write_binary_extradata
+(
+    FILE                        *index,
+    uint64_t                    *written,
+    lwindex_binary_section_t    *section,
+    lwlibav_extradata_handler_t *exhp,
+    uint64_t                    *payload_offset
+)
+{
+    lwindex_binary_extradata_t *list = NULL;
+    if( section->count > 0 )
+    {
+        list = (lwindex_binary_extradata_t *)lw_malloc_zero( section->count * sizeof(lwindex_binary_extradata_t) );
+        if( !list )
+            return -1;
+        for( uint32_t i = 0; i < section->count; i++ )
+        {
+            lwlibav_extradata_t *entry = &exhp->entries[i];
+            list[i].offset          = *payload_offset;
+            list[i].size            = entry->extradata_size;
+            list[i].codec_id        = entry->codec_id;
+            list[i].codec_tag       = entry->codec_tag;
+            list[i].width           = entry->width;
+            list[i].height          = entry->height;
+            list[i].pixel_format    = entry->pixel_format;
+            list[i].channel_layout  = entry->channel_layout;
+            list[i].sample_format   = entry->sample_format;
+            list[i].sample_rate     = entry->sample_rate;
+            list[i].bits_per_sample = entry->bits_per_sample;
+            list[i].block_align     = entry->block_align;
+            *payload_offset += MAX( entry->extradata_size, 0 );
+        }
+    }
+    int ret = write_binary_section( index, written, section, list );
+    lw_free( list );
+    return ret;
+}
+
+static void write_binary_index
+(
+    const char                     *index_file_path,
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    int64_t                         file_size,
+    uint32_t                        file_hash,
+    uint32_t                        content_hash_stride,
+    uint64_t                        content_hash,
+    int64_t                         video_stream_duration,
+    uint32_t                        invisible_count,
+    int                             audio_sample_rate,
+    int                             partial_video,
+    int                             partial_audio,
+    int64_t                         checkpoint_pos
+)
+{
+    FILE *index = lw_fopen( index_file_path, "wb" );
+    if( !index )
+    {
+        lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to create the binary index file." );
+        return;
+    }
+    lwindex_binary_header_t header = { { 0 } };
+    memcpy( header.magic, LWINDEX_BINARY_MAGIC, sizeof(header.magic) );
+    header.lwindex_version    = LWINDEX_VERSION;
+    header.index_file_version = LWINDEX_BINARY_INDEX_FILE_VERSION;
+    header.header_size        = sizeof(lwindex_binary_header_t);
+    header.avutil_version     = avutil_version();
+    header.avcodec_version    = avcodec_version();
+    header.avformat_version   = avformat_version();
+    header.file_hash          = file_hash;
+    header.file_size          = file_size;
+    header.content_hash_stride = content_hash ? content_hash_stride : 0;
+    header.content_hash        = content_hash;
+    header.format_flags       = lwhp->format_flags;
+    header.raw_demuxer        = lwhp->raw_demuxer;
+    snprintf( header.format_name, sizeof(header.format_name), "%s", lwhp->format_name );
+    header.video.stream_index = vdhp->stream_index;
+    header.audio.stream_index = adhp->stream_index;
+    header.video.partial      = partial_video;
+    header.audio.partial      = partial_audio;
+    header.dv_in_avi          = adhp->dv_in_avi;
+    header.checkpoint_pos     = checkpoint_pos;
+    uint64_t offset = set_binary_section( &header.input_file_path, sizeof(lwindex_binary_header_t),
+                                          (uint32_t)strlen( lwhp->file_path ), 1 );
+    if( vdhp->stream_index >= 0 )
+    {
+        header.video.codec_id      = vdhp->codec_id;
+        header.video.time_base_num = vdhp->time_base.num;
+        header.video.time_base_den = vdhp->time_base.den;
+        header.max_width           = vdhp->max_width;
+        header.max_height          = vdhp->max_height;
+        header.initial_width       = vdhp->initial_width;
+        header.initial_height      = vdhp->initial_height;
+        header.initial_pix_fmt     = vdhp->initial_pix_fmt;
+        header.initial_colorspace  = vdhp->initial_colorspace;
+        header.stream_duration     = video_stream_duration;
+        header.invisible_count     = invisible_count;
+        offset = set_binary_section( &header.video.frames,        offset, vdhp->frame_count + 1,     sizeof(video_frame_info_t) );
+        offset = set_binary_section( &header.video.index_entries, offset, vdhp->index_entries_count, sizeof(AVIndexEntry) );
+        offset = set_binary_section( &header.video.extradata,     offset, vdhp->exh.entry_count,     sizeof(lwindex_binary_extradata_t) );
+    }
+    if( adhp->stream_index >= 0 )
+    {
+        header.audio.codec_id              = adhp->codec_id;
+        header.audio.time_base_num         = adhp->time_base.num;
+        header.audio.time_base_den         = adhp->time_base.den;
+        header.frame_length                = adhp->frame_length;
+        header.sample_rate                 = audio_sample_rate;
+        header.output_channel_layout       = aohp->output_channel_layout;
+        header.output_sample_format        = aohp->output_sample_format;
+        header.output_sample_rate          = aohp->output_sample_rate;
+        header.output_bits_per_sample      = aohp->output_bits_per_sample;
+        offset = set_binary_section( &header.audio.frames,        offset, adhp->frame_count + 1,     sizeof(audio_frame_info_t) );
+        offset = set_binary_section( &header.audio.index_entries, offset, adhp->index_entries_count, sizeof(AVIndexEntry) );
+        offset = set_binary_section( &header.audio.extradata,     offset, adhp->exh.entry_count,     sizeof(lwindex_binary_extradata_t) );
+    }
+    uint64_t written = 0;
+    if( fwrite( &header, 1, sizeof(lwindex_binary_header_t), index ) != sizeof(lwindex_binary_header_t) )
+        goto fail;
+    written = sizeof(lwindex_binary_header_t);
+    if( write_binary_section( index, &written, &header.input_file_path, lwhp->file_path ) )
+        goto fail;
+    if( vdhp->stream_index >= 0
+     && (write_binary_section  ( index, &written, &header.video.frames,        vdhp->frame_list )
+      || write_binary_section  ( index, &written, &header.video.index_entries, vdhp->index_entries )
+      || write_binary_extradata( index, &written, &header.video.extradata,     &vdhp->exh, &offset )) )
+        goto fail;
+    if( adhp->stream_index >= 0
+     && (write_binary_section  ( index, &written, &header.audio.frames,        adhp->frame_list )
+      || write_binary_section  ( index, &written, &header.audio.index_entries, adhp->index_entries )
+      || write_binary_extradata( index, &written, &header.audio.extradata,     &adhp->exh, &offset )) )
+        goto fail;
+    /* Write extradata payloads in the same order as their offsets were assigned. */
+    lwlibav_extradata_handler_t *exhps[2] =
+    {
+        vdhp->stream_index >= 0 ? &vdhp->exh : NULL,
+        adhp->stream_index >= 0 ? &adhp->exh : NULL
+    };
+    for( int i = 0; i < 2; i++ )
+        if( exhps[i] )
+            for( int j = 0; j < exhps[i]->entry_count; j++ )
+            {
+                lwlibav_extradata_t *entry = &exhps[i]->entries[j];
+                if( entry->extradata_size > 0
+                 && fwrite( entry->extradata, 1, entry->extradata_size, index ) != (size_t)entry->extradata_size )
+                    goto fail;
+            }
+    if( fclose( index ) == 0 )
+        return;
+    index = NULL;
+fail:
+    if( index )
+        fclose( index );
+    remove( index_file_path );
+    lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to write the binary index file." );
+}
+
+static int check_binary_section
+(
+    const lwindex_binary_section_t *section,
+    uint32_t                        record_size,
+    size_t                          index_size
+)
+{
+    if( section->count == 0 )
+        return 0;
+    return section->record_size != record_size
+        || (section->offset & 7)
+        || section->offset > index_size
+        || (uint64_t)section->count * record_size > index_size - section->offset;
+}
+
+static int import_binary_extradata
+(
+    lwlibav_extradata_handler_t    *exhp,
+    const uint8_t                  *index,
+    size_t                          index_size,
+    const lwindex_binary_section_t *section
+)
+{
+    if( section->count == 0 )
+        return 0;
+    if( section->count > INT_MAX || !alloc_extradata_entries( exhp, (int)section->count ) )
+        return -1;
+    exhp->entry_count = (int)section->count;
+    const lwindex_binary_extradata_t *list = (const lwindex_binary_extradata_t *)(index + section->offset);
+    for( uint32_t i = 0; i < section->count; i++ )
+    {
+        lwlibav_extradata_t *entry = &exhp->entries[i];
+        entry->codec_id        = (enum AVCodecID)list[i].codec_id;
+        entry->codec_tag       = list[i].codec_tag;
+        entry->width           = list[i].width;
+        entry->height          = list[i].height;
+        entry->pixel_format    = (enum AVPixelFormat)list[i].pixel_format;
+        entry->channel_layout  = list[i].channel_layout;
+        entry->sample_format   = (enum AVSampleFormat)list[i].sample_format;
+        entry->sample_rate     = list[i].sample_rate;
+        entry->bits_per_sample = list[i].bits_per_sample;
+        entry->block_align     = list[i].block_align;
+        if( list[i].size <= 0 )
+            continue;
+        if( list[i].offset > index_size || (uint64_t)list[i].size > index_size - list[i].offset )
+            return -1;
+        entry->extradata = (uint8_t *)av_malloc( list[i].size + AV_INPUT_BUFFER_PADDING_SIZE );
+        if( !entry->extradata )
+            return -1;
+        entry->extradata_size = list[i].size;
+        memcpy( entry->extradata, index + list[i].offset, list[i].size );
+        memset( entry->extradata + list[i].size, 0, AV_INPUT_BUFFER_PADDING_SIZE );
+    }
+    return 0;
+}
+
+static void free_extradata_entries
+(
+    lwlibav_extradata_handler_t *exhp
+)
+{
+    if( !exhp->entries )
+        return;
+    for( int i = 0; i < exhp->entry_count; i++ )
+        av_freep( &exhp->entries[i].extradata );
+    lw_freep( &exhp->entries );
+    exhp->entry_count = 0;
+}
+
+static void *import_binary_records
+(
+    const uint8_t                  *index,
+    const lwindex_binary_section_t *section,
+    uint32_t                        extra_count
+)
+{
+    /* Just copy the fixed-width records into a writable buffer since the seek method decision modifies them. */
+    size_t size = (size_t)section->count * section->record_size;
+    uint8_t *records = (uint8_t *)lw_malloc_zero( size + (size_t)extra_count * section->record_size );
+    if( records && size > 0 )
+        memcpy( records, index + section->offset, size );
+    return records;
+}
+
+/* The state taken over from the binary index file of the input file which has grown since. */
+typedef struct
+{
+    lwindex_binary_header_t     header;
+    video_frame_info_t         *video_info;     /* the records before the checkpoint */
+    uint32_t                    video_sample_count;
+    audio_frame_info_t         *audio_info;
+    uint32_t                    audio_sample_count;
+    lwlibav_extradata_handler_t video_exh;
+    lwlibav_extradata_handler_t audio_exh;
+} lwindex_resume_t;
+
+static void cleanup_index_resume
+(
+    lwindex_resume_t *resume
+)
+{
+    lw_freep( &resume->video_info );
+    lw_freep( &resume->audio_info );
+    free_extradata_entries( &resume->video_exh );
+    free_extradata_entries( &resume->audio_exh );
+}
+
+/* Return 0 if the binary index file is available as it is.
+ * Return 1 if the input file has only grown since indexing and 'resume' is set up to continue the indexing from
+ * the checkpoint. 'resume' can be NULL if resuming is not wanted.
+ * Otherwise, return -1. */
+static int parse_binary_index
+(
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lwlibav_option_t               *opt,
+    int                             has_lwi_ext,
+    const char                     *index_file_path,
+    lwindex_resume_t               *resume
+)
+{
+    size_t index_size = 0;
+    const uint8_t *index = (const uint8_t *)lw_map_file( index_file_path, &index_size );
+    if( !index )
+        return -1;
+    const lwindex_binary_header_t *header = (const lwindex_binary_header_t *)index;
+    char                *file_path        = NULL;
+    video_frame_info_t  *video_info       = NULL;
+    audio_frame_info_t  *audio_info       = NULL;
+    AVIndexEntry        *video_entries    = NULL;
+    AVIndexEntry        *audio_entries    = NULL;
+    lwlibav_extradata_handler_t video_exh = { 0 };
+    lwlibav_extradata_handler_t audio_exh = { 0 };
+    if( index_size < sizeof(lwindex_binary_header_t)
+     || memcmp( header->magic, LWINDEX_BINARY_MAGIC, sizeof(header->magic) )
+     || header->lwindex_version    != LWINDEX_VERSION
+     || header->index_file_version != LWINDEX_BINARY_INDEX_FILE_VERSION
+     || header->header_size        != sizeof(lwindex_binary_header_t)
+     || header->avutil_version     != avutil_version()
+     || header->avcodec_version    != avcodec_version()
+     || header->avformat_version   != avformat_version()
+     || header->input_file_path.count == 0
+     || check_binary_section( &header->input_file_path,     1,                                  index_size )
+     || check_binary_section( &header->video.frames,        sizeof(video_frame_info_t),         index_size )
+     || check_binary_section( &header->video.index_entries, sizeof(AVIndexEntry),               index_size )
+     || check_binary_section( &header->video.extradata,     sizeof(lwindex_binary_extradata_t), index_size )
+     || check_binary_section( &header->audio.frames,        sizeof(audio_frame_info_t),         index_size )
+     || check_binary_section( &header->audio.index_entries, sizeof(AVIndexEntry),               index_size )
+     || check_binary_section( &header->audio.extradata,     sizeof(lwindex_binary_extradata_t), index_size ) )
+        goto fail;
+    /* The binary index file holds the frame lists of the active streams only.
+     * If other streams are requested, fall back to the text index file or reindexing. */
+    int video_stream_index = opt->force_video ? opt->force_video_index : header->video.stream_index;
+    int audio_stream_index = opt->force_audio ? opt->force_audio_index : header->audio.stream_index;
+    if( (video_stream_index >= 0 && video_stream_index != header->video.stream_index)
+     || (audio_stream_index >= 0 && audio_stream_index != header->audio.stream_index)
+     || (header->audio.stream_index == -2 && opt->force_audio_index != -2)
+     || (video_stream_index >= 0 && header->video.frames.count == 0)
+     || (audio_stream_index >= 0 && header->audio.frames.count == 0)
+     || (header->video.partial && (!opt->force_video || opt->force_video_index != header->video.stream_index))
+     || (header->audio.partial && (!opt->force_audio || opt->force_audio_index != header->audio.stream_index)) )
+        goto fail;
+    /* Test the target file. */
+    if( has_lwi_ext )
+    {
+        file_path = (char *)lw_malloc_zero( header->input_file_path.count + 1 );
+        if( !file_path )
+            goto fail;
+        memcpy( file_path, index + header->input_file_path.offset, header->input_file_path.count );
+    }
+    else
+    {
+        file_path = concatenate_path( opt->file_path, "" );
+        if( !file_path )
+            goto fail;
+    }
+    int64_t file_size;
+    if( get_file_status( file_path, &file_size, NULL ) )
+        goto fail;
+    /* If the input file has only grown, the hash of its first header->file_size bytes doesn't change.
+     * Resuming is limited to the files without the index entries by the demuxer, such as MPEG-2 TS, since
+     * the ones made from the tail only are not reliable. */
+    int grown = file_size > header->file_size
+             && resume
+             && header->checkpoint_pos >= 0
+             && header->dv_in_avi == 0
+             && header->video.index_entries.count == 0
+             && header->audio.index_entries.count == 0;
+    if( (file_size != header->file_size && !grown)
+     || xxhash_file( file_path, header->file_size ) != header->file_hash
+     || content_hash_mismatch( file_path, header->file_size, header->content_hash_stride, header->content_hash,
+                               (uint32_t)opt->content_hash_stride ) )
+        goto fail;
+    /* Import the records. */
+    if( video_stream_index >= 0 )
+    {
+        const lwindex_binary_stream_t *stream = &header->video;
+        video_info = (video_frame_info_t *)import_binary_records( index, &stream->frames, 1 );
+        if( !video_info )
+            goto fail;
+        if( stream->index_entries.count > 0 )
+        {
+            video_entries = (AVIndexEntry *)av_malloc( stream->index_entries.count * sizeof(AVIndexEntry) );
+            if( !video_entries )
+                goto fail;
+            memcpy( video_entries, index + stream->index_entries.offset, stream->index_entries.count * sizeof(AVIndexEntry) );
+        }
+        if( import_binary_extradata( &video_exh, index, index_size, &stream->extradata ) )
+            goto fail;
+    }
+    if( audio_stream_index >= 0 )
+    {
+        const lwindex_binary_stream_t *stream = &header->audio;
+        audio_info = (audio_frame_info_t *)import_binary_records( index, &stream->frames, 1 );
+        if( !audio_info )
+            goto fail;
+        if( stream->index_entries.count > 0 )
+        {
+            audio_entries = (AVIndexEntry *)av_malloc( stream->index_entries.count * sizeof(AVIndexEntry) );
+            if( !audio_entries )
+                goto fail;
+            memcpy( audio_entries, index + stream->index_entries.offset, stream->index_entries.count * sizeof(AVIndexEntry) );
+        }
+        if( import_binary_extradata( &audio_exh, index, index_size, &stream->extradata ) )
+            goto fail;
+    }
+    if( grown )
+    {
+        /* Keep the records before the checkpoint only. The others are made again by the indexing. */
+        memset( resume, 0, sizeof(lwindex_resume_t) );
+        resume->header     = *header;
+        resume->video_info = video_info;
+        resume->audio_info = audio_info;
+        resume->video_exh  = video_exh;
+        resume->audio_exh  = audio_exh;
+        if( video_info )
+            while( resume->video_sample_count + 1 < header->video.frames.count
+                && video_info[ resume->video_sample_count + 1 ].file_offset < header->checkpoint_pos )
+                ++resume->video_sample_count;
+        if( audio_info )
+            while( resume->audio_sample_count + 1 < header->audio.frames.count
+                && audio_info[ resume->audio_sample_count + 1 ].file_offset < header->checkpoint_pos )
+                ++resume->audio_sample_count;
+        resume->header.video.stream_index = video_stream_index;
+        resume->header.audio.stream_index = audio_stream_index;
+        if( !lwhp->file_path )
+            lwhp->file_path = file_path;
+        else
+            lw_free( file_path );
+        lw_unmap_file( (void *)index, index_size );
+        return 1;
+    }
+    /* Set up the handlers. */
+    char format_name[sizeof(header->format_name) + 1] = { 0 };
+    memcpy( format_name, header->format_name, sizeof(header->format_name) );
+    if( set_format_name( lwhp, format_name ) < 0 )
+        goto fail;
+    if( !lwhp->file_path )
+        lwhp->file_path = file_path;
+    else
+        lw_free( file_path );
+    lwhp->format_flags = header->format_flags;
+    lwhp->raw_demuxer  = header->raw_demuxer;
+    vdhp->stream_index = video_stream_index;
+    adhp->stream_index = audio_stream_index;
+    adhp->dv_in_avi    = header->dv_in_avi;
+    int64_t  stream_duration = header->stream_duration;
+    uint32_t invisible_count = header->invisible_count;
+    int      sample_rate     = header->sample_rate;
+    if( vdhp->stream_index >= 0 )
+    {
+        vdhp->codec_id            = (enum AVCodecID)header->video.codec_id;
+        vdhp->time_base.num       = header->video.time_base_num;
+        vdhp->time_base.den       = header->video.time_base_den;
+        vdhp->max_width           = header->max_width;
+        vdhp->max_height          = header->max_height;
+        vdhp->initial_width       = header->initial_width;
+        vdhp->initial_height      = header->initial_height;
+        vdhp->initial_pix_fmt     = (enum AVPixelFormat)header->initial_pix_fmt;
+        vdhp->initial_colorspace  = (enum AVColorSpace)header->initial_colorspace;
+        vdhp->index_entries       = video_entries;
+        vdhp->index_entries_count = header->video.index_entries.count;
+        vdhp->exh.entry_count     = video_exh.entry_count;
+        vdhp->exh.entries         = video_exh.entries;
+        vdhp->exh.current_index   = video_info[1].extradata_index;
+        vdhp->frame_list          = video_info;
+        vdhp->frame_count         = header->video.frames.count - 1;
+    }
+    if( adhp->stream_index >= 0 )
+    {
+        adhp->codec_id               = (enum AVCodecID)header->audio.codec_id;
+        adhp->time_base.num          = header->audio.time_base_num;
+        adhp->time_base.den          = header->audio.time_base_den;
+        adhp->index_entries          = audio_entries;
+        adhp->index_entries_count    = header->audio.index_entries.count;
+        adhp->exh.entry_count        = audio_exh.entry_count;
+        adhp->exh.entries            = audio_exh.entries;
+        adhp->exh.current_index      = audio_info[1].extradata_index;
+        adhp->frame_list             = audio_info;
+        adhp->frame_count            = header->audio.frames.count - 1;
+        adhp->frame_length           = header->frame_length;
+        aohp->output_channel_layout  = header->output_channel_layout;
+        aohp->output_sample_format   = (enum AVSampleFormat)header->output_sample_format;
+        aohp->output_sample_rate     = header->output_sample_rate;
+        aohp->output_bits_per_sample = header->output_bits_per_sample;
+    }
+    lw_unmap_file( (void *)index, index_size );
+    if( vdhp->stream_index >= 0 )
+    {
+        if( decide_video_seek_method( lwhp, vdhp, vdhp->frame_count ) )
+            return -1;
+        /* Compute the stream duration. */
+        compute_stream_duration( lwhp, vdhp, stream_duration );
+        keep_initial_frame_list( vdhp );
+        /* Create the repeat control info. */
+        create_video_frame_order_list( vdhp, vohp, opt );
+        /* Exclude invisible frames from the output handler. */
+        create_video_visible_frame_list( vdhp, vohp, invisible_count );
+    }
+    if( adhp->stream_index >= 0 )
+    {
+        decide_audio_seek_method( lwhp, adhp, adhp->frame_count );
+        if( opt->av_sync && vdhp->stream_index >= 0 )
+            lwhp->av_gap = calculate_av_gap( vdhp, vohp, adhp, sample_rate );
+    }
+    return 0;
+fail:
+    lw_unmap_file( (void *)index, index_size );
+    lw_free( file_path );
+    lw_free( video_info );
+    lw_free( audio_info );
+    av_free( video_entries );
+    av_free( audio_entries );
+    free_extradata_entries( &video_exh );
+    free_extradata_entries( &audio_exh );
+    return -1;
+}
+
+/* Parallel indexing
+ * The demuxer is single, but the parsing and probing of each stream, which is the most part of the indexing cost,
+ * is independent of the other streams. So, the indexed streams can be parsed by a pool of workers while the demuxer
+ * reads ahead. A worker takes the oldest packet of any stream not being parsed by another worker, so the packets of
+ * each stream are still parsed in order. The pool has at most as many workers as the threads option, or the CPUs if
+ * it is 0, and never more than the streams. The parsed packets are consumed in demuxing order, therefore the
+ * resulting index is identical to the one created serially.
+ * Since the pixel format investigation shares a frame buffer and a flag over all video streams, parallel parsing
+ * is not used if there are two or more video streams. */
+#define LWINDEX_PIPELINE_DEPTH 256
+
+enum
+{
+    LWINDEX_PACKET_QUEUED  = 0,
+    LWINDEX_PACKET_PARSING = 1,
+    LWINDEX_PACKET_PARSED  = 2,
+};
+
+typedef struct
+{
+    int                 error;
+    int                 extradata_index;
+    /* video */
+    int                 probed_width;       /* width, height and colorspace before getting the picture type */
+    int                 probed_height;
+    enum AVColorSpace   probed_colorspace;
+    int                 pict_type;
+    int                 poc;
+    int                 repeat_pict;
+    lw_field_info_t     field_info;
+    int                 vp8_invisible;
+    int                 width;
+    int                 height;
+    enum AVPixelFormat  pix_fmt;
+    /* audio */
+    int                 bits_per_sample;
+    int                 frame_length;
+    int                 sample_rate;
+    uint64_t            channel_layout;
+    enum AVSampleFormat sample_fmt;
+    uint32_t            delay_count;
+} lwindex_parsed_packet_t;
+
+typedef struct
+{
+    AVPacket                pkt;
+    lwindex_helper_t       *helper;
+    int                     state;
+    lwindex_parsed_packet_t parsed;
+} lwindex_pipeline_entry_t;
+
+typedef struct lwindex_pipeline_tag
+{
+    lwindex_pipeline_entry_t *entries;      /* ring buffer of demuxed packets */
+    int                       depth;
+    int                       head;         /* the oldest packet */
+    int                       count;
+    int                       threaded;
+    int                       exit;
+    lw_thread_t              *workers;
+    int                       worker_count;
+    int                       max_workers;
+    int                       stream_count; /* the number of the streams whose packets have been queued */
+    lw_mutex_t                mutex;
+    lw_cond_t                 work_cond;    /* signalled when a packet is queued or the workers shall exit */
+    lw_cond_t                 done_cond;    /* signalled when a packet is parsed */
+    lwindex_indexer_t        *indexer;
+    AVFrame                  *frame_buffer;
+    int                       pix_fmt_investigated;
+    int                       index_audio;
+} lwindex_pipeline_t;
+
+static void parse_index_packet
+(
+    lwindex_pipeline_t      *pipeline,
+    lwindex_helper_t        *helper,
+    AVPacket                *pkt,
+    lwindex_parsed_packet_t *parsed
+)
+{
+    AVCodecContext *pkt_ctx = helper->codec_ctx;
+    helper->already_decoded = 0;
+    int extradata_index = append_extradata_if_new( helper, pkt_ctx, pkt );
+    parsed->extradata_index = extradata_index;
+    if( extradata_index < 0 )
+    {
+        parsed->error = 1;
+        return;
+    }
+    if( pkt_ctx->codec_type == AVMEDIA_TYPE_VIDEO )
+    {
+        if( pkt_ctx->pix_fmt == AV_PIX_FMT_NONE
+         || (pkt_ctx->codec->wrapper_name && !pipeline->pix_fmt_investigated) )
+        {
+            investigate_pix_fmt_by_decoding( pkt_ctx, pkt, pipeline->frame_buffer );
+            pipeline->pix_fmt_investigated = 1;
+        }
+        parsed->probed_width      = pkt_ctx->width;
+        parsed->probed_height     = pkt_ctx->height;
+        parsed->probed_colorspace = pkt_ctx->colorspace;
+        /* Get picture type. */
+        int pict_type = get_picture_type( helper, pkt_ctx, pkt );
+        if( pict_type < 0 )
+        {
+            parsed->error = 1;
+            return;
+        }
+        /* Get Picture Order Count. */
+        int poc = helper->parser_ctx ? helper->parser_ctx->output_picture_number : 0;
+        /* Get field information. */
+        int             repeat_pict;
+        lw_field_info_t field_info;
+        if( helper->parser_ctx )
+        {
+            if( helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_TOP_FIELD
+             || helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_BOTTOM_FIELD )
+            {
+                /* field coded picture */
+                if( helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_TOP_FIELD )
+                    field_info = LW_FIELD_INFO_TOP;
+                else
+                    field_info = LW_FIELD_INFO_BOTTOM;
+                repeat_pict = helper->parser_ctx->repeat_pict;
+            }
+            else
+            {
+                /* frame coded picture */
+                if( helper->parser_ctx->field_order == AV_FIELD_TT
+                 || helper->parser_ctx->field_order == AV_FIELD_TB )
+                    field_info = LW_FIELD_INFO_TOP;
+                else if( helper->parser_ctx->field_order == AV_FIELD_BB
+                      || helper->parser_ctx->field_order == AV_FIELD_BT )
+                    field_info = LW_FIELD_INFO_BOTTOM;
+                else
+                    field_info = helper->last_field_info;
+                if( get_ticks_per_frame( pkt_ctx ) == 2 && helper->parser_ctx->repeat_pict != 0 )
+                    repeat_pict = helper->parser_ctx->repeat_pict;
+                else
+                    repeat_pict = 2 * helper->parser_ctx->repeat_pict + 1;
+            }
+            helper->last_field_info = field_info;
+        }
+        else
+        {
+            repeat_pict = 1;
+            field_info = helper->last_field_info;
+        }
+        parsed->pict_type     = pict_type;
+        parsed->poc           = poc;
+        parsed->repeat_pict   = repeat_pict;
+        parsed->field_info    = field_info;
+        parsed->vp8_invisible = pkt_ctx->codec_id == AV_CODEC_ID_VP8 && check_vp8_invisible_frame( pkt );
+        parsed->width         = pkt_ctx->width;
+        parsed->height        = pkt_ctx->height;
+        parsed->pix_fmt       = pkt_ctx->pix_fmt;
+        /* Set width, height and pixel_format for the current extradata. */
+        lwlibav_extradata_handler_t *list = &helper->exh;
+        lwlibav_extradata_t *entry = &list->entries[ list->current_index ];
+        if( entry->width < pkt_ctx->width )
+            entry->width = pkt_ctx->width;
+        if( entry->height < pkt_ctx->height )
+            entry->height = pkt_ctx->height;
+        if( entry->pixel_format == AV_PIX_FMT_NONE )
+            entry->pixel_format = pkt_ctx->pix_fmt;
+        if( entry->bits_per_sample == 0 )
+            entry->bits_per_sample = pkt_ctx->bits_per_coded_sample;
+        if( entry->codec_id == AV_CODEC_ID_NONE )
+            entry->codec_id = pkt_ctx->codec_id;
+        if( entry->codec_tag == 0 )
+            entry->codec_tag = pkt_ctx->codec_tag;
+    }
+    else if( pipeline->index_audio )
+    {
+        int bits_per_sample = pkt_ctx->bits_per_raw_sample   > 0 ? pkt_ctx->bits_per_raw_sample
+                            : pkt_ctx->bits_per_coded_sample > 0 ? pkt_ctx->bits_per_coded_sample
+                            : av_get_bytes_per_sample( pkt_ctx->sample_fmt ) << 3;
+        /* Get audio frame_length. */
+        parsed->frame_length    = get_audio_frame_length( helper, pkt_ctx, pkt );
+        parsed->bits_per_sample = bits_per_sample;
+        parsed->sample_rate     = pkt_ctx->sample_rate;
+        parsed->channel_layout  = pkt_ctx->channel_layout;
+        parsed->sample_fmt      = pkt_ctx->sample_fmt;
+        parsed->delay_count     = helper->delay_count;
+        /* Set channel_layout, sample_rate, sample_format and bits_per_sample for the current extradata. */
+        lwlibav_extradata_handler_t *list = &helper->exh;
+        lwlibav_extradata_t *entry = &list->entries[ list->current_index ];
+        if( entry->channel_layout == 0 )
+            entry->channel_layout = pkt_ctx->channel_layout;
+        if( entry->sample_rate == 0 )
+            entry->sample_rate = pkt_ctx->sample_rate;
+        if( entry->sample_format == AV_SAMPLE_FMT_NONE )
+            entry->sample_format = pkt_ctx->sample_fmt;
+        if( entry->bits_per_sample == 0 )
+            entry->bits_per_sample = bits_per_sample;
+        if( entry->block_align == 0 )
+            entry->block_align = pkt_ctx->block_align;
+        if( entry->codec_id == AV_CODEC_ID_NONE )
+            entry->codec_id = pkt_ctx->codec_id;
+        if( entry->codec_tag == 0 )
+            entry->codec_tag = pkt_ctx->codec_tag;
+    }
+}
+
+static void *index_worker
+(
+    void *arg
+)
+{
+    lwindex_pipeline_t *pipeline = (lwindex_pipeline_t *)arg;
+    lw_mutex_lock( pipeline->mutex );
+    while( !pipeline->exit )
+    {
+        /* Pick up the oldest queued packet of the streams not being parsed.
+         * The older packets of the same stream are parsed already, so the packets of each stream are parsed in order. */
+        lwindex_pipeline_entry_t *entry = NULL;
+        for( int i = 0; i < pipeline->count; i++ )
+        {
+            lwindex_pipeline_entry_t *temp = &pipeline->entries[ (pipeline->head + i) % pipeline->depth ];
+            if( temp->state == LWINDEX_PACKET_QUEUED && !temp->helper->parsing )
+            {
+                entry = temp;
+                break;
+            }
+        }
+        if( !entry )
+        {
+            lw_cond_wait( pipeline->work_cond, pipeline->mutex );
+            continue;
+        }
+        lwindex_helper_t *helper = entry->helper;
+        helper->parsing = 1;
+        entry->state    = LWINDEX_PACKET_PARSING;
+        lw_mutex_unlock( pipeline->mutex );
+        parse_index_packet( pipeline, helper, &entry->pkt, &entry->parsed );
+        lw_mutex_lock( pipeline->mutex );
+        entry->state    = LWINDEX_PACKET_PARSED;
+        helper->parsing = 0;
+        lw_cond_broadcast( pipeline->done_cond );
+        /* The next packet of this stream may be waiting for another worker. */
+        lw_cond_broadcast( pipeline->work_cond );
+    }
+    lw_mutex_unlock( pipeline->mutex );
+    return NULL;
+}
+
+static int open_index_pipeline
+(
+    lwindex_pipeline_t *pipeline,
+    lwindex_indexer_t  *indexer,
+    AVFormatContext    *format_ctx,
+    AVFrame            *frame_buffer,
+    int                 index_audio
+)
+{
+    int video_stream_count = 0;
+    for( unsigned int stream_index = 0; stream_index < format_ctx->nb_streams; stream_index++ )
+        if( format_ctx->streams[stream_index]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO )
+            ++video_stream_count;
+    pipeline->indexer      = indexer;
+    pipeline->frame_buffer = frame_buffer;
+    pipeline->index_audio  = index_audio;
+    /* Parse packets on the demuxer thread if threading is disabled by the user. */
+    pipeline->threaded     = indexer->thread_count != 1 && video_stream_count <= 1;
+    pipeline->depth        = pipeline->threaded ? LWINDEX_PIPELINE_DEPTH : 1;
+    pipeline->entries      = (lwindex_pipeline_entry_t *)lw_malloc_zero( pipeline->depth * sizeof(lwindex_pipeline_entry_t) );
+    if( !pipeline->entries )
+        return -1;
+    if( pipeline->threaded )
+    {
+        pipeline->max_workers = indexer->thread_count > 0 ? indexer->thread_count : av_cpu_count();
+        pipeline->max_workers = MAX( pipeline->max_workers, 1 );
+        pipeline->workers     = (lw_thread_t *)lw_malloc_zero( pipeline->max_workers * sizeof(lw_thread_t) );
+        pipeline->mutex       = lw_mutex_create();
+        pipeline->work_cond   = lw_cond_create();
+        pipeline->done_cond   = lw_cond_create();
+        if( !pipeline->workers || !pipeline->mutex || !pipeline->work_cond || !pipeline->done_cond )
+            return -1;
+    }
+    return 0;
+}
+
+static void close_index_pipeline
+(
+    lwindex_pipeline_t *pipeline
+)
+{
+    if( pipeline->threaded && pipeline->mutex )
+    {
+        lw_mutex_lock( pipeline->mutex );
+        pipeline->exit = 1;
+        lw_cond_broadcast( pipeline->work_cond );
+        lw_mutex_unlock( pipeline->mutex );
+    }
+    for( int i = 0; i < pipeline->worker_count; i++ )
+        lw_thread_join( pipeline->workers[i] );
+    pipeline->worker_count = 0;
+    lw_freep( &pipeline->workers );
+    if( pipeline->entries )
+        for( ; pipeline->count; pipeline->count-- )
+        {
+            av_packet_unref( &pipeline->entries[ pipeline->head ].pkt );
+            pipeline->head = (pipeline->head + 1) % pipeline->depth;
+        }
+    lw_freep( &pipeline->entries );
+    lw_cond_destroy( pipeline->done_cond );
+    lw_cond_destroy( pipeline->work_cond );
+    lw_mutex_destroy( pipeline->mutex );
+    pipeline->done_cond = NULL;
+    pipeline->work_cond = NULL;
+    pipeline->mutex     = NULL;
+}
+
+/* Queue a demuxed packet for parsing. The ownership of the packet moves into the pipeline. */
+static int queue_index_packet
+(
+    lwindex_pipeline_t *pipeline,
+    lwindex_helper_t   *helper,
+    AVPacket           *pkt
+)
+{
+    lwindex_pipeline_entry_t *entry = &pipeline->entries[ (pipeline->head + pipeline->count) % pipeline->depth ];
+    memset( &entry->parsed, 0, sizeof(lwindex_parsed_packet_t) );
+    av_packet_move_ref( &entry->pkt, pkt );
+    entry->helper = helper;
+    entry->state  = LWINDEX_PACKET_QUEUED;
+    if( !pipeline->threaded )
+    {
+        ++pipeline->count;
+        parse_index_packet( pipeline, helper, &entry->pkt, &entry->parsed );
+        entry->state = LWINDEX_PACKET_PARSED;
+        return 0;
+    }
+    /* Add a worker for each newly found stream until the pool is full.
+     * The workers are started by this thread only, so the pool needs no lock. */
+    if( !helper->queued )
+    {
+        helper->queued = 1;
+        ++pipeline->stream_count;
+    }
+    if( pipeline->worker_count < MIN( pipeline->stream_count, pipeline->max_workers ) )
+    {
+        lw_thread_t worker = lw_thread_create( index_worker, pipeline );
+        if( !worker )
+        {
+            av_packet_unref( &entry->pkt );
+            return -1;
+        }
+        pipeline->workers[ pipeline->worker_count++ ] = worker;
+    }
+    lw_mutex_lock( pipeline->mutex );
+    ++pipeline->count;
+    lw_cond_broadcast( pipeline->work_cond );
+    lw_mutex_unlock( pipeline->mutex );
+    return 0;
+}
+
+/* Wait until the oldest packet is parsed and take it out of the pipeline.
+ * Return -1 if the pipeline is empty. */
+static int take_index_packet
+(
+    lwindex_pipeline_t      *pipeline,
+    AVPacket                *pkt,
+    lwindex_parsed_packet_t *parsed
+)
+{
+    if( pipeline->count == 0 )
+        return -1;
+    lwindex_pipeline_entry_t *entry = &pipeline->entries[ pipeline->head ];
+    if( pipeline->threaded )
+    {
+        lw_mutex_lock( pipeline->mutex );
+        while( entry->state != LWINDEX_PACKET_PARSED )
+            lw_cond_wait( pipeline->done_cond, pipeline->mutex );
+    }
+    av_packet_move_ref( pkt, &entry->pkt );
+    *parsed = entry->parsed;
+    pipeline->head = (pipeline->head + 1) % pipeline->depth;
+    --pipeline->count;
+    if( pipeline->threaded )
+        lw_mutex_unlock( pipeline->mutex );
+    return 0;
+}
+
+static void create_index
+(
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    AVFormatContext                *format_ctx,
+    lwlibav_option_t               *opt,
+    lwindex_resume_t               *resume,
+    progress_indicator_t           *indicator,
+    progress_handler_t             *php
+)
+{
+    if( set_format_name( lwhp, format_ctx->iformat->name ) < 0 )
+        return;
+    uint32_t video_info_count = 1 << 16;
+    uint32_t audio_info_count = 1 << 16;
+    video_frame_info_t *video_info = (video_frame_info_t *)lw_malloc_zero( video_info_count * sizeof(video_frame_info_t) );
+    if( !video_info )
+        return;
+    audio_frame_info_t *audio_info = (audio_frame_info_t *)lw_malloc_zero( audio_info_count * sizeof(audio_frame_info_t) );
+    if( !audio_info )
+    {
+        free( video_info );
+        return;
+    }
+    /*
+        # Structure of Libav reader index file
+        <LibavReaderIndexFile=18>
+        <InputFilePath>foobar.omo</InputFilePath>
+        <FileSize=1048576>
+        <FileHash=0x1234abcd>
+        <ContentHash=0000000004,0x0123456789abcdef>
+        <LibavReaderIndex=0x00000208,0,marumoska>
+        <ActiveVideoStreamIndex>+0000000000</ActiveVideoStreamIndex>
+        <ActiveAudioStreamIndex>-0000000001</ActiveAudioStreamIndex>
+        <PartialIndex=0,0>
+        <StreamInfo=0,0>
+        Codec=2,TimeBase=1001/24000,Width=1920,Height=1080,Format=yuv420p,ColorSpace=5
+        </StreamInfo>
+        Index=0,POS=0,PTS=2002,DTS=0,EDI=0
+        Key=1,Pic=1,POC=0,Repeat=1,Field=0
+        </LibavReaderIndex>
+        <StreamDuration=0,0>5000</StreamDuration>
+        <StreamIndexEntries=0,0,1>
+        POS=0,TS=2002,Flags=1,Size=1024,Distance=0
+        </StreamIndexEntries>
+        <ExtraDataList=0,0,1>
+        Size=252,Codec=28,4CC=0x564d4448,Width=1920,Height=1080,Format=yuv420p,BPS=0
+        ... binary string ...
+        </ExtraDataList>
+        </LibavReaderIndexFile>
+     */
+    FILE    *index                  = NULL;
+    char    *binary_index_file_path = NULL;
+    int64_t  file_size              = 0;
+    uint32_t file_hash              = 0;
+    if( !opt->no_create_index )
+    {
+        char *index_file_path = get_index_file_path( opt, lwhp->file_path, is_per_stream_index( opt ) );
+        if( index_file_path )
+        {
+            binary_index_file_path = concatenate_path( index_file_path, "b" );
+            if( opt->text_index )
+                index = lw_fopen( index_file_path, "wb" );
+            lw_free( index_file_path );
+        }
+        if( !binary_index_file_path || (opt->text_index && !index)
+         || get_file_status( lwhp->file_path, &file_size, NULL ) )
+        {
+            if( index )
+                fclose( index );
+            lw_free( binary_index_file_path );
+            free( video_info );
+            free( audio_info );
+            return;
+        }
+        file_hash = xxhash_file( lwhp->file_path, file_size );
+    }
+    /* The content hash is computed along the demuxing, so it costs little extra reading. */
+    lwindex_content_hasher_t content_hasher = { 0 };
+    uint32_t content_hash_stride = opt->content_hash_stride > 0 && !opt->no_create_index ? (uint32_t)opt->content_hash_stride : 0;
+    uint64_t content_hash        = 0;
+    if( content_hash_stride && open_content_hasher( &content_hasher, lwhp->file_path, content_hash_stride ) < 0 )
+    {
+        close_content_hasher( &content_hasher );
+        content_hash_stride = 0;
+    }
+    lwhp->format_flags = format_ctx->iformat->flags;
+    lwhp->raw_demuxer  = !!format_ctx->iformat->raw_codec_id;
+    vdhp->format       = format_ctx;
+    adhp->format       = format_ctx;
+    adhp->dv_in_avi    = !strcmp( lwhp->format_name, "avi" ) ? -1 : 0;
+    /* The partial index has the forced streams only. The resumed indexing keeps the mark of the previous one. */
+    int partial_video = resume ? resume->header.video.partial : (opt->partial_index && opt->force_video);
+    int partial_audio = resume ? resume->header.audio.partial : (opt->partial_index && opt->force_audio);
+    int32_t video_index_pos  = 0;
+    int32_t audio_index_pos  = 0;
+    int32_t content_hash_pos = 0;
+    if( index )
+    {
+        /* Write Index file header. */
+        uint8_t lwindex_version[4] =
+        {
+            (LWINDEX_VERSION >> 24) & 0xff,
+            (LWINDEX_VERSION >> 16) & 0xff,
+            (LWINDEX_VERSION >>  8) & 0xff,
+             LWINDEX_VERSION        & 0xff
+        };
+        fprintf( index, "<LSMASHWorksIndexVersion=%" PRIu8 ".%" PRIu8 ".%" PRIu8 ".%" PRIu8 ">\n",
+                 lwindex_version[0], lwindex_version[1], lwindex_version[2], lwindex_version[3] );
+        fprintf( index, "<LibavReaderIndexFile=%d>\n", LWINDEX_INDEX_FILE_VERSION );
+        fprintf( index, "<InputFilePath>%s</InputFilePath>\n", lwhp->file_path );
+        fprintf( index, "<FileSize=%" PRId64 ">\n", file_size );
+        fprintf( index, "<FileHash=0x%08x>\n", file_hash );
+        content_hash_pos = ftell( index );
+        fprintf( index, "<ContentHash=%010" PRIu32 ",0x%016" PRIx64 ">\n", (uint32_t)0, (uint64_t)0 );
+        fprintf( index, "<LibavReaderIndex=0x%08x,%d,%s>\n", lwhp->format_flags, lwhp->raw_demuxer, lwhp->format_name );
+        video_index_pos = ftell( index );
+        fprintf( index, "<ActiveVideoStreamIndex>%+011d</ActiveVideoStreamIndex>\n", -1 );
+        audio_index_pos = ftell( index );
+        fprintf( index, "<ActiveAudioStreamIndex>%+011d</ActiveAudioStreamIndex>\n", adhp->stream_index == -2 ? -2 : -1 );
+        fprintf( index, "<PartialIndex=%d,%d>\n", partial_video, partial_audio );
+    }
+    AVPacket pkt = { 0 };
+    av_init_packet( &pkt );
+    int       video_resolution      = 0;
+    int       is_attached_pic       = 0;
+    uint32_t  video_sample_count    = 0;
+    uint32_t  invisible_count       = 0;
+    uint32_t  video_keyframe_count  = 0;
+    int64_t   last_keyframe_pts     = AV_NOPTS_VALUE;
+    uint32_t  audio_sample_count    = 0;
+    int       audio_sample_rate     = 0;
+    int       constant_frame_length = 1;
+    uint64_t  audio_duration        = 0;
+    int64_t   first_dts             = AV_NOPTS_VALUE;
+    int64_t   video_checkpoint_pos  = -1;
+    int64_t   audio_checkpoint_pos  = -1;
+    int64_t   filesize              = avio_size( format_ctx->pb );
+    if( indicator->open )
+        indicator->open( php );
+    /* Start to read frames and write the index file. */
+    lwindex_indexer_t indexer =
+    {
+        0,                              /* number_of_helpers */
         NULL,                           /* helpers */
         vdhp->preferred_decoder_names,  /* preferred_video_decoder_names */
         vdhp->prefer_hw_decoder,        /* prefer_video_hw_decoder */
         adhp->preferred_decoder_names,  /* preferred_audio_decoder_names */
         lwhp->threads,                  /* thread_count */
-        lwhp->format_name               /* format_name */
+        lwhp->format_name,              /* format_name */
+        partial_video,                  /* partial_video */
+        partial_audio,                  /* partial_audio */
+        opt->force_video_index,         /* video_stream_index */
+        opt->force_audio_index          /* audio_stream_index */
     };
+    if( resume )
+    {
+        /* The resumed indexing never replaces the active streams, so the others are useless. */
+        indexer.partial_video      = 1;
+        indexer.partial_audio      = 1;
+        indexer.video_stream_index = resume->header.video.stream_index;
+        indexer.audio_stream_index = resume->header.audio.stream_index;
+    }
     for( unsigned int stream_index = 0; stream_index < format_ctx->nb_streams; stream_index++ )
     {
         AVStream *stream = format_ctx->streams[stream_index];
@@ -2169,47 +3743,162 @@ static void create_index
         }
         print_index( index, "</StreamInfo>\n" );
     }
-    while( read_av_frame( format_ctx, &pkt ) >= 0 )
+    lwindex_pipeline_t pipeline = { 0 };
+    lwlibav_option_t   resume_opt;
+    if( resume )
     {
-        AVStream          *stream   = format_ctx->streams[ pkt.stream_index ];
-        AVCodecParameters *codecpar = stream->codecpar;
-        if( codecpar->codec_type != AVMEDIA_TYPE_VIDEO
-         && codecpar->codec_type != AVMEDIA_TYPE_AUDIO )
+        /* Take over the records before the checkpoint from the previous indexing.
+         * The demuxer is already at the checkpoint. The active streams are never replaced from here. */
+        const lwindex_binary_header_t *header = &resume->header;
+        if( header->video.stream_index >= 0 )
         {
-            stream->discard = AVDISCARD_ALL;
-            continue;
-        }
-        if( codecpar->codec_id == AV_CODEC_ID_NONE )
-        {
-            stream->discard = AVDISCARD_ALL;
-            continue;
+            AVStream         *stream = format_ctx->streams[ header->video.stream_index ];
+            lwindex_helper_t *helper = get_index_helper( &indexer, stream );
+            if( !helper || !helper->codec_ctx )
+                goto fail_index;
+            video_sample_count = resume->video_sample_count;
+            video_info_count   = MAX( video_info_count, 2 * (video_sample_count + 1) );
+            video_frame_info_t *temp = (video_frame_info_t *)realloc( resume->video_info, video_info_count * sizeof(video_frame_info_t) );
+            if( !temp )
+                goto fail_index;
+            resume->video_info = NULL;
+            free( video_info );
+            video_info = temp;
+            memset( &video_info[video_sample_count + 1], 0, (video_info_count - video_sample_count - 1) * sizeof(video_frame_info_t) );
+            for( uint32_t i = 1; i <= video_sample_count; i++ )
+            {
+                if( video_info[i].flags & LW_VFRAME_FLAG_KEY )
+                {
+                    last_keyframe_pts = video_info[i].pts;
+                    ++video_keyframe_count;
+                }
+                if( video_info[i].flags & LW_VFRAME_FLAG_INVISIBLE )
+                    ++invisible_count;
+            }
+            helper->exh                   = resume->video_exh;
+            helper->exh.current_index     = video_sample_count > 0 ? video_info[video_sample_count].extradata_index : 0;
+            resume->video_exh.entries     = NULL;
+            resume->video_exh.entry_count = 0;
+            vdhp->ctx                = helper->codec_ctx;
+            vdhp->codec_id           = helper->codec_ctx->codec_id;
+            vdhp->stream_index       = header->video.stream_index;
+            vdhp->time_base.num      = header->video.time_base_num;
+            vdhp->time_base.den      = header->video.time_base_den;
+            vdhp->max_width          = header->max_width;
+            vdhp->max_height         = header->max_height;
+            vdhp->initial_width      = header->initial_width;
+            vdhp->initial_height     = header->initial_height;
+            vdhp->initial_colorspace = (enum AVColorSpace)header->initial_colorspace;
+            video_resolution         = header->initial_width * header->initial_height;
+            is_attached_pic          = !!(stream->disposition & AV_DISPOSITION_ATTACHED_PIC);
         }
-        lwindex_helper_t *helper = get_index_helper( &indexer, stream );
-        if( !helper )
+        if( header->audio.stream_index >= 0 )
         {
-            av_packet_unref( &pkt );
-            goto fail_index;
+            AVStream         *stream = format_ctx->streams[ header->audio.stream_index ];
+            lwindex_helper_t *helper = get_index_helper( &indexer, stream );
+            if( !helper || !helper->codec_ctx )
+                goto fail_index;
+            audio_sample_count = resume->audio_sample_count;
+            audio_info_count   = MAX( audio_info_count, 2 * (audio_sample_count + 1) );
+            audio_frame_info_t *temp = (audio_frame_info_t *)realloc( resume->audio_info, audio_info_count * sizeof(audio_frame_info_t) );
+            if( !temp )
+                goto fail_index;
+            resume->audio_info = NULL;
+            free( audio_info );
+            audio_info = temp;
+            memset( &audio_info[audio_sample_count + 1], 0, (audio_info_count - audio_sample_count - 1) * sizeof(audio_frame_info_t) );
+            for( uint32_t i = 1; i <= audio_sample_count; i++ )
+            {
+                audio_duration += audio_info[i].length;
+                if( i > 1 && audio_info[i].length != audio_info[i - 1].length )
+                    constant_frame_length = 0;
+            }
+            helper->exh                   = resume->audio_exh;
+            helper->exh.current_index     = audio_sample_count > 0 ? audio_info[audio_sample_count].extradata_index : 0;
+            resume->audio_exh.entries     = NULL;
+            resume->audio_exh.entry_count = 0;
+            audio_sample_rate            = header->sample_rate;
+            adhp->ctx                    = helper->codec_ctx;
+            adhp->codec_id               = helper->codec_ctx->codec_id;
+            adhp->stream_index           = header->audio.stream_index;
+            adhp->time_base.num          = header->audio.time_base_num;
+            adhp->time_base.den          = header->audio.time_base_den;
+            aohp->output_channel_layout  = header->output_channel_layout;
+            aohp->output_sample_format   = (enum AVSampleFormat)header->output_sample_format;
+            aohp->output_sample_rate     = header->output_sample_rate;
+            aohp->output_bits_per_sample = header->output_bits_per_sample;
         }
-        AVCodecContext *pkt_ctx = helper->codec_ctx;
-        if( !pkt_ctx )
+        resume_opt = *opt;
+        resume_opt.force_video       = 1;
+        resume_opt.force_video_index = header->video.stream_index;
+        resume_opt.force_audio       = 1;
+        resume_opt.force_audio_index = header->audio.stream_index;
+        opt = &resume_opt;
+    }
+    if( open_index_pipeline( &pipeline, &indexer, format_ctx, vdhp->frame_buffer, adhp->stream_index != -2 ) < 0 )
+        goto fail_index;
+    int eof = 0;
+    while( 1 )
+    {
+        /* Demux packets until the pipeline is full. */
+        while( !eof && pipeline.count < pipeline.depth )
         {
-            stream->discard = AVDISCARD_ALL;
-            continue;
+            if( read_av_frame( format_ctx, &pkt ) < 0 )
+            {
+                eof = 1;
+                break;
+            }
+            if( content_hash_stride )
+                update_content_hash( &content_hasher, MIN( avio_tell( format_ctx->pb ), file_size ) );
+            AVStream          *stream   = format_ctx->streams[ pkt.stream_index ];
+            AVCodecParameters *codecpar = stream->codecpar;
+            if( codecpar->codec_type != AVMEDIA_TYPE_VIDEO
+             && codecpar->codec_type != AVMEDIA_TYPE_AUDIO )
+            {
+                stream->discard = AVDISCARD_ALL;
+                av_packet_unref( &pkt );
+                continue;
+            }
+            if( codecpar->codec_id == AV_CODEC_ID_NONE )
+            {
+                stream->discard = AVDISCARD_ALL;
+                av_packet_unref( &pkt );
+                continue;
+            }
+            /* Don't touch the existing helper here since it might be in use by a worker. */
+            lwindex_helper_t *helper = pkt.stream_index < indexer.number_of_helpers ? indexer.helpers[ pkt.stream_index ] : NULL;
+            if( !helper && !(helper = get_index_helper( &indexer, stream )) )
+            {
+                av_packet_unref( &pkt );
+                goto fail_index;
+            }
+            if( !helper->codec_ctx )
+            {
+                stream->discard = AVDISCARD_ALL;
+                av_packet_unref( &pkt );
+                continue;
+            }
+            if( queue_index_packet( &pipeline, helper, &pkt ) < 0 )
+            {
+                av_packet_unref( &pkt );
+                goto fail_index;
+            }
         }
-        int extradata_index = append_extradata_if_new( helper, pkt_ctx, &pkt );
-        if( extradata_index < 0 )
+        /* Take the oldest packet in demuxing order. */
+        lwindex_parsed_packet_t parsed;
+        if( take_index_packet( &pipeline, &pkt, &parsed ) < 0 )
+            break;
+        AVStream         *stream  = format_ctx->streams[ pkt.stream_index ];
+        lwindex_helper_t *helper  = indexer.helpers[ pkt.stream_index ];
+        AVCodecContext   *pkt_ctx = helper->codec_ctx;
+        int extradata_index = parsed.extradata_index;
+        if( parsed.error )
         {
             av_packet_unref( &pkt );
             goto fail_index;
         }
         if( pkt_ctx->codec_type == AVMEDIA_TYPE_VIDEO )
         {
-            if( pkt_ctx->pix_fmt == AV_PIX_FMT_NONE
-             || (pkt_ctx->codec->wrapper_name && !pix_fmt_investigated) )
-            {
-                investigate_pix_fmt_by_decoding( pkt_ctx, &pkt, vdhp->frame_buffer );
-                pix_fmt_investigated = 1;
-            }
             int dv_in_avi_init = 0;
             if( adhp->dv_in_avi    == -1
              && vdhp->stream_index == -1
@@ -2221,7 +3910,7 @@ static void create_index
                 vdhp->stream_index = pkt.stream_index;
             }
             /* Replace lower resolution stream with higher. Override attached picture. */
-            int higher_priority = ((pkt_ctx->width * pkt_ctx->height > video_resolution)
+            int higher_priority = ((parsed.probed_width * parsed.probed_height > video_resolution)
                                 || (is_attached_pic && !(stream->disposition & AV_DISPOSITION_ATTACHED_PIC)));
             if( dv_in_avi_init
              || (!opt->force_video && (vdhp->stream_index == -1 || (pkt.stream_index != vdhp->stream_index && higher_priority)))
@@ -2239,63 +3928,21 @@ static void create_index
                 vdhp->ctx                = pkt_ctx;
                 vdhp->codec_id           = pkt_ctx->codec_id;
                 vdhp->stream_index       = pkt.stream_index;
-                video_resolution         = pkt_ctx->width * pkt_ctx->height;
+                video_resolution         = parsed.probed_width * parsed.probed_height;
                 is_attached_pic          = !!(stream->disposition & AV_DISPOSITION_ATTACHED_PIC);
                 video_sample_count       = 0;
                 last_keyframe_pts        = AV_NOPTS_VALUE;
-                vdhp->max_width          = pkt_ctx->width;
-                vdhp->max_height         = pkt_ctx->height;
-                vdhp->initial_width      = pkt_ctx->width;
-                vdhp->initial_height     = pkt_ctx->height;
-                vdhp->initial_colorspace = pkt_ctx->colorspace;
-            }
-            /* Get picture type. */
-            int pict_type = get_picture_type( helper, pkt_ctx, &pkt );
-            if( pict_type < 0 )
-            {
-                av_packet_unref( &pkt );
-                goto fail_index;
-            }
-            /* Get Picture Order Count. */
-            int poc = helper->parser_ctx ? helper->parser_ctx->output_picture_number : 0;
-            /* Get field information. */
-            int             repeat_pict;
-            lw_field_info_t field_info;
-            if( helper->parser_ctx )
-            {
-                if( helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_TOP_FIELD
-                 || helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_BOTTOM_FIELD )
-                {
-                    /* field coded picture */
-                    if( helper->parser_ctx->picture_structure == AV_PICTURE_STRUCTURE_TOP_FIELD )
-                        field_info = LW_FIELD_INFO_TOP;
-                    else
-                        field_info = LW_FIELD_INFO_BOTTOM;
-                    repeat_pict = helper->parser_ctx->repeat_pict;
-                }
-                else
-                {
-                    /* frame coded picture */
-                    if( helper->parser_ctx->field_order == AV_FIELD_TT
-                     || helper->parser_ctx->field_order == AV_FIELD_TB )
-                        field_info = LW_FIELD_INFO_TOP;
-                    else if( helper->parser_ctx->field_order == AV_FIELD_BB
-                          || helper->parser_ctx->field_order == AV_FIELD_BT )
-                        field_info = LW_FIELD_INFO_BOTTOM;
-                    else
-                        field_info = helper->last_field_info;
-                    if( get_ticks_per_frame( pkt_ctx ) == 2 && helper->parser_ctx->repeat_pict != 0 )
-                        repeat_pict = helper->parser_ctx->repeat_pict;
-                    else
-                        repeat_pict = 2 * helper->parser_ctx->repeat_pict + 1;
-                }
-                helper->last_field_info = field_info;
-            }
-            else
-            {
-                repeat_pict = 1;
-                field_info = helper->last_field_info;
+                video_checkpoint_pos     = -1;
+                vdhp->max_width          = parsed.probed_width;
+                vdhp->max_height         = parsed.probed_height;
+                vdhp->initial_width      = parsed.probed_width;
+                vdhp->initial_height     = parsed.probed_height;
+                vdhp->initial_colorspace = parsed.probed_colorspace;
             }
+            int             pict_type   = parsed.pict_type;
+            int             poc         = parsed.poc;
+            int             repeat_pict = parsed.repeat_pict;
+            lw_field_info_t field_info  = parsed.field_info;
             /* Set video frame info if this stream is active. */
             if( pkt.stream_index == vdhp->stream_index )
             {
@@ -2318,12 +3965,15 @@ static void create_index
                     info->flags |= LW_VFRAME_FLAG_KEY;
                     last_keyframe_pts = pkt.pts;
                     ++video_keyframe_count;
+                    if( pkt.pos >= 0
+                     && (poc == 0 || (pkt_ctx->codec_id != AV_CODEC_ID_H264 && pkt_ctx->codec_id != AV_CODEC_ID_HEVC)) )
+                        video_checkpoint_pos = pkt.pos;
                 }
-                if( repeat_pict == 0 && field_info == LW_FIELD_INFO_UNKNOWN && pkt_ctx->pix_fmt == AV_PIX_FMT_NONE
+                if( repeat_pict == 0 && field_info == LW_FIELD_INFO_UNKNOWN && parsed.pix_fmt == AV_PIX_FMT_NONE
                  && (pkt_ctx->codec_id == AV_CODEC_ID_H264 || pkt_ctx->codec_id == AV_CODEC_ID_HEVC)
-                 && (pkt_ctx->width == 0 || pkt_ctx->height == 0) )
+                 && (parsed.width == 0 || parsed.height == 0) )
                     info->flags |= LW_VFRAME_FLAG_CORRUPT;
-                if( pkt_ctx->codec_id == AV_CODEC_ID_VP8 && check_vp8_invisible_frame( &pkt ) )
+                if( parsed.vp8_invisible )
                 {
                     /* VPx invisible altref frame. */
                     info->pts         = AV_NOPTS_VALUE;
@@ -2342,10 +3992,10 @@ static void create_index
                     vdhp->time_base.den = stream->time_base.den;
                 }
                 /* Set maximum resolution. */
-                if( vdhp->max_width  < pkt_ctx->width )
-                    vdhp->max_width  = pkt_ctx->width;
-                if( vdhp->max_height < pkt_ctx->height )
-                    vdhp->max_height = pkt_ctx->height;
+                if( vdhp->max_width  < parsed.width )
+                    vdhp->max_width  = parsed.width;
+                if( vdhp->max_height < parsed.height )
+                    vdhp->max_height = parsed.height;
                 if( video_sample_count + 1 == video_info_count )
                 {
                     video_info_count <<= 1;
@@ -2358,24 +4008,6 @@ static void create_index
                     video_info = temp;
                 }
             }
-            /* Set width, height and pixel_format for the current extradata. */
-            if( extradata_index >= 0 )
-            {
-                lwlibav_extradata_handler_t *list = &helper->exh;
-                lwlibav_extradata_t *entry = &list->entries[ list->current_index ];
-                if( entry->width < pkt_ctx->width )
-                    entry->width = pkt_ctx->width;
-                if( entry->height < pkt_ctx->height )
-                    entry->height = pkt_ctx->height;
-                if( entry->pixel_format == AV_PIX_FMT_NONE )
-                    entry->pixel_format = pkt_ctx->pix_fmt;
-                if( entry->bits_per_sample == 0 )
-                    entry->bits_per_sample = pkt_ctx->bits_per_coded_sample;
-                if( entry->codec_id == AV_CODEC_ID_NONE )
-                    entry->codec_id = pkt_ctx->codec_id;
-                if( entry->codec_tag == 0 )
-                    entry->codec_tag = pkt_ctx->codec_tag;
-            }
             /* Write a video packet info to the index file. */
             print_index( index, "Index=%d,POS=%" PRId64 ",PTS=%" PRId64 ",DTS=%" PRId64 ",EDI=%d\n"
                          "Key=%d,Pic=%d,POC=%d,Repeat=%d,Field=%d\n",
@@ -2398,14 +4030,13 @@ static void create_index
                 adhp->codec_id     = pkt_ctx->codec_id;
                 adhp->stream_index = pkt.stream_index;
             }
-            int bits_per_sample = pkt_ctx->bits_per_raw_sample   > 0 ? pkt_ctx->bits_per_raw_sample
-                                : pkt_ctx->bits_per_coded_sample > 0 ? pkt_ctx->bits_per_coded_sample
-                                : av_get_bytes_per_sample( pkt_ctx->sample_fmt ) << 3;
-            /* Get audio frame_length. */
-            int frame_length = get_audio_frame_length( helper, pkt_ctx, &pkt );
+            int bits_per_sample = parsed.bits_per_sample;
+            int frame_length    = parsed.frame_length;
             /* Set audio frame info if this stream is active. */
             if( pkt.stream_index == adhp->stream_index )
             {
+                if( pkt.pos >= 0 )
+                    audio_checkpoint_pos = pkt.pos;
                 if( frame_length != -1 )
                     audio_duration += frame_length;
                 if( audio_duration <= INT32_MAX )
@@ -2418,16 +4049,16 @@ static void create_index
                     info->file_offset     = pkt.pos;
                     info->sample_number   = audio_sample_count;
                     info->extradata_index = extradata_index;
-                    info->sample_rate     = pkt_ctx->sample_rate;
-                    if( frame_length != -1 && audio_sample_count > helper->delay_count )
+                    info->sample_rate     = parsed.sample_rate;
+                    if( frame_length != -1 && audio_sample_count > parsed.delay_count )
                     {
-                        uint32_t audio_frame_number = audio_sample_count - helper->delay_count;
+                        uint32_t audio_frame_number = audio_sample_count - parsed.delay_count;
                         audio_info[audio_frame_number].length = frame_length;
                         if( audio_frame_number > 1 && audio_info[audio_frame_number].length != audio_info[audio_frame_number - 1].length )
                             constant_frame_length = 0;
                     }
                     if( audio_sample_rate == 0 )
-                        audio_sample_rate = pkt_ctx->sample_rate;
+                        audio_sample_rate = parsed.sample_rate;
                     if( audio_sample_count + 1 == audio_info_count )
                     {
                         audio_info_count <<= 1;
@@ -2439,10 +4070,10 @@ static void create_index
                         }
                         audio_info = temp;
                     }
-                    if( av_get_channel_layout_nb_channels( pkt_ctx->channel_layout )
+                    if( av_get_channel_layout_nb_channels( parsed.channel_layout )
                       > av_get_channel_layout_nb_channels( aohp->output_channel_layout ) )
-                        aohp->output_channel_layout = pkt_ctx->channel_layout;
-                    aohp->output_sample_format   = select_better_sample_format( aohp->output_sample_format, pkt_ctx->sample_fmt );
+                        aohp->output_channel_layout = parsed.channel_layout;
+                    aohp->output_sample_format   = select_better_sample_format( aohp->output_sample_format, parsed.sample_fmt );
                     aohp->output_sample_rate     = MAX( aohp->output_sample_rate, audio_sample_rate );
                     aohp->output_bits_per_sample = MAX( aohp->output_bits_per_sample, bits_per_sample );
                 }
@@ -2452,26 +4083,6 @@ static void create_index
                     adhp->time_base.den = stream->time_base.den;
                 }
             }
-            /* Set channel_layout, sample_rate, sample_format and bits_per_sample for the current extradata. */
-            if( extradata_index >= 0 )
-            {
-                lwlibav_extradata_handler_t *list = &helper->exh;
-                lwlibav_extradata_t *entry = &list->entries[ list->current_index ];
-                if( entry->channel_layout == 0 )
-                    entry->channel_layout = pkt_ctx->channel_layout;
-                if( entry->sample_rate == 0 )
-                    entry->sample_rate = pkt_ctx->sample_rate;
-                if( entry->sample_format == AV_SAMPLE_FMT_NONE )
-                    entry->sample_format = pkt_ctx->sample_fmt;
-                if( entry->bits_per_sample == 0 )
-                    entry->bits_per_sample = bits_per_sample;
-                if( entry->block_align == 0 )
-                    entry->block_align = pkt_ctx->block_align;
-                if( entry->codec_id == AV_CODEC_ID_NONE )
-                    entry->codec_id = pkt_ctx->codec_id;
-                if( entry->codec_tag == 0 )
-                    entry->codec_tag = pkt_ctx->codec_tag;
-            }
             /* Write an audio packet info to the index file. */
             print_index( index, "Index=%d,POS=%" PRId64 ",PTS=%" PRId64 ",DTS=%" PRId64 ",EDI=%d\n"
                          "Length=%d\n",
@@ -2495,7 +4106,7 @@ static void create_index
                              * (pkt.dts - first_dts) * (stream->time_base.num / (double)stream->time_base.den)
                              / (format_ctx->duration / AV_TIME_BASE)
                              + 0.5);
-            const char *message = index ? "Creating Index file" : "Parsing input file";
+            const char *message = !opt->no_create_index ? "Creating Index file" : "Parsing input file";
             int abort = indicator->update( php, message, percent );
             av_packet_unref( &pkt );
             if( abort )
@@ -2504,6 +4115,15 @@ static void create_index
         else
             av_packet_unref( &pkt );
     }
+    close_index_pipeline( &pipeline );
+    for( int i = 0; i < indexer.number_of_helpers; i++ )
+    {
+        lwindex_helper_t *helper = indexer.helpers[i];
+        if( helper && helper->audio_packet_count )
+            lw_log_show( &adhp->lh, LW_LOG_INFO,
+                         "Stream %d: %" PRIu32 " of %" PRIu32 " audio packets were decoded to get their frame lengths.",
+                         i, helper->decoded_packet_count, helper->audio_packet_count );
+    }
     /* Handle delay derived from the audio decoder. */
     for( unsigned int stream_index = 0; stream_index < format_ctx->nb_streams; stream_index++ )
     {
@@ -2740,16 +4360,41 @@ static void create_index
     print_index( index, "</LibavReaderIndexFile>\n" );
     if( vdhp->stream_index >= 0 )
     {
-        vdhp->keyframe_list = (uint8_t *)lw_malloc_zero( (video_sample_count + 1) * sizeof(uint8_t) );
-        if( !vdhp->keyframe_list )
-            goto fail_index;
         vdhp->frame_list      = video_info;
         vdhp->frame_count     = video_sample_count;
         vdhp->initial_pix_fmt = vdhp->ctx->pix_fmt;
+    }
+    if( adhp->stream_index >= 0 )
+    {
+        adhp->frame_list   = audio_info;
+        adhp->frame_count  = audio_sample_count;
+        adhp->frame_length = constant_frame_length ? adhp->frame_list[1].length : 0;
+    }
+    if( content_hash_stride )
+    {
+        content_hash = finish_content_hash( &content_hasher, file_size );
+        if( index && content_hash )
+        {
+            int32_t current_pos = ftell( index );
+            fseek( index, content_hash_pos, SEEK_SET );
+            fprintf( index, "<ContentHash=%010" PRIu32 ",0x%016" PRIx64 ">\n", content_hash_stride, content_hash );
+            fseek( index, current_pos, SEEK_SET );
+        }
+    }
+    /* Write the binary index file before the frame lists are modified by the seek method decision. */
+    if( binary_index_file_path )
+        write_binary_index( binary_index_file_path, lwhp, vdhp, adhp, aohp, file_size, file_hash,
+                            content_hash_stride, content_hash,
+                            vdhp->stream_index >= 0 ? format_ctx->streams[ vdhp->stream_index ]->duration : 0,
+                            invisible_count, audio_sample_rate, partial_video, partial_audio,
+                            vdhp->stream_index >= 0 ? video_checkpoint_pos : audio_checkpoint_pos );
+    if( vdhp->stream_index >= 0 )
+    {
         if( decide_video_seek_method( lwhp, vdhp, video_sample_count ) )
             goto fail_index;
         /* Compute the stream duration. */
         compute_stream_duration( lwhp, vdhp, format_ctx->streams[ vdhp->stream_index ]->duration );
+        keep_initial_frame_list( vdhp );
         /* Create the repeat control info. */
         create_video_frame_order_list( vdhp, vohp, opt );
         /* Exclude invisible frames from the output handler. */
@@ -2757,14 +4402,12 @@ static void create_index
     }
     if( adhp->stream_index >= 0 )
     {
-        adhp->frame_list   = audio_info;
-        adhp->frame_count  = audio_sample_count;
-        adhp->frame_length = constant_frame_length ? adhp->frame_list[1].length : 0;
         decide_audio_seek_method( lwhp, adhp, audio_sample_count );
         if( opt->av_sync && vdhp->stream_index >= 0 )
             lwhp->av_gap = calculate_av_gap( vdhp, vohp, adhp, audio_sample_rate );
     }
     cleanup_index_helpers( &indexer, format_ctx );
+    lw_free( binary_index_file_path );
     if( index )
         fclose( index );
     if( indicator->close )
@@ -2773,7 +4416,12 @@ static void create_index
     adhp->format = NULL;
     return;
 fail_index:
+    close_index_pipeline( &pipeline );
+    close_content_hasher( &content_hasher );
     cleanup_index_helpers( &indexer, format_ctx );
+    lw_free( binary_index_file_path );
+    vdhp->frame_list = NULL;
+    adhp->frame_list = NULL;
     free( video_info );
     free( audio_info );
     if( index )
@@ -2793,7 +4441,8 @@ static int parse_index
     lwlibav_audio_decode_handler_t *adhp,
     lwlibav_audio_output_handler_t *aohp,
     lwlibav_option_t               *opt,
-    FILE                           *index
+    FILE                           *index,
+    int                             read_only
 )
 {
     /* Test to open the target file. */
@@ -2852,6 +4501,11 @@ static int parse_index
     if( fscanf( index, "<FileHash=0x%x>\n", &file_hash ) != 1
      || file_hash != xxhash_file( lwhp->file_path, file_stat.st_size ) )
         return -1;
+    uint32_t content_hash_stride;
+    uint64_t content_hash;
+    if( fscanf( index, "<ContentHash=%" SCNu32 ",0x%" SCNx64 ">\n", &content_hash_stride, &content_hash ) != 2
+     || content_hash_mismatch( lwhp->file_path, file_size, content_hash_stride, content_hash, (uint32_t)opt->content_hash_stride ) )
+        return -1;
     if( fscanf( index, "<LibavReaderIndex=0x%x,%d,%[^>]>\n",
                 (unsigned int *)&lwhp->format_flags, &lwhp->raw_demuxer, format_name ) != 3 )
         return -1;
@@ -2859,7 +4513,15 @@ static int parse_index
     if( fscanf( index, "<ActiveVideoStreamIndex>%d</ActiveVideoStreamIndex>\n", &active_video_index ) != 1
      || fscanf( index, "<ActiveAudioStreamIndex>%d</ActiveAudioStreamIndex>\n", &active_audio_index ) != 1 )
         return -1;
-    lwhp->format_name = format_name;
+    /* The partial index has the frame lists of the streams it was forced to only. */
+    int partial_video;
+    int partial_audio;
+    if( fscanf( index, "<PartialIndex=%d,%d>\n", &partial_video, &partial_audio ) != 2
+     || (partial_video && (!opt->force_video || opt->force_video_index != active_video_index))
+     || (partial_audio && (!opt->force_audio || opt->force_audio_index != active_audio_index)) )
+        return -1;
+    if( set_format_name( lwhp, format_name ) < 0 )
+        return -1;
     adhp->dv_in_avi = !strcmp( lwhp->format_name, "avi" ) ? -1 : 0;
     int video_present = (active_video_index >= 0);
     int audio_present = (active_audio_index >= 0);
@@ -3293,15 +4955,13 @@ static int parse_index
     {
         if( vdhp->stream_index >= 0 )
         {
-            vdhp->keyframe_list = (uint8_t *)lw_malloc_zero( (video_sample_count + 1) * sizeof(uint8_t) );
-            if( !vdhp->keyframe_list )
-                goto fail_parsing;
             vdhp->frame_list  = video_info;
             vdhp->frame_count = video_sample_count;
             if( decide_video_seek_method( lwhp, vdhp, video_sample_count ) )
                 goto fail_parsing;
             /* Compute the stream duration. */
             compute_stream_duration( lwhp, vdhp, vdhp->stream_duration );
+            keep_initial_frame_list( vdhp );
             /* Create the repeat control info. */
             create_video_frame_order_list( vdhp, vohp, opt );
             /* Exclude invisible frames from the output handler. */
@@ -3340,7 +5000,7 @@ static int parse_index
             if( opt->av_sync && vdhp->stream_index >= 0 )
                 lwhp->av_gap = calculate_av_gap( vdhp, vohp, adhp, audio_sample_rate );
         }
-        if( vdhp->stream_index != active_video_index || adhp->stream_index != active_audio_index )
+        if( !read_only && (vdhp->stream_index != active_video_index || adhp->stream_index != active_audio_index) )
         {
             /* Update the active stream indexes when specifying different stream indexes. */
             fseek( index, active_index_pos, SEEK_SET );
@@ -3361,39 +5021,32 @@ fail_parsing:
     return -1;
 }
 
-int lwlibav_construct_index
+/* Parse the binary index file if any, otherwise the text index file at 'index_file_path'.
+ * If 'read_only' is set to non-zero, the text index file is never updated.
+ * The return value is the same as open_index_file(). */
+static int read_index_file
 (
     lwlibav_file_handler_t         *lwhp,
     lwlibav_video_decode_handler_t *vdhp,
     lwlibav_video_output_handler_t *vohp,
     lwlibav_audio_decode_handler_t *adhp,
     lwlibav_audio_output_handler_t *aohp,
-    lw_log_handler_t               *lhp,
     lwlibav_option_t               *opt,
-    progress_indicator_t           *indicator,
-    progress_handler_t             *php
+    int                             has_lwi_ext,
+    const char                     *index_file_path,
+    lwindex_resume_t               *resume,
+    int                             read_only
 )
 {
-    /* Try to open the index file. */
-    size_t file_path_length = strlen( opt->file_path );
-    const char *ext = file_path_length >= 5 ? &opt->file_path[file_path_length - 4] : NULL;
-    int has_lwi_ext = ext && !strncmp( ext, ".lwi", strlen( ".lwi" ) );
-    FILE *index;
-    if( has_lwi_ext )
-        index = lw_fopen( opt->file_path, (opt->force_video || opt->force_audio) ? "r+b" : "rb" );
-    else if( opt->index_file_path )
-        index = lw_fopen( opt->index_file_path, (opt->force_video || opt->force_audio) ? "r+b" : "rb" );
-    else
-    {
-        char *index_file_path = (char *)lw_malloc_zero( file_path_length + 5 );
-        if( !index_file_path )
-            return -1;
-        memcpy( index_file_path, opt->file_path, file_path_length );
-        memcpy( index_file_path + file_path_length, ".lwi", strlen( ".lwi" ) );
-        index_file_path[file_path_length + 4] = '\0';
-        index = lw_fopen( index_file_path, (opt->force_video || opt->force_audio) ? "r+b" : "rb" );
-        free( index_file_path );
-    }
+    /* The binary index file is preferred since it can be used without parsing. */
+    char *binary_index_file_path = concatenate_path( index_file_path, "b" );
+    int ret = binary_index_file_path
+            ? parse_binary_index( lwhp, vdhp, vohp, adhp, aohp, opt, has_lwi_ext, binary_index_file_path, resume )
+            : -1;
+    lw_free( binary_index_file_path );
+    if( ret >= 0 )
+        return ret;
+    FILE *index = lw_fopen( index_file_path, !read_only && (opt->force_video || opt->force_audio) ? "r+b" : "rb" );
     if( index )
     {
         uint8_t lwindex_version[4] = { 0 };
@@ -3403,16 +5056,85 @@ int lwlibav_construct_index
          && ((lwindex_version[0] << 24) | (lwindex_version[1] << 16) | (lwindex_version[2] << 8) | lwindex_version[3]) == LWINDEX_VERSION
          && 1 == fscanf( index, "<LibavReaderIndexFile=%d>\n", &index_file_version )
          && index_file_version == LWINDEX_INDEX_FILE_VERSION
-         && parse_index( lwhp, vdhp, vohp, adhp, aohp, opt, index ) == 0 )
+         && parse_index( lwhp, vdhp, vohp, adhp, aohp, opt, index, read_only ) == 0 )
         {
             /* Opening and parsing the index file succeeded. */
             fclose( index );
-            lwhp->threads = opt->threads;
             return 0;
         }
         fclose( index );
     }
+    return -1;
+}
+
+/* Open and parse the existing index file of the input file.
+ * Return 0 if successful.
+ * Return 1 if the binary index file is of the input file before it grew, and then 'resume' is set up.
+ * Return -1 if no valid index file is there or failed.
+ * If 'read_only' is set to non-zero, the index file is opened just for queries and never updated. */
+static int open_index_file
+(
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lwlibav_option_t               *opt,
+    lwindex_resume_t               *resume,
+    int                             read_only
+)
+{
+    int has_lwi_ext = has_lwi_extension( opt->file_path );
+    int per_stream  = is_per_stream_index( opt );
+    char *index_file_path;
+    if( per_stream )
+    {
+        /* The index of all streams also serves the forced streams, so use it if any. */
+        index_file_path = get_index_file_path( opt, opt->file_path, 0 );
+        int ret = index_file_path ? read_index_file( lwhp, vdhp, vohp, adhp, aohp, opt, 0, index_file_path, NULL, read_only ) : -1;
+        lw_free( index_file_path );
+        if( ret == 0 )
+            return 0;
+    }
+    index_file_path = has_lwi_ext ? concatenate_path( opt->file_path, "" )
+                                  : get_index_file_path( opt, opt->file_path, per_stream );
+    if( !index_file_path )
+        return -1;
+    int ret = read_index_file( lwhp, vdhp, vohp, adhp, aohp, opt, has_lwi_ext, index_file_path, resume, read_only );
+    lw_free( index_file_path );
+    return ret;
+}
+
+static int construct_index
+(
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lw_log_handler_t               *lhp,
+    lwlibav_option_t               *opt,
+    progress_indicator_t           *indicator,
+    progress_handler_t             *php
+)
+{
+    /* Try to open the index file.
+     * If the input file has only grown since the binary index file was written, resume the indexing from the checkpoint in it.
+     * This is not available when the text index file is wanted since it must have all records of all streams. */
+    lwindex_resume_t  resume_data = { { { 0 } } };
+    lwindex_resume_t *resume      = NULL;
+    int ret = open_index_file( lwhp, vdhp, vohp, adhp, aohp, opt, opt->text_index ? NULL : &resume_data, 0 );
+    if( ret == 0 )
+    {
+        lwhp->threads = opt->threads;
+        return 0;
+    }
+    else if( ret == 1 )
+        resume = &resume_data;
     /* Open file. */
+    size_t file_path_length = strlen( opt->file_path );
+    const char *ext = file_path_length >= 5 ? &opt->file_path[file_path_length - 4] : NULL;
+    int has_lwi_ext = ext && !strncmp( ext, ".lwi", strlen( ".lwi" ) );
     if( !lwhp->file_path )
     {
         lwhp->file_path = (char *)lw_malloc_zero( file_path_length + 1 );
@@ -3429,11 +5151,26 @@ int lwlibav_construct_index
             lavf_close_file( &format_ctx );
         goto fail;
     }
+    if( resume && av_seek_frame( format_ctx, -1, resume->header.checkpoint_pos, AVSEEK_FLAG_BYTE ) < 0 )
+    {
+        /* Index the whole file from the beginning. */
+        cleanup_index_resume( resume );
+        resume = NULL;
+        lavf_close_file( &format_ctx );
+        if( lavf_open_file( &format_ctx, lwhp->file_path, lhp ) )
+        {
+            if( format_ctx )
+                lavf_close_file( &format_ctx );
+            goto fail;
+        }
+    }
     lwhp->threads      = opt->threads;
     vdhp->stream_index = -1;
     adhp->stream_index = ( opt->force_audio_index == -2 ) ? -2 : -1;
     /* Create the index file. */
-    create_index( lwhp, vdhp, vohp, adhp, aohp, format_ctx, opt, indicator, php );
+    create_index( lwhp, vdhp, vohp, adhp, aohp, format_ctx, opt, resume, indicator, php );
+    if( resume )
+        cleanup_index_resume( resume );
     /* Close file.
      * By opening file for video and audio separately, indecent work about frame reading can be avoidable. */
     lavf_close_file( &format_ctx );
@@ -3441,11 +5178,589 @@ int lwlibav_construct_index
     adhp->ctx = NULL;
     return 0;
 fail:
+    if( resume )
+        cleanup_index_resume( resume );
     if( lwhp->file_path )
         lw_freep( &lwhp->file_path );
+    lw_freep( &lwhp->format_name );
+    return -1;
+}
+
+/*****************************************************************************
+ * Shared index registry
+ *****************************************************************************/
+/* The parsed index of a file is registered here and borrowed by the handlers which open the same file
+ * for the same streams, so the frame lists are neither parsed nor allocated again.
+ * The output options such as repeat control and VFR->CFR are applied by each handler after borrowing.
+ * Creating the frame order list is not idempotent since it settles the field info and the flags in the video frame
+ * list, e.g. marks a field whose counterpart is missing, so the registry keeps the video frame list as it was before
+ * and each handler creates its frame order list from a copy of it. The settled frame list depends on the repeat
+ * option only, so the copy is replaced with the one settled by another handler with the same repeat option if any. */
+struct lwlibav_shared_index_tag
+{
+    lwlibav_shared_index_t        *next;
+    int                            ref_count;
+    /* the identity of the opened file */
+    char                          *file_path;
+    int64_t                        file_size;
+    int64_t                        file_mtime;
+    unsigned                       file_hash;
+    /* the stream selection which the index was made with */
+    int                            force_video;
+    int                            force_video_index;
+    int                            force_audio;
+    int                            force_audio_index;
+    /* the parsed index, which is never modified once registered
+     * The video frame list in vdh is the one before creating the frame order list. */
+    lwlibav_file_handler_t         lwh;
+    lwlibav_video_decode_handler_t vdh;
+    video_frame_info_t            *settled_frame_list[2];   /* the video frame lists settled without and with the repeat flags */
+    lwlibav_audio_decode_handler_t adh;
+    uint64_t                       output_channel_layout;
+    enum AVSampleFormat            output_sample_format;
+    int                            output_sample_rate;
+    int                            output_bits_per_sample;
+};
+
+static lwlibav_shared_index_t *shared_index_list = NULL;
+
+void lwlibav_setup_index_registry
+(
+    void
+)
+{
+    if( !shared_index_mutex )
+        shared_index_mutex = lw_mutex_create();
+}
+
+static void free_shared_index
+(
+    lwlibav_shared_index_t *sip
+)
+{
+    free_extradata_entries( &sip->vdh.exh );
+    lw_free( sip->vdh.frame_list );
+    lw_free( sip->settled_frame_list[0] );
+    lw_free( sip->settled_frame_list[1] );
+    lw_free( sip->vdh.order_converter );
+    lw_free( sip->vdh.rap_list );
+    av_free( sip->vdh.index_entries );
+    free_extradata_entries( &sip->adh.exh );
+    lw_free( sip->adh.frame_list );
+    av_free( sip->adh.index_entries );
+    lw_free( sip->lwh.file_path );
+    lw_free( sip->file_path );
+    lw_free( sip );
+}
+
+/* Return the key of the registry for the file and the stream selection.
+ * Return NULL if the file is not accessible. */
+static lwlibav_shared_index_t *create_shared_index_key
+(
+    lwlibav_option_t *opt
+)
+{
+    lwlibav_shared_index_t *sip = (lwlibav_shared_index_t *)lw_malloc_zero( sizeof(lwlibav_shared_index_t) );
+    if( !sip )
+        return NULL;
+    sip->file_path = concatenate_path( opt->file_path, "" );
+    if( !sip->file_path
+     || get_file_status( sip->file_path, &sip->file_size, &sip->file_mtime ) )
+    {
+        lw_free( sip->file_path );
+        lw_free( sip );
+        return NULL;
+    }
+    sip->file_hash         = xxhash_file( sip->file_path, sip->file_size );
+    sip->force_video       = opt->force_video;
+    sip->force_video_index = opt->force_video_index;
+    sip->force_audio       = opt->force_audio;
+    sip->force_audio_index = opt->force_audio_index;
+    return sip;
+}
+
+/* Return 1 if the registered index has the stream selected by the forcing option, otherwise 0.
+ * The stream chosen by default is known only by the selection the index was made with. */
+static int has_shared_stream
+(
+    int has_stream,
+    int stream_index,
+    int registered_force,
+    int registered_force_index,
+    int force,
+    int force_index
+)
+{
+    if( force && has_stream && stream_index == force_index )
+        return 1;
+    return registered_force == force && registered_force_index == force_index;
+}
+
+/* Return the index of the settled video frame list for the repeat option. */
+static inline int get_settled_frame_list_index
+(
+    lwlibav_option_t *opt
+)
+{
+    /* VFR->CFR conversion disables the repeat flags. */
+    return opt->apply_repeat_flag && !opt->vfr2cfr.active;
+}
+
+static lwlibav_shared_index_t *find_shared_index
+(
+    lwlibav_shared_index_t *key
+)
+{
+    for( lwlibav_shared_index_t *sip = shared_index_list; sip; sip = sip->next )
+        if( sip->file_size  == key->file_size
+         && sip->file_mtime == key->file_mtime
+         && sip->file_hash  == key->file_hash
+         && !strcmp( sip->file_path, key->file_path )
+         && has_shared_stream( !!sip->vdh.frame_list, sip->vdh.stream_index,
+                               sip->force_video, sip->force_video_index,
+                               key->force_video, key->force_video_index )
+            /* The audio stream is not needed if not indexed by the request. */
+         && (key->force_audio_index == -2
+          || has_shared_stream( !!sip->adh.frame_list, sip->adh.stream_index,
+                                sip->force_audio, sip->force_audio_index,
+                                key->force_audio, key->force_audio_index )) )
+            return sip;
+    return NULL;
+}
+
+/* Move the parsed index in the handlers into the registry.
+ * The handlers keep referring to it as the first borrowers. */
+static int register_shared_index
+(
+    lwlibav_shared_index_t         *sip,
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lwlibav_option_t               *opt
+)
+{
+    int has_video = vdhp->stream_index >= 0 && vdhp->frame_list;
+    int has_audio = adhp->stream_index >= 0 && adhp->frame_list;
+    /* The video frame list before creating the frame order list is needed for the other handlers. */
+    if( (!has_video && !has_audio) || (has_video && !vdhp->initial_frame_list) )
+        return -1;
+    sip->lwh             = *lwhp;
+    sip->lwh.file_path   = concatenate_path( lwhp->file_path, "" );
+    sip->lwh.format_name = NULL;
+    if( !sip->lwh.file_path )
+        return -1;
+    /* Take the fields given by the indexing only. The others belong to each handler. */
+    sip->vdh = *vdhp;
+    sip->adh = *adhp;
+    sip->vdh.format               = NULL;
+    sip->vdh.ctx                  = NULL;
+    sip->vdh.frame_buffer         = NULL;
+    sip->vdh.first_valid_frame    = NULL;
+    sip->vdh.movable_frame_buffer = NULL;
+    sip->vdh.cached_frame         = NULL;
+    sip->vdh.index_entries        = NULL;
+    sip->vdh.exh.decoder_pool     = NULL;
+    memset( &sip->vdh.packet,      0, sizeof(AVPacket) );
+    memset( &sip->vdh.frame_cache, 0, sizeof(lw_frame_cache_t) );
+    sip->adh.format               = NULL;
+    sip->adh.ctx                  = NULL;
+    sip->adh.frame_buffer         = NULL;
+    sip->adh.index_entries        = NULL;
+    sip->adh.sequence_list        = NULL;
+    sip->adh.sequence_count       = 0;
+    sip->adh.exh.decoder_pool     = NULL;
+    memset( &sip->adh.packet,       0, sizeof(AVPacket) );
+    memset( &sip->adh.alter_packet, 0, sizeof(AVPacket) );
+    memset( &sip->adh.pcm_cache,    0, sizeof(lw_pcm_cache_t) );
+    sip->adh.bulk_packets         = NULL;
+    sip->adh.bulk_frames          = NULL;
+    sip->adh.bulk_capacity        = 0;
+    sip->vdh.initial_frame_list   = NULL;
+    if( has_video )
+        sip->vdh.frame_list = vdhp->initial_frame_list;
+    else
+    {
+        memset( &sip->vdh.exh, 0, sizeof(lwlibav_extradata_handler_t) );
+        sip->vdh.frame_list      = NULL;
+        sip->vdh.order_converter = NULL;
+        sip->vdh.rap_list        = NULL;
+    }
+    if( !has_audio )
+    {
+        memset( &sip->adh.exh, 0, sizeof(lwlibav_extradata_handler_t) );
+        sip->adh.frame_list = NULL;
+    }
+    /* The index entries are taken over by the demuxer of each handler, so the registry keeps its own copy. */
+    if( has_video && vdhp->index_entries )
+    {
+        sip->vdh.index_entries = (AVIndexEntry *)av_memdup( vdhp->index_entries, vdhp->index_entries_count * sizeof(AVIndexEntry) );
+        if( !sip->vdh.index_entries )
+            goto fail;
+    }
+    if( has_audio && adhp->index_entries )
+    {
+        sip->adh.index_entries = (AVIndexEntry *)av_memdup( adhp->index_entries, adhp->index_entries_count * sizeof(AVIndexEntry) );
+        if( !sip->adh.index_entries )
+            goto fail;
+    }
+    sip->output_channel_layout  = aohp->output_channel_layout;
+    sip->output_sample_format   = aohp->output_sample_format;
+    sip->output_sample_rate     = aohp->output_sample_rate;
+    sip->output_bits_per_sample = aohp->output_bits_per_sample;
+    /* Now the registry owns the frame lists. */
+    sip->ref_count = 0;
+    if( has_video )
+    {
+        sip->settled_frame_list[ get_settled_frame_list_index( opt ) ] = vdhp->frame_list;
+        vdhp->shared_index       = 1;
+        vdhp->shared_index_ref   = sip;
+        vdhp->initial_frame_list = NULL;
+        ++sip->ref_count;
+    }
+    if( has_audio )
+    {
+        adhp->shared_index     = 1;
+        adhp->shared_index_ref = sip;
+        ++sip->ref_count;
+    }
+    sip->next         = shared_index_list;
+    shared_index_list = sip;
+    return 0;
+fail:
+    /* The frame lists still belong to the handlers. */
+    av_freep( &sip->vdh.index_entries );
+    av_freep( &sip->adh.index_entries );
+    memset( &sip->vdh, 0, sizeof(lwlibav_video_decode_handler_t) );
+    memset( &sip->adh, 0, sizeof(lwlibav_audio_decode_handler_t) );
+    lw_freep( &sip->lwh.file_path );
+    return -1;
+}
+
+/* Set up the handlers with the registered index, and apply the output options to them. */
+static int borrow_shared_index
+(
+    lwlibav_shared_index_t         *sip,
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lwlibav_option_t               *opt
+)
+{
+    int has_video = !!sip->vdh.frame_list;
+    int has_audio = !!sip->adh.frame_list;
+    /* The registered audio stream is left to the others if the request does not index audio. */
+    int skip_audio = has_audio && opt->force_audio_index == -2;
+    if( skip_audio )
+        has_audio = 0;
+    AVIndexEntry       *video_entries = NULL;
+    AVIndexEntry       *audio_entries = NULL;
+    char               *file_path     = NULL;
+    video_frame_info_t *frame_list    = NULL;
+    if( has_video )
+    {
+        /* The frame order list is created from a copy of the frame list before creating any. */
+        frame_list = (video_frame_info_t *)lw_memdup( sip->vdh.frame_list, (sip->vdh.frame_count + 1) * sizeof(video_frame_info_t) );
+        if( !frame_list )
+            goto fail;
+    }
+    if( sip->vdh.index_entries )
+    {
+        video_entries = (AVIndexEntry *)av_memdup( sip->vdh.index_entries, sip->vdh.index_entries_count * sizeof(AVIndexEntry) );
+        if( !video_entries )
+            goto fail;
+    }
+    if( has_audio && sip->adh.index_entries )
+    {
+        audio_entries = (AVIndexEntry *)av_memdup( sip->adh.index_entries, sip->adh.index_entries_count * sizeof(AVIndexEntry) );
+        if( !audio_entries )
+            goto fail;
+    }
+    if( !lwhp->file_path && !(file_path = concatenate_path( sip->lwh.file_path, "" )) )
+        goto fail;
+    if( file_path )
+        lwhp->file_path = file_path;
+    lwhp->format_flags = sip->lwh.format_flags;
+    lwhp->raw_demuxer  = sip->lwh.raw_demuxer;
+    lwhp->av_gap       = 0;
+    /* Keep the fields set up by the caller before the indexing. */
+    lwlibav_video_decode_handler_t video_caller = *vdhp;
+    *vdhp = sip->vdh;
+    vdhp->lh                      = video_caller.lh;
+    vdhp->preferred_decoder_names = video_caller.preferred_decoder_names;
+    vdhp->prefer_hw_decoder       = video_caller.prefer_hw_decoder;
+    vdhp->frame_buffer            = video_caller.frame_buffer;
+    vdhp->forward_seek_threshold  = video_caller.forward_seek_threshold;
+    vdhp->seek_mode               = video_caller.seek_mode;
+    vdhp->frame_cache             = video_caller.frame_cache;
+    vdhp->cached_frame            = video_caller.cached_frame;
+    vdhp->gop_retention           = video_caller.gop_retention;
+    vdhp->lookahead_depth         = video_caller.lookahead_depth;
+    vdhp->prefetch_depth          = video_caller.prefetch_depth;
+    vdhp->index_entries           = video_entries;
+    vdhp->exh.decoder_pool        = video_caller.exh.decoder_pool;
+    vdhp->shared_index            = 1;
+    vdhp->shared_index_ref        = has_video ? sip : NULL;
+    if( skip_audio )
+        /* Same as the index which does not have the audio stream. */
+        adhp->stream_index = -2;
+    else
+    {
+        lwlibav_audio_decode_handler_t audio_caller = *adhp;
+        *adhp = sip->adh;
+        adhp->lh                      = audio_caller.lh;
+        adhp->preferred_decoder_names = audio_caller.preferred_decoder_names;
+        adhp->prefer_hw_decoder       = audio_caller.prefer_hw_decoder;
+        adhp->frame_buffer            = audio_caller.frame_buffer;
+        adhp->pcm_cache               = audio_caller.pcm_cache;
+        adhp->index_entries           = audio_entries;
+        adhp->exh.decoder_pool        = audio_caller.exh.decoder_pool;
+        adhp->shared_index            = 1;
+        adhp->shared_index_ref        = has_audio ? sip : NULL;
+        aohp->output_channel_layout  = sip->output_channel_layout;
+        aohp->output_sample_format   = sip->output_sample_format;
+        aohp->output_sample_rate     = sip->output_sample_rate;
+        aohp->output_bits_per_sample = sip->output_bits_per_sample;
+    }
+    sip->ref_count += has_video + has_audio;
+    /* The output timing depends on the options of each handler. */
+    if( has_video )
+    {
+        int settled_index = get_settled_frame_list_index( opt );
+        vdhp->frame_list = frame_list;
+        /* Create the repeat control info. */
+        create_video_frame_order_list( vdhp, vohp, opt );
+        /* Exclude invisible frames from the output handler. */
+        uint32_t invisible_count = 0;
+        for( uint32_t i = 1; i <= vdhp->frame_count; i++ )
+            if( vdhp->frame_list[i].flags & LW_VFRAME_FLAG_INVISIBLE )
+                ++invisible_count;
+        create_video_visible_frame_list( vdhp, vohp, invisible_count );
+        /* Share the frame list settled in the same way if any. */
+        if( sip->settled_frame_list[settled_index] )
+        {
+            vdhp->frame_list = sip->settled_frame_list[settled_index];
+            lw_free( frame_list );
+        }
+        else
+            sip->settled_frame_list[settled_index] = frame_list;
+    }
+    if( has_audio && has_video && opt->av_sync )
+    {
+        /* The sample rate of the first audio frame is the base of A/V gap. */
+        int sample_rate = 0;
+        for( uint32_t i = 1; i <= adhp->frame_count && sample_rate == 0; i++ )
+            sample_rate = adhp->frame_list[i].sample_rate;
+        lwhp->av_gap = calculate_av_gap( vdhp, vohp, adhp, sample_rate );
+    }
+    return 0;
+fail:
+    av_free( video_entries );
+    av_free( audio_entries );
+    lw_free( file_path );
+    lw_free( frame_list );
+    return -1;
+}
+
+void lwlibav_release_shared_index
+(
+    lwlibav_shared_index_t *sip
+)
+{
+    lw_mutex_lock( shared_index_mutex );
+    if( --sip->ref_count == 0 )
+    {
+        lwlibav_shared_index_t **prev = &shared_index_list;
+        while( *prev != sip )
+            prev = &(*prev)->next;
+        *prev = sip->next;
+        free_shared_index( sip );
+    }
+    lw_mutex_unlock( shared_index_mutex );
+}
+
+int lwlibav_construct_index
+(
+    lwlibav_file_handler_t         *lwhp,
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lw_log_handler_t               *lhp,
+    lwlibav_option_t               *opt,
+    progress_indicator_t           *indicator,
+    progress_handler_t             *php
+)
+{
+    /* The registry is available only if set up by the application. */
+    lwlibav_shared_index_t *key = shared_index_mutex ? create_shared_index_key( opt ) : NULL;
+    if( key )
+    {
+        lw_mutex_lock( shared_index_mutex );
+        lwlibav_shared_index_t *sip = find_shared_index( key );
+        int ret = sip ? borrow_shared_index( sip, lwhp, vdhp, vohp, adhp, aohp, opt ) : -1;
+        lw_mutex_unlock( shared_index_mutex );
+        if( ret == 0 )
+        {
+            free_shared_index( key );
+            lwhp->threads = opt->threads;
+            return 0;
+        }
+    }
+    int ret = construct_index( lwhp, vdhp, vohp, adhp, aohp, lhp, opt, indicator, php );
+    if( key )
+    {
+        int registered = 0;
+        if( ret == 0 )
+        {
+            lw_mutex_lock( shared_index_mutex );
+            registered = (register_shared_index( key, lwhp, vdhp, adhp, aohp, opt ) == 0);
+            lw_mutex_unlock( shared_index_mutex );
+        }
+        if( !registered )
+            free_shared_index( key );
+    }
+    /* The copy for the registry is useless if not registered. */
+    lw_freep( &vdhp->initial_frame_list );
+    return ret;
+}
+
+static int get_video_metadata
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_index_metadata_t       *metadata
+)
+{
+    lwlibav_stream_metadata_t *smp = &metadata->video;
+    if( vdhp->stream_index < 0 || vdhp->frame_count == 0 || !vdhp->frame_list )
+        return 0;
+    smp->stream_index = vdhp->stream_index;
+    smp->codec_id    = vdhp->codec_id;
+    smp->time_base   = vdhp->time_base;
+    smp->frame_count = vdhp->frame_count;
+    smp->duration    = vdhp->stream_duration;
+    smp->timestamps  = (int64_t  *)lw_malloc_zero( vdhp->frame_count * sizeof(int64_t) );
+    smp->keyframes   = (uint32_t *)lw_malloc_zero( vdhp->frame_count * sizeof(uint32_t) );
+    if( !smp->timestamps || !smp->keyframes )
+        return -1;
+    for( uint32_t i = 1; i <= vdhp->frame_count; i++ )
+    {
+        video_frame_info_t *info = &vdhp->frame_list[i];
+        smp->timestamps[i - 1] = info->pts != AV_NOPTS_VALUE ? info->pts : info->dts;
+        if( info->flags & LW_VFRAME_FLAG_KEY )
+            smp->keyframes[ smp->keyframe_count ++ ] = i - 1;
+    }
+    metadata->width   = vdhp->initial_width;
+    metadata->height  = vdhp->initial_height;
+    metadata->pix_fmt = vdhp->initial_pix_fmt;
+    return 0;
+}
+
+static int get_audio_metadata
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    lwlibav_index_metadata_t       *metadata
+)
+{
+    lwlibav_stream_metadata_t *smp = &metadata->audio;
+    if( adhp->stream_index < 0 || adhp->frame_count == 0 || !adhp->frame_list )
+        return 0;
+    smp->stream_index = adhp->stream_index;
+    smp->codec_id    = adhp->codec_id;
+    smp->time_base   = adhp->time_base;
+    smp->frame_count = adhp->frame_count;
+    smp->timestamps  = (int64_t  *)lw_malloc_zero( adhp->frame_count * sizeof(int64_t) );
+    smp->keyframes   = (uint32_t *)lw_malloc_zero( adhp->frame_count * sizeof(uint32_t) );
+    if( !smp->timestamps || !smp->keyframes )
+        return -1;
+    for( uint32_t i = 1; i <= adhp->frame_count; i++ )
+    {
+        audio_frame_info_t *info = &adhp->frame_list[i];
+        smp->timestamps[i - 1] = info->pts != AV_NOPTS_VALUE ? info->pts : info->dts;
+        if( info->keyframe )
+            smp->keyframes[ smp->keyframe_count ++ ] = i - 1;
+    }
+    metadata->sample_rate    = aohp->output_sample_rate;
+    metadata->channel_layout = aohp->output_channel_layout;
+    metadata->sample_count   = lwlibav_audio_count_overall_pcm_samples( adhp, aohp->output_sample_rate );
+    if( metadata->sample_rate > 0 )
+    {
+        AVRational sample_time_base = { 1, metadata->sample_rate };
+        smp->duration = av_rescale_q( metadata->sample_count, sample_time_base, adhp->time_base );
+    }
+    return 0;
+}
+
+int lwlibav_get_index_metadata
+(
+    lwlibav_option_t         *opt,
+    lwlibav_index_metadata_t *metadata
+)
+{
+    memset( metadata, 0, sizeof(lwlibav_index_metadata_t) );
+    metadata->video.stream_index = -1;
+    metadata->audio.stream_index = -1;
+    lwlibav_file_handler_t          lwh  = { 0 };
+    lwlibav_video_decode_handler_t *vdhp = lwlibav_video_alloc_decode_handler();
+    lwlibav_video_output_handler_t *vohp = lwlibav_video_alloc_output_handler();
+    lwlibav_audio_decode_handler_t *adhp = lwlibav_audio_alloc_decode_handler();
+    lwlibav_audio_output_handler_t *aohp = lwlibav_audio_alloc_output_handler();
+    if( !vdhp || !vohp || !adhp || !aohp )
+        goto fail;
+    /* Borrow the index parsed already if any, otherwise parse the index file.
+     * Unlike lwlibav_construct_index(), never fall back on indexing the input file,
+     * which opens the demuxer and the decoders. */
+    int ret = -1;
+    lwlibav_shared_index_t *key = shared_index_mutex ? create_shared_index_key( opt ) : NULL;
+    if( key )
+    {
+        lw_mutex_lock( shared_index_mutex );
+        lwlibav_shared_index_t *sip = find_shared_index( key );
+        ret = sip ? borrow_shared_index( sip, &lwh, vdhp, vohp, adhp, aohp, opt ) : -1;
+        lw_mutex_unlock( shared_index_mutex );
+        free_shared_index( key );
+    }
+    if( ret < 0 && open_index_file( &lwh, vdhp, vohp, adhp, aohp, opt, NULL, 1 ) < 0 )
+        goto fail;
+    if( get_video_metadata( vdhp, metadata ) < 0
+     || get_audio_metadata( adhp, aohp, metadata ) < 0 )
+    {
+        lwlibav_cleanup_index_metadata( metadata );
+        goto fail;
+    }
+    lw_free( lwh.file_path );
+    lw_free( lwh.format_name );
+    lwlibav_video_free_decode_handler( vdhp );
+    lwlibav_video_free_output_handler( vohp );
+    lwlibav_audio_free_decode_handler( adhp );
+    lwlibav_audio_free_output_handler( aohp );
+    return 0;
+fail:
+    lw_free( lwh.file_path );
+    lw_free( lwh.format_name );
+    lwlibav_video_free_decode_handler( vdhp );
+    lwlibav_video_free_output_handler( vohp );
+    lwlibav_audio_free_decode_handler( adhp );
+    lwlibav_audio_free_output_handler( aohp );
     return -1;
 }
 
+void lwlibav_cleanup_index_metadata
+(
+    lwlibav_index_metadata_t *metadata
+)
+{
+    if( !metadata )
+        return;
+    lw_freep( &metadata->video.timestamps );
+    lw_freep( &metadata->video.keyframes );
+    lw_freep( &metadata->audio.timestamps );
+    lw_freep( &metadata->audio.keyframes );
+}
+
 int lwlibav_import_av_index_entry
 (
     lwlibav_decode_handler_t *dhp
@@ -27,7 +27,13 @@
 /* index file version
  * This version is bumped when its structure changed so that the lwindex invokes
  * reindexing opened file immediately. */
-#define LWINDEX_INDEX_FILE_VERSION 16
+#define LWINDEX_INDEX_FILE_VERSION 18
+
+/* binary index file version
+ * The binary index file is written next to the text one with the suffix 'b' (e.g. foobar.mkv.lwib).
+ * It holds the parsed frame lists of the active streams as fixed-width records so that opening it
+ * needs no per-record parsing. This version is bumped when its layout changed. */
+#define LWINDEX_BINARY_INDEX_FILE_VERSION 5
 
 typedef struct
 {
@@ -36,12 +42,22 @@ typedef struct
     int         av_sync;
     int         no_create_index;
     const char *index_file_path;
+    int         text_index;         /* 0: write the binary index file only
+                                     * 1: write the text index file too
+                                     *    The binary index file holds the active streams only, so the text one is
+                                     *    needed to open another stream of the same file without reindexing. */
     int         force_video;
     int         force_video_index;
     int         force_audio;
     int         force_audio_index;
+    int         partial_index;      /* 0: index all streams
+                                     * 1: index only the forced stream of each forced type
+                                     *    The index is marked as partial, and saved to the index file for the forced streams. */
     int         apply_repeat_flag;
     int         field_dominance;
+    int         content_hash_stride;    /* 0: check the first and the last 1MiB of the file only
+                                         * N: also hash every N-th 1MiB block of the whole file while indexing,
+                                         *    and require the same hash when opening the index file (1 is the strictest) */
     struct
     {
         int      active;
@@ -50,6 +66,32 @@ typedef struct
     } vfr2cfr;
 } lwlibav_option_t;
 
+/* the metadata of a stream taken from the index */
+typedef struct
+{
+    int            stream_index;    /* -1 if no stream is active */
+    enum AVCodecID codec_id;
+    AVRational     time_base;
+    uint32_t       frame_count;     /* the number of the coded frames */
+    int64_t        duration;        /* in time_base */
+    int64_t       *timestamps;      /* the presentation timestamps of the frames in presentation order in time_base
+                                     * The decoding timestamp substitutes for an unknown one. */
+    uint32_t      *keyframes;       /* the frame numbers of the keyframes, starting from 0 */
+    uint32_t       keyframe_count;
+} lwlibav_stream_metadata_t;
+
+typedef struct
+{
+    lwlibav_stream_metadata_t video;
+    int                       width;            /* the width of the first frame */
+    int                       height;           /* the height of the first frame */
+    enum AVPixelFormat        pix_fmt;          /* the pixel format of the first frame */
+    lwlibav_stream_metadata_t audio;
+    int                       sample_rate;      /* the output sample rate */
+    uint64_t                  channel_layout;   /* the output channel layout */
+    uint64_t                  sample_count;     /* the number of the output PCM samples */
+} lwlibav_index_metadata_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -68,6 +110,29 @@ int lwlibav_construct_index
     progress_handler_t             *php
 );
 
+/* Enable the process-wide registry of the parsed indexes.
+ * Once enabled, lwlibav_construct_index() on the same file for the same streams borrows the index parsed
+ * at first instead of parsing and allocating it again. Call this once before any indexing. */
+void lwlibav_setup_index_registry
+(
+    void
+);
+
+/* Get the metadata of the active streams from the existing index file of 'opt->file_path'.
+ * Neither the demuxer nor any decoder is opened, and the input file is never indexed.
+ * Return 0 if successful, and then the arrays in 'metadata' must be freed by lwlibav_cleanup_index_metadata().
+ * Return -1 if no valid index file is there or failed. */
+int lwlibav_get_index_metadata
+(
+    lwlibav_option_t         *opt,
+    lwlibav_index_metadata_t *metadata
+);
+
+void lwlibav_cleanup_index_metadata
+(
+    lwlibav_index_metadata_t *metadata
+);
+
 int lwlibav_import_av_index_entry
 (
     lwlibav_decode_handler_t *dhp
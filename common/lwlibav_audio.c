@@ -42,6 +42,7 @@ extern "C"
 
 #include "lwlibav_dec.h"
 #include "lwlibav_audio.h"
+#include "pcm_cache.h"
 #include "lwlibav_audio_internal.h"
 
 /*****************************************************************************
@@ -80,7 +81,7 @@ void lwlibav_audio_free_decode_handler
     if( !adhp )
         return;
     lwlibav_extradata_handler_t *exhp = &adhp->exh;
-    if( exhp->entries )
+    if( exhp->entries && !adhp->shared_index )
     {
         for( int i = 0; i < exhp->entry_count; i++ )
             if( exhp->entries[i].extradata )
@@ -88,9 +89,22 @@ void lwlibav_audio_free_decode_handler
         lw_free( exhp->entries );
     }
     av_packet_unref( &adhp->packet );
-    lw_free( adhp->frame_list );
+    if( !adhp->shared_index )
+        lw_free( adhp->frame_list );
+    if( adhp->shared_index_ref )
+        lwlibav_release_shared_index( adhp->shared_index_ref );
+    lw_free( adhp->sequence_list );
+    lw_pcm_cache_clear( &adhp->pcm_cache );
+    for( int i = 0; i < adhp->bulk_capacity; i++ )
+    {
+        av_packet_free( &adhp->bulk_packets[i] );
+        av_frame_free( &adhp->bulk_frames[i] );
+    }
+    lw_free( adhp->bulk_packets );
+    lw_free( adhp->bulk_frames );
     av_free( adhp->index_entries );
     av_frame_free( &adhp->frame_buffer );
+    lw_decoder_pool_destroy( &exhp->decoder_pool );
     avcodec_free_context( &adhp->ctx );
     if( adhp->format )
         lavf_close_file( &adhp->format );
@@ -151,6 +165,15 @@ void lwlibav_audio_set_log_handler
     adhp->lh = *lh;
 }
 
+void lwlibav_audio_set_pcm_cache_size
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    size_t                          max_size
+)
+{
+    lw_pcm_cache_init( &adhp->pcm_cache, max_size );
+}
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -205,7 +228,10 @@ int lwlibav_audio_get_desired_track
                                adhp->preferred_decoder_names, 0, threads ) < 0 )
     {
         av_freep( &adhp->index_entries );
-        lw_freep( &adhp->frame_list );
+        if( adhp->shared_index )
+            adhp->frame_list = NULL;
+        else
+            lw_freep( &adhp->frame_list );
         if( adhp->format )
             lavf_close_file( &adhp->format );
         return -1;
@@ -214,40 +240,94 @@ int lwlibav_audio_get_desired_track
     return 0;
 }
 
-uint64_t lwlibav_audio_count_overall_pcm_samples
+static inline uint64_t resample_sample_count
+(
+    uint64_t pcm_sample_count,
+    int      sample_rate,
+    int      output_sample_rate
+)
+{
+    return output_sample_rate == sample_rate || pcm_sample_count == 0
+         ? pcm_sample_count
+         : (pcm_sample_count * output_sample_rate - 1) / sample_rate + 1;
+}
+
+static inline uint64_t get_sequence_end_position
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    uint32_t                        sequence_number
+)
+{
+    audio_sequence_info_t *sequence = &adhp->sequence_list[sequence_number];
+    uint32_t next_frame_number = sequence_number + 1 < adhp->sequence_count
+                               ? sequence[1].first_frame_number
+                               : adhp->frame_count + 1;
+    uint64_t pcm_sample_count  = (uint64_t)(next_frame_number - sequence->first_frame_number) * sequence->frame_length;
+    return sequence->start_position
+         + resample_sample_count( pcm_sample_count, sequence->sample_rate, adhp->sequence_output_sample_rate );
+}
+
+/* Split the frames into sequences of the same sample rate and frame length, and accumulate their resampled lengths.
+ * Resampling is rounded up per sequence, so the output position of any frame can be derived from its sequence. */
+static int build_sequence_list
 (
     lwlibav_audio_decode_handler_t *adhp,
     int                             output_sample_rate
 )
 {
-    audio_frame_info_t *frame_list    = adhp->frame_list;
-    int      current_sample_rate      = frame_list[1].sample_rate > 0 ? frame_list[1].sample_rate : adhp->ctx->sample_rate;
-    uint32_t current_frame_length     = frame_list[1].length;
-    uint64_t pcm_sample_count         = 0;
-    uint64_t overall_pcm_sample_count = 0;
+    if( adhp->sequence_list && adhp->sequence_output_sample_rate == output_sample_rate )
+        return 0;
+    audio_frame_info_t *frame_list = adhp->frame_list;
+    uint32_t sequence_count       = 0;
+    int      current_sample_rate  = 0;
+    int      current_frame_length = 0;
     for( uint32_t i = 1; i <= adhp->frame_count; i++ )
-    {
-        if( (current_sample_rate != frame_list[i].sample_rate && frame_list[i].sample_rate > 0)
+        if( i == 1
+         || (current_sample_rate != frame_list[i].sample_rate && frame_list[i].sample_rate > 0)
          || current_frame_length != frame_list[i].length )
         {
-            uint64_t resampled_sample_count = output_sample_rate == current_sample_rate || pcm_sample_count == 0
-                                            ? pcm_sample_count
-                                            : (pcm_sample_count * output_sample_rate - 1) / current_sample_rate + 1;
-            overall_pcm_sample_count += resampled_sample_count;
-            pcm_sample_count     = 0;
             current_sample_rate  = frame_list[i].sample_rate > 0 ? frame_list[i].sample_rate : adhp->ctx->sample_rate;
             current_frame_length = frame_list[i].length;
+            ++sequence_count;
         }
-        pcm_sample_count += frame_list[i].length;
+    audio_sequence_info_t *sequence_list = (audio_sequence_info_t *)lw_malloc_zero( MAX( sequence_count, 1 ) * sizeof(audio_sequence_info_t) );
+    if( !sequence_list )
+    {
+        lw_log_show( &adhp->lh, LW_LOG_FATAL, "Failed to allocate the audio sequence list." );
+        return -1;
     }
-    current_sample_rate = frame_list[ adhp->frame_count ].sample_rate > 0
-                        ? frame_list[ adhp->frame_count ].sample_rate
-                        : adhp->ctx->sample_rate;
-    if( pcm_sample_count )
-        overall_pcm_sample_count += (pcm_sample_count * output_sample_rate - 1) / current_sample_rate + 1;
+    lw_free( adhp->sequence_list );
+    adhp->sequence_list               = sequence_list;
+    adhp->sequence_count              = 0;
+    adhp->sequence_output_sample_rate = output_sample_rate;
+    audio_sequence_info_t *sequence = NULL;
+    for( uint32_t i = 1; i <= adhp->frame_count; i++ )
+        if( !sequence
+         || (sequence->sample_rate != frame_list[i].sample_rate && frame_list[i].sample_rate > 0)
+         || sequence->frame_length != (uint32_t)frame_list[i].length )
+        {
+            uint64_t start_position = sequence ? get_sequence_end_position( adhp, adhp->sequence_count - 1 ) : 0;
+            sequence = &sequence_list[ adhp->sequence_count ];
+            sequence->first_frame_number = i;
+            sequence->frame_length       = frame_list[i].length;
+            sequence->sample_rate        = frame_list[i].sample_rate > 0 ? frame_list[i].sample_rate : adhp->ctx->sample_rate;
+            sequence->start_position     = start_position;
+            ++ adhp->sequence_count;
+        }
+    return 0;
+}
+
+uint64_t lwlibav_audio_count_overall_pcm_samples
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    int                             output_sample_rate
+)
+{
+    if( build_sequence_list( adhp, output_sample_rate ) < 0 || adhp->sequence_count == 0 )
+        return 0;
     /* Return the number of output PCM audio samples. */
-    adhp->pcm_sample_count = overall_pcm_sample_count;
-    return overall_pcm_sample_count;
+    adhp->pcm_sample_count = get_sequence_end_position( adhp, adhp->sequence_count - 1 );
+    return adhp->pcm_sample_count;
 }
 
 static int find_start_audio_frame
@@ -258,36 +338,45 @@ static int find_start_audio_frame
     uint64_t                       *start_offset
 )
 {
+    if( build_sequence_list( adhp, output_sample_rate ) < 0 || adhp->sequence_count == 0 )
+    {
+        adhp->error = 1;
+        return 0;
+    }
     audio_frame_info_t *frame_list = adhp->frame_list;
-    uint32_t frame_number                    = 1;
-    uint64_t current_frame_pos               = 0;
-    uint64_t next_frame_pos                  = 0;
-    int      current_sample_rate             = frame_list[frame_number].sample_rate > 0 ? frame_list[frame_number].sample_rate : adhp->ctx->sample_rate;
-    int      current_frame_length            = frame_list[frame_number].length;
-    uint64_t resampled_sample_count          = 0;   /* the number of accumulated PCM samples after resampling per sequence */
-    uint64_t pcm_sample_count                = 0;   /* the number of accumulated PCM samples before resampling per sequence */
-    uint64_t prior_sequences_resampled_count = 0;   /* the number of accumulated PCM samples of all prior sequences */
-    do
+    /* Find the last sequence starting at or before the requested position. */
+    uint32_t lo = 0;
+    uint32_t hi = adhp->sequence_count - 1;
+    while( lo < hi )
     {
-        current_frame_pos = next_frame_pos;
-        if( (current_sample_rate != frame_list[frame_number].sample_rate && frame_list[frame_number].sample_rate > 0)
-         || current_frame_length != frame_list[frame_number].length )
-        {
-            /* Encountered a new sequence. */
-            prior_sequences_resampled_count += resampled_sample_count;
-            pcm_sample_count = 0;
-            current_sample_rate  = frame_list[frame_number].sample_rate > 0 ? frame_list[frame_number].sample_rate : adhp->ctx->sample_rate;
-            current_frame_length = frame_list[frame_number].length;
-        }
-        pcm_sample_count += (uint64_t)current_frame_length;
-        resampled_sample_count = output_sample_rate == current_sample_rate || pcm_sample_count == 0
-                               ? pcm_sample_count
-                               : (pcm_sample_count * output_sample_rate - 1) / current_sample_rate + 1;
-        next_frame_pos = prior_sequences_resampled_count + resampled_sample_count;
-        if( start_frame_pos < next_frame_pos )
-            break;
-        ++frame_number;
-    } while( frame_number <= adhp->frame_count );
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if( adhp->sequence_list[mid].start_position <= start_frame_pos )
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    audio_sequence_info_t *sequence = &adhp->sequence_list[lo];
+    uint32_t sequence_frame_count = (lo + 1 < adhp->sequence_count ? sequence[1].first_frame_number : adhp->frame_count + 1)
+                                  - sequence->first_frame_number;
+    /* Find the first frame in the sequence which ends after the requested position.
+     * If none, the position is beyond the last frame. */
+    uint64_t offset = start_frame_pos - sequence->start_position;
+    uint32_t k_lo   = 0;
+    uint32_t k_hi   = sequence_frame_count;
+    while( k_lo < k_hi )
+    {
+        uint32_t mid = k_lo + (k_hi - k_lo) / 2;
+        if( offset < resample_sample_count( (uint64_t)(mid + 1) * sequence->frame_length, sequence->sample_rate, output_sample_rate ) )
+            k_hi = mid;
+        else
+            k_lo = mid + 1;
+    }
+    uint32_t frame_number = sequence->first_frame_number + k_lo;
+    if( k_lo == sequence_frame_count )
+        --k_lo;
+    uint64_t current_frame_pos = sequence->start_position
+                               + resample_sample_count( (uint64_t)k_lo * sequence->frame_length, sequence->sample_rate, output_sample_rate );
+    int current_sample_rate = sequence->sample_rate;
     *start_offset = start_frame_pos - current_frame_pos;
     if( *start_offset && current_sample_rate != output_sample_rate )
         *start_offset = (*start_offset * current_sample_rate - 1) / output_sample_rate + 1;
@@ -494,7 +583,166 @@ retry_seek:;
 #undef MAX_ERROR_COUNT
 }
 
-uint64_t lwlibav_audio_get_pcm_samples
+#define AUDIO_BULK_FRAMES_PER_DECODER 16
+
+/* Return the number of the frames from 'frame_number' to be decoded in bulk for the rest of the request.
+ * The frame expected to be needed only partly is left to the serial decoding,
+ * so that the demuxer does not get ahead of the output and the next read can continue from there. */
+static uint32_t count_bulk_decodable_frames
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    uint32_t                        frame_number
+)
+{
+    if( aohp->decode_threads <= 1
+     || adhp->exh.delay_count
+     || frame_number > adhp->frame_count
+     || !lw_check_audio_bulk_decodable( adhp->ctx ) )
+        return 0;
+    audio_frame_info_t *first = &adhp->frame_list[frame_number];
+    if( first->sample_rate <= 0 || aohp->output_sample_rate <= 0 )
+        return 0;
+    /* The input samples needed for the rest of the request. Resampling delays the output, so this never overestimates. */
+    uint64_t wanted_length = av_rescale_rnd( aohp->request_length, first->sample_rate, aohp->output_sample_rate, AV_ROUND_DOWN )
+                           + aohp->output_sample_offset;
+    uint64_t total_length  = 0;
+    uint32_t max_count     = (uint32_t)aohp->decode_threads * AUDIO_BULK_FRAMES_PER_DECODER;
+    uint32_t count         = 0;
+    for( uint32_t i = frame_number; i <= adhp->frame_count && count < max_count; i++ )
+    {
+        audio_frame_info_t *info = &adhp->frame_list[i];
+        if( info->extradata_index != adhp->exh.current_index
+         || info->sample_rate     != first->sample_rate
+         || info->length          <= 0 )
+            break;
+        total_length += info->length;
+        if( total_length >= wanted_length )
+            break;
+        ++count;
+    }
+    /* Too few frames are not worth waking up the decoders. */
+    return count >= 2 * (uint32_t)aohp->decode_threads ? count : 0;
+}
+
+static int alloc_bulk_buffers
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    int                             capacity
+)
+{
+    if( capacity <= adhp->bulk_capacity )
+        return 0;
+    AVPacket **packets = (AVPacket **)lw_malloc_zero( capacity * sizeof(AVPacket *) );
+    AVFrame  **frames  = (AVFrame  **)lw_malloc_zero( capacity * sizeof(AVFrame *) );
+    if( !packets || !frames )
+    {
+        lw_free( packets );
+        lw_free( frames );
+        return -1;
+    }
+    for( int i = 0; i < adhp->bulk_capacity; i++ )
+    {
+        packets[i] = adhp->bulk_packets[i];
+        frames [i] = adhp->bulk_frames [i];
+    }
+    lw_free( adhp->bulk_packets );
+    lw_free( adhp->bulk_frames );
+    adhp->bulk_packets = packets;
+    adhp->bulk_frames  = frames;
+    for( ; adhp->bulk_capacity < capacity; adhp->bulk_capacity++ )
+    {
+        int i = adhp->bulk_capacity;
+        if( !(packets[i] = av_packet_alloc()) || !(frames[i] = av_frame_alloc()) )
+        {
+            av_packet_free( &packets[i] );
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Read 'count' packets from 'frame_number', decode them in bulk and output their samples in order.
+ * Each packet the pool decoders leave is decoded by adhp->ctx as the serial decoding does, so the output is identical.
+ * The bulk buffers must be able to hold 'count' packets.
+ * Return the number of the packets consumed, which is 0 at the end of the stream. Then 'pkt' is left as a null packet.
+ * '*read_ahead' is set to 1 if some packets have been read but not consumed. */
+static uint32_t output_pcm_samples_in_bulk
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    uint32_t                        frame_number,
+    uint32_t                        count,
+    AVPacket                       *pkt,
+    uint8_t                       **buf,
+    uint64_t                       *output_length,
+    enum audio_output_flag         *output_flags,
+    int                            *read_ahead
+)
+{
+    *read_ahead = 0;
+    uint32_t read_count = 0;
+    while( read_count < count )
+    {
+        AVPacket *bulk_pkt = adhp->bulk_packets[read_count];
+        if( lwlibav_get_av_frame( adhp->format, adhp->stream_index, frame_number + read_count, bulk_pkt ) )
+            break;
+        ++read_count;
+    }
+    if( read_count == 0 )
+    {
+        /* Null packet */
+        av_packet_unref( pkt );
+        av_init_packet( pkt );
+        make_null_packet( pkt );
+        return 0;
+    }
+    if( lw_decode_audio_packets_in_bulk( aohp, adhp->ctx, adhp->exh.current_index,
+                                         adhp->bulk_packets, adhp->bulk_frames, (int)read_count ) < 0 )
+    {
+        lw_log_show( &adhp->lh, LW_LOG_WARNING, "Failed to set up the audio decoders for bulk reads. Audio is decoded on a single decoder." );
+        aohp->decode_threads = 1;
+        for( uint32_t i = 0; i < read_count; i++ )
+            av_frame_unref( adhp->bulk_frames[i] );
+    }
+    uint32_t consumed_count = 0;
+    while( consumed_count < read_count )
+    {
+        AVPacket *bulk_pkt = adhp->bulk_packets[consumed_count];
+        AVFrame  *frame    = adhp->bulk_frames [consumed_count];
+        *output_flags = AUDIO_OUTPUT_NO_FLAGS;
+        if( frame->extended_data && frame->extended_data[0] )
+        {
+            *output_length += output_pcm_samples_from_frame( aohp, adhp->ctx, frame, buf, output_flags );
+            *output_flags  |= AUDIO_DECODER_RECEIVED_PACKET;
+            /* Keep the last output frame as the serial decoding does, so that the next read flushes the resampler. */
+            av_frame_unref( adhp->frame_buffer );
+            av_frame_move_ref( adhp->frame_buffer, frame );
+        }
+        else
+        {
+            *output_length += output_pcm_samples_from_packet( aohp, adhp->ctx, bulk_pkt, adhp->frame_buffer, buf, output_flags );
+            if( *output_flags & AUDIO_DECODER_DELAY )
+                ++ adhp->exh.delay_count;
+        }
+        av_packet_unref( bulk_pkt );
+        ++consumed_count;
+        if( *output_flags & (AUDIO_RECONFIG_FAILURE | AUDIO_OUTPUT_ENOUGH) )
+            break;
+    }
+    if( consumed_count < read_count )
+    {
+        *read_ahead = 1;
+        for( uint32_t i = consumed_count; i < read_count; i++ )
+        {
+            av_packet_unref( adhp->bulk_packets[i] );
+            av_frame_unref( adhp->bulk_frames[i] );
+        }
+    }
+    return consumed_count;
+}
+
+static uint64_t get_pcm_samples
 (
     lwlibav_audio_decode_handler_t *adhp,
     lwlibav_audio_output_handler_t *aohp,
@@ -513,6 +761,8 @@ uint64_t lwlibav_audio_get_pcm_samples
     AVPacket              *pkt       = &adhp->packet;
     AVPacket              *alter_pkt = &adhp->alter_packet;
     int                    already_gotten;
+    int                    read_ahead      = 0;
+    uint32_t               bulk_count;
     aohp->request_length = wanted_length;
     if( start > 0 && start == adhp->next_pcm_sample_number )
     {
@@ -543,6 +793,8 @@ uint64_t lwlibav_audio_get_pcm_samples
             start_frame_pos = 0;
         }
         frame_number = find_start_audio_frame( adhp, aohp->output_sample_rate, start_frame_pos, &aohp->output_sample_offset );
+        if( adhp->error )
+            return 0;
 retry_seek:
         av_packet_unref( pkt );
         /* Flush audio resampler buffers. */
@@ -594,6 +846,33 @@ retry_seek:
             else
                 goto audio_out;
         }
+        else if( alter_pkt->size <= 0
+              && rap_number == 0
+              && (bulk_count = count_bulk_decodable_frames( adhp, aohp, frame_number )) > 0
+              && alloc_bulk_buffers( adhp, (int)bulk_count ) == 0 )
+        {
+            /* Decode the packets which can be decoded independently in parallel. */
+            uint32_t consumed_count = output_pcm_samples_in_bulk( adhp, aohp, frame_number, bulk_count, pkt,
+                                                                  (uint8_t **)&buf, &output_length, &output_flags, &read_ahead );
+            if( consumed_count > 0 )
+            {
+                frame_number += consumed_count - 1;
+                if( output_flags & AUDIO_RECONFIG_FAILURE )
+                {
+                    adhp->error = 1;
+                    lw_log_show( &adhp->lh, LW_LOG_FATAL,
+                                 "Failed to reconfigure resampler.\n"
+                                 "It is recommended you reopen the file." );
+                    goto audio_out;
+                }
+                if( output_flags & AUDIO_OUTPUT_ENOUGH )
+                    goto audio_out;
+                ++frame_number;
+                continue;
+            }
+            /* Reached the end of the stream. Decode the null packet as below. */
+            make_decodable_packet( alter_pkt, pkt );
+        }
         else if( alter_pkt->size <= 0 )
         {
             /* Getting an audio packet must be after flushing all remaining samples in resampler's FIFO buffer. */
@@ -635,9 +914,52 @@ retry_seek:
 audio_out:
     adhp->next_pcm_sample_number = start + output_length;
     adhp->last_frame_number      = frame_number;
+    if( read_ahead )
+        /* The demuxer is ahead of the last consumed packet. */
+        lwlibav_audio_force_seek( adhp );
     return output_length;
 }
 
+typedef struct
+{
+    lwlibav_audio_decode_handler_t *adhp;
+    lwlibav_audio_output_handler_t *aohp;
+} pcm_decoder_t;
+
+static uint64_t decode_pcm_samples
+(
+    void   *priv,
+    void   *buf,
+    int64_t start,
+    int64_t length
+)
+{
+    pcm_decoder_t *decoder = (pcm_decoder_t *)priv;
+    return get_pcm_samples( decoder->adhp, decoder->aohp, buf, start, length );
+}
+
+uint64_t lwlibav_audio_get_pcm_samples
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    lwlibav_audio_output_handler_t *aohp,
+    void                           *buf,
+    int64_t                         start,
+    int64_t                         wanted_length
+)
+{
+    if( adhp->error )
+        return 0;
+    if( adhp->pcm_cache.max_size == 0 )
+        return get_pcm_samples( adhp, aohp, buf, start, wanted_length );
+    lw_pcm_format_t format;
+    format.channel_layout = aohp->output_channel_layout;
+    format.sample_format  = aohp->output_sample_format;
+    format.sample_rate    = aohp->output_sample_rate;
+    format.block_align    = aohp->output_block_align;
+    pcm_decoder_t decoder = { adhp, aohp };
+    return lw_pcm_cache_get_samples( &adhp->pcm_cache, &format, decode_pcm_samples, &decoder, buf, start, wanted_length );
+}
+
 void set_audio_basic_settings
 (
     lwlibav_decode_handler_t *dhp,
@@ -74,6 +74,14 @@ void lwlibav_audio_set_preferred_decoder_names
     const char                    **preferred_decoder_names
 );
 
+/* Set the memory budget in bytes of the resampled PCM block cache.
+ * The cache is disabled if set to 0. */
+void lwlibav_audio_set_pcm_cache_size
+(
+    lwlibav_audio_decode_handler_t *adhp,
+    size_t                          max_size
+);
+
 void lwlibav_audio_set_codec_context
 (
     lwlibav_audio_decode_handler_t *adhp,
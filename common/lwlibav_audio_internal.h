@@ -32,6 +32,15 @@ typedef struct
     int      sample_rate;
 } audio_frame_info_t;
 
+/* consecutive frames with the same sample rate and frame length */
+typedef struct
+{
+    uint32_t first_frame_number;
+    uint32_t frame_length;
+    int      sample_rate;
+    uint64_t start_position;    /* the number of output PCM samples of all prior sequences */
+} audio_sequence_info_t;
+
 struct lwlibav_audio_decode_handler_tag
 {
     /* common */
@@ -60,4 +69,13 @@ struct lwlibav_audio_decode_handler_tag
     uint32_t            last_frame_number;
     uint64_t            pcm_sample_count;
     uint64_t            next_pcm_sample_number;
+    int                 shared_index;       /* The extradata entries and frame_list are owned by the index registry if set to non-zero. */
+    lwlibav_shared_index_t *shared_index_ref;
+    audio_sequence_info_t *sequence_list;   /* for looking up the frame from the output PCM sample position */
+    uint32_t            sequence_count;
+    int                 sequence_output_sample_rate;    /* the output sample rate which sequence_list is built for */
+    lw_pcm_cache_t      pcm_cache;
+    AVPacket          **bulk_packets;       /* the packets decoded in bulk by the decoders of the output handler */
+    AVFrame           **bulk_frames;
+    int                 bulk_capacity;
 };
@@ -33,6 +33,7 @@ extern "C"
 #endif  /* __cplusplus */
 
 #include "utils.h"
+#include "osdep.h"
 #include "lwlibav_dec.h"
 #include "qsv.h"
 #include "decode.h"
@@ -87,9 +88,24 @@ void lwlibav_update_configuration
     AVCodecParameters *codecpar          = dhp->format->streams[ dhp->stream_index ]->codecpar;
     void              *app_specific      = dhp->ctx->opaque;
     const int          thread_count      = dhp->ctx->thread_count;
-    /* Close the decoder here. */
+    /* Keep the decoder and the parameters here for switching back to the current configuration later. */
+    if( !dhp->error
+     && exhp->current_index >= 0 && exhp->current_index < exhp->entry_count )
+        lw_decoder_pool_put( &exhp->decoder_pool, exhp->current_index, dhp->ctx->codec, codecpar,
+                             dhp->ctx->width, dhp->ctx->height );
     dhp->ctx->opaque = NULL;
     avcodec_free_context( &dhp->ctx );
+    /* Reopen the decoder set up for the requested configuration before if any.
+     * The parameters it was opened with are restored here, so it needs no setup by actual decoding. */
+    dhp->ctx = lw_decoder_pool_open( exhp->decoder_pool, extradata_index, thread_count, codecpar );
+    if( dhp->ctx )
+    {
+        exhp->current_index   = extradata_index;
+        exhp->delay_count     = 0;
+        dhp->ctx->get_buffer2 = exhp->get_buffer ? exhp->get_buffer : avcodec_default_get_buffer2;
+        dhp->ctx->opaque      = app_specific;
+        return;
+    }
     /* Find an appropriate decoder. */
     const lwlibav_extradata_t *entry = &exhp->entries[extradata_index];
     const AVCodec *codec = find_decoder( entry->codec_id, codecpar, dhp->preferred_decoder_names, dhp->prefer_hw_decoder );
@@ -179,3 +195,197 @@ int lwlibav_get_av_frame
     pkt->size = 0;
     return 1;
 }
+
+/*****************************************************************************
+ * Packet reader
+ *****************************************************************************/
+struct lwlibav_packet_reader_tag
+{
+    AVFormatContext *format;
+    int              stream_index;
+    lw_thread_t      thread;
+    lw_mutex_t       mutex;
+    lw_cond_t        cond;          /* signaled whenever the state of the queue or the demuxer changes */
+    AVPacket       **queue;         /* ring buffer of the packets read ahead */
+    AVPacket        *pending;       /* the packet the demux thread is reading */
+    int              depth;         /* the maximum number of the queued packets */
+    int              head;
+    int              count;
+    int              eof;           /* No more packets until the next seek if set to non-zero. */
+    int              paused;        /* The demuxer is lent to the caller if set to non-zero. */
+    int              reading;       /* The demux thread is using the demuxer if set to non-zero. */
+    int              exit;
+};
+
+static void clear_packet_queue
+(
+    lwlibav_packet_reader_t *reader
+)
+{
+    for( ; reader->count; -- reader->count )
+    {
+        av_packet_unref( reader->queue[ reader->head ] );
+        reader->head = (reader->head + 1) % reader->depth;
+    }
+    reader->head = 0;
+    reader->eof  = 0;
+}
+
+static void *packet_reader_thread
+(
+    void *arg
+)
+{
+    lwlibav_packet_reader_t *reader = (lwlibav_packet_reader_t *)arg;
+    AVPacket *pkt = reader->pending;
+    lw_mutex_lock( reader->mutex );
+    while( !reader->exit )
+    {
+        if( reader->paused || reader->eof || reader->count == reader->depth )
+        {
+            lw_cond_wait( reader->cond, reader->mutex );
+            continue;
+        }
+        reader->reading = 1;
+        lw_mutex_unlock( reader->mutex );
+        /* Demux without the lock so that the decoding thread can take the queued packets meanwhile. */
+        int ret;
+        while( (ret = read_av_frame( reader->format, pkt )) >= 0
+            && pkt->stream_index != reader->stream_index )
+            av_packet_unref( pkt );
+        lw_mutex_lock( reader->mutex );
+        reader->reading = 0;
+        if( reader->paused )
+            /* The caller is going to seek, so this packet is stale. */
+            av_packet_unref( pkt );
+        else if( ret < 0 )
+            reader->eof = 1;
+        else
+        {
+            av_packet_move_ref( reader->queue[ (reader->head + reader->count) % reader->depth ], pkt );
+            ++ reader->count;
+        }
+        lw_cond_broadcast( reader->cond );
+    }
+    lw_mutex_unlock( reader->mutex );
+    return NULL;
+}
+
+lwlibav_packet_reader_t *lwlibav_open_packet_reader
+(
+    AVFormatContext *format_ctx,
+    int              stream_index,
+    int              depth
+)
+{
+    if( depth <= 0 )
+        return NULL;
+    lwlibav_packet_reader_t *reader = (lwlibav_packet_reader_t *)lw_malloc_zero( sizeof(lwlibav_packet_reader_t) );
+    if( !reader )
+        return NULL;
+    reader->format       = format_ctx;
+    reader->stream_index = stream_index;
+    reader->depth        = depth;
+    reader->queue        = (AVPacket **)lw_malloc_zero( depth * sizeof(AVPacket *) );
+    if( !reader->queue )
+        goto fail;
+    for( int i = 0; i < depth; i++ )
+        if( !(reader->queue[i] = av_packet_alloc()) )
+            goto fail;
+    reader->pending = av_packet_alloc();
+    reader->mutex   = lw_mutex_create();
+    reader->cond    = lw_cond_create();
+    if( !reader->pending || !reader->mutex || !reader->cond )
+        goto fail;
+    reader->thread = lw_thread_create( packet_reader_thread, reader );
+    if( !reader->thread )
+        goto fail;
+    return reader;
+fail:
+    lwlibav_close_packet_reader( reader );
+    return NULL;
+}
+
+void lwlibav_close_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+)
+{
+    if( !reader )
+        return;
+    if( reader->thread )
+    {
+        lw_mutex_lock( reader->mutex );
+        reader->exit = 1;
+        lw_cond_broadcast( reader->cond );
+        lw_mutex_unlock( reader->mutex );
+        lw_thread_join( reader->thread );
+    }
+    if( reader->queue )
+    {
+        for( int i = 0; i < reader->depth; i++ )
+            av_packet_free( &reader->queue[i] );
+        lw_free( reader->queue );
+    }
+    av_packet_free( &reader->pending );
+    lw_cond_destroy( reader->cond );
+    lw_mutex_destroy( reader->mutex );
+    lw_free( reader );
+}
+
+void lwlibav_pause_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+)
+{
+    lw_mutex_lock( reader->mutex );
+    reader->paused = 1;
+    while( reader->reading )
+        lw_cond_wait( reader->cond, reader->mutex );
+    clear_packet_queue( reader );
+    lw_mutex_unlock( reader->mutex );
+}
+
+void lwlibav_resume_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+)
+{
+    lw_mutex_lock( reader->mutex );
+    reader->paused = 0;
+    lw_cond_broadcast( reader->cond );
+    lw_mutex_unlock( reader->mutex );
+}
+
+int lwlibav_read_packet
+(
+    lwlibav_packet_reader_t *reader,
+    uint32_t                 frame_number,
+    AVPacket                *pkt
+)
+{
+    lw_mutex_lock( reader->mutex );
+    if( reader->paused )
+    {
+        /* The demuxer belongs to the caller until resumed. */
+        lw_mutex_unlock( reader->mutex );
+        return lwlibav_get_av_frame( reader->format, reader->stream_index, frame_number, pkt );
+    }
+    av_packet_unref( pkt );
+    while( reader->count == 0 && !reader->eof )
+        lw_cond_wait( reader->cond, reader->mutex );
+    if( reader->count == 0 )
+    {
+        lw_mutex_unlock( reader->mutex );
+        /* Return a null packet. */
+        pkt->data = NULL;
+        pkt->size = 0;
+        return 1;
+    }
+    av_packet_move_ref( pkt, reader->queue[ reader->head ] );
+    reader->head = (reader->head + 1) % reader->depth;
+    -- reader->count;
+    lw_cond_broadcast( reader->cond );
+    lw_mutex_unlock( reader->mutex );
+    return 0;
+}
@@ -36,6 +36,12 @@ typedef struct
     int64_t av_gap;
 } lwlibav_file_handler_t;
 
+/* demux thread which reads the packets of a stream ahead of decoding */
+typedef struct lwlibav_packet_reader_tag lwlibav_packet_reader_t;
+
+/* parsed index shared among the handlers which open the same file for the same streams */
+typedef struct lwlibav_shared_index_tag lwlibav_shared_index_t;
+
 typedef struct
 {
     uint8_t            *extradata;
@@ -62,6 +68,7 @@ typedef struct
     lwlibav_extradata_t *entries;
     uint32_t             delay_count;
     int (*get_buffer)( struct AVCodecContext *, AVFrame *, int );
+    struct lw_decoder_pool_tag *decoder_pool;   /* the decoders set up for the other entries, owned by each handler */
 } lwlibav_extradata_handler_t;
 
 typedef struct
@@ -141,6 +148,12 @@ void lwlibav_flush_buffers
     lwlibav_decode_handler_t *dhp
 );
 
+/* Drop a reference to the shared index. The index is freed together with the last reference. */
+void lwlibav_release_shared_index
+(
+    lwlibav_shared_index_t *sip
+);
+
 int lwlibav_get_av_frame
 (
     AVFormatContext *format_ctx,
@@ -149,6 +162,41 @@ int lwlibav_get_av_frame
     AVPacket        *pkt
 );
 
+/* Start reading the packets of 'stream_index' ahead into a queue of up to 'depth' packets.
+ * The demuxer must not be used by others until the reader is closed, except while paused.
+ * Return NULL if failed. */
+lwlibav_packet_reader_t *lwlibav_open_packet_reader
+(
+    AVFormatContext *format_ctx,
+    int              stream_index,
+    int              depth
+);
+
+void lwlibav_close_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+);
+
+/* Stop reading ahead and drop the queued packets.
+ * The demuxer can be used by the caller, e.g. for seeking, until lwlibav_resume_packet_reader() is called. */
+void lwlibav_pause_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+);
+
+void lwlibav_resume_packet_reader
+(
+    lwlibav_packet_reader_t *reader
+);
+
+/* Same as lwlibav_get_av_frame(), but take the packet from the queue. */
+int lwlibav_read_packet
+(
+    lwlibav_packet_reader_t *reader,
+    uint32_t                 frame_number,
+    AVPacket                *pkt
+);
+
 void lwlibav_update_configuration
 (
     lwlibav_decode_handler_t *dhp,
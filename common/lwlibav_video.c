@@ -39,6 +39,8 @@ extern "C"
 #include "video_output.h"
 #include "lwlibav_dec.h"
 #include "lwlibav_video.h"
+#include "frame_cache.h"
+#include "lookahead.h"
 #include "lwlibav_video_internal.h"
 #include "decode.h"
 
@@ -70,6 +72,58 @@ lwlibav_video_decode_handler_t *lwlibav_video_alloc_decode_handler
     return vdhp;
 }
 
+lwlibav_video_decode_handler_t *lwlibav_video_duplicate_decode_handler
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    const char                     *file_path,
+    int                             threads
+)
+{
+    lwlibav_video_decode_handler_t *dup = lwlibav_video_alloc_decode_handler();
+    if( !dup )
+        return NULL;
+    AVFrame *frame_buffer = dup->frame_buffer;
+    *dup = *vdhp;
+    /* The parsed index is read-only after indexing, so share it rather than copy.
+     * Everything on the decoding side is private to the duplicate. */
+    dup->shared_index         = 1;
+    dup->shared_index_ref     = NULL;
+    dup->initial_frame_list   = NULL;
+    dup->packet_reader        = NULL;
+    dup->lookahead            = NULL;
+    dup->format               = NULL;
+    dup->ctx                  = NULL;
+    dup->exh.decoder_pool     = NULL;
+    dup->index_entries        = NULL;
+    dup->frame_buffer         = frame_buffer;
+    dup->first_valid_frame    = NULL;
+    dup->movable_frame_buffer = NULL;
+    dup->last_req_frame       = NULL;
+    dup->last_dec_frame       = NULL;
+    dup->cached_frame         = NULL;
+    dup->output_cached_frame  = 0;
+    memset( &dup->packet,      0, sizeof(AVPacket) );
+    memset( &dup->frame_cache, 0, sizeof(lw_frame_cache_t) );
+    /* lwlibav_import_av_index_entry() takes over the index entries, so they are copied here. */
+    if( vdhp->index_entries )
+    {
+        dup->index_entries = (AVIndexEntry *)av_memdup( vdhp->index_entries,
+                                                        vdhp->index_entries_count * sizeof(AVIndexEntry) );
+        if( !dup->index_entries )
+            goto fail;
+    }
+    if( lwlibav_video_set_frame_cache_size( dup, vdhp->frame_cache.max_size ) < 0
+     || lavf_open_file( &dup->format, file_path, &dup->lh ) < 0
+     || find_and_open_decoder( &dup->ctx, dup->format->streams[ dup->stream_index ]->codecpar,
+                               dup->preferred_decoder_names, dup->prefer_hw_decoder, threads ) < 0 )
+        goto fail;
+    lwlibav_video_force_seek( dup );
+    return dup;
+fail:
+    lwlibav_video_free_decode_handler( dup );
+    return NULL;
+}
+
 lwlibav_video_output_handler_t *lwlibav_video_alloc_output_handler
 (
     void
@@ -78,6 +132,22 @@ lwlibav_video_output_handler_t *lwlibav_video_alloc_output_handler
     return (lwlibav_video_output_handler_t *)lw_malloc_zero( sizeof(lwlibav_video_output_handler_t) );
 }
 
+lwlibav_video_output_handler_t *lwlibav_video_duplicate_output_handler
+(
+    lwlibav_video_output_handler_t *vohp
+)
+{
+    lwlibav_video_output_handler_t *dup = lwlibav_video_alloc_output_handler();
+    if( !dup )
+        return NULL;
+    if( lwlibav_video_copy_output_timing( dup, vohp ) < 0 )
+    {
+        lwlibav_video_free_output_handler( dup );
+        return NULL;
+    }
+    return dup;
+}
+
 void lwlibav_video_free_decode_handler
 (
     lwlibav_video_decode_handler_t *vdhp
@@ -85,8 +155,11 @@ void lwlibav_video_free_decode_handler
 {
     if( !vdhp )
         return;
+    /* The lookahead and demux threads must be stopped before the decoder and the demuxer are closed. */
+    lw_lookahead_destroy( vdhp->lookahead );
+    lwlibav_close_packet_reader( vdhp->packet_reader );
     lwlibav_extradata_handler_t *exhp = &vdhp->exh;
-    if( exhp->entries )
+    if( exhp->entries && !vdhp->shared_index )
     {
         for( int i = 0; i < exhp->entry_count; i++ )
             if( exhp->entries[i].extradata )
@@ -94,13 +167,22 @@ void lwlibav_video_free_decode_handler
         lw_free( exhp->entries );
     }
     av_packet_unref( &vdhp->packet );
-    lw_free( vdhp->frame_list );
-    lw_free( vdhp->order_converter );
-    lw_free( vdhp->keyframe_list );
+    if( !vdhp->shared_index )
+    {
+        lw_free( vdhp->frame_list );
+        lw_free( vdhp->order_converter );
+        lw_free( vdhp->rap_list );
+    }
+    if( vdhp->shared_index_ref )
+        lwlibav_release_shared_index( vdhp->shared_index_ref );
+    lw_free( vdhp->initial_frame_list );
     av_free( vdhp->index_entries );
     av_frame_free( &vdhp->frame_buffer );
     av_frame_free( &vdhp->first_valid_frame );
     av_frame_free( &vdhp->movable_frame_buffer );
+    av_frame_free( &vdhp->cached_frame );
+    lw_frame_cache_clear( &vdhp->frame_cache );
+    lw_decoder_pool_destroy( &exhp->decoder_pool );
     avcodec_free_context( &vdhp->ctx );
     if( vdhp->format )
         lavf_close_file( &vdhp->format );
@@ -196,6 +278,50 @@ void lwlibav_video_set_get_buffer_func
     vdhp->exh.get_buffer = vdhp->ctx->get_buffer2;
 }
 
+void lwlibav_video_set_prefetch_depth
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             prefetch_depth
+)
+{
+    vdhp->prefetch_depth = prefetch_depth;
+}
+
+void lwlibav_video_set_lookahead_depth
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             lookahead_depth
+)
+{
+    vdhp->lookahead_depth = lookahead_depth;
+}
+
+int lwlibav_video_set_frame_cache_size
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    size_t                          max_size
+)
+{
+    if( max_size && !vdhp->cached_frame )
+    {
+        vdhp->cached_frame = av_frame_alloc();
+        if( !vdhp->cached_frame )
+            return -1;
+    }
+    lw_frame_cache_init( &vdhp->frame_cache, max_size );
+    vdhp->output_cached_frame = 0;
+    return 0;
+}
+
+void lwlibav_video_set_gop_retention
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             gop_retention
+)
+{
+    vdhp->gop_retention = gop_retention;
+}
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -252,12 +378,82 @@ AVFrame *lwlibav_video_get_frame_buffer
     lwlibav_video_decode_handler_t *vdhp
 )
 {
-    return vdhp ? vdhp->frame_buffer : NULL;
+    if( !vdhp )
+        return NULL;
+    return vdhp->output_cached_frame ? vdhp->cached_frame : vdhp->frame_buffer;
+}
+
+void lwlibav_video_get_frame_cache_stats
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    uint64_t                       *hits,
+    uint64_t                       *misses
+)
+{
+    *hits   = vdhp ? vdhp->frame_cache.hits   : 0;
+    *misses = vdhp ? vdhp->frame_cache.misses : 0;
+}
+
+uint64_t lwlibav_video_get_saved_decode_count
+(
+    lwlibav_video_decode_handler_t *vdhp
+)
+{
+    return vdhp ? vdhp->frame_cache.retained_hits : 0;
+}
+
+uint32_t lwlibav_video_get_last_frame_number
+(
+    lwlibav_video_decode_handler_t *vdhp
+)
+{
+    if( !vdhp )
+        return 0;
+    /* The decoder position moves on the lookahead thread, so take the one seen by the caller. */
+    return vdhp->lookahead ? lw_lookahead_get_last_request( vdhp->lookahead ) : vdhp->last_frame_number;
 }
 
 /*****************************************************************************
  * Others
  *****************************************************************************/
+int lwlibav_video_copy_output_timing
+(
+    lwlibav_video_output_handler_t *dst,
+    lwlibav_video_output_handler_t *src
+)
+{
+    /* Copy the frame timing only. The scaler and the private handler are set up for each handler. */
+    dst->vfr2cfr              = src->vfr2cfr;
+    dst->cfr_num              = src->cfr_num;
+    dst->cfr_den              = src->cfr_den;
+    dst->repeat_control       = src->repeat_control;
+    dst->repeat_correction_ts = src->repeat_correction_ts;
+    dst->frame_count          = src->frame_count;
+    dst->frame_order_count    = src->frame_order_count;
+    if( src->frame_order_list )
+    {
+        dst->frame_order_list = (lw_video_frame_order_t *)lw_memdup( src->frame_order_list,
+                                                                     (src->frame_order_count + 1) * sizeof(lw_video_frame_order_t) );
+        if( !dst->frame_order_list )
+            return -1;
+    }
+    if( src->cfr_frame_map )
+    {
+        dst->cfr_frame_map = (uint32_t *)lw_memdup( src->cfr_frame_map, (src->frame_count + 1) * sizeof(uint32_t) );
+        if( !dst->cfr_frame_map )
+            return -1;
+    }
+    for( int i = 0; i < REPEAT_CONTROL_CACHE_NUM; i++ )
+        if( src->frame_cache_buffers[i] )
+        {
+            dst->frame_cache_buffers[i] = av_frame_alloc();
+            if( !dst->frame_cache_buffers[i] )
+                return -1;
+            dst->frame_cache_numbers[i] = 0;
+        }
+    return 0;
+}
+
 void lwlibav_video_force_seek
 (
     lwlibav_video_decode_handler_t *vdhp
@@ -282,9 +478,18 @@ int lwlibav_video_get_desired_track
                                vdhp->preferred_decoder_names, vdhp->prefer_hw_decoder, threads ) < 0 )
     {
         av_freep( &vdhp->index_entries );
-        lw_freep( &vdhp->frame_list );
-        lw_freep( &vdhp->order_converter );
-        lw_freep( &vdhp->keyframe_list );
+        if( vdhp->shared_index )
+        {
+            vdhp->frame_list      = NULL;
+            vdhp->order_converter = NULL;
+            vdhp->rap_list        = NULL;
+        }
+        else
+        {
+            lw_freep( &vdhp->frame_list );
+            lw_freep( &vdhp->order_converter );
+            lw_freep( &vdhp->rap_list );
+        }
         if( vdhp->format )
             lavf_close_file( &vdhp->format );
         return -1;
@@ -293,6 +498,144 @@ int lwlibav_video_get_desired_track
     return 0;
 }
 
+static int64_t lwlibav_get_ts
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    uint32_t                        frame_number
+)
+{
+    return (vdhp->lw_seek_flags & (SEEK_PTS_GENERATED | SEEK_PTS_BASED)) ? vdhp->frame_list[frame_number].pts
+         : (vdhp->lw_seek_flags & SEEK_DTS_BASED)                        ? vdhp->frame_list[frame_number].dts
+         :                                                                 AV_NOPTS_VALUE;
+}
+
+/* Return the number of the source frame of the output frame 'frame_number' by scanning the timestamps from the source frame 'last_ts_frame_number'.
+ * Return 0 if not found. */
+static uint32_t scan_vfr2cfr
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    uint32_t                        frame_number,
+    uint32_t                        last_ts_frame_number
+)
+{
+    /* Convert VFR to CFR. */
+    double target_ts  = (double)((uint64_t)(frame_number - 1) * vohp->cfr_den) / vohp->cfr_num;
+    double current_ts = DBL_MAX;
+    AVRational time_base = vdhp->format->streams[ vdhp->stream_index ]->time_base;
+    int64_t ts = lwlibav_get_ts( vdhp, last_ts_frame_number );
+    if( ts != AV_NOPTS_VALUE )
+    {
+        current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
+        if( target_ts == current_ts )
+            return last_ts_frame_number;
+    }
+    uint32_t composition_frame_number = last_ts_frame_number;
+    double   prev_ts = current_ts;
+    if( target_ts < current_ts )
+    {
+        for( composition_frame_number--;
+             composition_frame_number;
+             composition_frame_number-- )
+        {
+            ts = lwlibav_get_ts( vdhp, composition_frame_number );
+            if( ts != AV_NOPTS_VALUE )
+            {
+                current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
+                prev_ts = current_ts;
+                if( current_ts <= target_ts )
+                    break;
+            }
+        }
+        if( composition_frame_number == 0 )
+            return 0;
+    }
+    double next_target_ts = (double)((uint64_t)frame_number * vohp->cfr_den) / vohp->cfr_num;
+    for( composition_frame_number++;
+         composition_frame_number <= vdhp->frame_count;
+         composition_frame_number++ )
+    {
+        ts = lwlibav_get_ts( vdhp, composition_frame_number );
+        if( ts != AV_NOPTS_VALUE )
+        {
+            current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
+            if( current_ts >= target_ts )
+            {
+                uint32_t prev_composition_frame_number = composition_frame_number;
+                while( lwlibav_get_ts( vdhp, --prev_composition_frame_number ) == AV_NOPTS_VALUE );
+                if( prev_composition_frame_number == 0 )
+                    frame_number = 1;
+                else
+                {
+                    if( current_ts > next_target_ts )
+                        /* Between the current target and the next target, there are no input frames.
+                         * Therefore, output the previous frame. This is absolutely correct. */
+                        frame_number = prev_composition_frame_number;
+                    else
+                    {
+                        if( current_ts > (next_target_ts + target_ts) / 2 )
+                            /* The current frame is far from the current target and should be a candidate for the next target. */
+                            frame_number = prev_composition_frame_number;
+                        else
+                        {
+                            /* Choose the nearest one. */
+                            if( current_ts - target_ts >= target_ts - prev_ts )
+                                frame_number = prev_composition_frame_number;
+                            else
+                                frame_number = composition_frame_number;
+                        }
+                    }
+                }
+                break;
+            }
+            prev_ts = current_ts;
+        }
+    }
+    if( composition_frame_number > vdhp->frame_count )
+        frame_number = vdhp->frame_count;
+    return frame_number;
+}
+
+/* Map all output frames to the source frames in ascending order, which takes linear time in total
+ * and gives the same frames as the sequential requests do, so that each request is a single lookup. */
+static void create_vfr2cfr_map
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp
+)
+{
+    lw_freep( &vohp->cfr_frame_map );
+    uint32_t *map = (uint32_t *)lw_malloc_zero( (vohp->frame_count + 1) * sizeof(uint32_t) );
+    if( !map )
+    {
+        lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to create the VFR to CFR conversion table. Seeking may get slow." );
+        return;
+    }
+    uint32_t last_ts_frame_number = vdhp->frame_count;
+    for( uint32_t i = 1; i <= vohp->frame_count; i++ )
+    {
+        map[i] = scan_vfr2cfr( vdhp, vohp, i, last_ts_frame_number );
+        if( map[i] )
+            last_ts_frame_number = map[i];
+    }
+    vohp->cfr_frame_map = map;
+}
+
+static uint32_t lwlibav_vfr2cfr
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    lwlibav_video_output_handler_t *vohp,
+    uint32_t                        frame_number
+)
+{
+    if( vohp->cfr_frame_map )
+        return frame_number <= vohp->frame_count ? vohp->cfr_frame_map[frame_number] : 0;
+    uint32_t source_frame_number = scan_vfr2cfr( vdhp, vohp, frame_number, vdhp->last_ts_frame_number );
+    if( source_frame_number )
+        vdhp->last_ts_frame_number = source_frame_number;
+    return source_frame_number;
+}
+
 void lwlibav_video_setup_timestamp_info
 (
     lwlibav_file_handler_t         *lwhp,
@@ -308,6 +651,7 @@ void lwlibav_video_setup_timestamp_info
     {
         *framerate_num = (int64_t)vohp->cfr_num;
         *framerate_den = (int64_t)vohp->cfr_den;
+        create_vfr2cfr_map( vdhp, vohp );
         return;
     }
     if( vdhp->frame_count == 1
@@ -459,6 +803,18 @@ static uint32_t correct_current_frame_number
 #undef MATCH_POS
 }
 
+static inline int get_video_packet
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    uint32_t                        picture_number,
+    AVPacket                       *pkt
+)
+{
+    return vdhp->packet_reader
+         ? lwlibav_read_packet( vdhp->packet_reader, picture_number, pkt )
+         : lwlibav_get_av_frame( vdhp->format, vdhp->stream_index, picture_number, pkt );
+}
+
 static int decode_video_picture
 (
     lwlibav_video_decode_handler_t *vdhp,
@@ -473,7 +829,7 @@ static int decode_video_picture
     /* Get a packet containing a frame. */
     uint32_t picture_number = *current;
     AVPacket *pkt = &vdhp->packet;
-    int ret = lwlibav_get_av_frame( vdhp->format, vdhp->stream_index, picture_number, pkt );
+    int ret = get_video_packet( vdhp, picture_number, pkt );
     if( ret > 0 )
         return ret;
     /* Correct the current picture number in order to match DTS since libavformat might have sought wrong position. */
@@ -494,7 +850,7 @@ static int decode_video_picture
     /* Avoid decoding frames until the seek correction caused by too backward is done. */
     while( correction_distance )
     {
-        ret = lwlibav_get_av_frame( vdhp->format, vdhp->stream_index, ++picture_number, pkt );
+        ret = get_video_packet( vdhp, ++picture_number, pkt );
         if( ret > 0 )
             return ret;
         if( pkt->flags & AV_PKT_FLAG_KEY )
@@ -536,20 +892,21 @@ static void find_random_accessible_point
     int is_leading = !!(vdhp->frame_list[presentation_picture_number].flags & LW_VFRAME_FLAG_LEADING);
     if( decoding_picture_number == 0 )
         decoding_picture_number = vdhp->frame_list[presentation_picture_number].sample_number;
-    *rap_number = decoding_picture_number;
-    while( *rap_number )
+    /* Find the number of the random accessible pictures at or before the picture. */
+    uint32_t lo = 0;
+    uint32_t hi = vdhp->rap_count;
+    while( lo < hi )
     {
-        if( vdhp->keyframe_list[ *rap_number ] )
-        {
-            if( !is_leading )
-                break;
-            /* Shall be decoded from more past random access point. */
-            is_leading = 0;
-        }
-        --(*rap_number);
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( vdhp->rap_list[mid] <= decoding_picture_number )
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    if( *rap_number == 0 )
-        *rap_number = 1;
+    /* A leading picture shall be decoded from more past random access point. */
+    if( is_leading && lo )
+        --lo;
+    *rap_number = lo ? vdhp->rap_list[lo - 1] : 1;
 }
 
 static int64_t get_random_accessible_point_position
@@ -595,6 +952,35 @@ static void correct_output_delay
     }
 }
 
+/* Keep a picture the decoder output on the way to the requested one so that requesting it later needs no decoding.
+ * Leading pictures of the random accessible picture may be broken, so they are not kept. */
+static void retain_decoded_picture
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    AVFrame                        *frame,
+    uint32_t                        picture_number,
+    uint32_t                        rap_number
+)
+{
+    if( !vdhp->retain_decoded || vdhp->frame_cache.max_size == 0
+     || picture_number == 0 || picture_number > vdhp->frame_count
+     || rap_number == 0 || rap_number > vdhp->frame_count
+     || is_half_frame( vdhp, picture_number )
+     || (vdhp->frame_list[picture_number].flags & (LW_VFRAME_FLAG_LEADING | LW_VFRAME_FLAG_CORRUPT)) )
+        return;
+    uint32_t rap_presentation_number = vdhp->order_converter
+                                     ? vdhp->order_converter[rap_number].decoding_to_presentation
+                                     : rap_number;
+    if( picture_number < rap_presentation_number )
+        return;
+    /* The output identifier is carried by the PTS, so replace it with the actual one only while referencing. */
+    int64_t output_id = frame->pts;
+    frame->pts = vdhp->frame_list[picture_number].pts;
+    if( lw_frame_cache_retain( &vdhp->frame_cache, picture_number, frame ) < 0 )
+        lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to cache a decoded video frame." );
+    frame->pts = output_id;
+}
+
 static uint32_t seek_video
 (
     lwlibav_video_decode_handler_t *vdhp,
@@ -608,15 +994,35 @@ static uint32_t seek_video
     /* Prepare to decode from random accessible picture. */
     lwlibav_extradata_handler_t *exhp = &vdhp->exh;
     int extradata_index = vdhp->frame_list[rap_number].extradata_index;
+    /* The packets read ahead are stale from here, and the demuxer is also used to update the decoder configuration. */
+    if( vdhp->packet_reader )
+        lwlibav_pause_packet_reader( vdhp->packet_reader );
     if( extradata_index != exhp->current_index )
         /* Update the decoder configuration. */
         lwlibav_update_configuration( (lwlibav_decode_handler_t *)vdhp, rap_number, extradata_index, rap_pos );
     else
         lwlibav_flush_buffers( (lwlibav_decode_handler_t *)vdhp );
     if( vdhp->error )
+    {
+        /* Never leave the reader paused, or it stops reading ahead. */
+        if( vdhp->packet_reader )
+            lwlibav_resume_packet_reader( vdhp->packet_reader );
         return 0;
+    }
     if( av_seek_frame( vdhp->format, vdhp->stream_index, rap_pos, vdhp->av_seek_flags ) < 0 )
         av_seek_frame( vdhp->format, vdhp->stream_index, rap_pos, vdhp->av_seek_flags | AVSEEK_FLAG_ANY );
+    if( vdhp->packet_reader )
+        lwlibav_resume_packet_reader( vdhp->packet_reader );
+    else if( vdhp->prefetch_depth > 0 )
+    {
+        /* Start reading ahead from the first seek, at which the demuxer is no longer used for the setup. */
+        vdhp->packet_reader = lwlibav_open_packet_reader( vdhp->format, vdhp->stream_index, vdhp->prefetch_depth );
+        if( !vdhp->packet_reader )
+        {
+            vdhp->prefetch_depth = 0;
+            lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to start reading packets ahead." );
+        }
+    }
     int      got_picture  = 0;
     int      output_ready = 0;
     int64_t  rap_pts = AV_NOPTS_VALUE;
@@ -652,6 +1058,7 @@ static uint32_t seek_video
                     vdhp->last_half_frame = is_half_frame( vdhp, picture_number );
                     return current + 1;
                 }
+                retain_decoded_picture( vdhp, frame, picture_number, rap_number );
                 decoder_delay = exhp->delay_count;
             }
             else
@@ -812,6 +1219,7 @@ static int get_frame
                     return 0;
                 else if( picture_number > requested_picture_number )
                     return -1;
+                retain_decoded_picture( vdhp, frame, picture_number, rap_number );
             }
             else
                 vdhp->last_half_frame = is_half_frame( vdhp, estimated_picture_number );
@@ -973,6 +1381,9 @@ static int get_requested_picture
     uint32_t last_frame_number = vdhp->last_frame_number + last_half_offset;
     int      seek_mode         = vdhp->seek_mode;
     int64_t  rap_pos           = INT64_MIN;
+    /* Pictures decoded with error ignorance are not reliable enough to be kept.
+     * Repeat control decodes into its own buffers and never looks up the decoded frame cache. */
+    vdhp->retain_decoded = vdhp->gop_retention && seek_mode == SEEK_MODE_NORMAL && frame == vdhp->frame_buffer;
     if( picture_number > last_frame_number
      && picture_number <= last_frame_number + vdhp->forward_seek_threshold )
     {
@@ -1006,6 +1417,7 @@ static int get_requested_picture
                 goto video_fail;
             /* Retry to decode from the same random accessible picture with error ignorance. */
             seek_mode = SEEK_MODE_AGGRESSIVE;
+            vdhp->retain_decoded = 0;
         }
         else
         {
@@ -1211,130 +1623,119 @@ static int lwlibav_repeat_control
     }
 }
 
-static int64_t lwlibav_get_ts
+/* The pixel formats described in the index may not match pixel formats supported by the active decoder.
+ * This selects the best pixel format from supported pixel formats with best effort. */
+static void handle_decoder_pix_fmt
 (
-    lwlibav_video_decode_handler_t *vdhp,
-    uint32_t                        frame_number
+    AVCodecParameters *codecpar,
+    const AVCodec     *codec,
+    enum AVPixelFormat pix_fmt
 )
 {
-    return (vdhp->lw_seek_flags & (SEEK_PTS_GENERATED | SEEK_PTS_BASED)) ? vdhp->frame_list[frame_number].pts
-         : (vdhp->lw_seek_flags & SEEK_DTS_BASED)                        ? vdhp->frame_list[frame_number].dts
-         :                                                                 AV_NOPTS_VALUE;
+    assert( codecpar && codec );
+    if( codec->pix_fmts )
+        codecpar->format = (int)avcodec_find_best_pix_fmt_of_list( codec->pix_fmts, pix_fmt, 1, NULL );
+    else
+        codecpar->format = (int)pix_fmt;
 }
 
-static uint32_t lwlibav_vfr2cfr
+/* The lookahead thread decodes into frame_buffer while the caller is using the output frame,
+ * so the caller takes the decoded frame through cached_frame. */
+static int hand_over_decoded_frame
+(
+    lwlibav_video_decode_handler_t *vdhp
+)
+{
+    av_frame_unref( vdhp->cached_frame );
+    if( av_frame_ref( vdhp->cached_frame, vdhp->frame_buffer ) < 0 )
+        return -1;
+    vdhp->output_cached_frame = 1;
+    return 0;
+}
+
+static int get_video_frame
 (
     lwlibav_video_decode_handler_t *vdhp,
     lwlibav_video_output_handler_t *vohp,
     uint32_t                        frame_number
 )
 {
-    /* Convert VFR to CFR. */
-    double target_ts  = (double)((uint64_t)(frame_number - 1) * vohp->cfr_den) / vohp->cfr_num;
-    double current_ts = DBL_MAX;
-    AVRational time_base = vdhp->format->streams[ vdhp->stream_index ]->time_base;
-    int64_t ts = lwlibav_get_ts( vdhp, vdhp->last_ts_frame_number );
-    if( ts != AV_NOPTS_VALUE )
-    {
-        current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
-        if( target_ts == current_ts )
-            return vdhp->last_ts_frame_number;
-    }
-    uint32_t composition_frame_number = vdhp->last_ts_frame_number;
-    double   prev_ts = current_ts;
-    if( target_ts < current_ts )
+    if( vohp->repeat_control )
+        return lwlibav_repeat_control( vdhp, vohp, frame_number );
+    lw_frame_cache_t *fcp = &vdhp->frame_cache;
+    int output_cached_frame = vdhp->output_cached_frame;
+    if( vdhp->lookahead )
     {
-        for( composition_frame_number--;
-             composition_frame_number;
-             composition_frame_number-- )
+        /* The last output frame is still referenced by cached_frame. */
+        if( frame_number == lw_lookahead_get_last_request( vdhp->lookahead ) )
+            return 1;
+        int ret = lw_lookahead_take( vdhp->lookahead, frame_number, vdhp->cached_frame );
+        if( ret < 0 )
+            return -1;
+        if( ret > 0 )
         {
-            ts = lwlibav_get_ts( vdhp, composition_frame_number );
-            if( ts != AV_NOPTS_VALUE )
-            {
-                current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
-                prev_ts = current_ts;
-                if( current_ts <= target_ts )
-                    break;
-            }
+            vdhp->output_cached_frame = 1;
+            goto put_frame;
         }
-        if( composition_frame_number == 0 )
-            return 0;
     }
-    double next_target_ts = (double)((uint64_t)frame_number * vohp->cfr_den) / vohp->cfr_num;
-    for( composition_frame_number++;
-         composition_frame_number <= vdhp->frame_count;
-         composition_frame_number++ )
+    if( fcp->max_size )
     {
-        ts = lwlibav_get_ts( vdhp, composition_frame_number );
-        if( ts != AV_NOPTS_VALUE )
+        /* The decoder state is left untouched on a hit, so the next miss keeps decoding from where it was. */
+        AVFrame *cached = lw_frame_cache_get( fcp, frame_number );
+        if( cached )
         {
-            current_ts = ((double)(ts - vdhp->min_ts) * time_base.num) / time_base.den;
-            if( current_ts >= target_ts )
-            {
-                uint32_t prev_composition_frame_number = composition_frame_number;
-                while( lwlibav_get_ts( vdhp, --prev_composition_frame_number ) == AV_NOPTS_VALUE );
-                if( prev_composition_frame_number == 0 )
-                    frame_number = 1;
-                else
-                {
-                    if( current_ts > next_target_ts )
-                        /* Between the current target and the next target, there are no input frames.
-                         * Therefore, output the previous frame. This is absolutely correct. */
-                        frame_number = prev_composition_frame_number;
-                    else
-                    {
-                        if( current_ts > (next_target_ts + target_ts) / 2 )
-                            /* The current frame is far from the current target and should be a candidate for the next target. */
-                            frame_number = prev_composition_frame_number;
-                        else
-                        {
-                            /* Choose the nearest one. */
-                            if( current_ts - target_ts >= target_ts - prev_ts )
-                                frame_number = prev_composition_frame_number;
-                            else
-                                frame_number = composition_frame_number;
-                        }
-                    }
-                }
-                break;
-            }
-            prev_ts = current_ts;
+            av_frame_unref( vdhp->cached_frame );
+            if( av_frame_ref( vdhp->cached_frame, cached ) < 0 )
+                return -1;
+            vdhp->output_cached_frame = 1;
+            return 0;
         }
+        vdhp->output_cached_frame = 0;
     }
-    if( composition_frame_number > vdhp->frame_count )
-        frame_number = vdhp->frame_count;
-    vdhp->last_ts_frame_number = frame_number;
-    return frame_number;
+    if( frame_number == vdhp->last_frame_number && !output_cached_frame )
+        return 1;
+    if( get_requested_picture( vdhp, vdhp->frame_buffer, frame_number ) < 0
+     || (vdhp->lookahead && hand_over_decoded_frame( vdhp ) < 0) )
+        return -1;
+put_frame:
+    if( fcp->max_size && lw_frame_cache_put( fcp, frame_number, lwlibav_video_get_frame_buffer( vdhp ) ) < 0 )
+        lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to cache a decoded video frame." );
+    return 0;
 }
 
-/* The pixel formats described in the index may not match pixel formats supported by the active decoder.
- * This selects the best pixel format from supported pixel formats with best effort. */
-static void handle_decoder_pix_fmt
+/* Decode the frame following the requested ones on the lookahead thread. */
+static int decode_video_frame_ahead
 (
-    AVCodecParameters *codecpar,
-    const AVCodec     *codec,
-    enum AVPixelFormat pix_fmt
+    void    *priv,
+    uint32_t frame_number,
+    AVFrame *frame
 )
 {
-    assert( codecpar && codec );
-    if( codec->pix_fmts )
-        codecpar->format = (int)avcodec_find_best_pix_fmt_of_list( codec->pix_fmts, pix_fmt, 1, NULL );
-    else
-        codecpar->format = (int)pix_fmt;
+    lwlibav_video_decode_handler_t *vdhp = (lwlibav_video_decode_handler_t *)priv;
+    if( get_requested_picture( vdhp, vdhp->frame_buffer, frame_number ) < 0 )
+        return -1;
+    return av_frame_ref( frame, vdhp->frame_buffer ) < 0 ? -1 : 0;
 }
 
-static int get_video_frame
+static void start_lookahead
 (
     lwlibav_video_decode_handler_t *vdhp,
-    lwlibav_video_output_handler_t *vohp,
-    uint32_t                        frame_number
+    lwlibav_video_output_handler_t *vohp
 )
 {
-    if( vohp->repeat_control )
-        return lwlibav_repeat_control( vdhp, vohp, frame_number );
-    if( frame_number == vdhp->last_frame_number )
-        return 1;
-    return get_requested_picture( vdhp, vdhp->frame_buffer, frame_number );
+    /* Direct rendering allocates the frame buffers through the front-end on the calling thread,
+     * and repeat control decodes into its own buffers, so neither can decode ahead. */
+    if( !vdhp->ctx || vohp->repeat_control || vdhp->ctx->get_buffer2 != avcodec_default_get_buffer2 )
+        goto disable;
+    if( !vdhp->cached_frame && !(vdhp->cached_frame = av_frame_alloc()) )
+        goto fail;
+    vdhp->lookahead = lw_lookahead_create( vdhp->lookahead_depth, vdhp->frame_count, decode_video_frame_ahead, vdhp );
+    if( vdhp->lookahead )
+        return;
+fail:
+    lw_log_show( &vdhp->lh, LW_LOG_WARNING, "Failed to start decoding frames ahead." );
+disable:
+    vdhp->lookahead_depth = 0;
 }
 
 /* Return 0 if successful.
@@ -1347,15 +1748,21 @@ int lwlibav_video_get_frame
     uint32_t                        frame_number
 )
 {
-    if( vohp->vfr2cfr )
-    {
-        frame_number = lwlibav_vfr2cfr( vdhp, vohp, frame_number );
-        if( frame_number == 0 )
-            return -1;
-    }
-    int ret;
-    if( (ret = get_video_frame( vdhp, vohp, frame_number )) != 0
-     || (ret = update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->lh, vdhp->frame_buffer )) < 0 )
+    if( vdhp->lookahead_depth > 0 && !vdhp->lookahead )
+        start_lookahead( vdhp, vohp );
+    if( vdhp->lookahead )
+        lw_lookahead_pause( vdhp->lookahead );
+    int ret = -1;
+    if( vohp->vfr2cfr
+     && (frame_number = lwlibav_vfr2cfr( vdhp, vohp, frame_number )) == 0 )
+        goto resume;
+    ret = get_video_frame( vdhp, vohp, frame_number );
+resume:
+    /* The thread must be resumed even on failure, or it never decodes ahead again. */
+    if( vdhp->lookahead )
+        lw_lookahead_resume( vdhp->lookahead, frame_number );
+    if( ret != 0
+     || (ret = update_scaler_configuration_if_needed( &vohp->scaler, &vdhp->lh, lwlibav_video_get_frame_buffer( vdhp ) )) < 0 )
         return ret;
     return 0;
 }
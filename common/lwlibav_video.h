@@ -51,11 +51,28 @@ lwlibav_video_decode_handler_t *lwlibav_video_alloc_decode_handler
     void
 );
 
+/* Allocate a decode handler which shares the parsed index with 'vdhp' and has its own demuxer and decoder.
+ * Must be called before lwlibav_import_av_index_entry() on 'vdhp', and 'vdhp' must outlive the duplicate.
+ * Return NULL if failed. */
+lwlibav_video_decode_handler_t *lwlibav_video_duplicate_decode_handler
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    const char                     *file_path,
+    int                             threads
+);
+
 lwlibav_video_output_handler_t *lwlibav_video_alloc_output_handler
 (
     void
 );
 
+/* Allocate an output handler which has the same frame timing and repeat control as 'vohp'.
+ * Return NULL if failed. */
+lwlibav_video_output_handler_t *lwlibav_video_duplicate_output_handler
+(
+    lwlibav_video_output_handler_t *vohp
+);
+
 void lwlibav_video_free_decode_handler
 (
     lwlibav_video_decode_handler_t *vdhp
@@ -114,6 +131,38 @@ void lwlibav_video_set_get_buffer_func
     lwlibav_video_decode_handler_t *vdhp
 );
 
+/* Set the number of packets read ahead of decoding by a dedicated demux thread.
+ * Reading ahead is disabled if set to 0. */
+void lwlibav_video_set_prefetch_depth
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             prefetch_depth
+);
+
+/* Set the maximum number of frames decoded ahead of sequential requests by a dedicated thread.
+ * Decoding ahead is disabled if set to 0. */
+void lwlibav_video_set_lookahead_depth
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             lookahead_depth
+);
+
+/* Set the memory budget in bytes of the decoded frame cache.
+ * The cache is disabled if set to 0. */
+int lwlibav_video_set_frame_cache_size
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    size_t                          max_size
+);
+
+/* Keep the pictures decoded on the way to the requested one in the decoded frame cache if set to non-zero.
+ * Have no effect if the decoded frame cache is disabled. */
+void lwlibav_video_set_gop_retention
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    int                             gop_retention
+);
+
 /*****************************************************************************
  * Getters
  *****************************************************************************/
@@ -152,9 +201,37 @@ AVFrame *lwlibav_video_get_frame_buffer
     lwlibav_video_decode_handler_t *vdhp
 );
 
+void lwlibav_video_get_frame_cache_stats
+(
+    lwlibav_video_decode_handler_t *vdhp,
+    uint64_t                       *hits,
+    uint64_t                       *misses
+);
+
+/* Return the number of requests served by pictures kept by GOP retention, i.e. decodes saved. */
+uint64_t lwlibav_video_get_saved_decode_count
+(
+    lwlibav_video_decode_handler_t *vdhp
+);
+
+/* Return the number of the last requested frame. */
+uint32_t lwlibav_video_get_last_frame_number
+(
+    lwlibav_video_decode_handler_t *vdhp
+);
+
 /*****************************************************************************
  * Others
  *****************************************************************************/
+/* Copy the frame timing and the repeat control of 'src' to 'dst', which has none of them yet.
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lwlibav_video_copy_output_timing
+(
+    lwlibav_video_output_handler_t *dst,
+    lwlibav_video_output_handler_t *src
+);
+
 void lwlibav_video_force_seek
 (
     lwlibav_video_decode_handler_t *vdhp
@@ -66,6 +66,8 @@ struct lwlibav_video_decode_handler_tag
     uint32_t            frame_count;
     AVFrame            *frame_buffer;
     video_frame_info_t *frame_list;         /* stored in presentation order */
+    video_frame_info_t *initial_frame_list; /* the copy of frame_list before creating the frame order list, which settles it
+                                             * This is kept only until the index is registered to the shared index registry. */
     /* */
     uint32_t            forward_seek_threshold;
     int                 seek_mode;
@@ -77,7 +79,9 @@ struct lwlibav_video_decode_handler_tag
     enum AVColorSpace   initial_colorspace;
     AVPacket            packet;
     order_converter_t  *order_converter;            /* maps of decoding to presentation stored in decoding order */
-    uint8_t            *keyframe_list;              /* keyframe list stored in decoding order */
+    uint32_t           *rap_list;                   /* the decoding order numbers of the random accessible pictures in ascending order
+                                                     * This takes 4 bytes per random accessible picture. */
+    uint32_t            rap_count;                  /* the number of the entries in rap_list */
     uint32_t            last_half_frame;            /* The last frame consists of complementary field coded picture pair
                                                      * if set to non-zero, otherwise single frame coded picture. */
     uint32_t            last_frame_number;          /* the number of the last requested frame */
@@ -98,4 +102,17 @@ struct lwlibav_video_decode_handler_tag
     uint32_t            last_ts_frame_number;
     AVRational          actual_time_base;
     int                 strict_cfr;
+    lw_frame_cache_t    frame_cache;                /* decoded frames keyed by frame number */
+    AVFrame            *cached_frame;               /* the frame buffer
+                                                     * where the frame taken from the frame cache is referenced */
+    int                 output_cached_frame;        /* Output cached_frame instead of frame_buffer if set to non-zero. */
+    int                 gop_retention;              /* Keep pictures decoded on the way to the requested one if set to non-zero. */
+    int                 retain_decoded;             /* whether pictures decoded at present are reliable enough to be kept */
+    int                 shared_index;               /* The extradata entries, frame_list, order_converter and rap_list
+                                                     * are owned by another handler if set to non-zero. */
+    lwlibav_shared_index_t *shared_index_ref;       /* the reference to the shared index in the registry if any */
+    int                 prefetch_depth;             /* the maximum number of packets read ahead; 0 means disabled */
+    lwlibav_packet_reader_t *packet_reader;         /* the demux thread reading packets ahead if prefetch_depth is non-zero */
+    int                 lookahead_depth;            /* the maximum number of frames decoded ahead; 0 means disabled */
+    lw_lookahead_t     *lookahead;                  /* the thread decoding frames ahead of sequential requests if lookahead_depth is non-zero */
 };
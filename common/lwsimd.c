@@ -25,14 +25,14 @@
 #ifdef __GNUC__
 static void __cpuid(int CPUInfo[4], int prm)
 {
-    __asm volatile ( "cpuid" :"=a"(CPUInfo[0]), "=b"(CPUInfo[1]), "=c"(CPUInfo[2]), "=d"(CPUInfo[3]) :"a"(prm) );
+    __asm volatile ( "cpuid" :"=a"(CPUInfo[0]), "=b"(CPUInfo[1]), "=c"(CPUInfo[2]), "=d"(CPUInfo[3]) :"a"(prm), "c"(0) );
     return;
 }
 #else
 #include <intrin.h>
 #endif /* __GNUC__ */
 
-static int check_xgetbv( void )
+static int check_xgetbv( uint32_t mask )
 {
 #if defined(_MSC_VER) && defined(_XCR_XFEATURE_ENABLED_MASK)
     uint64_t eax = _xgetbv( _XCR_XFEATURE_ENABLED_MASK );
@@ -43,7 +43,7 @@ static int check_xgetbv( void )
 #else
     uint32_t eax = 0;
 #endif
-    return (eax & 0x6) == 0x6;
+    return (eax & mask) == mask;
 }
 
 int lw_check_sse2()
@@ -71,10 +71,23 @@ int lw_check_avx2()
 {
     int CPUInfo[4];
     __cpuid( CPUInfo, 1 );
-    if( (CPUInfo[2] & 0x18000000) == 0x18000000 && check_xgetbv() )
+    if( (CPUInfo[2] & 0x18000000) == 0x18000000 && check_xgetbv( 0x6 ) )
     {
         __cpuid( CPUInfo, 7 );
         return (CPUInfo[1] & 0x00000020) != 0;
     }
     return 0;
 }
+
+int lw_check_avx512bw()
+{
+    int CPUInfo[4];
+    __cpuid( CPUInfo, 1 );
+    /* The OS has to save the opmask and the full ZMM registers too. */
+    if( (CPUInfo[2] & 0x18000000) == 0x18000000 && check_xgetbv( 0xE6 ) )
+    {
+        __cpuid( CPUInfo, 7 );
+        return (CPUInfo[1] & 0x40010000) == 0x40010000;     /* AVX512F and AVX512BW */
+    }
+    return 0;
+}
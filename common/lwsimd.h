@@ -39,6 +39,7 @@ int lw_check_sse2();
 int lw_check_ssse3();
 int lw_check_sse41();
 int lw_check_avx2();
+int lw_check_avx512bw();
 
 #ifdef __cplusplus
 }
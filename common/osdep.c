@@ -27,6 +27,7 @@
 #include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -65,4 +66,275 @@ FILE *lw_win32_fopen( const char *name, const char *mode )
     return fp;
 }
 
+void *lw_map_file( const char *name, size_t *size )
+{
+    wchar_t *wname = 0;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    if( lw_string_to_wchar( CP_UTF8, name, &wname ) )
+        file = CreateFileW( wname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    lw_freep( &wname );
+    if( file == INVALID_HANDLE_VALUE )
+        return NULL;
+    void *data = NULL;
+    LARGE_INTEGER file_size;
+    if( GetFileSizeEx( file, &file_size ) && file_size.QuadPart > 0 && (uint64_t)file_size.QuadPart <= SIZE_MAX )
+    {
+        HANDLE mapping = CreateFileMappingW( file, NULL, PAGE_READONLY, 0, 0, NULL );
+        if( mapping )
+        {
+            /* The view keeps the mapping object alive after closing its handle. */
+            data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+            CloseHandle( mapping );
+            if( data )
+                *size = (size_t)file_size.QuadPart;
+        }
+    }
+    CloseHandle( file );
+    return data;
+}
+
+void lw_unmap_file( void *data, size_t size )
+{
+    if( data )
+        UnmapViewOfFile( data );
+}
+
+int lw_fseek( FILE *fp, int64_t offset, int whence )
+{
+    return _fseeki64( fp, offset, whence );
+}
+
+struct lw_thread_tag
+{
+    HANDLE handle;
+    void *(*func)( void * );
+    void  *arg;
+    void  *ret;
+};
+
+struct lw_mutex_tag
+{
+    SRWLOCK lock;
+};
+
+struct lw_cond_tag
+{
+    CONDITION_VARIABLE cv;
+};
+
+static DWORD WINAPI lw_thread_entry( LPVOID arg )
+{
+    lw_thread_t thread = (lw_thread_t)arg;
+    thread->ret = thread->func( thread->arg );
+    return 0;
+}
+
+lw_thread_t lw_thread_create( void *(*func)( void * ), void *arg )
+{
+    lw_thread_t thread = (lw_thread_t)lw_malloc_zero( sizeof(struct lw_thread_tag) );
+    if( !thread )
+        return NULL;
+    thread->func   = func;
+    thread->arg    = arg;
+    thread->handle = CreateThread( NULL, 0, lw_thread_entry, thread, 0, NULL );
+    if( !thread->handle )
+        lw_freep( &thread );
+    return thread;
+}
+
+void *lw_thread_join( lw_thread_t thread )
+{
+    if( !thread )
+        return NULL;
+    WaitForSingleObject( thread->handle, INFINITE );
+    CloseHandle( thread->handle );
+    void *ret = thread->ret;
+    lw_free( thread );
+    return ret;
+}
+
+lw_mutex_t lw_mutex_create( void )
+{
+    lw_mutex_t mutex = (lw_mutex_t)lw_malloc_zero( sizeof(struct lw_mutex_tag) );
+    if( mutex )
+        InitializeSRWLock( &mutex->lock );
+    return mutex;
+}
+
+void lw_mutex_destroy( lw_mutex_t mutex )
+{
+    lw_free( mutex );
+}
+
+void lw_mutex_lock( lw_mutex_t mutex )
+{
+    AcquireSRWLockExclusive( &mutex->lock );
+}
+
+void lw_mutex_unlock( lw_mutex_t mutex )
+{
+    ReleaseSRWLockExclusive( &mutex->lock );
+}
+
+lw_cond_t lw_cond_create( void )
+{
+    lw_cond_t cond = (lw_cond_t)lw_malloc_zero( sizeof(struct lw_cond_tag) );
+    if( cond )
+        InitializeConditionVariable( &cond->cv );
+    return cond;
+}
+
+void lw_cond_destroy( lw_cond_t cond )
+{
+    lw_free( cond );
+}
+
+void lw_cond_wait( lw_cond_t cond, lw_mutex_t mutex )
+{
+    SleepConditionVariableSRW( &cond->cv, &mutex->lock, INFINITE, 0 );
+}
+
+void lw_cond_signal( lw_cond_t cond )
+{
+    WakeConditionVariable( &cond->cv );
+}
+
+void lw_cond_broadcast( lw_cond_t cond )
+{
+    WakeAllConditionVariable( &cond->cv );
+}
+
+#else
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "osdep.h"
+#include "utils.h"
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void *lw_map_file( const char *name, size_t *size )
+{
+    int fd = open( name, O_RDONLY );
+    if( fd < 0 )
+        return NULL;
+    void *data = NULL;
+    struct stat file_stat;
+    if( !fstat( fd, &file_stat ) && file_stat.st_size > 0 && (uint64_t)file_stat.st_size <= SIZE_MAX )
+    {
+        data = mmap( NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( data == MAP_FAILED )
+            data = NULL;
+        else
+            *size = (size_t)file_stat.st_size;
+    }
+    close( fd );
+    return data;
+}
+
+void lw_unmap_file( void *data, size_t size )
+{
+    if( data )
+        munmap( data, size );
+}
+
+int lw_fseek( FILE *fp, int64_t offset, int whence )
+{
+    return fseeko( fp, (off_t)offset, whence );
+}
+
+struct lw_thread_tag
+{
+    pthread_t handle;
+};
+
+struct lw_mutex_tag
+{
+    pthread_mutex_t mutex;
+};
+
+struct lw_cond_tag
+{
+    pthread_cond_t cond;
+};
+
+lw_thread_t lw_thread_create( void *(*func)( void * ), void *arg )
+{
+    lw_thread_t thread = (lw_thread_t)lw_malloc_zero( sizeof(struct lw_thread_tag) );
+    if( thread && pthread_create( &thread->handle, NULL, func, arg ) )
+        lw_freep( &thread );
+    return thread;
+}
+
+void *lw_thread_join( lw_thread_t thread )
+{
+    if( !thread )
+        return NULL;
+    void *ret = NULL;
+    pthread_join( thread->handle, &ret );
+    lw_free( thread );
+    return ret;
+}
+
+lw_mutex_t lw_mutex_create( void )
+{
+    lw_mutex_t mutex = (lw_mutex_t)lw_malloc_zero( sizeof(struct lw_mutex_tag) );
+    if( mutex && pthread_mutex_init( &mutex->mutex, NULL ) )
+        lw_freep( &mutex );
+    return mutex;
+}
+
+void lw_mutex_destroy( lw_mutex_t mutex )
+{
+    if( !mutex )
+        return;
+    pthread_mutex_destroy( &mutex->mutex );
+    lw_free( mutex );
+}
+
+void lw_mutex_lock( lw_mutex_t mutex )
+{
+    pthread_mutex_lock( &mutex->mutex );
+}
+
+void lw_mutex_unlock( lw_mutex_t mutex )
+{
+    pthread_mutex_unlock( &mutex->mutex );
+}
+
+lw_cond_t lw_cond_create( void )
+{
+    lw_cond_t cond = (lw_cond_t)lw_malloc_zero( sizeof(struct lw_cond_tag) );
+    if( cond && pthread_cond_init( &cond->cond, NULL ) )
+        lw_freep( &cond );
+    return cond;
+}
+
+void lw_cond_destroy( lw_cond_t cond )
+{
+    if( !cond )
+        return;
+    pthread_cond_destroy( &cond->cond );
+    lw_free( cond );
+}
+
+void lw_cond_wait( lw_cond_t cond, lw_mutex_t mutex )
+{
+    pthread_cond_wait( &cond->cond, &mutex->mutex );
+}
+
+void lw_cond_signal( lw_cond_t cond )
+{
+    pthread_cond_signal( &cond->cond );
+}
+
+void lw_cond_broadcast( lw_cond_t cond )
+{
+    pthread_cond_broadcast( &cond->cond );
+}
+
 #endif
@@ -37,4 +37,39 @@
    int lw_string_from_wchar( int cp, const wchar_t *from, char **to );
 #endif
 
+#include <stdio.h>
+#include <stdint.h>
+/* fseek() with 64-bit offset */
+int lw_fseek( FILE *fp, int64_t offset, int whence );
+
+#include <stddef.h>
+/* Map a whole file into memory for reading.
+ * Return NULL if failed, otherwise the mapped address and its size to '*size'. */
+void *lw_map_file( const char *name, size_t *size );
+void lw_unmap_file( void *data, size_t size );
+
+/* Threading primitives
+ * These are thin wrappers of Win32 threads and POSIX threads. */
+typedef struct lw_thread_tag *lw_thread_t;
+typedef struct lw_mutex_tag  *lw_mutex_t;
+typedef struct lw_cond_tag   *lw_cond_t;
+lw_thread_t lw_thread_create( void *(*func)( void * ), void *arg );
+void *lw_thread_join( lw_thread_t thread );
+lw_mutex_t lw_mutex_create( void );
+void lw_mutex_destroy( lw_mutex_t mutex );
+void lw_mutex_lock( lw_mutex_t mutex );
+void lw_mutex_unlock( lw_mutex_t mutex );
+lw_cond_t lw_cond_create( void );
+void lw_cond_destroy( lw_cond_t cond );
+void lw_cond_wait( lw_cond_t cond, lw_mutex_t mutex );
+void lw_cond_signal( lw_cond_t cond );
+void lw_cond_broadcast( lw_cond_t cond );
+
+/* storage class of per-thread variables */
+#ifdef _MSC_VER
+#  define LW_THREAD_LOCAL __declspec(thread)
+#else
+#  define LW_THREAD_LOCAL __thread
+#endif
+
 #endif
@@ -0,0 +1,239 @@
+/*****************************************************************************
+ * pcm_cache.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include <string.h>
+
+#include "cpp_compat.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+#include <libavutil/samplefmt.h>
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
+
+#include "utils.h"
+#include "pcm_cache.h"
+
+#define PCM_CACHE_BLOCK_LENGTH (1 << 14)    /* in output PCM samples */
+
+struct lw_pcm_cache_block_tag
+{
+    lw_pcm_cache_block_t *prev;
+    lw_pcm_cache_block_t *next;
+    uint8_t              *data;
+    uint64_t              number;   /* the position in units of PCM_CACHE_BLOCK_LENGTH samples */
+    size_t                size;
+};
+
+static void unlink_block
+(
+    lw_pcm_cache_t       *pcp,
+    lw_pcm_cache_block_t *block
+)
+{
+    if( block->prev )
+        block->prev->next = block->next;
+    else
+        pcp->head = block->next;
+    if( block->next )
+        block->next->prev = block->prev;
+    else
+        pcp->tail = block->prev;
+    block->prev = NULL;
+    block->next = NULL;
+}
+
+static void link_block_to_head
+(
+    lw_pcm_cache_t       *pcp,
+    lw_pcm_cache_block_t *block
+)
+{
+    block->prev = NULL;
+    block->next = pcp->head;
+    if( pcp->head )
+        pcp->head->prev = block;
+    else
+        pcp->tail = block;
+    pcp->head = block;
+}
+
+static void remove_block
+(
+    lw_pcm_cache_t       *pcp,
+    lw_pcm_cache_block_t *block
+)
+{
+    unlink_block( pcp, block );
+    pcp->size -= block->size;
+    lw_free( block->data );
+    lw_free( block );
+}
+
+static lw_pcm_cache_block_t *find_block
+(
+    lw_pcm_cache_t *pcp,
+    uint64_t        number
+)
+{
+    /* The number of blocks is bounded by the memory budget, and the blocks being read sequentially
+     * stay near the head, so a linear search is enough. */
+    for( lw_pcm_cache_block_t *block = pcp->head; block; block = block->next )
+        if( block->number == number )
+            return block;
+    return NULL;
+}
+
+/* Return 0 if successful, and then the cache owns 'data'.
+ * Return a negative value otherwise. */
+static int insert_block
+(
+    lw_pcm_cache_t *pcp,
+    uint64_t        number,
+    uint8_t        *data,
+    size_t          size
+)
+{
+    lw_pcm_cache_block_t *block = (lw_pcm_cache_block_t *)lw_malloc_zero( sizeof(lw_pcm_cache_block_t) );
+    if( !block )
+        return -1;
+    block->data   = data;
+    block->number = number;
+    block->size   = size;
+    /* Evict the least recently used blocks until the new one fits in the budget. */
+    while( pcp->tail && pcp->size + size > pcp->max_size )
+        remove_block( pcp, pcp->tail );
+    link_block_to_head( pcp, block );
+    pcp->size += size;
+    return 0;
+}
+
+static int is_same_format
+(
+    const lw_pcm_format_t *a,
+    const lw_pcm_format_t *b
+)
+{
+    return a->channel_layout == b->channel_layout
+        && a->sample_format  == b->sample_format
+        && a->sample_rate    == b->sample_rate
+        && a->block_align    == b->block_align;
+}
+
+void lw_pcm_cache_init
+(
+    lw_pcm_cache_t *pcp,
+    size_t          max_size
+)
+{
+    lw_pcm_cache_clear( pcp );
+    pcp->max_size = max_size;
+}
+
+void lw_pcm_cache_clear
+(
+    lw_pcm_cache_t *pcp
+)
+{
+    while( pcp->head )
+        remove_block( pcp, pcp->head );
+    pcp->size = 0;
+}
+
+uint64_t lw_pcm_cache_get_samples
+(
+    lw_pcm_cache_t        *pcp,
+    const lw_pcm_format_t *format,
+    lw_pcm_cache_decode_t  decode,
+    void                  *priv,
+    void                  *buf,
+    int64_t                start,
+    int64_t                wanted_length
+)
+{
+    size_t block_size = (size_t)PCM_CACHE_BLOCK_LENGTH * format->block_align;
+    if( format->block_align <= 0 || block_size > pcp->max_size )
+        return decode( priv, buf, start, wanted_length );
+    if( !is_same_format( &pcp->format, format ) )
+    {
+        lw_pcm_cache_clear( pcp );
+        pcp->format = *format;
+    }
+    uint8_t *out           = (uint8_t *)buf;
+    uint64_t output_length = 0;
+    if( start < 0 && wanted_length > 0 )
+    {
+        int64_t silence_length = MIN( -start, wanted_length );
+        memset( out, format->sample_format == AV_SAMPLE_FMT_U8 ? 0x80 : 0x00, (size_t)silence_length * format->block_align );
+        out           += (size_t)silence_length * format->block_align;
+        output_length += silence_length;
+        start         += silence_length;
+        wanted_length -= silence_length;
+    }
+    while( wanted_length > 0 )
+    {
+        uint64_t              number = (uint64_t)start / PCM_CACHE_BLOCK_LENGTH;
+        uint64_t              offset = (uint64_t)start % PCM_CACHE_BLOCK_LENGTH;
+        uint64_t              block_length;
+        uint8_t              *data;
+        lw_pcm_cache_block_t *block = find_block( pcp, number );
+        if( block )
+        {
+            if( block != pcp->head )
+            {
+                unlink_block( pcp, block );
+                link_block_to_head( pcp, block );
+            }
+            data         = block->data;
+            block_length = PCM_CACHE_BLOCK_LENGTH;
+        }
+        else
+        {
+            data = (uint8_t *)lw_malloc_zero( block_size );
+            if( !data )
+            {
+                output_length += decode( priv, out, start, wanted_length );
+                break;
+            }
+            /* Decode the whole block so that the following reads within it are served from the cache.
+             * The decoder continues without seeking as long as the blocks are read in order.
+             * A short block is the end of the stream or a failure, so it is not kept. */
+            block_length = decode( priv, data, (int64_t)(number * PCM_CACHE_BLOCK_LENGTH), PCM_CACHE_BLOCK_LENGTH );
+            if( block_length == PCM_CACHE_BLOCK_LENGTH && insert_block( pcp, number, data, block_size ) == 0 )
+                block = pcp->head;
+        }
+        uint64_t copy_length = block_length > offset ? MIN( block_length - offset, (uint64_t)wanted_length ) : 0;
+        memcpy( out, data + offset * format->block_align, (size_t)copy_length * format->block_align );
+        if( !block )
+            lw_free( data );
+        out           += (size_t)copy_length * format->block_align;
+        output_length += copy_length;
+        start         += copy_length;
+        wanted_length -= copy_length;
+        if( block_length < PCM_CACHE_BLOCK_LENGTH )
+            break;
+    }
+    return output_length;
+}
@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * pcm_cache.h
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Resampled PCM block cache
+ * The output PCM samples are kept in blocks of a fixed number of samples, keyed by the block position and the output format.
+ * A read overlapping cached blocks copies them instead of seeking and decoding.
+ * The least recently used blocks are dropped once they exceed max_size bytes. */
+typedef struct lw_pcm_cache_block_tag lw_pcm_cache_block_t;
+
+typedef struct
+{
+    uint64_t            channel_layout;
+    enum AVSampleFormat sample_format;
+    int                 sample_rate;
+    int                 block_align;
+} lw_pcm_format_t;
+
+typedef struct
+{
+    lw_pcm_cache_block_t *head;         /* most recently used */
+    lw_pcm_cache_block_t *tail;         /* least recently used */
+    size_t                size;         /* total bytes of the cached blocks */
+    size_t                max_size;     /* 0 means disabled */
+    lw_pcm_format_t       format;       /* the output format of the cached blocks */
+} lw_pcm_cache_t;
+
+/* Get 'length' output PCM samples from 'start' into 'buf' from the decoder.
+ * Return the number of the output PCM samples, which is less than 'length' only at the end of the stream or on failure. */
+typedef uint64_t (*lw_pcm_cache_decode_t)( void *priv, void *buf, int64_t start, int64_t length );
+
+void lw_pcm_cache_init
+(
+    lw_pcm_cache_t *pcp,
+    size_t          max_size
+);
+
+void lw_pcm_cache_clear
+(
+    lw_pcm_cache_t *pcp
+);
+
+/* Get 'wanted_length' output PCM samples from 'start' into 'buf' in 'format'.
+ * The samples at negative positions are silence, and the missing blocks are got through 'decode'.
+ * Return the number of the output PCM samples. */
+uint64_t lw_pcm_cache_get_samples
+(
+    lw_pcm_cache_t        *pcp,
+    const lw_pcm_format_t *format,
+    lw_pcm_cache_decode_t  decode,
+    void                  *priv,
+    void                  *buf,
+    int64_t                start,
+    int64_t                wanted_length
+);
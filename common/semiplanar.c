@@ -0,0 +1,539 @@
+/*****************************************************************************
+ * semiplanar.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <libavutil/pixfmt.h>
+
+#include "lwsimd.h"
+#include "semiplanar.h"
+
+#include <emmintrin.h>  /* SSE2 */
+
+#if defined(__GNUC__) || _MSC_VER >= 1700
+#define LW_HAS_AVX2 1
+#else
+#define LW_HAS_AVX2 0
+#endif
+
+#if defined(__GNUC__) || _MSC_VER >= 1911
+#define LW_HAS_AVX512 1
+#else
+#define LW_HAS_AVX512 0
+#endif
+
+#if LW_HAS_AVX2 || LW_HAS_AVX512
+#include <immintrin.h>  /* AVX2, AVX-512 */
+#endif
+
+/* Let the compiler emit instructions beyond the baseline only in the functions that need them. */
+#ifdef __GNUC__
+#define LW_TARGET( x ) __attribute__((target(x)))
+#else
+#define LW_TARGET( x )
+#endif
+
+typedef void func_shift_plane16
+(
+    uint16_t       *dst,
+    const uint16_t *src,
+    int             width,
+    int             shift
+);
+
+typedef void func_deinterleave8
+(
+    uint8_t       *dst_u,
+    uint8_t       *dst_v,
+    const uint8_t *src,
+    int            width
+);
+
+typedef void func_deinterleave16
+(
+    uint16_t       *dst_u,
+    uint16_t       *dst_v,
+    const uint16_t *src,
+    int             width,
+    int             shift
+);
+
+typedef struct
+{
+    func_shift_plane16  *shift_plane16;
+    func_deinterleave8  *deinterleave8;
+    func_deinterleave16 *deinterleave16;
+} unpack_kernels_t;
+
+/*****************************************************************************
+ * C
+ *****************************************************************************/
+static void shift_plane16_c
+(
+    uint16_t       *dst,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    for( int x = 0; x < width; x++ )
+        dst[x] = src[x] >> shift;
+}
+
+static void deinterleave8_c
+(
+    uint8_t       *dst_u,
+    uint8_t       *dst_v,
+    const uint8_t *src,
+    int            width
+)
+{
+    for( int x = 0; x < width; x++ )
+    {
+        dst_u[x] = src[2 * x];
+        dst_v[x] = src[2 * x + 1];
+    }
+}
+
+static void deinterleave16_c
+(
+    uint16_t       *dst_u,
+    uint16_t       *dst_v,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    for( int x = 0; x < width; x++ )
+    {
+        dst_u[x] = src[2 * x]     >> shift;
+        dst_v[x] = src[2 * x + 1] >> shift;
+    }
+}
+
+/*****************************************************************************
+ * SSE2
+ *****************************************************************************/
+/* Gather the even words into the lower half and the odd ones into the upper half. */
+static inline __m128i split_epi16_sse2( __m128i uv )
+{
+    uv = _mm_shufflelo_epi16( uv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    uv = _mm_shufflehi_epi16( uv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+    return _mm_shuffle_epi32( uv, _MM_SHUFFLE( 3, 1, 2, 0 ) );
+}
+
+static void shift_plane16_sse2
+(
+    uint16_t       *dst,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    const __m128i count = _mm_cvtsi32_si128( shift );
+    int x = 0;
+    for( ; x + 8 <= width; x += 8 )
+    {
+        __m128i y = _mm_loadu_si128( (const __m128i *)(src + x) );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_srl_epi16( y, count ) );
+    }
+    shift_plane16_c( dst + x, src + x, width - x, shift );
+}
+
+static void deinterleave8_sse2
+(
+    uint8_t       *dst_u,
+    uint8_t       *dst_v,
+    const uint8_t *src,
+    int            width
+)
+{
+    const __m128i mask = _mm_set1_epi16( 0x00FF );
+    int x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i uv0 = _mm_loadu_si128( (const __m128i *)(src + 2 * x) );
+        __m128i uv1 = _mm_loadu_si128( (const __m128i *)(src + 2 * x + 16) );
+        __m128i u   = _mm_packus_epi16( _mm_and_si128( uv0, mask ), _mm_and_si128( uv1, mask ) );
+        __m128i v   = _mm_packus_epi16( _mm_srli_epi16( uv0, 8 ), _mm_srli_epi16( uv1, 8 ) );
+        _mm_storeu_si128( (__m128i *)(dst_u + x), u );
+        _mm_storeu_si128( (__m128i *)(dst_v + x), v );
+    }
+    deinterleave8_c( dst_u + x, dst_v + x, src + 2 * x, width - x );
+}
+
+static void deinterleave16_sse2
+(
+    uint16_t       *dst_u,
+    uint16_t       *dst_v,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    const __m128i count = _mm_cvtsi32_si128( shift );
+    int x = 0;
+    for( ; x + 8 <= width; x += 8 )
+    {
+        __m128i uv0 = split_epi16_sse2( _mm_loadu_si128( (const __m128i *)(src + 2 * x) ) );
+        __m128i uv1 = split_epi16_sse2( _mm_loadu_si128( (const __m128i *)(src + 2 * x + 8) ) );
+        __m128i u   = _mm_unpacklo_epi64( uv0, uv1 );
+        __m128i v   = _mm_unpackhi_epi64( uv0, uv1 );
+        _mm_storeu_si128( (__m128i *)(dst_u + x), _mm_srl_epi16( u, count ) );
+        _mm_storeu_si128( (__m128i *)(dst_v + x), _mm_srl_epi16( v, count ) );
+    }
+    deinterleave16_c( dst_u + x, dst_v + x, src + 2 * x, width - x, shift );
+}
+
+/*****************************************************************************
+ * AVX2
+ *****************************************************************************/
+#if LW_HAS_AVX2
+LW_TARGET( "avx2" )
+static void shift_plane16_avx2
+(
+    uint16_t       *dst,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    const __m128i count = _mm_cvtsi32_si128( shift );
+    int x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m256i y = _mm256_loadu_si256( (const __m256i *)(src + x) );
+        _mm256_storeu_si256( (__m256i *)(dst + x), _mm256_srl_epi16( y, count ) );
+    }
+    shift_plane16_sse2( dst + x, src + x, width - x, shift );
+}
+
+/* The instructions work within each 128-bit lane, so the 64-bit quarters come out as 0, 2, 1, 3. */
+LW_TARGET( "avx2" )
+static void deinterleave8_avx2
+(
+    uint8_t       *dst_u,
+    uint8_t       *dst_v,
+    const uint8_t *src,
+    int            width
+)
+{
+    const __m256i mask = _mm256_set1_epi16( 0x00FF );
+    int x = 0;
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i uv0 = _mm256_loadu_si256( (const __m256i *)(src + 2 * x) );
+        __m256i uv1 = _mm256_loadu_si256( (const __m256i *)(src + 2 * x + 32) );
+        __m256i u   = _mm256_packus_epi16( _mm256_and_si256( uv0, mask ), _mm256_and_si256( uv1, mask ) );
+        __m256i v   = _mm256_packus_epi16( _mm256_srli_epi16( uv0, 8 ), _mm256_srli_epi16( uv1, 8 ) );
+        _mm256_storeu_si256( (__m256i *)(dst_u + x), _mm256_permute4x64_epi64( u, 0xD8 ) );
+        _mm256_storeu_si256( (__m256i *)(dst_v + x), _mm256_permute4x64_epi64( v, 0xD8 ) );
+    }
+    deinterleave8_sse2( dst_u + x, dst_v + x, src + 2 * x, width - x );
+}
+
+/* Each dword holds a U and V pair, so masking and shifting them apart needs no shuffle.
+ * Packing works within each 128-bit lane as well, which leaves one cross-lane permute per output. */
+LW_TARGET( "avx2" )
+static void deinterleave16_avx2
+(
+    uint16_t       *dst_u,
+    uint16_t       *dst_v,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    const __m256i mask    = _mm256_set1_epi32( 0x0000FFFF );
+    const __m128i count_u = _mm_cvtsi32_si128( shift );
+    const __m128i count_v = _mm_cvtsi32_si128( shift + 16 );
+    int x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m256i uv0 = _mm256_loadu_si256( (const __m256i *)(src + 2 * x) );
+        __m256i uv1 = _mm256_loadu_si256( (const __m256i *)(src + 2 * x + 16) );
+        __m256i u   = _mm256_packus_epi32( _mm256_srl_epi32( _mm256_and_si256( uv0, mask ), count_u ),
+                                           _mm256_srl_epi32( _mm256_and_si256( uv1, mask ), count_u ) );
+        __m256i v   = _mm256_packus_epi32( _mm256_srl_epi32( uv0, count_v ), _mm256_srl_epi32( uv1, count_v ) );
+        _mm256_storeu_si256( (__m256i *)(dst_u + x), _mm256_permute4x64_epi64( u, 0xD8 ) );
+        _mm256_storeu_si256( (__m256i *)(dst_v + x), _mm256_permute4x64_epi64( v, 0xD8 ) );
+    }
+    deinterleave16_sse2( dst_u + x, dst_v + x, src + 2 * x, width - x, shift );
+}
+#endif  /* LW_HAS_AVX2 */
+
+/*****************************************************************************
+ * AVX-512BW
+ *****************************************************************************/
+#if LW_HAS_AVX512
+/* The remainder of a row is done by masked loads and stores, which never touch memory beyond the row. */
+LW_TARGET( "avx512f,avx512bw" )
+static void shift_plane16_avx512
+(
+    uint16_t       *dst,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    const __m128i count = _mm_cvtsi32_si128( shift );
+    int x = 0;
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m512i y = _mm512_loadu_si512( (const void *)(src + x) );
+        _mm512_storeu_si512( (void *)(dst + x), _mm512_srl_epi16( y, count ) );
+    }
+    if( x < width )
+    {
+        __mmask32 m = (__mmask32)((1U << (width - x)) - 1);
+        __m512i   y = _mm512_maskz_loadu_epi16( m, src + x );
+        _mm512_mask_storeu_epi16( dst + x, m, _mm512_srl_epi16( y, count ) );
+    }
+}
+
+LW_TARGET( "avx512f,avx512bw" )
+static void deinterleave8_avx512
+(
+    uint8_t       *dst_u,
+    uint8_t       *dst_v,
+    const uint8_t *src,
+    int            width
+)
+{
+    const __m512i mask  = _mm512_set1_epi16( 0x00FF );
+    const __m512i order = _mm512_set_epi64( 7, 5, 3, 1, 6, 4, 2, 0 );
+    for( int x = 0; x < width; x += 64 )
+    {
+        int       n  = width - x;
+        __mmask64 m0 = ~(__mmask64)0;
+        __mmask64 m1 = ~(__mmask64)0;
+        __mmask64 m  = ~(__mmask64)0;
+        if( n < 64 )
+        {
+            m0 = 2 * n >= 64 ? ~(__mmask64)0 : ((__mmask64)1 << (2 * n)) - 1;
+            m1 = 2 * n >  64 ? ((__mmask64)1 << (2 * n - 64)) - 1 : 0;
+            m  = ((__mmask64)1 << n) - 1;
+        }
+        __m512i uv0 = _mm512_maskz_loadu_epi8( m0, src + 2 * x );
+        __m512i uv1 = _mm512_maskz_loadu_epi8( m1, src + 2 * x + 64 );
+        __m512i u   = _mm512_packus_epi16( _mm512_and_si512( uv0, mask ), _mm512_and_si512( uv1, mask ) );
+        __m512i v   = _mm512_packus_epi16( _mm512_srli_epi16( uv0, 8 ), _mm512_srli_epi16( uv1, 8 ) );
+        _mm512_mask_storeu_epi8( dst_u + x, m, _mm512_permutexvar_epi64( order, u ) );
+        _mm512_mask_storeu_epi8( dst_v + x, m, _mm512_permutexvar_epi64( order, v ) );
+    }
+}
+
+LW_TARGET( "avx512f,avx512bw" )
+static void deinterleave16_avx512
+(
+    uint16_t       *dst_u,
+    uint16_t       *dst_v,
+    const uint16_t *src,
+    int             width,
+    int             shift
+)
+{
+    /* Word indices into the concatenation of two vectors: the even ones for U, the odd ones for V. */
+    static const uint16_t LW_ALIGN(64) index_u[32] =
+        {
+             0,  2,  4,  6,  8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30,
+            32, 34, 36, 38, 40, 42, 44, 46, 48, 50, 52, 54, 56, 58, 60, 62
+        };
+    static const uint16_t LW_ALIGN(64) index_v[32] =
+        {
+             1,  3,  5,  7,  9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31,
+            33, 35, 37, 39, 41, 43, 45, 47, 49, 51, 53, 55, 57, 59, 61, 63
+        };
+    const __m512i idx_u = _mm512_load_si512( (const void *)index_u );
+    const __m512i idx_v = _mm512_load_si512( (const void *)index_v );
+    const __m128i count = _mm_cvtsi32_si128( shift );
+    for( int x = 0; x < width; x += 32 )
+    {
+        int       n  = width - x;
+        __mmask32 m0 = ~(__mmask32)0;
+        __mmask32 m1 = ~(__mmask32)0;
+        __mmask32 m  = ~(__mmask32)0;
+        if( n < 32 )
+        {
+            m0 = 2 * n >= 32 ? ~(__mmask32)0 : (__mmask32)((1U << (2 * n)) - 1);
+            m1 = 2 * n >  32 ? (__mmask32)((1U << (2 * n - 32)) - 1) : 0;
+            m  = (__mmask32)((1U << n) - 1);
+        }
+        __m512i uv0 = _mm512_maskz_loadu_epi16( m0, src + 2 * x );
+        __m512i uv1 = _mm512_maskz_loadu_epi16( m1, src + 2 * x + 32 );
+        __m512i u   = _mm512_permutex2var_epi16( uv0, idx_u, uv1 );
+        __m512i v   = _mm512_permutex2var_epi16( uv0, idx_v, uv1 );
+        _mm512_mask_storeu_epi16( dst_u + x, m, _mm512_srl_epi16( u, count ) );
+        _mm512_mask_storeu_epi16( dst_v + x, m, _mm512_srl_epi16( v, count ) );
+    }
+}
+#endif  /* LW_HAS_AVX512 */
+
+/*****************************************************************************
+ * Dispatcher
+ *****************************************************************************/
+static const unpack_kernels_t kernels_sse2   = { shift_plane16_sse2,   deinterleave8_sse2,   deinterleave16_sse2 };
+#if LW_HAS_AVX2
+static const unpack_kernels_t kernels_avx2   = { shift_plane16_avx2,   deinterleave8_avx2,   deinterleave16_avx2 };
+#endif
+#if LW_HAS_AVX512
+static const unpack_kernels_t kernels_avx512 = { shift_plane16_avx512, deinterleave8_avx512, deinterleave16_avx512 };
+#endif
+
+/* The wider 16-bit kernels are still slower than SSE2 in tools/semiplanar_bench.c,
+ * so the 16-bit formats stay on SSE2 until the bench shows a win. */
+static const unpack_kernels_t *get_unpack_kernels
+(
+    int bytes_per_sample
+)
+{
+    if( bytes_per_sample != 1 )
+        return &kernels_sse2;
+    /* Every caller picks the same set, so racing on the first call is harmless. */
+    static const unpack_kernels_t *volatile kernels = NULL;
+    if( !kernels )
+    {
+        const unpack_kernels_t *best = &kernels_sse2;
+#if LW_HAS_AVX512
+        if( lw_check_avx512bw() )
+            best = &kernels_avx512;
+        else
+#endif
+#if LW_HAS_AVX2
+        if( lw_check_avx2() )
+            best = &kernels_avx2;
+#endif
+        kernels = best;
+    }
+    return kernels;
+}
+
+static const struct
+{
+    enum AVPixelFormat input_pixel_format;
+    enum AVPixelFormat output_pixel_format;
+    int                bytes_per_sample;
+    int                shift;       /* the MSB-aligned samples are brought down to the LSBs */
+    int                log2_chroma_w;
+    int                log2_chroma_h;
+} unpack_table[] =
+    {
+        { AV_PIX_FMT_NV12,   AV_PIX_FMT_YUV420P,     1, 0, 1, 1 },
+        { AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE, 2, 6, 1, 1 },
+        { AV_PIX_FMT_P016LE, AV_PIX_FMT_YUV420P16LE, 2, 0, 1, 1 },
+#ifdef AV_PIX_FMT_P210
+        { AV_PIX_FMT_P210LE, AV_PIX_FMT_YUV422P10LE, 2, 6, 1, 0 },
+        { AV_PIX_FMT_P410LE, AV_PIX_FMT_YUV444P10LE, 2, 6, 0, 0 },
+#endif
+#ifdef AV_PIX_FMT_P216
+        { AV_PIX_FMT_P216LE, AV_PIX_FMT_YUV422P16LE, 2, 0, 1, 0 },
+        { AV_PIX_FMT_P416LE, AV_PIX_FMT_YUV444P16LE, 2, 0, 0, 0 },
+#endif
+        { AV_PIX_FMT_NONE,   AV_PIX_FMT_NONE,        0, 0, 0, 0 }
+    };
+
+static int find_unpack_entry
+(
+    enum AVPixelFormat input_pixel_format,
+    enum AVPixelFormat output_pixel_format
+)
+{
+    for( int i = 0; unpack_table[i].input_pixel_format != AV_PIX_FMT_NONE; i++ )
+        if( unpack_table[i].input_pixel_format  == input_pixel_format
+         && unpack_table[i].output_pixel_format == output_pixel_format )
+            return i;
+    return -1;
+}
+
+int lw_check_semiplanar_unpack
+(
+    enum AVPixelFormat input_pixel_format,
+    enum AVPixelFormat output_pixel_format
+)
+{
+    return find_unpack_entry( input_pixel_format, output_pixel_format ) >= 0;
+}
+
+/* Unpack with the given kernel set, which tools/semiplanar_bench.c also calls. */
+static void unpack_semiplanar
+(
+    const unpack_kernels_t *kernels,
+    int                     i,
+    uint8_t        * const *dst_data,
+    const int              *dst_linesize,
+    const uint8_t  * const *src_data,
+    const int              *src_linesize,
+    int                     width,
+    int                     height
+)
+{
+    const int bytes_per_sample = unpack_table[i].bytes_per_sample;
+    const int shift            = unpack_table[i].shift;
+    const int chroma_width     = -((-width)  >> unpack_table[i].log2_chroma_w);
+    const int chroma_height    = -((-height) >> unpack_table[i].log2_chroma_h);
+    /* Y */
+    const uint8_t *src = src_data[0];
+    uint8_t       *dst = dst_data[0];
+    for( int y = 0; y < height; y++ )
+    {
+        if( shift )
+            kernels->shift_plane16( (uint16_t *)dst, (const uint16_t *)src, width, shift );
+        else
+            memcpy( dst, src, (size_t)width * bytes_per_sample );
+        src += src_linesize[0];
+        dst += dst_linesize[0];
+    }
+    /* UV -> U and V */
+    src = src_data[1];
+    uint8_t *dst_u = dst_data[1];
+    uint8_t *dst_v = dst_data[2];
+    for( int y = 0; y < chroma_height; y++ )
+    {
+        if( bytes_per_sample == 1 )
+            kernels->deinterleave8( dst_u, dst_v, src, chroma_width );
+        else
+            kernels->deinterleave16( (uint16_t *)dst_u, (uint16_t *)dst_v, (const uint16_t *)src, chroma_width, shift );
+        src   += src_linesize[1];
+        dst_u += dst_linesize[1];
+        dst_v += dst_linesize[2];
+    }
+}
+
+int lw_unpack_semiplanar
+(
+    enum AVPixelFormat     input_pixel_format,
+    enum AVPixelFormat     output_pixel_format,
+    uint8_t       * const *dst_data,
+    const int             *dst_linesize,
+    const uint8_t * const *src_data,
+    const int             *src_linesize,
+    int                    width,
+    int                    height
+)
+{
+    int i = find_unpack_entry( input_pixel_format, output_pixel_format );
+    if( i < 0 )
+        return -1;
+    unpack_semiplanar( get_unpack_kernels( unpack_table[i].bytes_per_sample ), i, dst_data, dst_linesize, src_data, src_linesize, width, height );
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * semiplanar.h
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Semi-planar YUV (NV12, P010, P016, P210, P216, P410 and P416) to planar YUV
+ * Hardware decoders output these, and swscale is slow at just splitting the chroma plane.
+ * The kernels are chosen at runtime from SSE2, AVX2 and AVX-512BW, and take any alignment and width. */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif  /* __cplusplus */
+
+/* Return 1 if the conversion from 'input_pixel_format' into 'output_pixel_format' is done by lw_unpack_semiplanar().
+ * Return 0 otherwise. */
+int lw_check_semiplanar_unpack
+(
+    enum AVPixelFormat input_pixel_format,
+    enum AVPixelFormat output_pixel_format
+);
+
+/* Unpack the top-left 'width' x 'height' area of the picture into the Y, U and V planes.
+ * Return 0 if successful.
+ * Return a negative value if the conversion is not supported. */
+int lw_unpack_semiplanar
+(
+    enum AVPixelFormat     input_pixel_format,
+    enum AVPixelFormat     output_pixel_format,
+    uint8_t       * const *dst_data,
+    const int             *dst_linesize,
+    const uint8_t * const *src_data,
+    const int             *src_linesize,
+    int                    width,
+    int                    height
+);
+
+#ifdef __cplusplus
+}
+#endif  /* __cplusplus */
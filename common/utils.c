@@ -29,6 +29,9 @@
 #include <math.h>
 
 #include "utils.h"
+#include "osdep.h"
+
+static LW_THREAD_LOCAL int log_muted = 0;
 
 void *lw_malloc_zero( size_t size )
 {
@@ -112,7 +115,7 @@ void lw_log_show
     ...
 )
 {
-    if( !lhp || !lhp->priv || !lhp->show_log || level < lhp->level )
+    if( log_muted || !lhp || !lhp->priv || !lhp->show_log || level < lhp->level )
         return;
     va_list args;
     va_start( args, format );
@@ -122,6 +125,14 @@ void lw_log_show
     lhp->show_log( lhp, level, message );
 }
 
+void lw_log_mute_thread
+(
+    int mute
+)
+{
+    log_muted = mute;
+}
+
 int lw_check_file_extension
 (
     const char *file_name,
@@ -97,6 +97,13 @@ void lw_log_show
     ...
 );
 
+/* Drop the messages lw_log_show() is given on the calling thread if 'mute' is non-zero.
+ * Background threads use this since the log handlers are bound to the threads calling the front-end. */
+void lw_log_mute_thread
+(
+    int mute
+);
+
 static inline uint64_t get_gcd
 (
     uint64_t a,
@@ -27,6 +27,8 @@ extern "C"
 {
 #endif  /* __cplusplus */
 #include <libavutil/opt.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 #ifdef __cplusplus
@@ -34,6 +36,7 @@ extern "C"
 #endif  /* __cplusplus */
 
 #include "utils.h"
+#include "osdep.h"
 #include "video_output.h"
 
 /* If YUV is treated as full range, return 1.
@@ -77,6 +80,7 @@ static void initialize_scaler_handler
     vshp->output_pixel_format = output_pixel_format;
     vshp->input_colorspace    = AVCOL_SPC_UNSPECIFIED;
     vshp->input_yuv_range     = AVCOL_RANGE_UNSPECIFIED;
+    vshp->plane_copy          = 0;
 }
 
 void setup_video_rendering
@@ -146,6 +150,295 @@ static struct SwsContext *update_scaler_configuration
     return sws_ctx;
 }
 
+/* swscale with the same input and output formats does nothing but copying, and is much slower than a plain copy. */
+static int is_plane_copy_possible
+(
+    enum AVPixelFormat input_pixel_format,
+    enum AVPixelFormat output_pixel_format
+)
+{
+    if( input_pixel_format != output_pixel_format )
+        return 0;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( input_pixel_format );
+    return desc && !(desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM));
+}
+
+/*****************************************************************************
+ * Slice-parallel conversion
+ *****************************************************************************/
+/* Each slice is scaled by its own context, whose vertical filters and dither patterns start over at the top of the slice.
+ * So only the conversions without vertical resampling and dithering are split, which keeps the output bit-exact. */
+static int is_slicing_exact
+(
+    enum AVPixelFormat input_pixel_format,
+    enum AVPixelFormat output_pixel_format
+)
+{
+    if( is_plane_copy_possible( input_pixel_format, output_pixel_format ) )
+        return 1;
+    const AVPixFmtDescriptor *src_desc = av_pix_fmt_desc_get( input_pixel_format );
+    const AVPixFmtDescriptor *dst_desc = av_pix_fmt_desc_get( output_pixel_format );
+    if( !src_desc || !dst_desc )
+        return 0;
+    const uint64_t unsupported_flags = AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM;
+    if( (src_desc->flags | dst_desc->flags) & unsupported_flags )
+        return 0;
+    /* The chroma is resampled vertically if the vertical subsampling differs, e.g. from 4:2:0 into 4:2:2.
+     * Conversions between YUV and RGB are not split since RGB has no subsampling. */
+    if( src_desc->log2_chroma_h != dst_desc->log2_chroma_h
+     || (src_desc->flags & AV_PIX_FMT_FLAG_RGB) != (dst_desc->flags & AV_PIX_FMT_FLAG_RGB) )
+        return 0;
+    /* Reducing the bit depth is dithered. */
+    int src_depth = 0;
+    for( int i = 0; i < src_desc->nb_components; i++ )
+        src_depth = MAX( src_depth, src_desc->comp[i].depth );
+    for( int i = 0; i < dst_desc->nb_components; i++ )
+        if( dst_desc->comp[i].depth < src_depth )
+            return 0;
+    return 1;
+}
+
+typedef struct
+{
+    lw_scaler_pool_t  *pool;
+    int                index;
+    lw_thread_t        thread;      /* NULL for the first slice, which the calling thread converts */
+    struct SwsContext *sws_ctx;     /* NULL if plane_copy */
+    int                y;           /* the first row of the slice */
+    int                height;
+} lw_scaler_slice_t;
+
+struct lw_scaler_pool_tag
+{
+    lw_scaler_slice_t         *slices;
+    int                        slice_count;     /* the number of threads including the calling one */
+    int                        active_count;    /* the number of slices the current configuration uses */
+    lw_mutex_t                 mutex;
+    lw_cond_t                  cond;
+    uint32_t                   generation;      /* incremented for each picture to wake up the workers */
+    int                        pending;         /* the number of slices the workers have not finished yet */
+    int                        exit;
+    /* the picture being converted */
+    lw_video_scaler_handler_t *vshp;
+    const AVFrame             *src;
+    uint8_t * const           *dst_data;
+    const int                 *dst_linesize;
+};
+
+static inline int get_plane_shift
+(
+    const AVPixFmtDescriptor *desc,
+    int                       plane
+)
+{
+    return (plane == 1 || plane == 2) ? desc->log2_chroma_h : 0;
+}
+
+static void copy_planes
+(
+    lw_video_scaler_handler_t *vshp,
+    const uint8_t * const     *src_data,
+    const int                 *src_linesize,
+    uint8_t * const           *dst_data,
+    const int                 *dst_linesize,
+    int                        height
+)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( vshp->input_pixel_format );
+    int planes = av_pix_fmt_count_planes( vshp->input_pixel_format );
+    for( int i = 0; i < planes; i++ )
+    {
+        int bytewidth    = av_image_get_linesize( vshp->input_pixel_format, vshp->input_width, i );
+        int plane_height = -((-height) >> get_plane_shift( desc, i ));
+        av_image_copy_plane( dst_data[i], dst_linesize[i], src_data[i], src_linesize[i], bytewidth, plane_height );
+    }
+}
+
+static void convert_slice
+(
+    lw_video_scaler_handler_t *vshp,
+    lw_scaler_slice_t         *slice,
+    const AVFrame             *av_frame,
+    uint8_t * const           *dst_data,
+    const int                 *dst_linesize
+)
+{
+    const AVPixFmtDescriptor *src_desc = av_pix_fmt_desc_get( vshp->input_pixel_format );
+    const AVPixFmtDescriptor *dst_desc = av_pix_fmt_desc_get( vshp->output_pixel_format );
+    int src_planes = av_pix_fmt_count_planes( vshp->input_pixel_format );
+    int dst_planes = av_pix_fmt_count_planes( vshp->output_pixel_format );
+    const uint8_t *src_slice[4] = { NULL };
+    uint8_t       *dst_slice[4] = { NULL };
+    /* Slices start at a row shared by every plane, so the subsampled planes are offset exactly. */
+    for( int i = 0; i < src_planes && i < 4; i++ )
+        src_slice[i] = av_frame->data[i] + (ptrdiff_t)(slice->y >> get_plane_shift( src_desc, i )) * av_frame->linesize[i];
+    for( int i = 0; i < dst_planes && i < 4; i++ )
+        dst_slice[i] = dst_data[i] + (ptrdiff_t)(slice->y >> get_plane_shift( dst_desc, i )) * dst_linesize[i];
+    if( vshp->plane_copy )
+        copy_planes( vshp, src_slice, av_frame->linesize, dst_slice, dst_linesize, slice->height );
+    else
+        sws_scale( slice->sws_ctx, src_slice, av_frame->linesize, 0, slice->height, dst_slice, dst_linesize );
+}
+
+static void *scaler_worker
+(
+    void *arg
+)
+{
+    lw_scaler_slice_t *slice = (lw_scaler_slice_t *)arg;
+    lw_scaler_pool_t  *pool  = slice->pool;
+    uint32_t generation = 0;
+    lw_mutex_lock( pool->mutex );
+    while( 1 )
+    {
+        while( !pool->exit && generation == pool->generation )
+            lw_cond_wait( pool->cond, pool->mutex );
+        if( pool->exit )
+            break;
+        generation = pool->generation;
+        if( slice->index >= pool->active_count )
+            continue;
+        lw_mutex_unlock( pool->mutex );
+        convert_slice( pool->vshp, slice, pool->src, pool->dst_data, pool->dst_linesize );
+        lw_mutex_lock( pool->mutex );
+        if( -- pool->pending == 0 )
+            lw_cond_broadcast( pool->cond );
+    }
+    lw_mutex_unlock( pool->mutex );
+    return NULL;
+}
+
+static void destroy_scaler_pool
+(
+    lw_scaler_pool_t *pool
+)
+{
+    if( !pool )
+        return;
+    if( pool->slices )
+    {
+        lw_mutex_lock( pool->mutex );
+        pool->exit = 1;
+        lw_cond_broadcast( pool->cond );
+        lw_mutex_unlock( pool->mutex );
+        for( int i = 0; i < pool->slice_count; i++ )
+        {
+            if( pool->slices[i].thread )
+                lw_thread_join( pool->slices[i].thread );
+            if( pool->slices[i].sws_ctx )
+                sws_freeContext( pool->slices[i].sws_ctx );
+        }
+        lw_free( pool->slices );
+    }
+    lw_cond_destroy( pool->cond );
+    lw_mutex_destroy( pool->mutex );
+    lw_free( pool );
+}
+
+static lw_scaler_pool_t *create_scaler_pool
+(
+    int threads
+)
+{
+    lw_scaler_pool_t *pool = (lw_scaler_pool_t *)lw_malloc_zero( sizeof(lw_scaler_pool_t) );
+    if( !pool )
+        return NULL;
+    pool->mutex = lw_mutex_create();
+    pool->cond  = lw_cond_create();
+    if( !pool->mutex || !pool->cond )
+        goto fail;
+    pool->slices = (lw_scaler_slice_t *)lw_malloc_zero( threads * sizeof(lw_scaler_slice_t) );
+    if( !pool->slices )
+        goto fail;
+    pool->slice_count = threads;
+    for( int i = 0; i < threads; i++ )
+    {
+        pool->slices[i].pool  = pool;
+        pool->slices[i].index = i;
+    }
+    for( int i = 1; i < threads; i++ )
+    {
+        pool->slices[i].thread = lw_thread_create( scaler_worker, &pool->slices[i] );
+        if( !pool->slices[i].thread )
+            goto fail;
+    }
+    return pool;
+fail:
+    destroy_scaler_pool( pool );
+    return NULL;
+}
+
+/* Split the picture into slices whose boundaries are on the rows where every plane of both formats starts a new row.
+ * The picture is converted as a single slice if splitting could change the output. */
+static int configure_scaler_slices
+(
+    lw_video_scaler_handler_t *vshp,
+    const AVFrame             *av_frame,
+    enum AVPixelFormat         input_pixel_format,
+    int                        yuv_range
+)
+{
+    lw_scaler_pool_t *pool = vshp->pool;
+    int log2_align = MAX( av_pix_fmt_desc_get( input_pixel_format        )->log2_chroma_h,
+                          av_pix_fmt_desc_get( vshp->output_pixel_format )->log2_chroma_h );
+    int count = is_slicing_exact( input_pixel_format, vshp->output_pixel_format )
+              ? MAX( 1, MIN( pool->slice_count, av_frame->height >> log2_align ) )
+              : 1;
+    int rows  = ((av_frame->height / count) >> log2_align) << log2_align;
+    for( int i = 0; i < pool->slice_count; i++ )
+    {
+        lw_scaler_slice_t *slice = &pool->slices[i];
+        if( i >= count || vshp->plane_copy )
+        {
+            if( slice->sws_ctx )
+            {
+                sws_freeContext( slice->sws_ctx );
+                slice->sws_ctx = NULL;
+            }
+            if( i >= count )
+                continue;
+        }
+        slice->y      = i * rows;
+        slice->height = i == count - 1 ? av_frame->height - slice->y : rows;
+        if( vshp->plane_copy )
+            continue;
+        slice->sws_ctx = update_scaler_configuration( slice->sws_ctx, vshp->scaler_flags,
+                                                      av_frame->width, slice->height,
+                                                      input_pixel_format, vshp->output_pixel_format,
+                                                      av_frame->colorspace, yuv_range );
+        if( !slice->sws_ctx )
+            return -1;
+    }
+    pool->active_count = count;
+    return 0;
+}
+
+static int configure_scaler
+(
+    lw_video_scaler_handler_t *vshp,
+    const AVFrame             *av_frame,
+    enum AVPixelFormat         input_pixel_format,
+    int                        yuv_range
+)
+{
+    if( vshp->pool )
+        return configure_scaler_slices( vshp, av_frame, input_pixel_format, yuv_range );
+    if( vshp->plane_copy )
+    {
+        if( vshp->sws_ctx )
+        {
+            sws_freeContext( vshp->sws_ctx );
+            vshp->sws_ctx = NULL;
+        }
+        return 0;
+    }
+    vshp->sws_ctx = update_scaler_configuration( vshp->sws_ctx, vshp->scaler_flags,
+                                                 av_frame->width, av_frame->height,
+                                                 input_pixel_format, vshp->output_pixel_format,
+                                                 av_frame->colorspace, yuv_range );
+    return vshp->sws_ctx ? 0 : -1;
+}
+
 int update_scaler_configuration_if_needed
 (
     lw_video_scaler_handler_t *vshp,
@@ -164,18 +457,34 @@ int update_scaler_configuration_if_needed
         | (vshp->input_pixel_format != *input_pixel_format  ? LW_FRAME_PROP_CHANGE_FLAG_PIXEL_FORMAT : 0)
         | (vshp->input_colorspace   != av_frame->colorspace ? LW_FRAME_PROP_CHANGE_FLAG_COLORSPACE   : 0)
         | (vshp->input_yuv_range    != yuv_range            ? LW_FRAME_PROP_CHANGE_FLAG_YUV_RANGE    : 0);
-    if( !vshp->sws_ctx || vshp->frame_prop_change_flags )
+    if( (!vshp->sws_ctx && !vshp->plane_copy && !vshp->pool) || vshp->frame_prop_change_flags )
     {
         /* Update scaler. */
-        vshp->sws_ctx = update_scaler_configuration( vshp->sws_ctx, vshp->scaler_flags,
-                                                     av_frame->width, av_frame->height,
-                                                     *input_pixel_format, vshp->output_pixel_format,
-                                                     av_frame->colorspace, yuv_range );
-        if( !vshp->sws_ctx )
+        vshp->plane_copy = is_plane_copy_possible( *input_pixel_format, vshp->output_pixel_format );
+        if( vshp->threads > 1 && !vshp->pool && !(vshp->pool = create_scaler_pool( vshp->threads )) )
+        {
+            lw_log_show( lhp, LW_LOG_WARNING, "Failed to create the scaler threads. Video frames are converted on a single thread." );
+            vshp->threads = 1;
+        }
+        if( vshp->pool && vshp->sws_ctx )
         {
+            sws_freeContext( vshp->sws_ctx );
+            vshp->sws_ctx = NULL;
+        }
+        if( configure_scaler( vshp, av_frame, *input_pixel_format, yuv_range ) < 0 )
+        {
+            /* Retry at the next frame even if its properties are the same as the last configured ones. */
+            vshp->input_pixel_format = AV_PIX_FMT_NONE;
             lw_log_show( lhp, LW_LOG_WARNING, "Failed to update video scaler configuration." );
             return -1;
         }
+        int slices = vshp->pool ? vshp->pool->active_count : 1;
+        if( vshp->plane_copy )
+            lw_log_show( lhp, LW_LOG_INFO, "Video frames in %s are copied without the scaler in %d slice(s).",
+                         av_get_pix_fmt_name( *input_pixel_format ), slices );
+        else
+            lw_log_show( lhp, LW_LOG_INFO, "Video frames are converted from %s into %s by the scaler in %d slice(s).",
+                         av_get_pix_fmt_name( *input_pixel_format ), av_get_pix_fmt_name( vshp->output_pixel_format ), slices );
         vshp->input_width        = av_frame->width;
         vshp->input_height       = av_frame->height;
         vshp->input_pixel_format = *input_pixel_format;
@@ -186,6 +495,51 @@ int update_scaler_configuration_if_needed
     return 0;
 }
 
+int scale_video_frame
+(
+    lw_video_scaler_handler_t *vshp,
+    const AVFrame             *av_frame,
+    uint8_t * const           *dst_data,
+    const int                 *dst_linesize
+)
+{
+    lw_scaler_pool_t *pool = vshp->pool;
+    if( pool )
+    {
+        if( pool->active_count > 1 )
+        {
+            lw_mutex_lock( pool->mutex );
+            pool->vshp         = vshp;
+            pool->src          = av_frame;
+            pool->dst_data     = dst_data;
+            pool->dst_linesize = dst_linesize;
+            pool->pending      = pool->active_count - 1;
+            ++ pool->generation;
+            lw_cond_broadcast( pool->cond );
+            lw_mutex_unlock( pool->mutex );
+        }
+        /* The calling thread takes the first slice. */
+        convert_slice( vshp, &pool->slices[0], av_frame, dst_data, dst_linesize );
+        if( pool->active_count > 1 )
+        {
+            lw_mutex_lock( pool->mutex );
+            while( pool->pending > 0 )
+                lw_cond_wait( pool->cond, pool->mutex );
+            lw_mutex_unlock( pool->mutex );
+        }
+        return vshp->input_height;
+    }
+    if( vshp->plane_copy )
+    {
+        copy_planes( vshp, (const uint8_t * const *)av_frame->data, av_frame->linesize, dst_data, dst_linesize, vshp->input_height );
+        return vshp->input_height;
+    }
+    return sws_scale( vshp->sws_ctx,
+                      (const uint8_t * const *)av_frame->data, av_frame->linesize,
+                      0, av_frame->height,
+                      dst_data, dst_linesize );
+}
+
 void lw_cleanup_video_output_handler
 (
     lw_video_output_handler_t *vohp
@@ -195,6 +549,7 @@ void lw_cleanup_video_output_handler
         vohp->free_private_handler( vohp->private_handler );
     vohp->private_handler = NULL;
     lw_freep( &vohp->frame_order_list );
+    lw_freep( &vohp->cfr_frame_map );
     for( int i = 0; i < REPEAT_CONTROL_CACHE_NUM; i++ )
         av_frame_free( &vohp->frame_cache_buffers[i] );
     if( vohp->scaler.sws_ctx )
@@ -202,4 +557,6 @@ void lw_cleanup_video_output_handler
         sws_freeContext( vohp->scaler.sws_ctx );
         vohp->scaler.sws_ctx = NULL;
     }
+    destroy_scaler_pool( vohp->scaler.pool );
+    vohp->scaler.pool = NULL;
 }
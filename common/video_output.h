@@ -28,6 +28,8 @@
 #define LW_FRAME_PROP_CHANGE_FLAG_COLORSPACE   (1<<3)
 #define LW_FRAME_PROP_CHANGE_FLAG_YUV_RANGE    (1<<4)
 
+typedef struct lw_scaler_pool_tag lw_scaler_pool_t;
+
 typedef struct
 {
     int                scaler_flags;
@@ -38,7 +40,10 @@ typedef struct
     enum AVPixelFormat output_pixel_format;
     enum AVColorSpace  input_colorspace;
     int                input_yuv_range;
-    struct SwsContext *sws_ctx;
+    int                plane_copy;      /* The input is copied as it is since it is already in the output pixel format. */
+    struct SwsContext *sws_ctx;         /* NULL if plane_copy or pool */
+    int                threads;         /* the number of slices converted in parallel; 1 or less means the calling thread only */
+    lw_scaler_pool_t  *pool;            /* the worker threads and the scaler of each slice if threads > 1 */
 } lw_video_scaler_handler_t;
 
 typedef struct
@@ -56,6 +61,8 @@ typedef struct
     int                       vfr2cfr;
     uint32_t                  cfr_num;
     uint32_t                  cfr_den;
+    uint32_t                 *cfr_frame_map;    /* the source frame numbers of the output frames, or NULL if not created
+                                                 * This takes 4 bytes per output frame, and its index is 1-origin. */
     /* Repeat control */
     int                       repeat_control;
     int64_t                   repeat_correction_ts;
@@ -97,6 +104,17 @@ int update_scaler_configuration_if_needed
     const AVFrame             *av_frame
 );
 
+/* Convert the picture into the output pixel format, or just copy it if no conversion is needed.
+ * The picture is split into horizontal slices converted in parallel if vshp->threads is greater than 1.
+ * Return the height of the output picture as sws_scale() does. */
+int scale_video_frame
+(
+    lw_video_scaler_handler_t *vshp,
+    const AVFrame             *av_frame,
+    uint8_t * const           *dst_data,
+    const int                 *dst_linesize
+);
+
 void lw_cleanup_video_output_handler
 (
     lw_video_output_handler_t *vohp
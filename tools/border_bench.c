@@ -0,0 +1,287 @@
+/*****************************************************************************
+ * border_bench.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Standalone benchmark of the black background of the VapourSynth output frames of constant format.
+ * The former way copies a whole black frame made at setup into each output frame, and the current way
+ * paints black only the border the picture leaves uncovered, as new_output_video_frame() does.
+ * Both are followed by writing the picture, which is the same for both and timed as well.
+ * VapourSynth is not needed: the frames are plain buffers with 64-byte aligned strides as VapourSynth allocates.
+ *   usage: border_bench [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define STRIDE_ALIGN 64
+#define MAX_REGIONS  6
+
+typedef struct
+{
+    const char *name;
+    int         bytes_per_sample;
+    int         bits_per_sample;
+    int         sub_sampling_w;
+    int         sub_sampling_h;
+} format_t;
+
+typedef struct
+{
+    uint8_t *data  [3];
+    int      stride[3];
+    int      width [3];
+    int      height[3];
+} frame_t;
+
+typedef struct
+{
+    int plane;
+    int x;
+    int y;
+    int width;
+    int height;
+} region_t;
+
+static const format_t formats[] =
+    {
+        { "YUV420P8",  1,  8, 1, 1 },
+        { "YUV420P10", 2, 10, 1, 1 }
+    };
+
+static const struct
+{
+    const char *name;
+    int         width;
+    int         height;
+} sizes[] =
+    {
+        { "1080p", 1920, 1080 },
+        { "2160p", 3840, 2160 },
+        { "4320p", 7680, 4320 }
+    };
+
+static int alloc_frame
+(
+    frame_t        *frame,
+    const format_t *format,
+    int             width,
+    int             height
+)
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        frame->width [i] = width  >> (i ? format->sub_sampling_w : 0);
+        frame->height[i] = height >> (i ? format->sub_sampling_h : 0);
+        frame->stride[i] = (frame->width[i] * format->bytes_per_sample + STRIDE_ALIGN - 1) & ~(STRIDE_ALIGN - 1);
+        frame->data  [i] = (uint8_t *)malloc( (size_t)frame->stride[i] * frame->height[i] );
+        if( !frame->data[i] )
+            return -1;
+    }
+    return 0;
+}
+
+static void free_frame
+(
+    frame_t *frame
+)
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        free( frame->data[i] );
+        frame->data[i] = NULL;
+    }
+}
+
+/* the same as make_black_background_planar_yuv8/16 in VapourSynth/video_output.c */
+static void fill_black
+(
+    frame_t        *frame,
+    const format_t *format,
+    const region_t *region
+)
+{
+    int      stride = frame->stride[region->plane];
+    uint8_t *line   = frame->data[region->plane]
+                    + (size_t)region->y * stride
+                    + (size_t)region->x * format->bytes_per_sample;
+    if( format->bytes_per_sample == 1 || region->plane == 0 || region->height <= 0 )
+    {
+        for( int i = 0; i < region->height; i++, line += stride )
+            memset( line, region->plane ? 0x80 : 0x00, (size_t)region->width * format->bytes_per_sample );
+        return;
+    }
+    uint16_t  v    = 0x0080 << (format->bits_per_sample - 8);
+    uint16_t *data = (uint16_t *)line;
+    for( int i = 0; i < region->width; i++ )
+        data[i] = v;
+    for( int i = 1; i < region->height; i++ )
+        memcpy( line + (size_t)i * stride, line, 2 * region->width );
+}
+
+/* the same as update_border_regions in VapourSynth/video_output.c */
+static int get_border_regions
+(
+    region_t       *regions,
+    const frame_t  *frame,
+    const format_t *format,
+    int             picture_width,
+    int             picture_height
+)
+{
+    int count = 0;
+    for( int i = 0; i < 3; i++ )
+    {
+        int ssw = i ? format->sub_sampling_w : 0;
+        int ssh = i ? format->sub_sampling_h : 0;
+        int covered_width  = (picture_width  + (1 << ssw) - 1) >> ssw;
+        int covered_height = (picture_height + (1 << ssh) - 1) >> ssh;
+        if( covered_width  > frame->width [i] ) covered_width  = frame->width [i];
+        if( covered_height > frame->height[i] ) covered_height = frame->height[i];
+        if( covered_width < frame->width[i] && covered_height > 0 )
+            regions[count++] = (region_t){ i, covered_width, 0, frame->width[i] - covered_width, covered_height };
+        if( covered_height < frame->height[i] )
+            regions[count++] = (region_t){ i, 0, covered_height, frame->width[i], frame->height[i] - covered_height };
+    }
+    return count;
+}
+
+/* Stand in for the conversion of the picture into the covered area. */
+static void write_picture
+(
+    frame_t        *frame,
+    const format_t *format,
+    int             picture_width,
+    int             picture_height
+)
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        int ssw = i ? format->sub_sampling_w : 0;
+        int ssh = i ? format->sub_sampling_h : 0;
+        int width  = (picture_width  + (1 << ssw) - 1) >> ssw;
+        int height = (picture_height + (1 << ssh) - 1) >> ssh;
+        for( int y = 0; y < height; y++ )
+            memset( frame->data[i] + (size_t)y * frame->stride[i], 0x10, (size_t)width * format->bytes_per_sample );
+    }
+}
+
+/* Return the time per frame in milliseconds of the background and of the whole frame, or a negative value on failure. */
+static int time_case
+(
+    const format_t *format,
+    int             output_width,
+    int             output_height,
+    int             picture_width,
+    int             picture_height,
+    int             iterations,
+    double         *ms
+)
+{
+    frame_t black = { { NULL } };
+    frame_t frame = { { NULL } };
+    int ret = -1;
+    if( alloc_frame( &black, format, output_width, output_height ) < 0
+     || alloc_frame( &frame, format, output_width, output_height ) < 0 )
+        goto fail;
+    for( int i = 0; i < 3; i++ )
+        fill_black( &black, format, &(region_t){ i, 0, 0, black.width[i], black.height[i] } );
+    /* Touch every page before timing. */
+    for( int i = 0; i < 3; i++ )
+        memset( frame.data[i], 0, (size_t)frame.stride[i] * frame.height[i] );
+    region_t regions[MAX_REGIONS];
+    int region_count = get_border_regions( regions, &frame, format, picture_width, picture_height );
+    for( int way = 0; way < 2; way++ )
+    {
+        clock_t background = 0;
+        clock_t start      = clock();
+        for( int n = 0; n < iterations; n++ )
+        {
+            clock_t t = clock();
+            if( way == 0 )
+                for( int i = 0; i < 3; i++ )
+                    memcpy( frame.data[i], black.data[i], (size_t)frame.stride[i] * frame.height[i] );
+            else
+                for( int i = 0; i < region_count; i++ )
+                    fill_black( &frame, format, &regions[i] );
+            background += clock() - t;
+            write_picture( &frame, format, picture_width, picture_height );
+        }
+        clock_t total = clock() - start;
+        ms[2 * way]     = (double)background * 1000.0 / CLOCKS_PER_SEC / iterations;
+        ms[2 * way + 1] = (double)total      * 1000.0 / CLOCKS_PER_SEC / iterations;
+    }
+    ret = 0;
+fail:
+    free_frame( &black );
+    free_frame( &frame );
+    return ret;
+}
+
+int main
+(
+    int   argc,
+    char *argv[]
+)
+{
+    int iterations = argc > 1 ? atoi( argv[1] ) : 100;
+    if( iterations <= 0 )
+    {
+        fprintf( stderr, "usage: %s [iterations]\n", argv[0] );
+        return 2;
+    }
+    printf( "ms/frame of the background and of the whole frame, %d iterations.\n", iterations );
+    printf( "  %-9s %-5s %-10s %17s %17s\n", "format", "size", "picture", "whole copy", "border only" );
+    for( int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++ )
+        for( int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ )
+        {
+            int width  = sizes[s].width;
+            int height = sizes[s].height;
+            /* the picture covering the frame, the one in the frame aligned for direct rendering and a smaller one */
+            const struct
+            {
+                const char *name;
+                int         output_width;
+                int         output_height;
+                int         picture_width;
+                int         picture_height;
+            } cases[] =
+                {
+                    { "full",     width,               height,               width,     height     },
+                    { "dr-align", (width + 63) & ~63, (height + 31) & ~31, width,     height     },
+                    { "half",     width,               height,               width / 2, height / 2 }
+                };
+            for( int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++ )
+            {
+                double ms[4];
+                if( time_case( &formats[f], cases[c].output_width, cases[c].output_height,
+                               cases[c].picture_width, cases[c].picture_height, iterations, ms ) < 0 )
+                {
+                    fprintf( stderr, "Failed to allocate frames.\n" );
+                    return 1;
+                }
+                printf( "  %-9s %-5s %-10s %8.3f %8.3f %8.3f %8.3f\n",
+                        formats[f].name, sizes[s].name, cases[c].name, ms[0], ms[1], ms[2], ms[3] );
+            }
+        }
+    return 0;
+}
@@ -0,0 +1,433 @@
+/*****************************************************************************
+ * index_check.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Standalone checks of the Libav reader index on a real input file.
+ * The copies of the input file and their index files are made next to the input file, and removed at the end.
+ *   usage: index_check resume <input> [percent]
+ *     Index the first 'percent' (50 by default) percent of a copy of the input file, append the rest to it and
+ *     index it again, so that the indexing resumes from the checkpoint in the binary index file. The result must
+ *     be the same as indexing the whole file from scratch. Resuming is available only without the text index
+ *     file, so both indexings are done with text_index=0. Use a file without the index by the container, such as
+ *     MPEG-2 TS or raw H.264 ES, which must have two or more coded video sequences to resume from the middle.
+ *   usage: index_check shared <input>
+ *     Open the input file without the index registry with and without the repeat flags applied, and then open it
+ *     several times through the registry. The sources borrowing the index parsed by the first one must get the
+ *     same frames as the ones opened alone. Use a PAFF H.264 sample or a soft telecined MPEG-2 one, where the
+ *     field handling makes the frame count. No index file is written. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <libavformat/avformat.h>
+
+#include "../common/osdep.h"
+#include "../common/utils.h"
+#include "../common/video_output.h"
+#include "../common/audio_output.h"
+#include "../common/lwlibav_dec.h"
+#include "../common/lwlibav_video.h"
+#include "../common/lwlibav_audio.h"
+#include "../common/progress.h"
+#include "../common/lwindex.h"
+
+#define COPY_BUFFER_SIZE (1 << 20)
+
+typedef struct
+{
+    lwlibav_file_handler_t          lwh;
+    lwlibav_video_decode_handler_t *vdhp;
+    lwlibav_video_output_handler_t *vohp;
+    lwlibav_audio_decode_handler_t *adhp;
+    lwlibav_audio_output_handler_t *aohp;
+} source_t;
+
+static void show_log
+(
+    lw_log_handler_t *lhp,
+    lw_log_level      level,
+    const char       *message
+)
+{
+    fprintf( stderr, "%s\n", message );
+}
+
+static void set_default_options
+(
+    lwlibav_option_t *opt,
+    const char       *file_path
+)
+{
+    memset( opt, 0, sizeof(lwlibav_option_t) );
+    opt->file_path         = file_path;
+    opt->force_video_index = -1;
+    opt->force_audio_index = -1;
+    opt->apply_repeat_flag = 1;
+}
+
+static void close_source
+(
+    source_t *src
+)
+{
+    lwlibav_video_free_decode_handler( src->vdhp );
+    lwlibav_video_free_output_handler( src->vohp );
+    lwlibav_audio_free_decode_handler( src->adhp );
+    lwlibav_audio_free_output_handler( src->aohp );
+    lw_free( src->lwh.file_path );
+    lw_free( src->lwh.format_name );
+    memset( src, 0, sizeof(source_t) );
+}
+
+/* Index the input file, or take the index from the index file or the registry. */
+static int open_source
+(
+    source_t         *src,
+    lwlibav_option_t *opt
+)
+{
+    memset( src, 0, sizeof(source_t) );
+    src->vdhp = lwlibav_video_alloc_decode_handler();
+    src->vohp = lwlibav_video_alloc_output_handler();
+    src->adhp = lwlibav_audio_alloc_decode_handler();
+    src->aohp = lwlibav_audio_alloc_output_handler();
+    if( !src->vdhp || !src->vohp || !src->adhp || !src->aohp )
+    {
+        close_source( src );
+        return -1;
+    }
+    lw_log_handler_t lh = { 0 };
+    lh.level    = LW_LOG_WARNING;
+    lh.priv     = src;
+    lh.show_log = show_log;
+    progress_indicator_t indicator = { NULL, NULL, NULL };
+    if( lwlibav_construct_index( &src->lwh, src->vdhp, src->vohp, src->adhp, src->aohp, &lh, opt, &indicator, NULL ) < 0 )
+    {
+        close_source( src );
+        return -1;
+    }
+    return 0;
+}
+
+static char *make_path
+(
+    const char *path,
+    const char *infix
+)
+{
+    /* Keep the extension since the demuxer may be probed by it. */
+    const char *ext = strrchr( path, '.' );
+    if( !ext || strchr( ext, '/' ) || strchr( ext, '\\' ) )
+        ext = path + strlen( path );
+    size_t base_length = ext - path;
+    char *made = (char *)malloc( strlen( path ) + strlen( infix ) + 1 );
+    if( !made )
+        return NULL;
+    memcpy( made, path, base_length );
+    strcpy( made + base_length, infix );
+    strcat( made, ext );
+    return made;
+}
+
+/* Copy the bytes from 'start' to 'end' of the file at 'src_path' to the end of the file at 'dst_path'. */
+static int copy_file
+(
+    const char *dst_path,
+    const char *src_path,
+    const char *mode,
+    int64_t     start,
+    int64_t     end
+)
+{
+    FILE *src = fopen( src_path, "rb" );
+    FILE *dst = fopen( dst_path, mode );
+    uint8_t *buffer = (uint8_t *)malloc( COPY_BUFFER_SIZE );
+    int ret = -1;
+    if( !src || !dst || !buffer || lw_fseek( src, start, SEEK_SET ) )
+        goto done;
+    for( int64_t left = end - start; left > 0; )
+    {
+        size_t size = left < COPY_BUFFER_SIZE ? (size_t)left : COPY_BUFFER_SIZE;
+        if( fread( buffer, 1, size, src ) != size
+         || fwrite( buffer, 1, size, dst ) != size )
+            goto done;
+        left -= size;
+    }
+    ret = 0;
+done:
+    free( buffer );
+    if( dst )
+        fclose( dst );
+    if( src )
+        fclose( src );
+    return ret;
+}
+
+static int64_t get_file_size
+(
+    const char *path
+)
+{
+    FILE *file = fopen( path, "rb" );
+    if( !file )
+        return -1;
+    int64_t size = 0;
+    uint8_t buffer[4096];
+    for( size_t read_size; (read_size = fread( buffer, 1, sizeof(buffer), file )) > 0; )
+        size += read_size;
+    fclose( file );
+    return size;
+}
+
+/* Remove the copy of the input file and its index files. */
+static void remove_copy
+(
+    const char *path
+)
+{
+    static const char *suffixes[] = { "", ".lwi", ".lwib", NULL };
+    for( int i = 0; suffixes[i]; i++ )
+    {
+        char *file_path = (char *)malloc( strlen( path ) + strlen( suffixes[i] ) + 1 );
+        if( !file_path )
+            continue;
+        strcpy( file_path, path );
+        strcat( file_path, suffixes[i] );
+        remove( file_path );
+        free( file_path );
+    }
+}
+
+static int compare_stream_metadata
+(
+    const char                      *name,
+    const lwlibav_stream_metadata_t *expected,
+    const lwlibav_stream_metadata_t *actual
+)
+{
+    if( expected->stream_index != actual->stream_index
+     || expected->frame_count  != actual->frame_count
+     || expected->keyframe_count != actual->keyframe_count )
+    {
+        fprintf( stderr, "  %s: stream %d, %" PRIu32 " frames, %" PRIu32 " keyframes expected, but stream %d, %" PRIu32 " frames, %" PRIu32 " keyframes.\n",
+                 name, expected->stream_index, expected->frame_count, expected->keyframe_count,
+                 actual->stream_index, actual->frame_count, actual->keyframe_count );
+        return -1;
+    }
+    for( uint32_t i = 0; i < expected->frame_count; i++ )
+        if( expected->timestamps[i] != actual->timestamps[i] )
+        {
+            fprintf( stderr, "  %s: the timestamp of frame %" PRIu32 " is %" PRId64 " instead of %" PRId64 ".\n",
+                     name, i, actual->timestamps[i], expected->timestamps[i] );
+            return -1;
+        }
+    for( uint32_t i = 0; i < expected->keyframe_count; i++ )
+        if( expected->keyframes[i] != actual->keyframes[i] )
+        {
+            fprintf( stderr, "  %s: keyframe %" PRIu32 " is frame %" PRIu32 " instead of %" PRIu32 ".\n",
+                     name, i, actual->keyframes[i], expected->keyframes[i] );
+            return -1;
+        }
+    return 0;
+}
+
+static int check_resume
+(
+    const char *input_path,
+    int         percent
+)
+{
+    int64_t file_size = get_file_size( input_path );
+    char *grown_path  = make_path( input_path, ".grown" );
+    char *whole_path  = make_path( input_path, ".whole" );
+    lwlibav_index_metadata_t expected = { { 0 } };
+    lwlibav_index_metadata_t actual   = { { 0 } };
+    int ret = -1;
+    if( file_size <= 0 || !grown_path || !whole_path )
+        goto done;
+    int64_t cut_size = file_size * percent / 100;
+    printf( "Indexing %" PRId64 " of %" PRId64 " bytes, and resuming after the rest is appended.\n", cut_size, file_size );
+    lwlibav_option_t opt;
+    source_t src;
+    /* Index the first part, and then the grown file, which resumes the indexing. */
+    set_default_options( &opt, grown_path );
+    if( copy_file( grown_path, input_path, "wb", 0, cut_size ) < 0
+     || open_source( &src, &opt ) < 0 )
+        goto done;
+    close_source( &src );
+    if( copy_file( grown_path, input_path, "ab", cut_size, file_size ) < 0
+     || open_source( &src, &opt ) < 0 )
+        goto done;
+    close_source( &src );
+    /* Index the whole file from scratch. */
+    set_default_options( &opt, whole_path );
+    if( copy_file( whole_path, input_path, "wb", 0, file_size ) < 0
+     || open_source( &src, &opt ) < 0 )
+        goto done;
+    close_source( &src );
+    /* Compare the indexes. */
+    set_default_options( &opt, whole_path );
+    if( lwlibav_get_index_metadata( &opt, &expected ) < 0 )
+        goto done;
+    set_default_options( &opt, grown_path );
+    if( lwlibav_get_index_metadata( &opt, &actual ) < 0 )
+        goto done;
+    ret = compare_stream_metadata( "video", &expected.video, &actual.video ) < 0
+       || compare_stream_metadata( "audio", &expected.audio, &actual.audio ) < 0 ? 1 : 0;
+    printf( "  %s\n", ret ? "MISMATCH" : "ok" );
+done:
+    if( ret < 0 )
+        fprintf( stderr, "Failed to index the copies of %s.\n", input_path );
+    lwlibav_cleanup_index_metadata( &expected );
+    lwlibav_cleanup_index_metadata( &actual );
+    if( grown_path )
+        remove_copy( grown_path );
+    if( whole_path )
+        remove_copy( whole_path );
+    free( grown_path );
+    free( whole_path );
+    return ret;
+}
+
+typedef struct
+{
+    uint32_t                frame_count;
+    uint32_t                frame_order_count;
+    lw_video_frame_order_t *frame_order_list;
+} video_timing_t;
+
+static int compare_video_timing
+(
+    const char                *name,
+    const video_timing_t      *expected,
+    lw_video_output_handler_t *vohp
+)
+{
+    if( vohp->frame_count != expected->frame_count
+     || vohp->frame_order_count != expected->frame_order_count
+     || (expected->frame_order_list
+      && memcmp( vohp->frame_order_list, expected->frame_order_list,
+                 (expected->frame_order_count + 1) * sizeof(lw_video_frame_order_t) )) )
+    {
+        fprintf( stderr, "  %s: %" PRIu32 " frames expected, but %" PRIu32 " frames, or the frame order differs.\n",
+                 name, expected->frame_count, vohp->frame_count );
+        return -1;
+    }
+    printf( "  %-32s %8" PRIu32 " frames  ok\n", name, vohp->frame_count );
+    return 0;
+}
+
+static int check_shared
+(
+    const char *input_path
+)
+{
+    static const struct
+    {
+        const char *name;
+        int         apply_repeat_flag;
+    } cases[] =
+        {
+            { "owner, repeat=1",    1 },
+            { "borrower, repeat=1", 1 },
+            { "borrower, repeat=0", 0 },
+            { "borrower, repeat=0", 0 },
+            { "borrower, repeat=1", 1 },
+        };
+    const int case_count = sizeof(cases) / sizeof(cases[0]);
+    video_timing_t expected[2] = { { 0 } };
+    source_t       sources[sizeof(cases) / sizeof(cases[0])];
+    int            source_count = 0;
+    int            ret          = -1;
+    lwlibav_option_t opt;
+    /* Get the expected frames by opening the file alone. */
+    for( int repeat = 0; repeat < 2; repeat++ )
+    {
+        source_t src;
+        set_default_options( &opt, input_path );
+        opt.no_create_index   = 1;
+        opt.apply_repeat_flag = repeat;
+        if( open_source( &src, &opt ) < 0 )
+            goto done;
+        expected[repeat].frame_count       = src.vohp->frame_count;
+        expected[repeat].frame_order_count = src.vohp->frame_order_count;
+        if( src.vohp->frame_order_list )
+        {
+            size_t size = (src.vohp->frame_order_count + 1) * sizeof(lw_video_frame_order_t);
+            expected[repeat].frame_order_list = (lw_video_frame_order_t *)malloc( size );
+            if( !expected[repeat].frame_order_list )
+            {
+                close_source( &src );
+                goto done;
+            }
+            memcpy( expected[repeat].frame_order_list, src.vohp->frame_order_list, size );
+        }
+        close_source( &src );
+    }
+    /* Open the file through the registry. The first source is kept open so that the others borrow its index. */
+    lwlibav_setup_index_registry();
+    ret = 0;
+    for( int i = 0; i < case_count; i++ )
+    {
+        set_default_options( &opt, input_path );
+        opt.no_create_index   = 1;
+        opt.apply_repeat_flag = cases[i].apply_repeat_flag;
+        if( open_source( &sources[source_count], &opt ) < 0 )
+        {
+            ret = -1;
+            break;
+        }
+        ++source_count;
+        if( compare_video_timing( cases[i].name, &expected[ cases[i].apply_repeat_flag ], sources[i].vohp ) < 0 )
+            ret = 1;
+    }
+    printf( "  %s\n", ret > 0 ? "MISMATCH" : ret == 0 ? "ok" : "FAILED" );
+done:
+    if( ret < 0 )
+        fprintf( stderr, "Failed to open %s.\n", input_path );
+    while( source_count )
+        close_source( &sources[ --source_count ] );
+    free( expected[0].frame_order_list );
+    free( expected[1].frame_order_list );
+    return ret;
+}
+
+int main
+(
+    int   argc,
+    char *argv[]
+)
+{
+    av_log_set_level( AV_LOG_QUIET );
+    if( argc >= 3 && !strcmp( argv[1], "resume" ) )
+    {
+        int percent = argc > 3 ? atoi( argv[3] ) : 50;
+        if( percent > 0 && percent < 100 )
+            return check_resume( argv[2], percent ) ? 1 : 0;
+    }
+    else if( argc == 3 && !strcmp( argv[1], "shared" ) )
+        return check_shared( argv[2] ) ? 1 : 0;
+    fprintf( stderr, "usage: %s resume <input> [percent]\n"
+                     "       %s shared <input>\n", argv[0], argv[0] );
+    return 2;
+}
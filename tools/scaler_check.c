@@ -0,0 +1,240 @@
+/*****************************************************************************
+ * scaler_check.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Standalone check of the slice-parallel conversion of the output frames.
+ * Random pictures are converted on a single thread and with 'scale_threads', and the outputs must be bit-exact.
+ * The conversions which are not split into slices show "1 slice(s)" in the log.
+ *   usage: scaler_check [scale_threads] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+
+#include "../common/utils.h"
+#include "../common/video_output.h"
+
+typedef struct
+{
+    enum AVPixelFormat input_pixel_format;
+    enum AVPixelFormat output_pixel_format;
+} conversion_t;
+
+static const conversion_t conversions[] =
+    {
+        /* the plain copy */
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P10LE },
+        /* neither vertical resampling nor dithering */
+        { AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P16LE },
+        { AV_PIX_FMT_YUYV422,     AV_PIX_FMT_YUV422P     },
+        { AV_PIX_FMT_YUV444P,     AV_PIX_FMT_YUV444P10LE },
+        { AV_PIX_FMT_GBRP,        AV_PIX_FMT_BGRA        },
+        /* vertical resampling */
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV422P     },
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV444P     },
+        { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_BGRA        },
+        /* dithering */
+        { AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P     },
+        { AV_PIX_FMT_YUV444P16LE, AV_PIX_FMT_YUV444P     },
+        { AV_PIX_FMT_NONE,        AV_PIX_FMT_NONE        }
+    };
+
+static const int scaler_flags[] = { SWS_FAST_BILINEAR, SWS_BICUBIC };
+
+static const struct
+{
+    int width;
+    int height;
+} sizes[] =
+    {
+        { 1920, 1080 },
+        {  723,  477 }
+    };
+
+static void show_log
+(
+    lw_log_handler_t *lhp,
+    lw_log_level      level,
+    const char       *message
+)
+{
+    printf( "    %s\n", message );
+}
+
+static AVFrame *make_random_frame
+(
+    enum AVPixelFormat pixel_format,
+    int                width,
+    int                height
+)
+{
+    AVFrame *frame = av_frame_alloc();
+    if( !frame )
+        return NULL;
+    frame->format = pixel_format;
+    frame->width  = width;
+    frame->height = height;
+    if( av_frame_get_buffer( frame, 0 ) < 0 )
+    {
+        av_frame_free( &frame );
+        return NULL;
+    }
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( pixel_format );
+    for( int i = 0; i < av_pix_fmt_count_planes( pixel_format ); i++ )
+    {
+        int plane_height = (i == 1 || i == 2) ? -((-height) >> desc->log2_chroma_h) : height;
+        size_t size = (size_t)frame->linesize[i] * plane_height;
+        for( size_t j = 0; j < size; j++ )
+            frame->data[i][j] = (uint8_t)rand();
+    }
+    return frame;
+}
+
+/* Convert the frame into a newly allocated picture with the given number of threads. */
+static int convert_frame
+(
+    const AVFrame     *frame,
+    enum AVPixelFormat output_pixel_format,
+    int                flags,
+    int                threads,
+    uint8_t           *dst_data[4],
+    int                dst_linesize[4]
+)
+{
+    lw_log_handler_t lh = { 0 };
+    lh.level    = LW_LOG_INFO;
+    lh.priv     = &lh;
+    lh.show_log = show_log;
+    lw_video_output_handler_t voh = { 0 };
+    setup_video_rendering( &voh, flags, frame->width, frame->height, output_pixel_format, NULL, NULL );
+    voh.scaler.threads = threads;
+    int ret = -1;
+    if( update_scaler_configuration_if_needed( &voh.scaler, &lh, frame ) < 0 )
+        goto fail;
+    if( av_image_alloc( dst_data, dst_linesize, frame->width, frame->height, output_pixel_format, 32 ) < 0 )
+        goto fail;
+    if( scale_video_frame( &voh.scaler, frame, dst_data, dst_linesize ) != frame->height )
+    {
+        av_freep( &dst_data[0] );
+        goto fail;
+    }
+    ret = 0;
+fail:
+    lw_cleanup_video_output_handler( &voh );
+    return ret;
+}
+
+static int compare_pictures
+(
+    uint8_t           *a_data[4],
+    int                a_linesize[4],
+    uint8_t           *b_data[4],
+    int                b_linesize[4],
+    enum AVPixelFormat pixel_format,
+    int                width,
+    int                height
+)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get( pixel_format );
+    for( int i = 0; i < av_pix_fmt_count_planes( pixel_format ); i++ )
+    {
+        int bytewidth    = av_image_get_linesize( pixel_format, width, i );
+        int plane_height = (i == 1 || i == 2) ? -((-height) >> desc->log2_chroma_h) : height;
+        for( int y = 0; y < plane_height; y++ )
+            if( memcmp( a_data[i] + (size_t)y * a_linesize[i], b_data[i] + (size_t)y * b_linesize[i], bytewidth ) )
+            {
+                printf( "    mismatch at row %d of plane %d\n", y, i );
+                return -1;
+            }
+    }
+    return 0;
+}
+
+/* Return 1 if the outputs differ, 0 if they are the same, or -1 on failure. */
+static int check_conversion
+(
+    const conversion_t *conversion,
+    int                 flags,
+    int                 width,
+    int                 height,
+    int                 threads
+)
+{
+    printf( "%s -> %s, %dx%d, flags 0x%x\n",
+            av_get_pix_fmt_name( conversion->input_pixel_format ),
+            av_get_pix_fmt_name( conversion->output_pixel_format ),
+            width, height, flags );
+    AVFrame *frame = make_random_frame( conversion->input_pixel_format, width, height );
+    if( !frame )
+        return -1;
+    uint8_t *whole_data [4] = { NULL };
+    uint8_t *sliced_data[4] = { NULL };
+    int      whole_linesize [4];
+    int      sliced_linesize[4];
+    int ret = -1;
+    if( convert_frame( frame, conversion->output_pixel_format, flags, 1,       whole_data,  whole_linesize  ) < 0
+     || convert_frame( frame, conversion->output_pixel_format, flags, threads, sliced_data, sliced_linesize ) < 0 )
+        goto fail;
+    ret = compare_pictures( whole_data, whole_linesize, sliced_data, sliced_linesize,
+                            conversion->output_pixel_format, width, height ) < 0;
+    printf( "    %s\n", ret ? "MISMATCH" : "ok" );
+fail:
+    av_freep( &whole_data[0] );
+    av_freep( &sliced_data[0] );
+    av_frame_free( &frame );
+    return ret;
+}
+
+int main
+(
+    int   argc,
+    char *argv[]
+)
+{
+    int threads = argc > 1 ? atoi( argv[1] ) : 4;
+    if( threads < 2 || threads > 64 )
+    {
+        fprintf( stderr, "usage: %s [scale_threads]\n", argv[0] );
+        return 2;
+    }
+    int failed = 0;
+    srand( 1 );
+    for( int i = 0; conversions[i].input_pixel_format != AV_PIX_FMT_NONE; i++ )
+        for( int f = 0; f < sizeof(scaler_flags) / sizeof(scaler_flags[0]); f++ )
+            for( int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ )
+            {
+                int ret = check_conversion( &conversions[i], scaler_flags[f], sizes[s].width, sizes[s].height, threads );
+                if( ret < 0 )
+                {
+                    fprintf( stderr, "Failed to convert.\n" );
+                    return 1;
+                }
+                failed |= ret;
+            }
+    return failed;
+}
@@ -0,0 +1,310 @@
+/*****************************************************************************
+ * semiplanar_bench.c
+ *****************************************************************************
+ * Copyright (C) 2026 L-SMASH Works project
+ *
+ * Authors: agent <agent@local>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/* Standalone check and benchmark of the semi-planar unpack kernels.
+ * Every kernel set supported by the CPU is compared with the C version on random widths and misalignments,
+ * and then timed on whole frames.
+ *   usage: semiplanar_bench [width height [iterations]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* The kernels are static, so take in the whole implementation. */
+#include "../common/semiplanar.c"
+
+#define CHECK_COUNT     20000
+#define CHECK_MAX_WIDTH 4096
+#define CHECK_HEIGHT    2
+#define MAX_MISALIGN    64
+
+static const unpack_kernels_t kernels_c = { shift_plane16_c, deinterleave8_c, deinterleave16_c };
+
+typedef struct
+{
+    const char             *name;
+    const unpack_kernels_t *kernels;
+} kernel_set_t;
+
+typedef struct
+{
+    uint8_t *buffer[3];
+    uint8_t *data[3];
+    int      linesize[3];
+} picture_t;
+
+static const char *get_format_name
+(
+    enum AVPixelFormat pixel_format
+)
+{
+    switch( pixel_format )
+    {
+        case AV_PIX_FMT_NV12   : return "NV12";
+        case AV_PIX_FMT_P010LE : return "P010";
+        case AV_PIX_FMT_P016LE : return "P016";
+#ifdef AV_PIX_FMT_P210
+        case AV_PIX_FMT_P210LE : return "P210";
+        case AV_PIX_FMT_P410LE : return "P410";
+#endif
+#ifdef AV_PIX_FMT_P216
+        case AV_PIX_FMT_P216LE : return "P216";
+        case AV_PIX_FMT_P416LE : return "P416";
+#endif
+        default                : return "unknown";
+    }
+}
+
+static int get_kernel_sets
+(
+    kernel_set_t *sets
+)
+{
+    int count = 0;
+    sets[count++] = (kernel_set_t){ "C",    &kernels_c };
+    sets[count++] = (kernel_set_t){ "SSE2", &kernels_sse2 };
+#if LW_HAS_AVX2
+    if( lw_check_avx2() )
+        sets[count++] = (kernel_set_t){ "AVX2", &kernels_avx2 };
+#endif
+#if LW_HAS_AVX512
+    if( lw_check_avx512bw() )
+        sets[count++] = (kernel_set_t){ "AVX-512BW", &kernels_avx512 };
+#endif
+    return count;
+}
+
+/* Allocate a picture whose planes start at 'misalign' bytes past the allocated buffers.
+ * Plane 0 is luma. Planes 1 and 2 are either the interleaved chroma and nothing, or the U and V planes. */
+static int alloc_picture
+(
+    picture_t *picture,
+    int        i,
+    int        semiplanar,
+    int        width,
+    int        height,
+    int        misalign
+)
+{
+    const int bytes_per_sample = unpack_table[i].bytes_per_sample;
+    const int chroma_width     = -((-width)  >> unpack_table[i].log2_chroma_w);
+    const int chroma_height    = -((-height) >> unpack_table[i].log2_chroma_h);
+    const int plane_count      = semiplanar ? 2 : 3;
+    for( int p = 0; p < plane_count; p++ )
+    {
+        int row_width = p == 0 ? width : semiplanar ? 2 * chroma_width : chroma_width;
+        int rows      = p == 0 ? height : chroma_height;
+        picture->linesize[p] = row_width * bytes_per_sample + misalign;
+        picture->buffer  [p] = (uint8_t *)malloc( (size_t)picture->linesize[p] * rows + MAX_MISALIGN );
+        if( !picture->buffer[p] )
+            return -1;
+        picture->data[p] = picture->buffer[p] + misalign;
+    }
+    return 0;
+}
+
+static void free_picture
+(
+    picture_t *picture
+)
+{
+    for( int p = 0; p < 3; p++ )
+    {
+        free( picture->buffer[p] );
+        picture->buffer[p] = NULL;
+    }
+}
+
+static void fill_picture
+(
+    picture_t *picture,
+    int        i,
+    int        height
+)
+{
+    const int chroma_height = -((-height) >> unpack_table[i].log2_chroma_h);
+    for( int p = 0; p < 2; p++ )
+    {
+        size_t size = (size_t)picture->linesize[p] * (p == 0 ? height : chroma_height);
+        for( size_t j = 0; j < size; j++ )
+            picture->data[p][j] = (uint8_t)rand();
+    }
+}
+
+static int compare_pictures
+(
+    picture_t *a,
+    picture_t *b,
+    int        i,
+    int        width,
+    int        height
+)
+{
+    const int bytes_per_sample = unpack_table[i].bytes_per_sample;
+    const int chroma_width     = -((-width)  >> unpack_table[i].log2_chroma_w);
+    const int chroma_height    = -((-height) >> unpack_table[i].log2_chroma_h);
+    for( int p = 0; p < 3; p++ )
+        for( int y = 0; y < (p == 0 ? height : chroma_height); y++ )
+            if( memcmp( a->data[p] + (size_t)y * a->linesize[p],
+                        b->data[p] + (size_t)y * b->linesize[p],
+                        (size_t)(p == 0 ? width : chroma_width) * bytes_per_sample ) )
+                return -1;
+    return 0;
+}
+
+static void unpack_picture
+(
+    const unpack_kernels_t *kernels,
+    int                     i,
+    picture_t              *dst,
+    picture_t              *src,
+    int                     width,
+    int                     height
+)
+{
+    unpack_semiplanar( kernels, i,
+                       dst->data, dst->linesize,
+                       (const uint8_t * const *)src->data, src->linesize,
+                       width, height );
+}
+
+/* Return the number of the mismatches against the C version, or -1 on failure. */
+static int check_kernels
+(
+    const kernel_set_t *set,
+    int                 i
+)
+{
+    int mismatch_count = 0;
+    for( int n = 0; n < CHECK_COUNT; n++ )
+    {
+        int width = 1 + rand() % CHECK_MAX_WIDTH;
+        picture_t src      = { { NULL } };
+        picture_t expected = { { NULL } };
+        picture_t actual   = { { NULL } };
+        if( alloc_picture( &src,      i, 1, width, CHECK_HEIGHT, rand() % MAX_MISALIGN ) < 0
+         || alloc_picture( &expected, i, 0, width, CHECK_HEIGHT, 0 ) < 0
+         || alloc_picture( &actual,   i, 0, width, CHECK_HEIGHT, rand() % MAX_MISALIGN ) < 0 )
+        {
+            free_picture( &src );
+            free_picture( &expected );
+            free_picture( &actual );
+            return -1;
+        }
+        fill_picture( &src, i, CHECK_HEIGHT );
+        unpack_picture( &kernels_c,   i, &expected, &src, width, CHECK_HEIGHT );
+        unpack_picture( set->kernels, i, &actual,   &src, width, CHECK_HEIGHT );
+        if( compare_pictures( &expected, &actual, i, width, CHECK_HEIGHT ) < 0 )
+        {
+            if( mismatch_count == 0 )
+                fprintf( stderr, "%s %s: mismatch at width %d\n", set->name, get_format_name( unpack_table[i].input_pixel_format ), width );
+            ++mismatch_count;
+        }
+        free_picture( &src );
+        free_picture( &expected );
+        free_picture( &actual );
+    }
+    return mismatch_count;
+}
+
+/* Return the average time per frame in milliseconds, or a negative value on failure. */
+static double time_kernels
+(
+    const kernel_set_t *set,
+    int                 i,
+    int                 width,
+    int                 height,
+    int                 iterations
+)
+{
+    picture_t src = { { NULL } };
+    picture_t dst = { { NULL } };
+    if( alloc_picture( &src, i, 1, width, height, 0 ) < 0
+     || alloc_picture( &dst, i, 0, width, height, 0 ) < 0 )
+    {
+        free_picture( &src );
+        free_picture( &dst );
+        return -1.0;
+    }
+    fill_picture( &src, i, height );
+    /* Warm up the caches. */
+    unpack_picture( set->kernels, i, &dst, &src, width, height );
+    clock_t start = clock();
+    for( int n = 0; n < iterations; n++ )
+        unpack_picture( set->kernels, i, &dst, &src, width, height );
+    clock_t end = clock();
+    free_picture( &src );
+    free_picture( &dst );
+    return (double)(end - start) * 1000.0 / CLOCKS_PER_SEC / iterations;
+}
+
+int main
+(
+    int   argc,
+    char *argv[]
+)
+{
+    int width      = argc > 2 ? atoi( argv[1] ) : 1920;
+    int height     = argc > 2 ? atoi( argv[2] ) : 1080;
+    int iterations = argc > 3 ? atoi( argv[3] ) : 200;
+    if( width <= 0 || height <= 0 || iterations <= 0 )
+    {
+        fprintf( stderr, "usage: %s [width height [iterations]]\n", argv[0] );
+        return 2;
+    }
+    kernel_set_t sets[4];
+    int set_count = get_kernel_sets( sets );
+    int failed    = 0;
+    srand( 1 );
+    printf( "Checking against C on %d random widths with random misalignments.\n", CHECK_COUNT );
+    for( int i = 0; unpack_table[i].input_pixel_format != AV_PIX_FMT_NONE; i++ )
+        for( int s = 1; s < set_count; s++ )
+        {
+            int ret = check_kernels( &sets[s], i );
+            if( ret < 0 )
+            {
+                fprintf( stderr, "Failed to allocate pictures.\n" );
+                return 1;
+            }
+            printf( "  %-6s %-10s %s\n", get_format_name( unpack_table[i].input_pixel_format ), sets[s].name, ret ? "MISMATCH" : "ok" );
+            failed |= !!ret;
+        }
+    printf( "Unpacking %dx%d, %d iterations.\n", width, height, iterations );
+    for( int i = 0; unpack_table[i].input_pixel_format != AV_PIX_FMT_NONE; i++ )
+    {
+        double base = 0.0;
+        for( int s = 0; s < set_count; s++ )
+        {
+            double ms = time_kernels( &sets[s], i, width, height, iterations );
+            if( ms < 0.0 )
+            {
+                fprintf( stderr, "Failed to allocate pictures.\n" );
+                return 1;
+            }
+            if( s == 0 )
+                base = ms;
+            printf( "  %-6s %-10s %8.3f ms/frame  x%.2f\n", get_format_name( unpack_table[i].input_pixel_format ), sets[s].name,
+                    ms, ms > 0.0 ? base / ms : 0.0 );
+        }
+    }
+    return failed;
+}